@@ -0,0 +1,315 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Drive a real client/server Transport pair over a simulated network and
+   report keystroke-to-display latency and bytes sent.  Timing is
+   deterministic for a given seed; byte counts vary slightly with the
+   transport's random chaff. */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include <unistd.h>
+
+#include "src/network/networktransport-impl.h"
+#include "src/network/simulatedconnection.h"
+#include "src/statesync/completeterminal.h"
+#include "src/statesync/user.h"
+#include "src/util/fatal_assert.h"
+#include "src/util/locale_utils.h"
+#include "src/util/timestamp.h"
+
+using namespace Network;
+
+typedef Transport<UserStream, Terminal::Complete> ClientTransport;
+typedef Transport<Terminal::Complete, UserStream> ServerTransport;
+
+struct Scenario
+{
+  const char* name;
+  LinkConditions conditions;
+  uint64_t duration;           /* ms of typing */
+  uint64_t keystroke_interval; /* ms between keystrokes */
+  size_t flood_bytes;          /* bytes of host output per flood interval */
+  uint64_t flood_interval;     /* ms */
+  uint64_t stall_at;           /* ms; client process stops running for stall_length */
+  uint64_t stall_length;       /* ms */
+};
+
+static LinkConditions link_conditions( uint64_t latency,
+                                       uint64_t jitter,
+                                       double loss,
+                                       double reorder,
+                                       double duplicate,
+                                       uint64_t bandwidth )
+{
+  LinkConditions c;
+  c.latency = latency;
+  c.jitter = jitter;
+  c.loss = loss;
+  c.reorder = reorder;
+  c.duplicate = duplicate;
+  c.bandwidth = bandwidth;
+  return c;
+}
+
+static const Scenario scenarios[] = {
+  { "lan", link_conditions( 1, 0, 0, 0, 0, 0 ), 20000, 100, 0, 0, 0, 0 },
+  { "wan", link_conditions( 40, 10, 0, 0, 0, 0 ), 20000, 100, 0, 0, 0, 0 },
+  { "lossy", link_conditions( 80, 30, 0.1, 0.05, 0.02, 0 ), 20000, 100, 0, 0, 0, 0 },
+  { "congested", link_conditions( 60, 5, 0.01, 0, 0, 16000 ), 20000, 150, 2000, 100, 0, 0 },
+  { "flood", link_conditions( 20, 5, 0, 0, 0, 1000000 ), 20000, 100, 20000, 50, 0, 0 },
+  { "stall", link_conditions( 20, 5, 0, 0, 0, 1000000 ), 20000, 100, 2000, 20, 10000, 2000 },
+};
+
+static const uint64_t DRAIN_TIME = 10000; /* ms allowed for outstanding echoes */
+
+struct Result
+{
+  std::vector<uint64_t> latencies;
+  size_t keystrokes;
+  size_t frames; /* new remote states the client would render */
+  SimulatedLink::Statistics upstream, downstream;
+};
+
+/* "host application": echo each keystroke as a counter on the status line */
+static std::string echo_keystroke( unsigned int count )
+{
+  char buf[64];
+  snprintf( buf, sizeof buf, "\0337\033[1;1Htyped %u\033[K\0338", count );
+  return buf;
+}
+
+static std::string flood_output( size_t bytes, unsigned int& line )
+{
+  std::string out;
+  while ( out.size() < bytes ) {
+    char buf[128];
+    snprintf( buf, sizeof buf, "line %u: the quick brown fox jumps over the lazy dog\r\n", line++ );
+    out.append( buf );
+  }
+  return out;
+}
+
+/* read the echo counter back out of the client's copy of the screen */
+static unsigned int echoed_keystrokes( const Terminal::Framebuffer& fb )
+{
+  std::string status;
+  for ( int col = 0; col < fb.ds.get_width(); col++ ) {
+    fb.get_cell( 0, col )->print_grapheme( status );
+  }
+  unsigned int count = 0;
+  if ( sscanf( status.c_str(), "typed %u", &count ) != 1 ) {
+    return 0;
+  }
+  return count;
+}
+
+static Result run( const Scenario& scenario, uint64_t seed )
+{
+  uint64_t now = 1000000;
+  set_virtual_timestamp( now );
+
+  std::shared_ptr<SimulatedLink> link( new SimulatedLink( scenario.conditions, seed ) );
+
+  Terminal::Complete terminal( 80, 24 );
+  UserStream blank;
+  std::unique_ptr<ServerTransport> server(
+    ServerTransport::create_with_connection( new SimulatedConnection( link, SimulatedLink::SERVER ), terminal, blank ) );
+  Terminal::Complete local_terminal( 80, 24 );
+  std::unique_ptr<ClientTransport> client( ClientTransport::create_with_connection(
+    new SimulatedConnection( link, SimulatedLink::CLIENT ), blank, local_terminal ) );
+
+  /* keep the status line out of the scrolling region */
+  terminal.act( "\033[2;24r\033[2;1H" );
+  server->set_current_state( terminal );
+
+  const uint64_t start = now;
+  std::vector<uint64_t> typed_at;
+  unsigned int echoed = 0, confirmed = 0, flood_line = 0;
+  uint64_t last_remote_num = server->get_remote_state_num();
+  uint64_t last_client_num = client->get_remote_state_num();
+  Result result;
+  result.frames = 0;
+
+  while ( ( now < start + scenario.duration )
+          || ( ( confirmed < typed_at.size() ) && ( now < start + scenario.duration + DRAIN_TIME ) ) ) {
+    set_virtual_timestamp( now );
+    const uint64_t elapsed = now - start;
+    const bool client_running
+      = ( elapsed < scenario.stall_at ) || ( elapsed >= scenario.stall_at + scenario.stall_length );
+
+    /* user types */
+    if ( client_running && ( elapsed < scenario.duration ) && ( elapsed % scenario.keystroke_interval == 0 ) ) {
+      client->get_current_state().push_back( Parser::UserByte( 'a' + typed_at.size() % 26 ) );
+      typed_at.push_back( now );
+    }
+
+    /* server: receive keystrokes and echo them (one recv() per wakeup,
+       like the select loop in mosh-server) */
+    if ( link->pending( SimulatedLink::SERVER ) ) {
+      server->recv();
+    }
+    if ( server->get_remote_state_num() != last_remote_num ) {
+      last_remote_num = server->get_remote_state_num();
+      UserStream us;
+      us.apply_string( server->get_remote_diff() );
+      for ( size_t i = 0; i < us.size(); i++ ) {
+        if ( typeid( us.get_action( i ) ) == typeid( Parser::UserByte ) ) {
+          terminal.act( echo_keystroke( ++echoed ) );
+        }
+      }
+      server->set_current_state( terminal );
+    }
+
+    /* server: background output */
+    if ( scenario.flood_bytes && ( elapsed < scenario.duration ) && ( elapsed % scenario.flood_interval == 0 ) ) {
+      terminal.act( flood_output( scenario.flood_bytes, flood_line ) );
+      server->set_current_state( terminal );
+    }
+
+    if ( !client_running ) {
+      server->tick();
+      now++;
+      continue;
+    }
+
+    /* client: receive screen updates */
+    if ( link->pending( SimulatedLink::CLIENT ) ) {
+      client->recv();
+    }
+    if ( client->get_remote_state_num() != last_client_num ) {
+      last_client_num = client->get_remote_state_num();
+      result.frames++;
+      const unsigned int shown = echoed_keystrokes( client->get_latest_remote_state().state->get_fb() );
+      for ( ; confirmed < shown && confirmed < typed_at.size(); confirmed++ ) {
+        result.latencies.push_back( now - typed_at[confirmed] );
+      }
+    }
+
+    client->tick();
+    server->tick();
+    now++;
+  }
+
+  result.keystrokes = typed_at.size();
+  result.upstream = link->get_statistics( SimulatedLink::CLIENT );
+  result.downstream = link->get_statistics( SimulatedLink::SERVER );
+  return result;
+}
+
+static uint64_t percentile( const std::vector<uint64_t>& sorted, double p )
+{
+  if ( sorted.empty() ) {
+    return 0;
+  }
+  size_t index = size_t( p * ( sorted.size() - 1 ) + 0.5 );
+  return sorted[index];
+}
+
+static void usage( const char* argv0 )
+{
+  fprintf( stderr, "Usage: %s [-s seed] [scenario ...]\nScenarios:", argv0 );
+  for ( const Scenario& scenario : scenarios ) {
+    fprintf( stderr, " %s", scenario.name );
+  }
+  fprintf( stderr, "\n" );
+}
+
+int main( int argc, char* argv[] )
+{
+  uint64_t seed = 1;
+  int opt;
+  while ( ( opt = getopt( argc, argv, "s:" ) ) != -1 ) {
+    switch ( opt ) {
+      case 's':
+        seed = strtoull( optarg, NULL, 10 );
+        break;
+      default:
+        usage( argv[0] );
+        return 1;
+    }
+  }
+
+  /* Adopt native locale */
+  set_native_locale();
+  fatal_assert( is_utf8_locale() );
+
+  printf( "%-10s %6s %6s %6s %6s %6s %6s %6s %10s %10s %8s\n",
+          "scenario",
+          "keys",
+          "shown",
+          "frames",
+          "p50",
+          "p90",
+          "p99",
+          "max",
+          "up bytes",
+          "down bytes",
+          "dropped" );
+
+  for ( const Scenario& scenario : scenarios ) {
+    if ( optind < argc ) {
+      bool selected = false;
+      for ( int i = optind; i < argc; i++ ) {
+        selected = selected || !strcmp( argv[i], scenario.name );
+      }
+      if ( !selected ) {
+        continue;
+      }
+    }
+
+    Result result = run( scenario, seed );
+    std::sort( result.latencies.begin(), result.latencies.end() );
+    printf( "%-10s %6zu %6zu %6zu %6lu %6lu %6lu %6lu %10lu %10lu %8lu\n",
+            scenario.name,
+            result.keystrokes,
+            result.latencies.size(),
+            result.frames,
+            (unsigned long)percentile( result.latencies, 0.5 ),
+            (unsigned long)percentile( result.latencies, 0.9 ),
+            (unsigned long)percentile( result.latencies, 0.99 ),
+            (unsigned long)percentile( result.latencies, 1.0 ),
+            (unsigned long)result.upstream.bytes_sent,
+            (unsigned long)result.downstream.bytes_sent,
+            (unsigned long)( result.upstream.packets_dropped + result.downstream.packets_dropped ) );
+  }
+
+  return 0;
+}
@@ -197,9 +197,7 @@ static int vt_parser( int fd, Parser::UTF8Parser* parser )
   for ( int i = 0; i < bytes_read; i++ ) {
     parser->input( buf[i], actions );
     for ( Parser::Actions::iterator j = actions.begin(); j != actions.end(); j++ ) {
-
-      assert( *j );
-      Parser::Action& act = **j;
+      const Parser::Action& act = Parser::get_action( *j );
 
       if ( act.char_present ) {
         if ( iswprint( act.ch ) ) {
@@ -0,0 +1,875 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Measure host-output throughput through the parser alone and through the
+   full terminal emulator, over a set of generated workloads.  Also counts
+   heap allocations per kilobyte of input, which should be zero for the
+   parser once its action buffer has grown, and for the emulator once
+   the row pool has filled.  Flood throughput is the emulator's when
+   fed in reads as large as mosh-server takes during a flood.  Scroll
+   throughput is the emulator's while it keeps a scrollback, and compact
+   throughput that of turning its rows into compressed text.  Frame
+   time is the mean cost of computing the screen update after each host
+   read, and sent bytes the size of the updates per kilobyte of output
+   read in small pieces; echo time is the cost for a single typed
+   character on a 400-column screen.  Repaint time is that of redrawing
+   the whole screen into a reused buffer, as the client does, along with
+   the allocations each repaint makes once warmed up.  With -M, reports instead the memory
+   held by a terminal's rows after each workload, and with -W the cost
+   of a character width lookup over the workload's characters, from
+   the emulator's compiled table and from the C library's wcwidth(). */
+
+#include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "src/statesync/completeterminal.h"
+#include "src/terminal/charwidth.h"
+#include "src/terminal/parser.h"
+#include "src/terminal/terminalscrollback.h"
+#include "src/terminal/terminaldisplay.h"
+#include "src/util/fatal_assert.h"
+#include "src/util/locale_utils.h"
+
+static size_t allocation_count = 0;
+static size_t live_bytes = 0;
+
+/* each block is prefixed with its size, so that deletes can be counted */
+static const size_t HEADER = alignof( std::max_align_t );
+
+void* operator new( size_t size )
+{
+  allocation_count++;
+  live_bytes += size;
+  char* p = static_cast<char*>( malloc( HEADER + size ) );
+  if ( p == NULL ) {
+    throw std::bad_alloc();
+  }
+  memcpy( p, &size, sizeof size );
+  return p + HEADER;
+}
+
+/* out of line, so the compiler doesn't see free() of a pointer it knows came from new */
+__attribute__( ( noinline ) ) void operator delete( void* p ) noexcept
+{
+  if ( p == NULL ) {
+    return;
+  }
+  char* block = static_cast<char*>( p ) - HEADER;
+  size_t size;
+  memcpy( &size, block, sizeof size );
+  live_bytes -= size;
+  free( block );
+}
+
+void operator delete( void* p, size_t ) noexcept
+{
+  operator delete( p );
+}
+
+static const int WIDTH = 80;
+static const int HEIGHT = 24;
+static const size_t CHUNK = 4096;         /* bytes per host read */
+static const size_t FLOOD_CHUNK = 262144; /* bytes per host read as mosh-server drains a flood */
+static const size_t UPDATE_CHUNK = 256;   /* bytes per host read as a program answers a keystroke */
+
+/* Plain text lines, like `cat` of a source file. */
+static std::string make_ascii( size_t target )
+{
+  static const char* words[] = { "static", "int", "return", "const", "void", "if", "(",
+                                 ")",      "{",   "}",      "x",     "=",    "0;" };
+  std::string out;
+  unsigned int n = 1;
+  while ( out.size() < target ) {
+    size_t line = 0;
+    while ( line < 70 ) {
+      n = n * 1103515245 + 12345;
+      const char* w = words[( n >> 16 ) % ( sizeof( words ) / sizeof( words[0] ) )];
+      out += w;
+      out += ' ';
+      line += strlen( w ) + 1;
+    }
+    out += "\r\n";
+  }
+  return out;
+}
+
+/* `tail -f` of a log: short lines, so nearly every few bytes scroll
+   the whole screen. */
+static std::string make_tail( size_t target )
+{
+  std::string out;
+  unsigned int n = 1;
+  char buf[64];
+  while ( out.size() < target ) {
+    n = n * 1103515245 + 12345;
+    snprintf( buf, sizeof( buf ), "12:%02u:%02u GET /%u 200\r\n", ( n >> 8 ) % 60, ( n >> 16 ) % 60, n % 1000 );
+    out += buf;
+  }
+  return out;
+}
+
+/* Colorized listing: an SGR sequence around every word. */
+static std::string make_sgr( size_t target )
+{
+  std::string out;
+  unsigned int n = 1;
+  char buf[64];
+  while ( out.size() < target ) {
+    for ( int i = 0; i < 6; i++ ) {
+      n = n * 1103515245 + 12345;
+      snprintf( buf, sizeof( buf ), "\033[01;%dmfile%04u\033[0m  ", 30 + ( n >> 16 ) % 8, ( n >> 8 ) % 10000 );
+      out += buf;
+    }
+    out += "\r\n";
+  }
+  return out;
+}
+
+/* Full-screen editor redraw: cursor positioning, erase, short text runs. */
+static std::string make_cursor( size_t target )
+{
+  std::string out;
+  unsigned int n = 1;
+  char buf[64];
+  while ( out.size() < target ) {
+    for ( int row = 1; row <= HEIGHT; row++ ) {
+      n = n * 1103515245 + 12345;
+      snprintf( buf, sizeof( buf ), "\033[%d;%dH\033[K", row, 1 + ( n >> 16 ) % 40 );
+      out += buf;
+      out += "    if ( x ) { return y; }";
+    }
+  }
+  return out;
+}
+
+/* vim: syntax-highlighted redraws inside a scrolling region, with
+   insert/delete line and a status line. */
+static std::string make_vim( size_t target )
+{
+  std::string out;
+  unsigned int n = 1;
+  char buf[256];
+  out += "\033[1;23r";
+  while ( out.size() < target ) {
+    n = n * 1103515245 + 12345;
+    const int row = 1 + ( n >> 16 ) % 23;
+    snprintf( buf,
+              sizeof( buf ),
+              "\033[%d;1H\033[L\033[38;5;130mstatic\033[m \033[38;5;28mint\033[m \033[1mparse_%u\033[m( "
+              "\033[38;5;28mconst\033[m \033[38;5;28mchar\033[m* s ) \033[38;5;244m/* line %u */\033[m\033[K",
+              row,
+              n % 1000,
+              n % 5000 );
+    out += buf;
+    if ( n % 4 == 0 ) {
+      snprintf(
+        buf, sizeof( buf ), "\033[%d;1H\033[M\033[24;1H\033[7m-- INSERT --\033[m\033[K\033[%d;5H", row, row );
+      out += buf;
+    }
+  }
+  return out;
+}
+
+/* Line number n of a source file, for the pager and split workloads;
+   every seventh is blank. */
+static std::string source_line( unsigned int n )
+{
+  char buf[128];
+  if ( n % 7 == 0 ) {
+    return "";
+  }
+  snprintf( buf,
+            sizeof( buf ),
+            "\033[38;5;28mint\033[m parse_%u( \033[38;5;28mconst\033[m \033[38;5;28mchar\033[m* s%u ); "
+            "\033[38;5;244m/* %u */\033[m",
+            n % 97,
+            n % 13,
+            n );
+  return buf;
+}
+
+/* less: paging a few lines forward or back at a time, under a prompt
+   on the last line.  Backward steps insert lines at the top. */
+static std::string make_pager( size_t target )
+{
+  std::string out;
+  unsigned int n = 1;
+  unsigned int top = 1000;
+  while ( out.size() < target ) {
+    n = n * 1103515245 + 12345;
+    const unsigned int lines = 1 + ( n >> 16 ) % 4;
+    if ( ( n >> 20 ) % 3 ) {
+      out += "\r\033[K";
+      for ( unsigned int i = 0; i < lines; i++ ) {
+        out += source_line( top + HEIGHT - 1 + i ) + "\r\n";
+      }
+      top += lines;
+    } else {
+      for ( unsigned int i = 0; i < lines; i++ ) {
+        out += "\033[H\033[L" + source_line( --top );
+      }
+      out += "\033[24;1H\033[K";
+    }
+    out += ":";
+  }
+  return out;
+}
+
+/* vim with the screen split in two windows, each with a status line:
+   one window scrolls either way, or has a line opened or deleted. */
+static std::string make_split( size_t target )
+{
+  std::string out;
+  unsigned int n = 1;
+  unsigned int tops[2] = { 100, 5000 };
+  char buf[64];
+  while ( out.size() < target ) {
+    n = n * 1103515245 + 12345;
+    const int window = ( n >> 16 ) % 2;
+    const int first = 1 + window * 12, last = first + 10;
+    unsigned int& top = tops[window];
+    const unsigned int lines = 1 + ( n >> 18 ) % 3;
+    const int row = first + ( n >> 21 ) % 11;
+    snprintf( buf, sizeof( buf ), "\033[%d;%dr", first, last );
+    out += buf;
+    switch ( ( n >> 24 ) % 4 ) {
+      case 0: /* scroll forward */
+        snprintf( buf, sizeof( buf ), "\033[%d;1H", last );
+        out += buf;
+        for ( unsigned int i = 0; i < lines; i++ ) {
+          out += "\n\r" + source_line( top + 11 + i );
+        }
+        top += lines;
+        break;
+      case 1: /* scroll back */
+        snprintf( buf, sizeof( buf ), "\033[%d;1H", first );
+        out += buf;
+        for ( unsigned int i = 0; i < lines; i++ ) {
+          out += "\033M\r" + source_line( --top );
+        }
+        break;
+      case 2: /* open a line */
+        snprintf( buf, sizeof( buf ), "\033[%d;1H\033[L", row );
+        out += buf + source_line( n % 10000 );
+        break;
+      default: /* delete a line */
+        snprintf( buf, sizeof( buf ), "\033[%d;1H\033[M\033[%d;1H", row, last );
+        out += buf + source_line( top + 10 );
+        break;
+    }
+    snprintf( buf, sizeof( buf ), "\033[r\033[%d;1H\033[7mfile%d.c line %u\033[m\033[K", last + 1, window, top );
+    out += buf;
+  }
+  return out;
+}
+
+/* A shell prompt: a long command line edited in the middle, one
+   character at a time, the way readline redraws it. */
+static std::string make_edit( size_t target )
+{
+  static const char command[] = "find . -name '*.cc' -exec grep -n 'put_row' {} + | sort -u";
+  std::string out;
+  std::string line = command;
+  unsigned int n = 1;
+  size_t cursor = line.size();
+  char buf[32];
+  out += "\033[24;1H$ " + line;
+  while ( out.size() < target ) {
+    n = n * 1103515245 + 12345;
+    const size_t to = ( n >> 16 ) % ( line.size() + 1 );
+    if ( to < cursor ) {
+      snprintf( buf, sizeof( buf ), "\033[%zuD", cursor - to );
+      out += buf;
+    } else if ( to > cursor ) {
+      snprintf( buf, sizeof( buf ), "\033[%zuC", to - cursor );
+      out += buf;
+    }
+    cursor = to;
+    if ( ( n >> 24 ) % 2 && line.size() > 40 ) {
+      if ( cursor == line.size() ) {
+        continue;
+      }
+      /* delete the character under the cursor */
+      line.erase( cursor, 1 );
+      out += "\033[P";
+    } else if ( line.size() < WIDTH - 4 ) {
+      /* insert a character, redrawing the rest of the line */
+      const char c = static_cast<char>( 'a' + ( n >> 8 ) % 26 );
+      line.insert( cursor, 1, c );
+      out += line.substr( cursor );
+      cursor++;
+      if ( line.size() > cursor ) {
+        snprintf( buf, sizeof( buf ), "\033[%zuD", line.size() - cursor );
+        out += buf;
+      }
+    }
+  }
+  return out;
+}
+
+/* htop: every row repositioned and recolored, with meter bars. */
+static std::string make_htop( size_t target )
+{
+  std::string out;
+  unsigned int n = 1;
+  char buf[256];
+  while ( out.size() < target ) {
+    out += "\033[H\033[1;34m  1  \033[m\033[1;34m[\033[32m||||||||\033[31m|||\033[90m          \033[m 45.2%"
+           "\033[1;34m]\033[m";
+    for ( int row = 3; row <= HEIGHT; row++ ) {
+      n = n * 1103515245 + 12345;
+      snprintf( buf,
+                sizeof( buf ),
+                "\033[%d;1H\033[%sm%6u \033[36mroot\033[m     20   0 \033[36m%5uM\033[m %4uM S %4.1f  0.%u "
+                "\033[1m%u:%02u.%02u\033[m /usr/bin/proc%u\033[K",
+                row,
+                row == 3 ? "30;46" : "0",
+                n % 100000,
+                n % 9000,
+                n % 500,
+                ( n % 1000 ) / 10.0,
+                n % 10,
+                n % 60,
+                n % 60,
+                n % 100,
+                n % 50 );
+      out += buf;
+    }
+  }
+  return out;
+}
+
+/* gcc: colored diagnostics with caret lines. */
+static std::string make_gcc( size_t target )
+{
+  std::string out;
+  unsigned int n = 1;
+  char buf[512];
+  while ( out.size() < target ) {
+    n = n * 1103515245 + 12345;
+    snprintf( buf,
+              sizeof( buf ),
+              "\033[01m\033[Ksrc/file%u.cc:%u:%u:\033[m\033[K \033[01;31m\033[Kerror: \033[m\033[Kexpected "
+              "'\033[01m\033[K;\033[m\033[K' before '\033[01m\033[K}\033[m\033[K' token\r\n"
+              "  %4u |   x = \033[01;31m\033[Kfoo\033[m\033[K( 1 )\r\n"
+              "       |       \033[01;31m\033[K^~~\033[m\033[K\r\n",
+              n % 40,
+              n % 900,
+              n % 80,
+              n % 900 );
+    out += buf;
+  }
+  return out;
+}
+
+/* CJK text with emoji, all multibyte UTF-8. */
+static std::string make_utf8( size_t target )
+{
+  static const char* glyphs[] = { "\xe4\xb8\xad", "\xe6\x96\x87", "\xe5\xad\x97", "\xe3\x81\x82", "\xea\xb0\x80",
+                                  "\xf0\x9f\x98\x80", "\xf0\x9f\x8e\x89", "\xc3\xa9", " " };
+  std::string out;
+  unsigned int n = 1;
+  while ( out.size() < target ) {
+    for ( int i = 0; i < 36; i++ ) {
+      n = n * 1103515245 + 12345;
+      out += glyphs[( n >> 16 ) % ( sizeof( glyphs ) / sizeof( glyphs[0] ) )];
+    }
+    out += "\r\n";
+  }
+  return out;
+}
+
+/* Chinese, Japanese and Korean text in wide characters, with fullwidth
+   punctuation, so that every character is printed and has its width
+   looked up. */
+static std::string make_cjk( size_t target )
+{
+  static const uint32_t ranges[][2] = {
+    { 0x4e00, 0x9fff }, /* CJK unified ideographs */
+    { 0x3041, 0x3096 }, /* hiragana */
+    { 0x30a1, 0x30fa }, /* katakana */
+    { 0xac00, 0xd7a3 }, /* hangul syllables */
+    { 0xff01, 0xff5e }, /* fullwidth forms */
+  };
+  std::string out;
+  unsigned int n = 1;
+  while ( out.size() < target ) {
+    for ( int i = 0; i < 38; i++ ) {
+      n = n * 1103515245 + 12345;
+      const uint32_t* range = ranges[( n >> 16 ) % ( sizeof( ranges ) / sizeof( ranges[0] ) )];
+      n = n * 1103515245 + 12345;
+      const uint32_t c = range[0] + ( n >> 8 ) % ( range[1] - range[0] + 1 );
+      out += static_cast<char>( 0xe0 | ( c >> 12 ) );
+      out += static_cast<char>( 0x80 | ( ( c >> 6 ) & 0x3f ) );
+      out += static_cast<char>( 0x80 | ( c & 0x3f ) );
+    }
+    out += "\r\n";
+  }
+  return out;
+}
+
+/* Emoji with skin-tone modifiers, ZWJ sequences and variation selectors. */
+static std::string make_emoji( size_t target )
+{
+  static const char* glyphs[] = { "\xf0\x9f\x98\x80",
+                                  "\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd",
+                                  "\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9\xe2\x80\x8d\xf0\x9f\x91\xa7",
+                                  "\xe2\x9d\xa4\xef\xb8\x8f",
+                                  "\xf0\x9f\x9a\x80",
+                                  " " };
+  std::string out;
+  unsigned int n = 1;
+  while ( out.size() < target ) {
+    for ( int i = 0; i < 24; i++ ) {
+      n = n * 1103515245 + 12345;
+      out += glyphs[( n >> 16 ) % ( sizeof( glyphs ) / sizeof( glyphs[0] ) )];
+    }
+    out += "\r\n";
+  }
+  return out;
+}
+
+struct Scenario
+{
+  const char* name;
+  std::string ( *generate )( size_t );
+};
+
+static const Scenario scenarios[] = {
+  { "ascii", make_ascii },
+  { "tail", make_tail },
+  { "sgr", make_sgr },
+  { "cursor", make_cursor },
+  { "utf8", make_utf8 },
+  { "cjk", make_cjk },
+  { "emoji", make_emoji },
+  { "vim", make_vim },
+  { "pager", make_pager },
+  { "split", make_split },
+  { "edit", make_edit },
+  { "htop", make_htop },
+  { "gcc", make_gcc },
+};
+
+struct Result
+{
+  double seconds;
+  size_t allocations;
+};
+
+static Result run_parser( const std::string& input )
+{
+  Parser::UTF8Parser parser;
+  Parser::Actions actions;
+  size_t count = 0;
+
+  /* warm up the action buffer, as a long-lived terminal would have */
+  actions.reserve( 8 );
+
+  size_t allocations = allocation_count;
+  auto start = std::chrono::steady_clock::now();
+  for ( const char c : input ) {
+    parser.input( c, actions );
+    count += actions.size();
+    actions.clear();
+  }
+  auto end = std::chrono::steady_clock::now();
+  fatal_assert( count > 0 );
+
+  return { std::chrono::duration<double>( end - start ).count(), allocation_count - allocations };
+}
+
+static Result run_emulator( const std::string& input, size_t chunk_size )
+{
+  Terminal::Complete terminal( WIDTH, HEIGHT );
+  terminal.act( input.substr( 0, chunk_size ) ); /* warm up */
+
+  std::string chunk;
+  chunk.reserve( chunk_size );
+  size_t allocations = allocation_count;
+  auto start = std::chrono::steady_clock::now();
+  for ( size_t i = 0; i < input.size(); i += chunk_size ) {
+    chunk.assign( input, i, chunk_size );
+    terminal.act( chunk );
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return { std::chrono::duration<double>( end - start ).count(), allocation_count - allocations };
+}
+
+/* The emulator keeping a scrollback, compacted after each host read as
+   mosh-server does.  Returns the emulator's time; the compactions' goes
+   to compact_seconds. */
+static Result run_scrollback( const std::string& input, double* compact_seconds )
+{
+  Terminal::Complete terminal( WIDTH, HEIGHT );
+  Terminal::Scrollback scrollback( 1 << 20 );
+  terminal.set_scrollback( &scrollback );
+  terminal.act( input.substr( 0, CHUNK ) ); /* warm up */
+  scrollback.compact();
+
+  std::string chunk;
+  chunk.reserve( CHUNK );
+  std::chrono::steady_clock::duration acting {}, compacting {};
+  size_t allocations = allocation_count;
+  for ( size_t i = 0; i < input.size(); i += CHUNK ) {
+    chunk.assign( input, i, CHUNK );
+    auto start = std::chrono::steady_clock::now();
+    terminal.act( chunk );
+    auto acted = std::chrono::steady_clock::now();
+    scrollback.compact();
+    compacting += std::chrono::steady_clock::now() - acted;
+    acting += acted - start;
+  }
+
+  *compact_seconds = std::chrono::duration<double>( compacting ).count();
+  return { std::chrono::duration<double>( acting ).count(), allocation_count - allocations };
+}
+
+/* Time spent in Display::new_frame, as the server would call it after
+   each host read. */
+static Result run_display( const std::string& input )
+{
+  Terminal::Complete terminal( WIDTH, HEIGHT );
+  const Terminal::Display display( false );
+  Terminal::Framebuffer last( WIDTH, HEIGHT );
+  size_t frame_bytes = 0;
+
+  std::string chunk;
+  chunk.reserve( CHUNK );
+  double seconds = 0;
+  size_t frames = 0;
+  for ( size_t i = 0; i < input.size(); i += CHUNK ) {
+    chunk.assign( input, i, CHUNK );
+    terminal.act( chunk );
+    auto start = std::chrono::steady_clock::now();
+    frame_bytes += display.new_frame( true, last, terminal.get_fb() ).size();
+    auto end = std::chrono::steady_clock::now();
+    seconds += std::chrono::duration<double>( end - start ).count();
+    frames++;
+    last = terminal.get_fb();
+  }
+  fatal_assert( frame_bytes > 0 );
+
+  return { seconds / frames, 0 };
+}
+
+/* Bytes of screen update per kilobyte of host output, when it arrives
+   in reads as small as an interactive program's. */
+static double run_updates( const std::string& input )
+{
+  Terminal::Complete terminal( WIDTH, HEIGHT );
+  const Terminal::Display display( false );
+  Terminal::Framebuffer last( WIDTH, HEIGHT );
+  size_t frame_bytes = 0;
+  for ( size_t i = 0; i < input.size() && i < ( 1 << 20 ); i += UPDATE_CHUNK ) {
+    terminal.act( input.substr( i, UPDATE_CHUNK ) );
+    frame_bytes += display.new_frame( true, last, terminal.get_fb() ).size();
+    last = terminal.get_fb();
+  }
+  return frame_bytes * 1024.0 / std::min<size_t>( input.size(), 1 << 20 );
+}
+
+/* Time spent in Display::new_frame for each character typed at the
+   bottom of a wide screen filled by the workload, as for keystroke
+   echo. */
+static Result run_echo( const std::string& input )
+{
+  const int width = 400, height = 100;
+  Terminal::Complete terminal( width, height );
+  const Terminal::Display display( false );
+  for ( size_t i = 0; i < input.size() && i < ( 1 << 16 ); i += CHUNK ) {
+    terminal.act( input.substr( i, CHUNK ) );
+  }
+  terminal.act( std::string( "\033[m\033[100;1H\033[K$ " ) );
+  Terminal::Framebuffer last( terminal.get_fb() );
+
+  double seconds = 0;
+  const int keystrokes = 300;
+  for ( int i = 0; i < keystrokes; i++ ) {
+    terminal.act( std::string( 1, 'a' + i % 26 ) );
+    auto start = std::chrono::steady_clock::now();
+    fatal_assert( !display.new_frame( true, last, terminal.get_fb() ).empty() );
+    auto end = std::chrono::steady_clock::now();
+    seconds += std::chrono::duration<double>( end - start ).count();
+    last = terminal.get_fb();
+  }
+
+  return { seconds / keystrokes, 0 };
+}
+
+/* Time and allocations of Display::new_frame redrawing the whole
+   screen, filled by the workload, into one buffer reused each time. */
+static Result run_repaint( const std::string& input )
+{
+  Terminal::Complete terminal( WIDTH, HEIGHT );
+  const Terminal::Display display( false );
+  for ( size_t i = 0; i < input.size() && i < ( 1 << 16 ); i += CHUNK ) {
+    terminal.act( input.substr( i, CHUNK ) );
+  }
+  const Terminal::Framebuffer& fb = terminal.get_fb();
+  std::string out;
+  display.new_frame( false, fb, fb, out ); /* warm up */
+
+  const int repaints = 200;
+  size_t allocations = allocation_count;
+  auto start = std::chrono::steady_clock::now();
+  for ( int i = 0; i < repaints; i++ ) {
+    display.new_frame( false, fb, fb, out );
+    fatal_assert( !out.empty() );
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return { std::chrono::duration<double>( end - start ).count() / repaints,
+           ( allocation_count - allocations ) / repaints };
+}
+
+/* Memory held by a terminal's rows once the workload has filled its
+   screen.  Rows come from and go back to a pool that outlives any one
+   terminal, so this counts the heap taken by fresh copies of them. */
+static size_t terminal_footprint( int width, int height, const std::string& input )
+{
+  Terminal::Complete terminal( width, height );
+  for ( size_t i = 0; i < input.size(); i += CHUNK ) {
+    terminal.act( input.substr( i, CHUNK ) );
+  }
+  const Terminal::Framebuffer::rows_type rows = terminal.get_fb().get_rows();
+  std::vector<Terminal::Row> copies;
+  copies.reserve( rows.size() );
+  const size_t before = live_bytes;
+  for ( const auto& row : rows ) {
+    copies.push_back( *row );
+  }
+  return live_bytes - before + copies.size() * sizeof( Terminal::Row );
+}
+
+static void report_memory( const Scenario& s )
+{
+  static const int sizes[][2] = { { 80, 24 }, { 400, 100 } };
+  const std::string input = s.generate( 1 << 16 );
+
+  printf( "%-8s", s.name );
+  for ( const auto& size : sizes ) {
+    const size_t bytes = terminal_footprint( size[0], size[1], input );
+    printf( " %12.1f %10.1f", bytes / 1024.0, static_cast<double>( bytes ) / ( size[0] * size[1] ) );
+  }
+  printf( "\n" );
+}
+
+/* The workload's characters, decoded once so that only lookups are timed */
+static std::vector<wchar_t> decode( const std::string& input )
+{
+  std::vector<wchar_t> chars;
+  mbstate_t state;
+  memset( &state, 0, sizeof state );
+  for ( size_t i = 0; i < input.size(); ) {
+    wchar_t wc;
+    const size_t len = mbrtowc( &wc, input.data() + i, input.size() - i, &state );
+    if ( len == static_cast<size_t>( -1 ) || len == static_cast<size_t>( -2 ) ) {
+      memset( &state, 0, sizeof state );
+      i++;
+      continue;
+    }
+    chars.push_back( wc );
+    i += std::max<size_t>( len, 1 );
+  }
+  return chars;
+}
+
+static volatile int width_sink;
+
+/* Mean time of one width lookup over the characters */
+template<typename Width>
+static double time_widths( const std::vector<wchar_t>& chars, Width width )
+{
+  int total = 0;
+  auto start = std::chrono::steady_clock::now();
+  for ( const wchar_t c : chars ) {
+    total += width( c );
+  }
+  auto end = std::chrono::steady_clock::now();
+  width_sink = total;
+
+  return std::chrono::duration<double>( end - start ).count() / chars.size();
+}
+
+static void report_widths( const Scenario& s, size_t megabytes, int repeats )
+{
+  const std::vector<wchar_t> chars = decode( s.generate( megabytes << 20 ) );
+  auto table = []( wchar_t c ) { return Terminal::char_width( c ); };
+  auto libc = []( wchar_t c ) { return wcwidth( c ); };
+
+  double table_seconds = time_widths( chars, table );
+  double libc_seconds = time_widths( chars, libc );
+  for ( int i = 1; i < repeats; i++ ) {
+    table_seconds = std::min( table_seconds, time_widths( chars, table ) );
+    libc_seconds = std::min( libc_seconds, time_widths( chars, libc ) );
+  }
+  printf( "%-8s %10.2f %12.2f\n", s.name, table_seconds * 1e9, libc_seconds * 1e9 );
+}
+
+static void usage( const char* argv0 )
+{
+  fprintf( stderr, "Usage: %s [-M | -W] [-m megabytes] [-r repeats] [scenario ...]\n", argv0 );
+  fprintf( stderr, "Scenarios:" );
+  for ( const Scenario& s : scenarios ) {
+    fprintf( stderr, " %s", s.name );
+  }
+  fprintf( stderr, "\n" );
+  exit( 1 );
+}
+
+int main( int argc, char** argv )
+{
+  size_t megabytes = 8;
+  int repeats = 3;
+  bool memory = false;
+  bool widths = false;
+  int opt;
+  while ( ( opt = getopt( argc, argv, "MWm:r:" ) ) != -1 ) {
+    if ( opt == 'M' ) {
+      memory = true;
+    } else if ( opt == 'W' ) {
+      widths = true;
+    } else if ( opt == 'm' ) {
+      megabytes = strtoul( optarg, NULL, 10 );
+      if ( megabytes < 1 || megabytes > 1024 ) {
+        usage( argv[0] );
+      }
+    } else if ( opt == 'r' ) {
+      repeats = atoi( optarg );
+      if ( repeats < 1 || repeats > 100 ) {
+        usage( argv[0] );
+      }
+    } else {
+      usage( argv[0] );
+    }
+  }
+
+  set_native_locale();
+  if ( !is_utf8_locale() ) {
+    /* the parser needs a UTF-8 locale; don't depend on the environment */
+    setlocale( LC_ALL, "C.UTF-8" );
+  }
+  fatal_assert( is_utf8_locale() );
+
+  if ( memory ) {
+    printf( "%-8s %12s %10s %12s %10s\n", "scenario", "80x24 KB", "B/cell", "400x100 KB", "B/cell" );
+  } else if ( widths ) {
+    printf( "%-8s %10s %12s\n", "scenario", "table ns", "wcwidth ns" );
+  } else {
+    printf( "%-8s %14s %10s %14s %10s %12s %12s %13s %10s %10s %10s %11s %8s\n",
+            "scenario",
+            "parse MB/s",
+            "allocs/KB",
+            "emulate MB/s",
+            "allocs/KB",
+            "flood MB/s",
+            "scroll MB/s",
+            "compact MB/s",
+            "frame us",
+            "sent B/KB",
+            "echo us",
+            "repaint us",
+            "allocs" );
+  }
+  for ( const Scenario& s : scenarios ) {
+    bool selected = ( optind == argc );
+    for ( int i = optind; i < argc; i++ ) {
+      selected = selected || ( strcmp( argv[i], s.name ) == 0 );
+    }
+    if ( !selected ) {
+      continue;
+    }
+
+    if ( memory ) {
+      report_memory( s );
+      continue;
+    }
+    if ( widths ) {
+      report_widths( s, megabytes, repeats );
+      continue;
+    }
+
+    const std::string input = s.generate( megabytes << 20 );
+    const double kb = input.size() / 1024.0;
+    const double mb = kb / 1024.0;
+    /* best of several runs, to see past scheduling noise */
+    Result parse = run_parser( input );
+    Result emulate = run_emulator( input, CHUNK );
+    Result flood = run_emulator( input, FLOOD_CHUNK );
+    double compact = 0, compact_run = 0;
+    Result scroll = run_scrollback( input, &compact );
+    Result display = run_display( input );
+    const double sent = run_updates( input );
+    Result echo = run_echo( input );
+    Result repaint = run_repaint( input );
+    for ( int i = 1; i < repeats; i++ ) {
+      parse.seconds = std::min( parse.seconds, run_parser( input ).seconds );
+      emulate.seconds = std::min( emulate.seconds, run_emulator( input, CHUNK ).seconds );
+      flood.seconds = std::min( flood.seconds, run_emulator( input, FLOOD_CHUNK ).seconds );
+      scroll.seconds = std::min( scroll.seconds, run_scrollback( input, &compact_run ).seconds );
+      compact = std::min( compact, compact_run );
+      display.seconds = std::min( display.seconds, run_display( input ).seconds );
+      echo.seconds = std::min( echo.seconds, run_echo( input ).seconds );
+      repaint.seconds = std::min( repaint.seconds, run_repaint( input ).seconds );
+    }
+    printf( "%-8s %14.1f %10.2f %14.1f %10.2f %12.1f %12.1f %13.1f %10.2f %10.1f %10.2f %11.2f %8zu\n",
+            s.name,
+            mb / parse.seconds,
+            parse.allocations / kb,
+            mb / emulate.seconds,
+            emulate.allocations / kb,
+            mb / flood.seconds,
+            mb / scroll.seconds,
+            mb / compact,
+            display.seconds * 1e6,
+            sent,
+            echo.seconds * 1e6,
+            repaint.seconds * 1e6,
+            repaint.allocations );
+  }
+
+  return 0;
+}
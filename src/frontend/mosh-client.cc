@@ -207,6 +207,19 @@ int main( int argc, char* argv[] )
     tcp_timeout_ms = static_cast<uint64_t>( timeout );
   }
 
+  /* Read maximum frame rate preference */
+  char* frame_rate_env = getenv( "MOSH_MAX_FRAME_RATE" );
+  unsigned int max_frame_rate = 60; /* default */
+  if ( frame_rate_env ) {
+    char* endptr;
+    long rate = strtol( frame_rate_env, &endptr, 10 );
+    if ( *endptr != '\0' || rate < 0 || rate > 1000 ) {
+      fprintf( stderr, "MOSH_MAX_FRAME_RATE must be between 0 (unlimited) and 1000 frames per second\n" );
+      exit( 1 );
+    }
+    max_frame_rate = static_cast<unsigned int>( rate );
+  }
+
   std::string key( env_key );
 
   if ( unsetenv( "MOSH_KEY" ) < 0 ) {
@@ -220,7 +233,7 @@ int main( int argc, char* argv[] )
   bool success = false;
   try {
     STMClient client( ip, desired_port, key.c_str(), predict_mode, verbose, predict_overwrite, protocol,
-                      tcp_timeout_ms );
+                      tcp_timeout_ms, max_frame_rate );
     client.init();
 
     try {
@@ -47,6 +47,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <netdb.h>
+#include <poll.h>
 #include <pwd.h>
 #include <strings.h>
 #include <sys/ioctl.h>
@@ -82,6 +83,7 @@
 
 #include "src/statesync/completeterminal.h"
 #include "src/statesync/user.h"
+#include "src/terminal/terminalscrollback.h"
 #include "src/util/fatal_assert.h"
 #include "src/util/locale_utils.h"
 #include "src/util/pty_compat.h"
@@ -97,9 +99,13 @@
 
 using ServerConnection = Network::Transport<Terminal::Complete, Network::UserStream>;
 
+/* most lines of scrollback sent in answer to one request */
+static const uint32_t MAX_SCROLLBACK_PAGE = 500;
+
 static void serve( int host_fd,
                    int pipe_fd,
                    Terminal::Complete& terminal,
+                   Terminal::Scrollback* scrollback,
                    ServerConnection& network,
                    long network_timeout,
                    long network_signaled_timeout );
@@ -452,6 +458,36 @@ static int run_server( const char* desired_ip,
       network_signaled_timeout = 0;
     }
   }
+  /* get per-frame byte budget for progressive screen updates */
+  long frame_budget = 0;
+  char* budget_envar = getenv( "MOSH_SERVER_FRAME_BUDGET" );
+  if ( budget_envar && *budget_envar ) {
+    errno = 0;
+    char* endptr;
+    frame_budget = strtol( budget_envar, &endptr, 10 );
+    if ( *endptr != '\0' || ( frame_budget == 0 && errno == EINVAL ) ) {
+      fputs( "MOSH_SERVER_FRAME_BUDGET not a valid integer, ignoring\n", stderr );
+      frame_budget = 0;
+    } else if ( frame_budget < 0 ) {
+      fputs( "MOSH_SERVER_FRAME_BUDGET is negative, ignoring\n", stderr );
+      frame_budget = 0;
+    }
+  }
+  /* get memory limit for scrollback */
+  long scrollback_kb = 0;
+  char* scrollback_envar = getenv( "MOSH_SERVER_SCROLLBACK" );
+  if ( scrollback_envar && *scrollback_envar ) {
+    errno = 0;
+    char* endptr;
+    scrollback_kb = strtol( scrollback_envar, &endptr, 10 );
+    if ( *endptr != '\0' || ( scrollback_kb == 0 && errno == EINVAL ) ) {
+      fputs( "MOSH_SERVER_SCROLLBACK not a valid integer, ignoring\n", stderr );
+      scrollback_kb = 0;
+    } else if ( scrollback_kb < 0 ) {
+      fputs( "MOSH_SERVER_SCROLLBACK is negative, ignoring\n", stderr );
+      scrollback_kb = 0;
+    }
+  }
   /* get initial window size */
   struct winsize window_size;
   if ( ioctl( STDIN_FILENO, TIOCGWINSZ, &window_size ) < 0 || window_size.ws_col == 0 || window_size.ws_row == 0 ) {
@@ -464,6 +500,11 @@ static int run_server( const char* desired_ip,
 
   /* open parser and terminal */
   Terminal::Complete terminal( window_size.ws_col, window_size.ws_row );
+  std::unique_ptr<Terminal::Scrollback> scrollback;
+  if ( scrollback_kb > 0 ) {
+    scrollback.reset( new Terminal::Scrollback( static_cast<size_t>( scrollback_kb ) * 1024 ) );
+    terminal.set_scrollback( scrollback.get() );
+  }
 
   /* open network */
   Network::UserStream blank;
@@ -472,6 +513,7 @@ static int run_server( const char* desired_ip,
                                                                    desired_port, tcp_timeout_ms ) );
 
   network->set_verbose( verbose );
+  network->set_frame_budget( frame_budget );
   Select::set_verbose( verbose );
 
   /*
@@ -689,7 +731,7 @@ static int run_server( const char* desired_ip,
 #endif
 
     try {
-      serve( master, pipes[1], terminal, *network, network_timeout, network_signaled_timeout );
+      serve( master, pipes[1], terminal, scrollback.get(), *network, network_timeout, network_signaled_timeout );
     } catch ( const Network::NetworkException& e ) {
       fprintf( stderr, "Network exception: %s\n", e.what() );
     } catch ( const Crypto::CryptoException& e ) {
@@ -711,9 +753,17 @@ static int run_server( const char* desired_ip,
   return 0;
 }
 
+/* Whether a read from fd would return at once. */
+static bool readable_now( int fd )
+{
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  return poll( &pfd, 1, 0 ) > 0 && ( pfd.revents & POLLIN );
+}
+
 static void serve( int host_fd,
                    int pipe_fd,
                    Terminal::Complete& terminal,
+                   Terminal::Scrollback* scrollback,
                    ServerConnection& network,
                    long network_timeout,
                    long network_signaled_timeout )
@@ -807,7 +857,19 @@ static void serve( int host_fd,
           /* apply userstream to terminal */
           for ( size_t i = 0; i < us.size(); i++ ) {
             const Parser::Action& action = us.get_action( i );
-            if ( typeid( action ) == typeid( Parser::Resize ) ) {
+            if ( typeid( action ) == typeid( Parser::ScrollbackRequest ) ) {
+              /* answer from scrollback, or with nothing if there is none */
+              const Parser::ScrollbackRequest& request = static_cast<const Parser::ScrollbackRequest&>( action );
+              Terminal::ScrollbackPage page { 0, 0, 0, {} };
+              if ( scrollback ) {
+                const uint32_t count = std::min( request.count, MAX_SCROLLBACK_PAGE );
+                page.first = scrollback->get_lines( request.end, count, &page.lines );
+                page.end = scrollback->get_end_line();
+                page.oldest = scrollback->get_first_line();
+              }
+              terminal.set_scrollback_page( page );
+              continue;
+            } else if ( typeid( action ) == typeid( Parser::Resize ) ) {
               /* apply only the last consecutive Resize action */
               if ( i < us.size() - 1 ) {
                 const Parser::Action& next = us.get_action( i + 1 );
@@ -907,7 +969,23 @@ static void serve( int host_fd,
         if ( bytes_read <= 0 ) {
           network.start_shutdown();
         } else {
-          terminal_to_host += terminal.act( std::string( buf, bytes_read ) );
+          /* During a flood, take in all the pty holds (up to a limit),
+             so the terminal can skip what would scroll away unseen.
+             A failed read here shows up again on the next pass. */
+          const size_t flood_limit = 262144;
+          std::string host_output( buf, bytes_read );
+          while ( host_output.size() < flood_limit && readable_now( host_fd ) ) {
+            bytes_read = read( host_fd, buf, buf_size );
+            if ( bytes_read <= 0 ) {
+              break;
+            }
+            host_output.append( buf, bytes_read );
+          }
+
+          terminal_to_host += terminal.act( host_output );
+          if ( scrollback ) {
+            scrollback->compact();
+          }
 
           /* update client with new state of terminal */
           network.set_current_state( terminal );
@@ -193,7 +193,8 @@ void STMClient::init( void )
     tmp = std::string( escape_key_name_buf );
     std::wstring escape_key_name = std::wstring( tmp.begin(), tmp.end() );
     escape_key_help
-      = L"Commands: Ctrl-Z suspends, \".\" quits, " + escape_pass_name + L" gives literal " + escape_key_name;
+      = L"Commands: Ctrl-Z suspends, \".\" quits, " + escape_pass_name + L" gives literal " + escape_key_name
+          + L", \"<\" and \">\" page scrollback";
     overlays.get_notification_engine().set_escape_key_string( tmp );
   }
   wchar_t tmp[128];
@@ -281,20 +282,127 @@ void STMClient::output_new_frame( void )
   }
 
   /* fetch target state */
-  new_state = network->get_latest_remote_state().state.get_fb();
+  new_state = network->get_latest_remote_state().state->get_fb();
+  if ( scrollback_view ) {
+    draw_scrollback( new_state );
+  }
 
   /* apply local overlays */
   overlays.apply( new_state );
 
   /* calculate minimal difference from where we are */
-  const std::string diff( display.new_frame( !repaint_requested, local_framebuffer, new_state ) );
-  swrite( STDOUT_FILENO, diff.data(), diff.size() );
+  display.new_frame( !repaint_requested, local_framebuffer, new_state, frame_output );
+  swrite( STDOUT_FILENO, frame_output.data(), frame_output.size() );
 
   repaint_requested = false;
+  keystroke_pending = false;
+  last_frame_time = timestamp();
+  last_echo_ack = network->get_latest_remote_state().state->get_echo_ack();
 
   local_framebuffer = new_state;
 }
 
+/* Should the next frame be written now?  Output arriving in a burst of
+   states waits to be written as one frame, but whatever answers a
+   keystroke -- a prediction, or the server's echo -- goes out at once. */
+bool STMClient::frame_due( void ) const
+{
+  if ( !network || frame_interval == 0 || repaint_requested || keystroke_pending ) {
+    return true;
+  }
+  if ( network->get_latest_remote_state().state->get_echo_ack() != last_echo_ack ) {
+    return true;
+  }
+  return timestamp() - last_frame_time >= frame_interval;
+}
+
+void STMClient::page_scrollback( bool older )
+{
+  const uint32_t count = network->get_latest_remote_state().state->get_fb().ds.get_height();
+  const std::shared_ptr<const Terminal::ScrollbackPage> page
+    = network->get_latest_remote_state().state->get_scrollback_page();
+
+  if ( !scrollback_view ) {
+    if ( !older ) {
+      return;
+    }
+    scrollback_end = 0; /* newest lines */
+  } else if ( page ) {
+    /* step from the page last requested, whether or not it has arrived */
+    const uint64_t end = scrollback_end ? scrollback_end : page->end;
+    if ( older ) {
+      if ( end <= page->oldest + count ) {
+        return; /* already at the oldest line kept */
+      }
+      scrollback_end = std::max( end - count, page->oldest + count );
+    } else {
+      if ( !scrollback_end ) {
+        leave_scrollback();
+        return;
+      }
+      scrollback_end = ( end + count >= page->end ) ? 0 : end + count;
+    }
+  } else {
+    return; /* no answer from the server yet */
+  }
+
+  scrollback_view = true;
+  network->get_current_state().push_back( Parser::ScrollbackRequest( scrollback_end, count ) );
+}
+
+void STMClient::leave_scrollback( void )
+{
+  scrollback_view = false;
+  shown_page.reset();
+  overlays.get_notification_engine().set_notification_string( L"" );
+}
+
+void STMClient::draw_scrollback( Terminal::Framebuffer& fb )
+{
+  const std::shared_ptr<const Terminal::ScrollbackPage> page
+    = network->get_latest_remote_state().state->get_scrollback_page();
+  if ( !page ) { /* no answer from the server yet */
+    return;
+  }
+
+  if ( page->lines.empty() ) {
+    overlays.get_notification_engine().set_notification_string( L"No scrollback on the server.", true, false );
+    return;
+  }
+
+  const int width = fb.ds.get_width();
+  const int height = fb.ds.get_height();
+  if ( ( page != shown_page ) || ( scrollback_framebuffer.ds.get_width() != width )
+       || ( scrollback_framebuffer.ds.get_height() != height ) ) {
+    /* lay the page out with the client's own emulator, newest line at the bottom */
+    Terminal::Complete view( width, height );
+    std::string text( "\033[?7l\033[?25l" );
+    const size_t shown = std::min( page->lines.size(), size_t( height ) );
+    text.append( height - shown, '\n' );
+    for ( size_t i = page->lines.size() - shown; i < page->lines.size(); i++ ) {
+      text += "\r";
+      text += page->lines[i];
+      if ( i + 1 < page->lines.size() ) {
+        text += "\n";
+      }
+    }
+    view.act( text );
+    scrollback_framebuffer = view.get_fb();
+    shown_page = page;
+
+    wchar_t msg[128];
+    swprintf( msg,
+              128,
+              L"Scrollback lines %llu-%llu of %llu",
+              (unsigned long long)page->first + 1,
+              (unsigned long long)( page->first + page->lines.size() ),
+              (unsigned long long)page->end );
+    overlays.get_notification_engine().set_notification_string( msg, true, false );
+  }
+
+  fb = scrollback_framebuffer;
+}
+
 void STMClient::process_network_input( void )
 {
   network->recv();
@@ -306,7 +414,7 @@ void STMClient::process_network_input( void )
   overlays.get_prediction_engine().set_local_frame_acked( network->get_sent_state_acked() );
   overlays.get_prediction_engine().set_send_interval( network->send_interval() );
   overlays.get_prediction_engine().set_local_frame_late_acked(
-    network->get_latest_remote_state().state.get_echo_ack() );
+    network->get_latest_remote_state().state->get_echo_ack() );
 }
 
 bool STMClient::process_user_input( int fd )
@@ -328,6 +436,7 @@ bool STMClient::process_user_input( int fd )
   if ( net.shutdown_in_progress() ) {
     return true;
   }
+  keystroke_pending = true;
   overlays.get_prediction_engine().set_local_frame_sent( net.get_sent_state_last() );
 
   /* Don't predict for bulk data. */
@@ -369,6 +478,12 @@ bool STMClient::process_user_input( int fd )
         kill( 0, SIGSTOP );
 
         resume();
+      } else if ( ( the_byte == '<' ) || ( the_byte == '>' ) ) { /* page the server's scrollback */
+        quit_sequence_started = false;
+        overlays.get_notification_engine().set_notification_string( L"" );
+        page_scrollback( the_byte == '<' );
+        shown_page.reset(); /* redraw and notify again on the next frame */
+        continue;
       } else if ( ( the_byte == escape_pass_key ) || ( the_byte == escape_pass_key2 ) ) {
         /* Emulation sequence to type escape_key is escape_key +
            escape_pass_key (that is escape key without Ctrl) */
@@ -388,6 +503,10 @@ bool STMClient::process_user_input( int fd )
       continue;
     }
 
+    if ( scrollback_view ) { /* any other key returns to the live screen */
+      leave_scrollback();
+    }
+
     quit_sequence_started
       = ( escape_key > 0 ) && ( the_byte == escape_key ) && ( lf_entered || ( !escape_requires_lf ) );
     if ( quit_sequence_started ) {
@@ -451,10 +570,19 @@ bool STMClient::main( void )
 
   while ( 1 ) {
     try {
-      output_new_frame();
+      const bool frame_deferred = !frame_due();
+      if ( !frame_deferred ) {
+        output_new_frame();
+      }
 
       int wait_time = std::min( network->wait_time(), overlays.wait_time() );
 
+      /* wake up to write a deferred frame */
+      if ( frame_deferred ) {
+        const uint64_t since = timestamp() - last_frame_time;
+        wait_time = std::min( wait_time, static_cast<int>( frame_interval - std::min( since, frame_interval ) ) );
+      }
+
       /* Handle startup "Connecting..." message */
       if ( still_connecting() ) {
         wait_time = std::min( 250, wait_time );
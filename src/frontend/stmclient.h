@@ -53,6 +53,13 @@ private:
   Network::TransportProtocol protocol;
   uint64_t tcp_timeout_ms;
 
+  /* Frames are written to the terminal at most once per frame_interval
+     ms (0 for no limit), except those answering a keystroke. */
+  uint64_t frame_interval;
+  uint64_t last_frame_time;
+  uint64_t last_echo_ack;
+  bool keystroke_pending;
+
   int escape_key;
   int escape_pass_key;
   int escape_pass_key2;
@@ -69,18 +76,30 @@ private:
   using NetworkPointer = std::shared_ptr<NetworkType>;
   NetworkPointer network;
   Terminal::Display display;
+  std::string frame_output; /* reused for each update written to the terminal */
 
   std::wstring connecting_notification;
   bool repaint_requested, lf_entered, quit_sequence_started;
   bool clean_shutdown;
   unsigned int verbose;
 
+  /* paging through the server's scrollback */
+  bool scrollback_view;
+  uint64_t scrollback_end; /* end of the page last requested, 0 for the newest */
+  std::shared_ptr<const Terminal::ScrollbackPage> shown_page;
+  Terminal::Framebuffer scrollback_framebuffer;
+
   void main_init( void );
   void process_network_input( void );
   bool process_user_input( int fd );
   bool process_resize( void );
 
+  void page_scrollback( bool older );
+  void leave_scrollback( void );
+  void draw_scrollback( Terminal::Framebuffer& fb );
+
   void output_new_frame( void );
+  bool frame_due( void ) const;
 
   bool still_connecting( void ) const
   {
@@ -98,14 +117,17 @@ public:
              unsigned int s_verbose,
              const char* predict_overwrite,
              Network::TransportProtocol s_protocol = Network::TransportProtocol::UDP,
-             uint64_t s_tcp_timeout_ms = 500 )
+             uint64_t s_tcp_timeout_ms = 500,
+             unsigned int s_max_frame_rate = 60 )
     : ip( s_ip ? s_ip : "" ), port( s_port ? s_port : "" ), key( s_key ? s_key : "" ), protocol( s_protocol ),
-      tcp_timeout_ms( s_tcp_timeout_ms ), escape_key( 0x1E ), escape_pass_key( '^' ), escape_pass_key2( '^' ),
+      tcp_timeout_ms( s_tcp_timeout_ms ), frame_interval( s_max_frame_rate ? 1000 / s_max_frame_rate : 0 ),
+      last_frame_time( 0 ), last_echo_ack( 0 ), keystroke_pending( false ),
+      escape_key( 0x1E ), escape_pass_key( '^' ), escape_pass_key2( '^' ),
       escape_requires_lf( false ), escape_key_help( L"?" ), saved_termios(), raw_termios(), window_size(),
       local_framebuffer( 1, 1 ), new_state( 1, 1 ), overlays(), network(),
-      display( true ) /* use TERM environment var to initialize display */, connecting_notification(),
+      display( true ) /* use TERM environment var to initialize display */, frame_output(), connecting_notification(),
       repaint_requested( false ), lf_entered( false ), quit_sequence_started( false ), clean_shutdown( false ),
-      verbose( s_verbose )
+      verbose( s_verbose ), scrollback_view( false ), scrollback_end( 0 ), shown_page(), scrollback_framebuffer( 1, 1 )
   {
     if ( predict_mode ) {
       if ( !strcmp( predict_mode, "always" ) ) {
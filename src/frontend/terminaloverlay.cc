@@ -37,9 +37,17 @@
 #include <typeinfo>
 
 #include "src/frontend/terminaloverlay.h"
+#include "src/terminal/charwidth.h"
 
 using namespace Overlay;
 
+static void underline( Framebuffer& fb, int row, int col )
+{
+  Renditions renditions = fb.get_renditions( row, col );
+  renditions.set_attribute( Renditions::underlined, true );
+  fb.set_renditions( row, col, renditions );
+}
+
 void ConditionalOverlayCell::apply( Framebuffer& fb, uint64_t confirmed_epoch, int row, bool flag ) const
 {
   if ( ( !active ) || ( row >= fb.ds.get_height() ) || ( col >= fb.ds.get_width() ) ) {
@@ -56,15 +64,15 @@ void ConditionalOverlayCell::apply( Framebuffer& fb, uint64_t confirmed_epoch, i
 
   if ( unknown ) {
     if ( flag && ( col != fb.ds.get_width() - 1 ) ) {
-      fb.get_mutable_cell( row, col )->get_renditions().set_attribute( Renditions::underlined, true );
+      underline( fb, row, col );
     }
     return;
   }
 
-  if ( *fb.get_cell( row, col ) != replacement ) {
-    *( fb.get_mutable_cell( row, col ) ) = replacement;
+  if ( *fb.get_cell( row, col ) != replacement || !( fb.get_renditions( row, col ) == replacement_renditions ) ) {
+    fb.set_cell( row, col, replacement, replacement_renditions );
     if ( flag ) {
-      fb.get_mutable_cell( row, col )->get_renditions().set_attribute( Renditions::underlined, true );
+      underline( fb, row, col );
     }
   }
 }
@@ -189,13 +197,14 @@ void NotificationEngine::apply( Framebuffer& fb ) const
   }
 
   /* draw bar across top of screen */
-  Cell notification_bar( 0 );
-  notification_bar.get_renditions().set_foreground_color( 7 );
-  notification_bar.get_renditions().set_background_color( 4 );
+  Cell notification_bar;
+  Renditions notification_renditions( 0 );
+  notification_renditions.set_foreground_color( 7 );
+  notification_renditions.set_background_color( 4 );
   notification_bar.append( 0x20 );
 
   for ( int i = 0; i < fb.ds.get_width(); i++ ) {
-    *( fb.get_mutable_cell( 0, i ) ) = notification_bar;
+    fb.set_cell( 0, i, notification_bar, notification_renditions );
   }
 
   /* write message */
@@ -249,6 +258,8 @@ void NotificationEngine::apply( Framebuffer& fb ) const
   int overlay_col = 0;
 
   Cell* combining_cell = fb.get_mutable_cell( 0, 0 );
+  Renditions message_renditions = notification_renditions;
+  message_renditions.set_attribute( Renditions::bold, true );
 
   /* We unfortunately duplicate the terminal's logic for how to render a Unicode sequence into graphemes */
   for ( std::wstring::const_iterator i = string_to_draw.begin(); i != string_to_draw.end(); i++ ) {
@@ -257,17 +268,15 @@ void NotificationEngine::apply( Framebuffer& fb ) const
     }
 
     wchar_t ch = *i;
-    int chwidth = ch == L'\0' ? -1 : wcwidth( ch );
+    int chwidth = ch == L'\0' ? -1 : Terminal::char_width( ch );
     Cell* this_cell = 0;
 
     switch ( chwidth ) {
       case 1: /* normal character */
       case 2: /* wide character */
+        fb.reset_cell( 0, overlay_col );
+        fb.set_renditions( 0, overlay_col, message_renditions );
         this_cell = fb.get_mutable_cell( 0, overlay_col );
-        fb.reset_cell( this_cell );
-        this_cell->get_renditions().set_attribute( Renditions::bold, true );
-        this_cell->get_renditions().set_foreground_color( 7 );
-        this_cell->get_renditions().set_background_color( 4 );
 
         this_cell->append( ch );
         this_cell->set_wide( chwidth == 2 );
@@ -293,7 +302,7 @@ void NotificationEngine::apply( Framebuffer& fb ) const
       case -1: /* unprintable character */
         break;
       default:
-        assert( !"unexpected character width from wcwidth()" );
+        assert( !"unexpected character width from char_width()" );
     }
   }
 }
@@ -533,9 +542,9 @@ void PredictionEngine::cull( const Framebuffer& fb )
 
           /* match rest of row to the actual renditions */
           {
-            const Renditions& actual_renditions = fb.get_cell( i->row_num, j->col )->get_renditions();
+            const Renditions& actual_renditions = fb.get_renditions( i->row_num, j->col );
             for ( overlay_cells_type::iterator k = j; k != i->overlay_cells.end(); k++ ) {
-              k->replacement.get_renditions() = actual_renditions;
+              k->replacement_renditions = actual_renditions;
             }
           }
 
@@ -641,11 +650,11 @@ void PredictionEngine::new_user_byte( char the_byte, const Framebuffer& fb )
   parser.input( the_byte, actions );
 
   for ( Parser::Actions::iterator it = actions.begin(); it != actions.end(); it++ ) {
-    Parser::Action& act = **it;
+    const Parser::Action& act = Parser::get_action( *it );
 
     /*
     fprintf( stderr, "Action: %s (%lc)\n",
-             act->name().c_str(), act->char_present ? act->ch : L'_' );
+             act.name().c_str(), act.char_present ? act.ch : L'_' );
     */
 
     const std::type_info& type_act = typeid( act );
@@ -676,6 +685,7 @@ void PredictionEngine::new_user_byte( char the_byte, const Framebuffer& fb )
             const Cell orig_cell = *fb.get_cell();
             cell.original_contents.push_back( orig_cell );
             cell.replacement = orig_cell;
+            cell.replacement_renditions = fb.get_renditions();
             cell.replacement.clear();
             cell.replacement.append( ' ' );
           } else {
@@ -698,10 +708,12 @@ void PredictionEngine::new_user_byte( char the_byte, const Framebuffer& fb )
                   } else {
                     cell.unknown = false;
                     cell.replacement = next_cell.replacement;
+                    cell.replacement_renditions = next_cell.replacement_renditions;
                   }
                 } else {
                   cell.unknown = false;
                   cell.replacement = *next_cell_actual;
+                  cell.replacement_renditions = fb.get_renditions( cursor().row, i + 1 );
                 }
               } else {
                 cell.unknown = true;
@@ -709,7 +721,7 @@ void PredictionEngine::new_user_byte( char the_byte, const Framebuffer& fb )
             }
           }
         }
-      } else if ( ( ch < 0x20 ) || ( wcwidth( ch ) != 1 ) ) {
+      } else if ( ( ch < 0x20 ) || ( Terminal::char_width( ch ) != 1 ) ) {
         /* unknown print */
         become_tentative();
         //	fprintf( stderr, "Unknown print 0x%x\n", ch );
@@ -748,10 +760,12 @@ void PredictionEngine::new_user_byte( char the_byte, const Framebuffer& fb )
             } else {
               cell.unknown = false;
               cell.replacement = prev_cell.replacement;
+              cell.replacement_renditions = prev_cell.replacement_renditions;
             }
           } else {
             cell.unknown = false;
             cell.replacement = *prev_cell_actual;
+            cell.replacement_renditions = fb.get_renditions( cursor().row, i - 1 );
           }
         }
 
@@ -760,16 +774,15 @@ void PredictionEngine::new_user_byte( char the_byte, const Framebuffer& fb )
         cell.active = true;
         cell.tentative_until_epoch = prediction_epoch;
         cell.expire( local_frame_sent + 1, now );
-        cell.replacement.get_renditions() = fb.ds.get_renditions();
+        cell.replacement_renditions = fb.ds.get_renditions();
 
         /* heuristic: match renditions of character to the left */
         if ( cursor().col > 0 ) {
           ConditionalOverlayCell& prev_cell = the_row.overlay_cells[cursor().col - 1];
-          const Cell* prev_cell_actual = fb.get_cell( cursor().row, cursor().col - 1 );
           if ( prev_cell.active && ( !prev_cell.unknown ) ) {
-            cell.replacement.get_renditions() = prev_cell.replacement.get_renditions();
+            cell.replacement_renditions = prev_cell.replacement_renditions;
           } else {
-            cell.replacement.get_renditions() = prev_cell_actual->get_renditions();
+            cell.replacement_renditions = fb.get_renditions( cursor().row, cursor().col - 1 );
           }
         }
 
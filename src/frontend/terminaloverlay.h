@@ -101,6 +101,7 @@ class ConditionalOverlayCell : public ConditionalOverlay
 {
 public:
   Cell replacement;
+  Renditions replacement_renditions;
   bool unknown;
 
   std::vector<Cell> original_contents; /* we don't give credit for correct predictions
@@ -110,7 +111,8 @@ public:
   Validity get_validity( const Framebuffer& fb, int row, uint64_t early_ack, uint64_t late_ack ) const;
 
   ConditionalOverlayCell( uint64_t s_exp, int s_col, uint64_t s_tentative )
-    : ConditionalOverlay( s_exp, s_col, s_tentative ), replacement( 0 ), unknown( false ), original_contents()
+    : ConditionalOverlay( s_exp, s_col, s_tentative ), replacement(), replacement_renditions( 0 ), unknown( false ),
+      original_contents()
   {}
 
   void reset( void )
@@ -0,0 +1,154 @@
+#include <cassert>
+#include <cerrno>
+#include <clocale>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <utility>
+#include <vector>
+
+#include "src/terminal/parser.h"
+
+/* Differential fuzzer: UTF8Parser must produce exactly the actions of
+   the mbrtowc-based decoder it replaced, both byte by byte and through
+   input_printable_run() as Complete::act uses it. */
+
+namespace {
+/* The previous decoder, kept here as the reference.  Needs a UTF-8 locale. */
+class LegacyUTF8Parser
+{
+private:
+  static const size_t BUF_SIZE = 8;
+
+  Parser::Parser parser;
+  char buf[BUF_SIZE];
+  size_t buf_len;
+
+public:
+  LegacyUTF8Parser() : parser(), buf_len( 0 ) { buf[0] = '\0'; }
+
+  void input( char c, Parser::Actions& ret )
+  {
+    assert( buf_len < BUF_SIZE );
+
+    /* 1-byte UTF-8 character, aka ASCII?  Cheat. */
+    if ( buf_len == 0 && static_cast<unsigned char>( c ) <= 0x7f ) {
+      parser.input( static_cast<wchar_t>( c ), ret );
+      return;
+    }
+
+    buf[buf_len++] = c;
+
+    wchar_t pwc;
+    mbstate_t ps = mbstate_t();
+
+    size_t total_bytes_parsed = 0;
+    size_t orig_buf_len = buf_len;
+
+    while ( total_bytes_parsed != orig_buf_len ) {
+      assert( total_bytes_parsed < orig_buf_len );
+      assert( buf_len > 0 );
+      size_t bytes_parsed = mbrtowc( &pwc, buf, buf_len, &ps );
+
+      if ( bytes_parsed == 0 ) {
+        assert( buf_len == 1 );
+        buf_len = 0;
+        pwc = L'\0';
+        bytes_parsed = 1;
+      } else if ( bytes_parsed == (size_t)-1 ) {
+        assert( errno == EILSEQ );
+        if ( buf_len > 1 ) {
+          buf[0] = buf[buf_len - 1];
+          bytes_parsed = buf_len - 1;
+          buf_len = 1;
+        } else {
+          buf_len = 0;
+          bytes_parsed = 1;
+        }
+        pwc = (wchar_t)0xFFFD;
+      } else if ( bytes_parsed == (size_t)-2 ) {
+        total_bytes_parsed += buf_len;
+        continue;
+      } else {
+        assert( bytes_parsed <= buf_len );
+        memmove( buf, buf + bytes_parsed, buf_len - bytes_parsed );
+        buf_len = buf_len - bytes_parsed;
+      }
+
+      const uint32_t pwcheck = pwc;
+      if ( pwcheck > 0x10FFFF ) {
+        pwc = (wchar_t)0xFFFD;
+      }
+      if ( ( pwcheck >= 0xD800 ) && ( pwcheck <= 0xDFFF ) ) {
+        pwc = (wchar_t)0xFFFD;
+      }
+
+      parser.input( pwc, ret );
+
+      total_bytes_parsed += bytes_parsed;
+    }
+  }
+};
+
+using Trace = std::vector<std::pair<size_t, wchar_t>>;
+
+void record( Parser::Actions& actions, Trace& trace )
+{
+  for ( const Parser::ParserAction& act : actions ) {
+    const Parser::Action& a = Parser::get_action( act );
+    trace.push_back( std::make_pair( act.index(), a.char_present ? a.ch : -1 ) );
+  }
+  actions.clear();
+}
+}
+
+extern "C" int LLVMFuzzerInitialize( int*, char*** )
+{
+  if ( setlocale( LC_ALL, "C.UTF-8" ) == NULL ) {
+    abort();
+  }
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+  const char* input = reinterpret_cast<const char*>( data );
+  Parser::Actions actions;
+
+  Trace expected;
+  LegacyUTF8Parser legacy;
+  for ( size_t i = 0; i < size; i++ ) {
+    legacy.input( input[i], actions );
+    record( actions, expected );
+  }
+
+  Trace bytewise;
+  Parser::UTF8Parser parser;
+  for ( size_t i = 0; i < size; i++ ) {
+    parser.input( input[i], actions );
+    record( actions, bytewise );
+  }
+
+  Trace runs;
+  Parser::UTF8Parser run_parser;
+  for ( size_t i = 0; i < size; ) {
+    size_t consumed = 0;
+    if ( run_parser.is_ground() && data[i] >= 0x80 ) {
+      consumed = run_parser.input_printable_run( input + i, size - i, 1 + data[i] % 8, actions );
+    }
+    if ( consumed == 0 ) {
+      run_parser.input( input[i], actions );
+      consumed = 1;
+    }
+    i += consumed;
+    record( actions, runs );
+  }
+
+  if ( bytewise != expected || runs != expected ) {
+    abort();
+  }
+
+  return 0;
+}
@@ -0,0 +1,336 @@
+/* src/include/config.h.  Generated from config.h.in by configure.  */
+/* src/include/config.h.in.  Generated from configure.ac by autoheader.  */
+
+/* Define if FD_ISSET() fd_set argument is const. */
+#define FD_ISSET_IS_CONST 1
+
+/* Define if libutil.h necessary for forkpty(). */
+/* #undef FORKPTY_IN_LIBUTIL */
+
+/* Define to 1 if you have the `cfmakeraw' function. */
+#define HAVE_CFMAKERAW 1
+
+/* Define if clock_gettime() is available. */
+#define HAVE_CLOCK_GETTIME 1
+
+/* Define to 1 if you have the <CommonCrypto/CommonCrypto.h> header file. */
+/* #undef HAVE_COMMONCRYPTO_COMMONCRYPTO_H */
+
+/* Define to 1 if a SysV or X/Open compatible Curses library is present */
+/* #undef HAVE_CURSES */
+
+/* Define to 1 if library supports color (enhanced functions) */
+/* #undef HAVE_CURSES_COLOR */
+
+/* Define to 1 if library supports X/Open Enhanced functions */
+/* #undef HAVE_CURSES_ENHANCED */
+
+/* Define to 1 if <curses.h> is present */
+#define HAVE_CURSES_H 1
+
+/* Define to 1 if library supports certain obsolete features */
+/* #undef HAVE_CURSES_OBSOLETE */
+
+/* define if the compiler supports basic C++17 syntax */
+#define HAVE_CXX17 1
+
+/* Define to 1 if you have the declaration of `be64toh', and to 0 if you
+   don't. */
+#define HAVE_DECL_BE64TOH 1
+
+/* Define to 1 if you have the declaration of `betoh64', and to 0 if you
+   don't. */
+#define HAVE_DECL_BETOH64 0
+
+/* Define to 1 if you have the declaration of `bswap64', and to 0 if you
+   don't. */
+#define HAVE_DECL_BSWAP64 0
+
+/* Define to 1 if you have the declaration of `ffs', and to 0 if you don't. */
+#define HAVE_DECL_FFS 1
+
+/* Define to 1 if you have the declaration of `__builtin_bswap64', and to 0 if
+   you don't. */
+#define HAVE_DECL___BUILTIN_BSWAP64 1
+
+/* Define to 1 if you have the declaration of `__builtin_ctz', and to 0 if you
+   don't. */
+#define HAVE_DECL___BUILTIN_CTZ 1
+
+/* Define to 1 if you have the <endian.h> header file. */
+#define HAVE_ENDIAN_H 1
+
+/* Define to 1 if you have the <fcntl.h> header file. */
+#define HAVE_FCNTL_H 1
+
+/* Define if you have forkpty(). */
+#define HAVE_FORKPTY /**/
+
+/* Define to 1 if you have the `gettimeofday' function. */
+#define HAVE_GETTIMEOFDAY 1
+
+/* Define to 1 if you have the <inttypes.h> header file. */
+#define HAVE_INTTYPES_H 1
+
+/* Define if IP_MTU_DISCOVER is a valid sockopt. */
+#define HAVE_IP_MTU_DISCOVER 1
+
+/* Define if IP_RECVTOS is a valid sockopt. */
+#define HAVE_IP_RECVTOS 1
+
+/* Define if IUTF8 is a defined termios mode. */
+#define HAVE_IUTF8 1
+
+/* Define to 1 if you have the <langinfo.h> header file. */
+#define HAVE_LANGINFO_H 1
+
+/* Define to 1 if you have the <libutil.h> header file. */
+/* #undef HAVE_LIBUTIL_H */
+
+/* Define to 1 if you have the <limits.h> header file. */
+#define HAVE_LIMITS_H 1
+
+/* Define to 1 if you have the <locale.h> header file. */
+#define HAVE_LOCALE_H 1
+
+/* Define if mach_absolute_time is available. */
+/* #undef HAVE_MACH_ABSOLUTE_TIME */
+
+/* Define to 1 if you have the <memory> header file. */
+#define HAVE_MEMORY 1
+
+/* Define to 1 if the Ncurses library is present */
+/* #undef HAVE_NCURSES */
+
+/* Define to 1 if the NcursesW library is present */
+/* #undef HAVE_NCURSESW */
+
+/* Define to 1 if <ncursesw/curses.h> is present */
+/* #undef HAVE_NCURSESW_CURSES_H */
+
+/* Define to 1 if <ncursesw.h> is present */
+/* #undef HAVE_NCURSESW_H */
+
+/* Define to 1 if <ncurses/curses.h> is present */
+/* #undef HAVE_NCURSES_CURSES_H */
+
+/* Define to 1 if <ncurses.h> is present */
+/* #undef HAVE_NCURSES_H */
+
+/* Define to 1 if you have the <netdb.h> header file. */
+#define HAVE_NETDB_H 1
+
+/* Define to 1 if you have the <netinet/in.h> header file. */
+#define HAVE_NETINET_IN_H 1
+
+/* Define if OSSwapHostToBigInt64 and friends exist. */
+/* #undef HAVE_OSX_SWAP */
+
+/* Define to 1 if you have the <paths.h> header file. */
+#define HAVE_PATHS_H 1
+
+/* Define to 1 if you have the `pledge' function. */
+/* #undef HAVE_PLEDGE */
+
+/* Define to 1 if you have the `posix_memalign' function. */
+#define HAVE_POSIX_MEMALIGN 1
+
+/* Define to 1 if you have the `pselect' function. */
+#define HAVE_PSELECT 1
+
+/* Define to 1 if you have the <pty.h> header file. */
+#define HAVE_PTY_H 1
+
+/* Define to 1 if you have the <stddef.h> header file. */
+#define HAVE_STDDEF_H 1
+
+/* Define to 1 if you have the <stdint.h> header file. */
+#define HAVE_STDINT_H 1
+
+/* Define to 1 if you have the <stdio.h> header file. */
+#define HAVE_STDIO_H 1
+
+/* Define to 1 if you have the <stdlib.h> header file. */
+#define HAVE_STDLIB_H 1
+
+/* Define if std::shared_ptr is available. */
+#define HAVE_STD_SHARED_PTR 1
+
+/* Define if std::tr1::shared_ptr is available. */
+#define HAVE_STD_TR1_SHARED_PTR 1
+
+/* Define to 1 if you have the <strings.h> header file. */
+#define HAVE_STRINGS_H 1
+
+/* Define to 1 if you have the <string.h> header file. */
+#define HAVE_STRING_H 1
+
+/* Define if syslog is available. */
+/* #undef HAVE_SYSLOG */
+
+/* Define to 1 if you have the <syslog.h> header file. */
+/* #undef HAVE_SYSLOG_H */
+
+/* Define to 1 if you have the <sys/endian.h> header file. */
+/* #undef HAVE_SYS_ENDIAN_H */
+
+/* Define to 1 if you have the <sys/ioctl.h> header file. */
+#define HAVE_SYS_IOCTL_H 1
+
+/* Define to 1 if you have the <sys/resource.h> header file. */
+#define HAVE_SYS_RESOURCE_H 1
+
+/* Define to 1 if you have the <sys/socket.h> header file. */
+#define HAVE_SYS_SOCKET_H 1
+
+/* Define to 1 if you have the <sys/stat.h> header file. */
+#define HAVE_SYS_STAT_H 1
+
+/* Define to 1 if you have the <sys/time.h> header file. */
+#define HAVE_SYS_TIME_H 1
+
+/* Define to 1 if you have the <sys/types.h> header file. */
+#define HAVE_SYS_TYPES_H 1
+
+/* Define to 1 if you have the <sys/uio.h> header file. */
+#define HAVE_SYS_UIO_H 1
+
+/* Define to 1 if you have the <termios.h> header file. */
+#define HAVE_TERMIOS_H 1
+
+/* Define to 1 if you have the <termio.h> header file. */
+#define HAVE_TERMIO_H 1
+
+/* Define to 1 if TINFO is found */
+/* #undef HAVE_TINFO */
+
+/* Define to 1 if you have the <tr1/memory> header file. */
+#define HAVE_TR1_MEMORY 1
+
+/* Define to 1 if the system has the type `uintptr_t'. */
+#define HAVE_UINTPTR_T 1
+
+/* Define to 1 if you have the <unistd.h> header file. */
+#define HAVE_UNISTD_H 1
+
+/* Define if libutempter is available. */
+/* #undef HAVE_UTEMPTER */
+
+/* Define to 1 if you have the <util.h> header file. */
+/* #undef HAVE_UTIL_H */
+
+/* Define to 1 if you have the <utmpx.h> header file. */
+#define HAVE_UTMPX_H 1
+
+/* Define to 1 if you have the <wchar.h> header file. */
+#define HAVE_WCHAR_H 1
+
+/* Define to 1 if you have the <wctype.h> header file. */
+#define HAVE_WCTYPE_H 1
+
+/* Name of package */
+#define PACKAGE "mosh"
+
+/* Define to the address where bug reports for this package should be sent. */
+#define PACKAGE_BUGREPORT "mosh-devel@mit.edu"
+
+/* Define to the full name of this package. */
+#define PACKAGE_NAME "mosh"
+
+/* Define to the full name and version of this package. */
+#define PACKAGE_STRING "mosh 1.4.0"
+
+/* Define to the one symbol short name of this package. */
+#define PACKAGE_TARNAME "mosh"
+
+/* Define to the home page for this package. */
+#define PACKAGE_URL ""
+
+/* Define to the version of this package. */
+#define PACKAGE_VERSION "1.4.0"
+
+/* Define to 1 if all of the C90 standard headers exist (not just the ones
+   required in a freestanding environment). This macro is provided for
+   backward compatibility; new code need not use it. */
+#define STDC_HEADERS 1
+
+/* Use Apple Common Crypto library */
+/* #undef USE_APPLE_COMMON_CRYPTO_AES */
+
+/* Use Nettle library */
+/* #undef USE_NETTLE_AES */
+
+/* Use OpenSSL library */
+#define USE_OPENSSL_AES 1
+
+/* Version number of package */
+#define VERSION "1.4.0"
+
+/* Define for Solaris 2.5.1 so the uint32_t typedef from <sys/synch.h>,
+   <pthread.h>, or <semaphore.h> is not used. If the typedef were allowed, the
+   #define below would cause a syntax error. */
+/* #undef _UINT32_T */
+
+/* Define for Solaris 2.5.1 so the uint64_t typedef from <sys/synch.h>,
+   <pthread.h>, or <semaphore.h> is not used. If the typedef were allowed, the
+   #define below would cause a syntax error. */
+/* #undef _UINT64_T */
+
+/* Define for Solaris 2.5.1 so the uint8_t typedef from <sys/synch.h>,
+   <pthread.h>, or <semaphore.h> is not used. If the typedef were allowed, the
+   #define below would cause a syntax error. */
+/* #undef _UINT8_T */
+
+/* Define to `__inline__' or `__inline' if that's what the C compiler
+   calls it, or to nothing if 'inline' is not supported under any name.  */
+#ifndef __cplusplus
+/* #undef inline */
+#endif
+
+/* Define to the type of a signed integer type of width exactly 64 bits if
+   such a type exists and the standard includes do not define it. */
+/* #undef int64_t */
+
+/* Define as a signed integer type capable of holding a process identifier. */
+/* #undef pid_t */
+
+/* Define to the equivalent of the C99 'restrict' keyword, or to
+   nothing if this is not supported.  Do not define if restrict is
+   supported only directly.  */
+#define restrict /**/
+/* Work around a bug in older versions of Sun C++, which did not
+   #define __restrict__ or support _Restrict or __restrict__
+   even though the corresponding Sun C compiler ended up with
+   "#define restrict _Restrict" or "#define restrict __restrict__"
+   in the previous line.  This workaround can be removed once
+   we assume Oracle Developer Studio 12.5 (2016) or later.  */
+#if defined __SUNPRO_CC && !defined __RESTRICT && !defined __restrict__
+# define _Restrict
+# define __restrict__
+#endif
+
+/* Define to `unsigned int' if <sys/types.h> does not define. */
+/* #undef size_t */
+
+/* Define to `int' if <sys/types.h> does not define. */
+/* #undef ssize_t */
+
+/* Define to the type of an unsigned integer type of width exactly 16 bits if
+   such a type exists and the standard includes do not define it. */
+/* #undef uint16_t */
+
+/* Define to the type of an unsigned integer type of width exactly 32 bits if
+   such a type exists and the standard includes do not define it. */
+/* #undef uint32_t */
+
+/* Define to the type of an unsigned integer type of width exactly 64 bits if
+   such a type exists and the standard includes do not define it. */
+/* #undef uint64_t */
+
+/* Define to the type of an unsigned integer type of width exactly 8 bits if
+   such a type exists and the standard includes do not define it. */
+/* #undef uint8_t */
+
+/* Define to the type of an unsigned integer type wide enough to hold a
+   pointer, if such a type exists, and if the system does not define it. */
+/* #undef uintptr_t */
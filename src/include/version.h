@@ -0,0 +1 @@
+#define BUILD_VERSION "1fee056-dirty"
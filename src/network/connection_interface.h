@@ -38,6 +38,7 @@
 #include <vector>
 
 #include <netinet/in.h>
+#include <poll.h>
 #include <sys/socket.h>
 
 namespace Network {
@@ -79,6 +80,29 @@ public:
    */
   virtual std::string recv( void ) = 0;
 
+  /**
+   * Check whether recv() can return a message without waiting.
+   *
+   * The default polls fds(); implementations that buffer messages
+   * internally should override this.
+   *
+   * @return true if a message (or a socket error) is ready
+   */
+  virtual bool has_pending_data( void ) const
+  {
+    std::vector<int> fd_list( fds() );
+    std::vector<struct pollfd> pfds( fd_list.size() );
+    for ( size_t i = 0; i < fd_list.size(); i++ ) {
+      pfds[i].fd = fd_list[i];
+      pfds[i].events = POLLIN;
+      pfds[i].revents = 0;
+    }
+    if ( pfds.empty() || poll( pfds.data(), pfds.size(), 0 ) <= 0 ) {
+      return false;
+    }
+    return true;
+  }
+
   /**
    * Get file descriptors to monitor for I/O readiness.
    *
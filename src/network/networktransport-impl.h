@@ -33,6 +33,12 @@
 #ifndef NETWORK_TRANSPORT_IMPL_HPP
 #define NETWORK_TRANSPORT_IMPL_HPP
 
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
 #include "src/network/networktransport.h"
 #include "src/network/tcpconnection.h"
 
@@ -46,8 +52,9 @@ Transport<MyState, RemoteState>::Transport( ConnectionInterface* conn,
                                             MyState& initial_state,
                                             RemoteState& initial_remote )
   : connection( conn ), sender( connection, initial_state ),
-    received_states( 1, TimestampedState<RemoteState>( timestamp(), 0, initial_remote ) ),
-    receiver_quench_timer( 0 ), last_receiver_state( initial_remote ), fragments(), verbose( 0 )
+    received_states(
+      1, TimestampedState<RemoteStatePointer>( timestamp(), 0, std::make_shared<RemoteState>( initial_remote ) ) ),
+    receiver_quench_timer( 0 ), last_receiver_state( received_states.front().state ), fragments(), verbose( 0 )
 {
   /* helper constructor - connection already created */
 }
@@ -58,8 +65,9 @@ Transport<MyState, RemoteState>::Transport( MyState& initial_state,
                                             const char* desired_ip,
                                             const char* desired_port )
   : connection( new UDPConnection( desired_ip, desired_port ) ), sender( connection, initial_state ),
-    received_states( 1, TimestampedState<RemoteState>( timestamp(), 0, initial_remote ) ),
-    receiver_quench_timer( 0 ), last_receiver_state( initial_remote ), fragments(), verbose( 0 )
+    received_states(
+      1, TimestampedState<RemoteStatePointer>( timestamp(), 0, std::make_shared<RemoteState>( initial_remote ) ) ),
+    receiver_quench_timer( 0 ), last_receiver_state( received_states.front().state ), fragments(), verbose( 0 )
 {
   /* server */
 }
@@ -71,8 +79,9 @@ Transport<MyState, RemoteState>::Transport( MyState& initial_state,
                                             const char* ip,
                                             const char* port )
   : connection( new UDPConnection( key_str, ip, port ) ), sender( connection, initial_state ),
-    received_states( 1, TimestampedState<RemoteState>( timestamp(), 0, initial_remote ) ),
-    receiver_quench_timer( 0 ), last_receiver_state( initial_remote ), fragments(), verbose( 0 )
+    received_states(
+      1, TimestampedState<RemoteStatePointer>( timestamp(), 0, std::make_shared<RemoteState>( initial_remote ) ) ),
+    receiver_quench_timer( 0 ), last_receiver_state( received_states.front().state ), fragments(), verbose( 0 )
 {
   /* client */
 }
@@ -138,123 +147,241 @@ Transport<MyState, RemoteState>* Transport<MyState, RemoteState>::create_with_pr
   return new Transport( conn, initial_state, initial_remote );
 }
 
+/* Factory method for a caller-supplied connection */
 template<class MyState, class RemoteState>
-void Transport<MyState, RemoteState>::recv( void )
+Transport<MyState, RemoteState>* Transport<MyState, RemoteState>::create_with_connection(
+  ConnectionInterface* conn,
+  MyState& initial_state,
+  RemoteState& initial_remote )
+{
+  return new Transport( conn, initial_state, initial_remote );
+}
+
+/* Read one datagram; returns true if it completed an instruction */
+template<class MyState, class RemoteState>
+bool Transport<MyState, RemoteState>::read_instruction( Instruction& inst )
 {
   std::string s( connection->recv() );
+  if ( s.empty() ) { /* nothing ready (stream and simulated connections) */
+    return false;
+  }
   Fragment frag( s );
 
-  if ( fragments.add_fragment( frag ) ) { /* complete packet */
-    Instruction inst = fragments.get_assembly();
+  if ( !fragments.add_fragment( frag ) ) {
+    return false;
+  }
+
+  inst = fragments.get_assembly();
+
+  if ( inst.protocol_version() != MOSH_PROTOCOL_VERSION ) {
+    throw NetworkException( "mosh protocol version mismatch", 0 );
+  }
+
+  return true;
+}
+
+template<class MyState, class RemoteState>
+void Transport<MyState, RemoteState>::recv( void )
+{
+  /* Drain everything that is ready, so that a backlog (e.g. after a
+     stall) reaches the caller as one new state.  An error after the first
+     read is raised once the instructions already read are processed. */
+  std::vector<Instruction> batch;
+  std::exception_ptr deferred_error;
+  Instruction inst;
+
+  if ( read_instruction( inst ) ) {
+    batch.push_back( inst );
+  }
 
-    if ( inst.protocol_version() != MOSH_PROTOCOL_VERSION ) {
-      throw NetworkException( "mosh protocol version mismatch", 0 );
+  for ( unsigned int reads = 1; ( reads < RECEIVE_BATCH_LIMIT ) && connection->has_pending_data(); reads++ ) {
+    try {
+      if ( read_instruction( inst ) ) {
+        batch.push_back( inst );
+      }
+    } catch ( ... ) {
+      deferred_error = std::current_exception();
+      break;
     }
+  }
 
-    sender.process_acknowledgment_through( inst.ack_num() );
+  if ( !batch.empty() ) {
+    for ( typename std::vector<Instruction>::const_iterator i = batch.begin(); i != batch.end(); i++ ) {
+      sender.process_acknowledgment_through( i->ack_num() );
+    }
 
     /* inform network layer of roundtrip (end-to-end-to-end) connectivity */
     connection->set_last_roundtrip_success( sender.get_sent_state_acked_timestamp() );
 
-    /* first, make sure we don't already have the new state */
-    for ( typename std::list<TimestampedState<RemoteState>>::iterator i = received_states.begin();
-          i != received_states.end();
-          i++ ) {
-      if ( inst.new_num() == i->num ) {
-        return;
-      }
+    /* apply only the diffs leading to the newest state we can build */
+    std::vector<const Instruction*> chain( newest_chain( batch ) );
+    for ( typename std::vector<const Instruction*>::const_iterator i = chain.begin(); i != chain.end(); i++ ) {
+      apply_instruction( **i );
     }
+  }
 
-    /* now, make sure we do have the old state */
-    bool found = 0;
-    typename std::list<TimestampedState<RemoteState>>::iterator reference_state = received_states.begin();
-    while ( reference_state != received_states.end() ) {
-      if ( inst.old_num() == reference_state->num ) {
-        found = true;
-        break;
-      }
-      reference_state++;
+  if ( deferred_error ) {
+    std::rethrow_exception( deferred_error );
+  }
+}
+
+/* Is this state number in the receiver's queue? */
+template<class MyState, class RemoteState>
+bool Transport<MyState, RemoteState>::have_state( uint64_t num ) const
+{
+  for ( typename received_states_type::const_iterator i = received_states.begin(); i != received_states.end();
+        i++ ) {
+    if ( i->num == num ) {
+      return true;
     }
+  }
+  return false;
+}
 
-    if ( !found ) {
-      //    fprintf( stderr, "Ignoring out-of-order packet. Reference state %d has been discarded or hasn't yet been
-      //    received.\n", int(inst.old_num) );
-      return; /* this is security-sensitive and part of how we enforce idempotency */
+/* The instructions, oldest first, that lead from a state we have to the
+   newest new state in the batch that can be reached at all.  States that
+   are superseded within the batch are never built. */
+template<class MyState, class RemoteState>
+std::vector<const Instruction*> Transport<MyState, RemoteState>::newest_chain(
+  const std::vector<Instruction>& batch ) const
+{
+  std::vector<const Instruction*> candidates;
+  for ( typename std::vector<Instruction>::const_iterator i = batch.begin(); i != batch.end(); i++ ) {
+    candidates.push_back( &*i );
+  }
+  std::stable_sort( candidates.begin(), candidates.end(), []( const Instruction* a, const Instruction* b ) {
+    return a->new_num() > b->new_num();
+  } );
+
+  std::vector<const Instruction*> chain;
+  for ( typename std::vector<const Instruction*>::const_iterator c = candidates.begin(); c != candidates.end();
+        c++ ) {
+    if ( have_state( ( *c )->new_num() ) ) {
+      continue;
     }
 
-    /* Do not accept state if our queue is full */
-    /* This is better than dropping states from the middle of the
-       queue (as sender does), because we don't want to ACK a state
-       and then discard it later. */
-
-    process_throwaway_until( inst.throwaway_num() );
-
-    if ( received_states.size() > 1024 ) { /* limit on state queue */
-      uint64_t now = timestamp();
-      if ( now < receiver_quench_timer ) { /* deny letting state grow further */
-        if ( verbose ) {
-          fprintf(
-            stderr,
-            "[%u] Receiver queue full, discarding %d (malicious sender or long-unidirectional connectivity?)\n",
-            (unsigned int)( timestamp() % 100000 ),
-            (int)inst.new_num() );
+    chain.assign( 1, *c );
+    while ( !have_state( chain.back()->old_num() ) && ( chain.size() <= batch.size() ) ) {
+      const Instruction* predecessor = nullptr;
+      for ( typename std::vector<const Instruction*>::const_iterator p = candidates.begin(); p != candidates.end();
+            p++ ) {
+        if ( ( *p )->new_num() == chain.back()->old_num() ) {
+          predecessor = *p;
+          break;
         }
-        return;
-      } else {
-        receiver_quench_timer = now + 15000;
       }
+      if ( !predecessor ) {
+        break;
+      }
+      chain.push_back( predecessor );
     }
 
-    /* apply diff to reference state */
-    TimestampedState<RemoteState> new_state = *reference_state;
-    new_state.timestamp = timestamp();
-    new_state.num = inst.new_num();
+    if ( have_state( chain.back()->old_num() ) ) {
+      std::reverse( chain.begin(), chain.end() );
+      return chain;
+    }
+  }
 
-    if ( !inst.diff().empty() ) {
-      new_state.state.apply_string( inst.diff() );
+  return std::vector<const Instruction*>();
+}
+
+/* Build and queue the new state described by one instruction */
+template<class MyState, class RemoteState>
+void Transport<MyState, RemoteState>::apply_instruction( const Instruction& inst )
+{
+  /* first, make sure we don't already have the new state */
+  if ( have_state( inst.new_num() ) ) {
+    return;
+  }
+
+  /* now, make sure we do have the old state */
+  bool found = 0;
+  typename received_states_type::iterator reference_state = received_states.begin();
+  while ( reference_state != received_states.end() ) {
+    if ( inst.old_num() == reference_state->num ) {
+      found = true;
+      break;
     }
+    reference_state++;
+  }
 
-    /* Insert new state in sorted place */
-    for ( typename std::list<TimestampedState<RemoteState>>::iterator i = received_states.begin();
-          i != received_states.end();
-          i++ ) {
-      if ( i->num > new_state.num ) {
-        received_states.insert( i, new_state );
-        if ( verbose ) {
-          fprintf( stderr,
-                   "[%u] Received OUT-OF-ORDER state %d [ack %d]\n",
-                   (unsigned int)( timestamp() % 100000 ),
-                   (int)new_state.num,
-                   (int)inst.ack_num() );
-        }
-        return;
+  if ( !found ) {
+    //    fprintf( stderr, "Ignoring out-of-order packet. Reference state %d has been discarded or hasn't yet been
+    //    received.\n", int(inst.old_num) );
+    return; /* this is security-sensitive and part of how we enforce idempotency */
+  }
+
+  /* Do not accept state if our queue is full */
+  /* This is better than dropping states from the middle of the
+     queue (as sender does), because we don't want to ACK a state
+     and then discard it later. */
+
+  process_throwaway_until( inst.throwaway_num() );
+
+  if ( received_states.size() > 1024 ) { /* limit on state queue */
+    uint64_t now = timestamp();
+    if ( now < receiver_quench_timer ) { /* deny letting state grow further */
+      if ( verbose ) {
+        fprintf(
+          stderr,
+          "[%u] Receiver queue full, discarding %d (malicious sender or long-unidirectional connectivity?)\n",
+          (unsigned int)( timestamp() % 100000 ),
+          (int)inst.new_num() );
       }
+      return;
+    } else {
+      receiver_quench_timer = now + 15000;
     }
-    if ( verbose ) {
-      fprintf( stderr,
-               "[%u] Received state %d [coming from %d, ack %d]\n",
-               (unsigned int)( timestamp() % 100000 ),
-               (int)new_state.num,
-               (int)inst.old_num(),
-               (int)inst.ack_num() );
-    }
-    received_states.push_back( new_state );
-    sender.set_ack_num( received_states.back().num );
+  }
 
-    sender.remote_heard( new_state.timestamp );
-    if ( !inst.diff().empty() ) {
-      sender.set_data_ack();
+  /* apply diff to a copy of the reference state (an empty diff shares it) */
+  TimestampedState<RemoteStatePointer> new_state = *reference_state;
+  new_state.timestamp = timestamp();
+  new_state.num = inst.new_num();
+
+  if ( !inst.diff().empty() ) {
+    new_state.state = std::make_shared<RemoteState>( *reference_state->state );
+    new_state.state->apply_string( inst.diff() );
+  }
+
+  /* Insert new state in sorted place */
+  for ( typename received_states_type::iterator i = received_states.begin(); i != received_states.end(); i++ ) {
+    if ( i->num > new_state.num ) {
+      received_states.insert( i, new_state );
+      if ( verbose ) {
+        fprintf( stderr,
+                 "[%u] Received OUT-OF-ORDER state %d [ack %d]\n",
+                 (unsigned int)( timestamp() % 100000 ),
+                 (int)new_state.num,
+                 (int)inst.ack_num() );
+      }
+      return;
     }
   }
+  if ( verbose ) {
+    fprintf( stderr,
+             "[%u] Received state %d [coming from %d, ack %d]\n",
+             (unsigned int)( timestamp() % 100000 ),
+             (int)new_state.num,
+             (int)inst.old_num(),
+             (int)inst.ack_num() );
+  }
+  received_states.push_back( new_state );
+  sender.set_ack_num( received_states.back().num );
+
+  sender.remote_heard( new_state.timestamp );
+  if ( !inst.diff().empty() ) {
+    sender.set_data_ack();
+  }
 }
 
 /* The sender uses throwaway_num to tell us the earliest received state that we need to keep around */
 template<class MyState, class RemoteState>
 void Transport<MyState, RemoteState>::process_throwaway_until( uint64_t throwaway_num )
 {
-  typename std::list<TimestampedState<RemoteState>>::iterator i = received_states.begin();
+  typename received_states_type::iterator i = received_states.begin();
   while ( i != received_states.end() ) {
-    typename std::list<TimestampedState<RemoteState>>::iterator inext = i;
+    typename received_states_type::iterator inext = i;
     inext++;
     if ( i->num < throwaway_num ) {
       received_states.erase( i );
@@ -265,19 +392,33 @@ void Transport<MyState, RemoteState>::process_throwaway_until( uint64_t throwawa
   fatal_assert( received_states.size() > 0 );
 }
 
+/* Subtract a prefix from a shared state, copying it first if anyone else holds it */
+template<class MyState, class RemoteState>
+void Transport<MyState, RemoteState>::subtract_state( RemoteStatePointer& state, const RemoteState* prefix )
+{
+  if constexpr ( std::is_invocable_v<decltype( &RemoteState::subtract ), const RemoteState&, const RemoteState*> ) {
+    /* subtraction cannot modify the state */
+    static_cast<const RemoteState&>( *state ).subtract( prefix );
+  } else {
+    if ( state.use_count() > 1 ) {
+      state = std::make_shared<RemoteState>( *state );
+    }
+    state->subtract( prefix );
+  }
+}
+
 template<class MyState, class RemoteState>
 std::string Transport<MyState, RemoteState>::get_remote_diff( void )
 {
   /* find diff between last receiver state and current remote state, then rationalize states */
 
-  std::string ret( received_states.back().state.diff_from( last_receiver_state ) );
+  std::string ret( received_states.back().state->diff_from( *last_receiver_state ) );
 
-  const RemoteState* oldest_receiver_state = &received_states.front().state;
+  const RemoteState* oldest_receiver_state = received_states.front().state.get();
 
-  for ( typename std::list<TimestampedState<RemoteState>>::reverse_iterator i = received_states.rbegin();
-        i != received_states.rend();
+  for ( typename received_states_type::reverse_iterator i = received_states.rbegin(); i != received_states.rend();
         i++ ) {
-    i->state.subtract( oldest_receiver_state );
+    subtract_state( i->state, oldest_receiver_state );
   }
 
   last_receiver_state = received_states.back().state;
@@ -36,6 +36,7 @@
 #include <csignal>
 #include <ctime>
 #include <list>
+#include <memory>
 #include <string>
 #include <vector>
 #include <strings.h>
@@ -81,12 +82,25 @@ private:
   TransportSender<MyState> sender;
 
   /* helper methods for recv() */
+  static const unsigned int RECEIVE_BATCH_LIMIT = 256; /* datagrams read per recv() */
+  bool read_instruction( Instruction& inst );
+  bool have_state( uint64_t num ) const;
+  std::vector<const Instruction*> newest_chain( const std::vector<Instruction>& batch ) const;
+  void apply_instruction( const Instruction& inst );
   void process_throwaway_until( uint64_t throwaway_num );
 
   /* simple receiver */
-  std::list<TimestampedState<RemoteState>> received_states;
+  /* Received states are shared, copy-on-write snapshots: a state is only
+     cloned when a diff is applied to it or it must be modified while
+     another holder still refers to it. */
+  using RemoteStatePointer = std::shared_ptr<RemoteState>;
+  using received_states_type = std::list<TimestampedState<RemoteStatePointer>>;
+  received_states_type received_states;
   uint64_t receiver_quench_timer;
-  RemoteState last_receiver_state; /* the state we were in when user last queried state */
+  RemoteStatePointer last_receiver_state; /* the state we were in when user last queried state */
+
+  /* helper method for get_remote_diff() */
+  void subtract_state( RemoteStatePointer& state, const RemoteState* prefix );
   FragmentAssembly fragments;
   unsigned int verbose;
 
@@ -123,13 +137,19 @@ public:
                                           const char* port,
                                           uint64_t tcp_timeout_ms = 500 );
 
+  /* Factory method for a caller-supplied connection (e.g. simulated); takes ownership */
+  static Transport* create_with_connection( ConnectionInterface* conn,
+                                            MyState& initial_state,
+                                            RemoteState& initial_remote );
+
   /* Send data or an ack if necessary. */
   void tick( void ) { sender.tick(); }
 
   /* Returns the number of ms to wait until next possible event. */
   int wait_time( void ) { return sender.wait_time(); }
 
-  /* Blocks waiting for a packet. */
+  /* Blocks waiting for a packet, then also reads any others already
+     waiting and applies them as one update. */
   void recv( void );
 
   /* Find diff between last receiver state and current remote state, then rationalize states. */
@@ -154,7 +174,10 @@ public:
 
   uint64_t get_remote_state_num( void ) const { return received_states.back().num; }
 
-  const TimestampedState<RemoteState>& get_latest_remote_state( void ) const { return received_states.back(); }
+  const TimestampedState<RemoteStatePointer>& get_latest_remote_state( void ) const
+  {
+    return received_states.back();
+  }
 
   const std::vector<int> fds( void ) const { return connection->fds(); }
 
@@ -165,6 +188,7 @@ public:
   }
 
   void set_send_delay( int new_delay ) { sender.set_send_delay( new_delay ); }
+  void set_frame_budget( size_t budget ) { sender.set_frame_budget( budget ); }
 
   uint64_t get_sent_state_acked_timestamp( void ) const { return sender.get_sent_state_acked_timestamp(); }
   uint64_t get_sent_state_acked( void ) const { return sender.get_sent_state_acked(); }
@@ -0,0 +1,166 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "src/network/simulatedconnection.h"
+#include "src/util/timestamp.h"
+
+using namespace Network;
+
+uint64_t SimulatedLink::delay( void )
+{
+  uint64_t d = conditions.latency;
+  if ( conditions.jitter ) {
+    d += std::uniform_int_distribution<uint64_t>( 0, conditions.jitter )( rng );
+  }
+  return d;
+}
+
+void SimulatedLink::transmit( Side from, const Packet& packet )
+{
+  Queue& queue = queues[1 - from];
+  const uint64_t now = timestamp();
+
+  queue.stats.packets_sent++;
+  queue.stats.bytes_sent += packet.payload.size();
+
+  /* serialization delay behind earlier packets */
+  double sent_at = now;
+  if ( conditions.bandwidth ) {
+    sent_at = std::max( sent_at, queue.busy_until ) + 1000.0 * packet.payload.size() / conditions.bandwidth;
+    queue.busy_until = sent_at;
+  }
+
+  if ( uniform() < conditions.loss ) {
+    queue.stats.packets_dropped++;
+    return;
+  }
+
+  uint64_t arrival = uint64_t( ceil( sent_at ) ) + delay();
+  if ( uniform() < conditions.reorder ) {
+    arrival += conditions.latency + 1;
+  }
+  queue.packets.emplace( std::make_pair( arrival, next_seq++ ), packet );
+
+  if ( uniform() < conditions.duplicate ) {
+    queue.stats.packets_duplicated++;
+    queue.packets.emplace( std::make_pair( uint64_t( ceil( sent_at ) ) + delay(), next_seq++ ), packet );
+  }
+}
+
+bool SimulatedLink::pending( Side to ) const
+{
+  const Queue& queue = queues[to];
+  return !queue.packets.empty() && ( queue.packets.begin()->first.first <= timestamp() );
+}
+
+bool SimulatedLink::deliver( Side to, Packet& packet )
+{
+  if ( !pending( to ) ) {
+    return false;
+  }
+
+  Queue& queue = queues[to];
+  packet = queue.packets.begin()->second;
+  queue.packets.erase( queue.packets.begin() );
+  return true;
+}
+
+SimulatedConnection::SimulatedConnection( std::shared_ptr<SimulatedLink> s_link, SimulatedLink::Side s_side )
+  : link( s_link ), side( s_side ), has_remote_addr( s_side == SimulatedLink::CLIENT ), remote_addr(),
+    saved_timestamp( -1 ), saved_timestamp_received_at( 0 ), RTT_hit( false ), SRTT( 1000 ), RTTVAR( 500 ),
+    send_error()
+{
+  memset( &remote_addr, 0, sizeof( remote_addr ) );
+}
+
+void SimulatedConnection::send( const std::string& s )
+{
+  const uint64_t now = timestamp();
+  SimulatedLink::Packet packet = { now, uint64_t( -1 ), s };
+
+  if ( now - saved_timestamp_received_at < 1000 ) { /* we have a recent received timestamp */
+    /* send "corrected" timestamp advanced by how long we held it */
+    packet.timestamp_reply = saved_timestamp + ( now - saved_timestamp_received_at );
+    saved_timestamp = -1;
+    saved_timestamp_received_at = 0;
+  }
+
+  link->transmit( side, packet );
+}
+
+std::string SimulatedConnection::recv( void )
+{
+  SimulatedLink::Packet packet;
+  if ( !link->deliver( side, packet ) ) {
+    return std::string();
+  }
+
+  const uint64_t now = timestamp();
+  saved_timestamp = packet.timestamp;
+  saved_timestamp_received_at = now;
+
+  if ( packet.timestamp_reply != uint64_t( -1 ) ) {
+    double R = now - packet.timestamp_reply;
+
+    if ( !RTT_hit ) { /* first measurement */
+      SRTT = R;
+      RTTVAR = R / 2;
+      RTT_hit = true;
+    } else {
+      const double alpha = 1.0 / 8.0;
+      const double beta = 1.0 / 4.0;
+
+      RTTVAR = ( 1 - beta ) * RTTVAR + ( beta * fabs( SRTT - R ) );
+      SRTT = ( 1 - alpha ) * SRTT + ( alpha * R );
+    }
+  }
+
+  has_remote_addr = true;
+
+  return packet.payload;
+}
+
+uint64_t SimulatedConnection::timeout( void ) const
+{
+  uint64_t RTO = lrint( ceil( SRTT + 4 * RTTVAR ) );
+  if ( RTO < MIN_RTO ) {
+    RTO = MIN_RTO;
+  } else if ( RTO > MAX_RTO ) {
+    RTO = MAX_RTO;
+  }
+  return RTO;
+}
@@ -0,0 +1,185 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+#ifndef SIMULATEDCONNECTION_HPP
+#define SIMULATEDCONNECTION_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "connection_interface.h"
+#include "network.h"
+
+namespace Network {
+
+/* Conditions applied to each direction of a simulated link */
+struct LinkConditions
+{
+  uint64_t latency;   /* ms, one way */
+  uint64_t jitter;    /* ms, uniformly distributed extra delay */
+  double loss;        /* probability that a packet is dropped */
+  double reorder;     /* probability that a packet is held back by another latency */
+  double duplicate;   /* probability that a packet is delivered twice */
+  uint64_t bandwidth; /* bytes per second, 0 for unlimited */
+
+  LinkConditions() : latency( 0 ), jitter( 0 ), loss( 0 ), reorder( 0 ), duplicate( 0 ), bandwidth( 0 ) {}
+};
+
+/*
+ * In-process, deterministic model of a network path between a client
+ * and a server endpoint.  All timing comes from timestamp(), so a
+ * harness driving the clock with set_virtual_timestamp() gets the same
+ * run for the same seed.
+ */
+class SimulatedLink
+{
+public:
+  enum Side
+  {
+    CLIENT = 0,
+    SERVER = 1
+  };
+
+  struct Packet
+  {
+    uint64_t timestamp;       /* sender clock, ms */
+    uint64_t timestamp_reply; /* echoed peer timestamp, or -1 */
+    std::string payload;
+  };
+
+  struct Statistics
+  {
+    uint64_t packets_sent;
+    uint64_t packets_dropped;
+    uint64_t packets_duplicated;
+    uint64_t bytes_sent;
+
+    Statistics() : packets_sent( 0 ), packets_dropped( 0 ), packets_duplicated( 0 ), bytes_sent( 0 ) {}
+  };
+
+private:
+  struct Queue
+  {
+    /* keyed by delivery time, then by order of transmission */
+    std::map<std::pair<uint64_t, uint64_t>, Packet> packets;
+    double busy_until; /* ms, end of serialization of the last packet */
+    Statistics stats;
+
+    Queue() : packets(), busy_until( 0 ), stats() {}
+  };
+
+  LinkConditions conditions;
+  std::mt19937_64 rng;
+  uint64_t next_seq;
+  Queue queues[2]; /* indexed by receiving side */
+
+  double uniform( void ) { return std::uniform_real_distribution<double>( 0.0, 1.0 )( rng ); }
+  uint64_t delay( void );
+
+public:
+  SimulatedLink( const LinkConditions& s_conditions, uint64_t seed )
+    : conditions( s_conditions ), rng( seed ), next_seq( 0 ), queues()
+  {}
+
+  void set_conditions( const LinkConditions& s_conditions ) { conditions = s_conditions; }
+  const LinkConditions& get_conditions( void ) const { return conditions; }
+
+  /* Queue a packet for delivery to the other side */
+  void transmit( Side from, const Packet& packet );
+
+  /* Take the next packet that has arrived at a side by now */
+  bool deliver( Side to, Packet& packet );
+  bool pending( Side to ) const;
+
+  /* Statistics for packets sent by a side */
+  const Statistics& get_statistics( Side from ) const { return queues[1 - from].stats; }
+};
+
+/*
+ * ConnectionInterface endpoint of a SimulatedLink.  Payloads are not
+ * encrypted; round-trip time is estimated from echoed timestamps the way
+ * UDPConnection does it.
+ */
+class SimulatedConnection : public ConnectionInterface
+{
+private:
+  static const int DEFAULT_MTU = 1280 - 28; /* as for UDP over IPv4 */
+  static const uint64_t MIN_RTO = 50;       /* ms */
+  static const uint64_t MAX_RTO = 1000;     /* ms */
+
+  std::shared_ptr<SimulatedLink> link;
+  SimulatedLink::Side side;
+
+  bool has_remote_addr;
+  Addr remote_addr;
+
+  uint64_t saved_timestamp;
+  uint64_t saved_timestamp_received_at;
+
+  bool RTT_hit;
+  double SRTT;
+  double RTTVAR;
+
+  std::string send_error;
+
+public:
+  SimulatedConnection( std::shared_ptr<SimulatedLink> s_link, SimulatedLink::Side s_side );
+
+  void send( const std::string& s ) override;
+  std::string recv( void ) override;
+  bool has_pending_data( void ) const override { return link->pending( side ); }
+
+  const std::vector<int> fds( void ) const override { return std::vector<int>(); }
+  uint64_t timeout( void ) const override;
+  int get_MTU( void ) const override { return DEFAULT_MTU; }
+
+  std::string port( void ) const override { return "simulated"; }
+  std::string get_key( void ) const override { return std::string(); }
+  bool get_has_remote_addr( void ) const override { return has_remote_addr; }
+
+  double get_SRTT( void ) const override { return SRTT; }
+  void set_last_roundtrip_success( uint64_t ) override {}
+
+  std::string& get_send_error( void ) override { return send_error; }
+
+  const Addr& get_remote_addr( void ) const override { return remote_addr; }
+  socklen_t get_remote_addr_len( void ) const override { return 0; }
+};
+}
+
+#endif
@@ -827,6 +827,18 @@ std::string TCPConnection::recv( void )
   }
 }
 
+/* Is a complete message already buffered?  (Reading the socket for a
+   partial one could block, so only buffered messages count.) */
+bool TCPConnection::has_pending_data( void ) const
+{
+  if ( !connected || recv_buffer.size() < sizeof( uint32_t ) ) {
+    return false;
+  }
+  uint32_t net_len;
+  memcpy( &net_len, recv_buffer.data(), sizeof( net_len ) );
+  return recv_buffer.size() >= sizeof( uint32_t ) + ntohl( net_len );
+}
+
 /* Get file descriptors for select/poll */
 const std::vector<int> TCPConnection::fds( void ) const
 {
@@ -176,6 +176,7 @@ public:
   /* ConnectionInterface implementation */
   void send( const std::string& s ) override;
   std::string recv( void ) override;
+  bool has_pending_data( void ) const override;
   const std::vector<int> fds( void ) const override;
   uint64_t timeout( void ) const override;
   int get_MTU( void ) const override { return MTU; }
@@ -39,6 +39,7 @@
 #include <cstdlib>
 #include <ctime>
 #include <list>
+#include <optional>
 
 #include "src/network/transportfragment.h"
 #include "src/network/transportsender.h"
@@ -53,7 +54,8 @@ TransportSender<MyState>::TransportSender( ConnectionInterface* s_connection, My
     assumed_receiver_state( sent_states.begin() ), fragmenter(), next_ack_time( timestamp() ),
     next_send_time( timestamp() ), verbose( 0 ), shutdown_in_progress( false ), shutdown_tries( 0 ),
     shutdown_start( -1 ), ack_num( 0 ), pending_data_ack( false ), SEND_MINDELAY( 8 ), last_heard( 0 ), prng(),
-    mindelay_clock( -1 )
+    mindelay_clock( -1 ), frame_budget( 0 ), partial_state(), partial_diff(), partial_base_generation( 0 ),
+    partial_target_generation( 0 )
 {}
 
 /* Try to send roughly two frames per RTT, bounded by limits on frame rate */
@@ -86,18 +88,20 @@ void TransportSender<MyState>::calculate_timers( void )
     next_ack_time = now + ACK_DELAY;
   }
 
-  if ( !( current_state == sent_states.back().state ) ) {
+  if ( !same_state( current_state, sent_states.back().state ) ) {
     if ( mindelay_clock == uint64_t( -1 ) ) {
       mindelay_clock = now;
     }
 
     next_send_time = std::max( mindelay_clock + SEND_MINDELAY, sent_states.back().timestamp + send_interval() );
-  } else if ( !( current_state == assumed_receiver_state->state ) && ( last_heard + ACTIVE_RETRY_TIMEOUT > now ) ) {
+  } else if ( !same_state( current_state, assumed_receiver_state->state )
+              && ( last_heard + ACTIVE_RETRY_TIMEOUT > now ) ) {
     next_send_time = sent_states.back().timestamp + send_interval();
     if ( mindelay_clock != uint64_t( -1 ) ) {
       next_send_time = std::max( next_send_time, mindelay_clock + SEND_MINDELAY );
     }
-  } else if ( !( current_state == sent_states.front().state ) && ( last_heard + ACTIVE_RETRY_TIMEOUT > now ) ) {
+  } else if ( !same_state( current_state, sent_states.front().state )
+              && ( last_heard + ACTIVE_RETRY_TIMEOUT > now ) ) {
     next_send_time = sent_states.back().timestamp + connection->timeout() + ACK_DELAY;
   } else {
     next_send_time = uint64_t( -1 );
@@ -151,19 +155,52 @@ void TransportSender<MyState>::tick( void )
 
   /* Determine if a new diff or empty ack needs to be sent */
 
-  std::string diff = current_state.diff_from( assumed_receiver_state->state );
+  std::string diff;
+  bool send_partial = false;
 
-  attempt_prospective_resend_optimization( diff );
+  /* Fast path: the receiver has the current state, so the diff is empty
+     and only an ack can be due. */
+  const uint64_t generation = current_state.get_generation();
+  const bool pure_ack = ( generation == assumed_receiver_state->state.get_generation() )
+                        && ( generation == sent_states.front().state.get_generation() );
 
-  if ( verbose ) {
+  if ( pure_ack ) {
+    assumed_receiver_state = sent_states.begin();
+  } else {
+    diff = current_state.diff_from( assumed_receiver_state->state );
+
+    attempt_prospective_resend_optimization( diff );
+
+    /* If the diff is too big for one frame, send an intermediate state
+       now and let later frames carry the rest. */
+    if ( frame_budget && ( diff.size() > frame_budget ) && !shutdown_in_progress ) {
+      const uint64_t base_generation = assumed_receiver_state->state.get_generation();
+      if ( !partial_state || ( partial_base_generation != base_generation )
+           || ( partial_target_generation != generation ) ) {
+        partial_state.emplace( current_state.partial_from( assumed_receiver_state->state, frame_budget ) );
+        partial_diff = partial_state->diff_from( assumed_receiver_state->state );
+        partial_base_generation = base_generation;
+        partial_target_generation = generation;
+      }
+      send_partial = !same_state( *partial_state, current_state );
+      if ( send_partial ) {
+        diff = partial_diff;
+      }
+    } else {
+      partial_state.reset();
+    }
+  }
+  const MyState& target_state = send_partial ? *partial_state : current_state;
+
+  if ( verbose && !pure_ack ) {
     /* verify diff has round-trip identity (modulo Unicode fallback rendering) */
     MyState newstate( assumed_receiver_state->state );
     newstate.apply_string( diff );
-    if ( current_state.compare( newstate ) ) {
+    if ( target_state.compare( newstate ) ) {
       fprintf( stderr, "Warning, round-trip Instruction verification failed!\n" );
     }
     /* Also verify that both the original frame and generated frame have the same initial diff. */
-    std::string current_diff( current_state.init_diff() );
+    std::string current_diff( target_state.init_diff() );
     std::string new_diff( newstate.init_diff() );
     if ( current_diff != new_diff ) {
       fprintf( stderr, "Warning, target state Instruction verification failed!\n" );
@@ -181,7 +218,7 @@ void TransportSender<MyState>::tick( void )
     }
   } else if ( ( now >= next_send_time ) || ( now >= next_ack_time ) ) {
     /* Send diffs or ack */
-    send_to_receiver( diff );
+    send_to_receiver( diff, target_state );
     mindelay_clock = uint64_t( -1 );
   }
 }
@@ -209,7 +246,7 @@ void TransportSender<MyState>::send_empty_ack( void )
 }
 
 template<class MyState>
-void TransportSender<MyState>::add_sent_state( uint64_t the_timestamp, uint64_t num, MyState& state )
+void TransportSender<MyState>::add_sent_state( uint64_t the_timestamp, uint64_t num, const MyState& state )
 {
   sent_states.push_back( TimestampedState<MyState>( the_timestamp, num, state ) );
   if ( sent_states.size() > 32 ) { /* limit on state queue */
@@ -222,10 +259,10 @@ void TransportSender<MyState>::add_sent_state( uint64_t the_timestamp, uint64_t
 }
 
 template<class MyState>
-void TransportSender<MyState>::send_to_receiver( const std::string& diff )
+void TransportSender<MyState>::send_to_receiver( const std::string& diff, const MyState& state )
 {
   uint64_t new_num;
-  if ( current_state == sent_states.back().state ) { /* previously sent */
+  if ( same_state( state, sent_states.back().state ) ) { /* previously sent */
     new_num = sent_states.back().num;
   } else { /* new state */
     new_num = sent_states.back().num + 1;
@@ -239,7 +276,7 @@ void TransportSender<MyState>::send_to_receiver( const std::string& diff )
   if ( new_num == sent_states.back().num ) {
     sent_states.back().timestamp = timestamp();
   } else {
-    add_sent_state( timestamp(), new_num, current_state );
+    add_sent_state( timestamp(), new_num, state );
   }
 
   send_in_fragments( diff, new_num ); // Can throw NetworkException
@@ -34,6 +34,7 @@
 #define TRANSPORT_SENDER_HPP
 
 #include <list>
+#include <optional>
 #include <string>
 
 #include "src/crypto/prng.h"
@@ -62,10 +63,10 @@ private:
   void update_assumed_receiver_state( void );
   void attempt_prospective_resend_optimization( std::string& proposed_diff );
   void rationalize_states( void );
-  void send_to_receiver( const std::string& diff );
+  void send_to_receiver( const std::string& diff, const MyState& state );
   void send_empty_ack( void );
   void send_in_fragments( const std::string& diff, uint64_t new_num );
-  void add_sent_state( uint64_t the_timestamp, uint64_t num, MyState& state );
+  void add_sent_state( uint64_t the_timestamp, uint64_t num, const MyState& state );
 
   /* state of sender */
   ConnectionInterface* connection;
@@ -89,6 +90,12 @@ private:
 
   void calculate_timers( void );
 
+  /* equal generations are a cheap proof of equality */
+  static bool same_state( const MyState& a, const MyState& b )
+  {
+    return ( a.get_generation() == b.get_generation() ) || ( a == b );
+  }
+
   unsigned int verbose;
   bool shutdown_in_progress;
   int shutdown_tries;
@@ -108,6 +115,17 @@ private:
 
   uint64_t mindelay_clock; /* time of first pending change to current state */
 
+  size_t frame_budget; /* max diff bytes per frame before sending partial states, 0 = unlimited */
+
+  /* The intermediate state sent while the diff is over budget, and its
+     diff, kept until the current or assumed receiver state (whose
+     generations they were made from) changes, since each tick would
+     otherwise search for the same one again. */
+  std::optional<MyState> partial_state;
+  std::string partial_diff;
+  uint64_t partial_base_generation;
+  uint64_t partial_target_generation;
+
 public:
   /* constructor */
   TransportSender( ConnectionInterface* s_connection, MyState& initial_state );
@@ -165,6 +183,8 @@ public:
 
   void set_send_delay( int new_delay ) { SEND_MINDELAY = new_delay; }
 
+  void set_frame_budget( size_t budget ) { frame_budget = budget; }
+
   unsigned int send_interval( void ) const;
 
   /* nonexistent methods to satisfy -Weffc++ */
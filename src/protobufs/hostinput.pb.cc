@@ -0,0 +1,1459 @@
+// Generated by the protocol buffer compiler.  DO NOT EDIT!
+// source: hostinput.proto
+
+#include "hostinput.pb.h"
+
+#include <algorithm>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/extension_set.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+// @@protoc_insertion_point(includes)
+#include <google/protobuf/port_def.inc>
+
+PROTOBUF_PRAGMA_INIT_SEG
+
+namespace _pb = ::PROTOBUF_NAMESPACE_ID;
+namespace _pbi = _pb::internal;
+
+namespace HostBuffers {
+PROTOBUF_CONSTEXPR HostMessage::HostMessage(
+    ::_pbi::ConstantInitialized): _impl_{
+    /*decltype(_impl_.instruction_)*/{}
+  , /*decltype(_impl_._cached_size_)*/{}} {}
+struct HostMessageDefaultTypeInternal {
+  PROTOBUF_CONSTEXPR HostMessageDefaultTypeInternal()
+      : _instance(::_pbi::ConstantInitialized{}) {}
+  ~HostMessageDefaultTypeInternal() {}
+  union {
+    HostMessage _instance;
+  };
+};
+PROTOBUF_ATTRIBUTE_NO_DESTROY PROTOBUF_CONSTINIT PROTOBUF_ATTRIBUTE_INIT_PRIORITY1 HostMessageDefaultTypeInternal _HostMessage_default_instance_;
+PROTOBUF_CONSTEXPR Instruction::Instruction(
+    ::_pbi::ConstantInitialized): _impl_{
+    /*decltype(_impl_._extensions_)*/{}
+  , /*decltype(_impl_._cached_size_)*/{}} {}
+struct InstructionDefaultTypeInternal {
+  PROTOBUF_CONSTEXPR InstructionDefaultTypeInternal()
+      : _instance(::_pbi::ConstantInitialized{}) {}
+  ~InstructionDefaultTypeInternal() {}
+  union {
+    Instruction _instance;
+  };
+};
+PROTOBUF_ATTRIBUTE_NO_DESTROY PROTOBUF_CONSTINIT PROTOBUF_ATTRIBUTE_INIT_PRIORITY1 InstructionDefaultTypeInternal _Instruction_default_instance_;
+PROTOBUF_CONSTEXPR HostBytes::HostBytes(
+    ::_pbi::ConstantInitialized): _impl_{
+    /*decltype(_impl_._has_bits_)*/{}
+  , /*decltype(_impl_._cached_size_)*/{}
+  , /*decltype(_impl_.hoststring_)*/{&::_pbi::fixed_address_empty_string, ::_pbi::ConstantInitialized{}}} {}
+struct HostBytesDefaultTypeInternal {
+  PROTOBUF_CONSTEXPR HostBytesDefaultTypeInternal()
+      : _instance(::_pbi::ConstantInitialized{}) {}
+  ~HostBytesDefaultTypeInternal() {}
+  union {
+    HostBytes _instance;
+  };
+};
+PROTOBUF_ATTRIBUTE_NO_DESTROY PROTOBUF_CONSTINIT PROTOBUF_ATTRIBUTE_INIT_PRIORITY1 HostBytesDefaultTypeInternal _HostBytes_default_instance_;
+PROTOBUF_CONSTEXPR ResizeMessage::ResizeMessage(
+    ::_pbi::ConstantInitialized): _impl_{
+    /*decltype(_impl_._has_bits_)*/{}
+  , /*decltype(_impl_._cached_size_)*/{}
+  , /*decltype(_impl_.width_)*/0
+  , /*decltype(_impl_.height_)*/0} {}
+struct ResizeMessageDefaultTypeInternal {
+  PROTOBUF_CONSTEXPR ResizeMessageDefaultTypeInternal()
+      : _instance(::_pbi::ConstantInitialized{}) {}
+  ~ResizeMessageDefaultTypeInternal() {}
+  union {
+    ResizeMessage _instance;
+  };
+};
+PROTOBUF_ATTRIBUTE_NO_DESTROY PROTOBUF_CONSTINIT PROTOBUF_ATTRIBUTE_INIT_PRIORITY1 ResizeMessageDefaultTypeInternal _ResizeMessage_default_instance_;
+PROTOBUF_CONSTEXPR EchoAck::EchoAck(
+    ::_pbi::ConstantInitialized): _impl_{
+    /*decltype(_impl_._has_bits_)*/{}
+  , /*decltype(_impl_._cached_size_)*/{}
+  , /*decltype(_impl_.echo_ack_num_)*/uint64_t{0u}} {}
+struct EchoAckDefaultTypeInternal {
+  PROTOBUF_CONSTEXPR EchoAckDefaultTypeInternal()
+      : _instance(::_pbi::ConstantInitialized{}) {}
+  ~EchoAckDefaultTypeInternal() {}
+  union {
+    EchoAck _instance;
+  };
+};
+PROTOBUF_ATTRIBUTE_NO_DESTROY PROTOBUF_CONSTINIT PROTOBUF_ATTRIBUTE_INIT_PRIORITY1 EchoAckDefaultTypeInternal _EchoAck_default_instance_;
+PROTOBUF_CONSTEXPR ScrollbackLines::ScrollbackLines(
+    ::_pbi::ConstantInitialized): _impl_{
+    /*decltype(_impl_._has_bits_)*/{}
+  , /*decltype(_impl_._cached_size_)*/{}
+  , /*decltype(_impl_.line_)*/{}
+  , /*decltype(_impl_.first_)*/uint64_t{0u}
+  , /*decltype(_impl_.end_)*/uint64_t{0u}
+  , /*decltype(_impl_.oldest_)*/uint64_t{0u}} {}
+struct ScrollbackLinesDefaultTypeInternal {
+  PROTOBUF_CONSTEXPR ScrollbackLinesDefaultTypeInternal()
+      : _instance(::_pbi::ConstantInitialized{}) {}
+  ~ScrollbackLinesDefaultTypeInternal() {}
+  union {
+    ScrollbackLines _instance;
+  };
+};
+PROTOBUF_ATTRIBUTE_NO_DESTROY PROTOBUF_CONSTINIT PROTOBUF_ATTRIBUTE_INIT_PRIORITY1 ScrollbackLinesDefaultTypeInternal _ScrollbackLines_default_instance_;
+}  // namespace HostBuffers
+namespace HostBuffers {
+
+// ===================================================================
+
+class HostMessage::_Internal {
+ public:
+};
+
+HostMessage::HostMessage(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                         bool is_message_owned)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite(arena, is_message_owned) {
+  SharedCtor(arena, is_message_owned);
+  // @@protoc_insertion_point(arena_constructor:HostBuffers.HostMessage)
+}
+HostMessage::HostMessage(const HostMessage& from)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite() {
+  HostMessage* const _this = this; (void)_this;
+  new (&_impl_) Impl_{
+      decltype(_impl_.instruction_){from._impl_.instruction_}
+    , /*decltype(_impl_._cached_size_)*/{}};
+
+  _internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+  // @@protoc_insertion_point(copy_constructor:HostBuffers.HostMessage)
+}
+
+inline void HostMessage::SharedCtor(
+    ::_pb::Arena* arena, bool is_message_owned) {
+  (void)arena;
+  (void)is_message_owned;
+  new (&_impl_) Impl_{
+      decltype(_impl_.instruction_){arena}
+    , /*decltype(_impl_._cached_size_)*/{}
+  };
+}
+
+HostMessage::~HostMessage() {
+  // @@protoc_insertion_point(destructor:HostBuffers.HostMessage)
+  if (auto *arena = _internal_metadata_.DeleteReturnArena<std::string>()) {
+  (void)arena;
+    return;
+  }
+  SharedDtor();
+}
+
+inline void HostMessage::SharedDtor() {
+  GOOGLE_DCHECK(GetArenaForAllocation() == nullptr);
+  _impl_.instruction_.~RepeatedPtrField();
+}
+
+void HostMessage::SetCachedSize(int size) const {
+  _impl_._cached_size_.Set(size);
+}
+
+void HostMessage::Clear() {
+// @@protoc_insertion_point(message_clear_start:HostBuffers.HostMessage)
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  _impl_.instruction_.Clear();
+  _internal_metadata_.Clear<std::string>();
+}
+
+const char* HostMessage::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
+#define CHK_(x) if (PROTOBUF_PREDICT_FALSE(!(x))) goto failure
+  while (!ctx->Done(&ptr)) {
+    uint32_t tag;
+    ptr = ::_pbi::ReadTag(ptr, &tag);
+    switch (tag >> 3) {
+      // repeated .HostBuffers.Instruction instruction = 1;
+      case 1:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 10)) {
+          ptr -= 1;
+          do {
+            ptr += 1;
+            ptr = ctx->ParseMessage(_internal_add_instruction(), ptr);
+            CHK_(ptr);
+            if (!ctx->DataAvailable(ptr)) break;
+          } while (::PROTOBUF_NAMESPACE_ID::internal::ExpectTag<10>(ptr));
+        } else
+          goto handle_unusual;
+        continue;
+      default:
+        goto handle_unusual;
+    }  // switch
+  handle_unusual:
+    if ((tag == 0) || ((tag & 7) == 4)) {
+      CHK_(ptr);
+      ctx->SetLastTag(tag);
+      goto message_done;
+    }
+    ptr = UnknownFieldParse(
+        tag,
+        _internal_metadata_.mutable_unknown_fields<std::string>(),
+        ptr, ctx);
+    CHK_(ptr != nullptr);
+  }  // while
+message_done:
+  return ptr;
+failure:
+  ptr = nullptr;
+  goto message_done;
+#undef CHK_
+}
+
+uint8_t* HostMessage::_InternalSerialize(
+    uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const {
+  // @@protoc_insertion_point(serialize_to_array_start:HostBuffers.HostMessage)
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  // repeated .HostBuffers.Instruction instruction = 1;
+  for (unsigned i = 0,
+      n = static_cast<unsigned>(this->_internal_instruction_size()); i < n; i++) {
+    const auto& repfield = this->_internal_instruction(i);
+    target = ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::
+        InternalWriteMessage(1, repfield, repfield.GetCachedSize(), target, stream);
+  }
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    target = stream->WriteRaw(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).data(),
+        static_cast<int>(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size()), target);
+  }
+  // @@protoc_insertion_point(serialize_to_array_end:HostBuffers.HostMessage)
+  return target;
+}
+
+size_t HostMessage::ByteSizeLong() const {
+// @@protoc_insertion_point(message_byte_size_start:HostBuffers.HostMessage)
+  size_t total_size = 0;
+
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  // repeated .HostBuffers.Instruction instruction = 1;
+  total_size += 1UL * this->_internal_instruction_size();
+  for (const auto& msg : this->_impl_.instruction_) {
+    total_size +=
+      ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::MessageSize(msg);
+  }
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    total_size += _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size();
+  }
+  int cached_size = ::_pbi::ToCachedSize(total_size);
+  SetCachedSize(cached_size);
+  return total_size;
+}
+
+void HostMessage::CheckTypeAndMergeFrom(
+    const ::PROTOBUF_NAMESPACE_ID::MessageLite& from) {
+  MergeFrom(*::_pbi::DownCast<const HostMessage*>(
+      &from));
+}
+
+void HostMessage::MergeFrom(const HostMessage& from) {
+  HostMessage* const _this = this;
+  // @@protoc_insertion_point(class_specific_merge_from_start:HostBuffers.HostMessage)
+  GOOGLE_DCHECK_NE(&from, _this);
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  _this->_impl_.instruction_.MergeFrom(from._impl_.instruction_);
+  _this->_internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+}
+
+void HostMessage::CopyFrom(const HostMessage& from) {
+// @@protoc_insertion_point(class_specific_copy_from_start:HostBuffers.HostMessage)
+  if (&from == this) return;
+  Clear();
+  MergeFrom(from);
+}
+
+bool HostMessage::IsInitialized() const {
+  if (!::PROTOBUF_NAMESPACE_ID::internal::AllAreInitialized(_impl_.instruction_))
+    return false;
+  return true;
+}
+
+void HostMessage::InternalSwap(HostMessage* other) {
+  using std::swap;
+  _internal_metadata_.InternalSwap(&other->_internal_metadata_);
+  _impl_.instruction_.InternalSwap(&other->_impl_.instruction_);
+}
+
+std::string HostMessage::GetTypeName() const {
+  return "HostBuffers.HostMessage";
+}
+
+
+// ===================================================================
+
+class Instruction::_Internal {
+ public:
+};
+
+Instruction::Instruction(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                         bool is_message_owned)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite(arena, is_message_owned) {
+  SharedCtor(arena, is_message_owned);
+  // @@protoc_insertion_point(arena_constructor:HostBuffers.Instruction)
+}
+Instruction::Instruction(const Instruction& from)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite() {
+  Instruction* const _this = this; (void)_this;
+  new (&_impl_) Impl_{
+      /*decltype(_impl_._extensions_)*/{}
+    , /*decltype(_impl_._cached_size_)*/{}};
+
+  _internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+  _impl_._extensions_.MergeFrom(internal_default_instance(), from._impl_._extensions_);
+  // @@protoc_insertion_point(copy_constructor:HostBuffers.Instruction)
+}
+
+inline void Instruction::SharedCtor(
+    ::_pb::Arena* arena, bool is_message_owned) {
+  (void)arena;
+  (void)is_message_owned;
+  new (&_impl_) Impl_{
+      /*decltype(_impl_._extensions_)*/{::_pbi::ArenaInitialized(), arena}
+    , /*decltype(_impl_._cached_size_)*/{}
+  };
+}
+
+Instruction::~Instruction() {
+  // @@protoc_insertion_point(destructor:HostBuffers.Instruction)
+  if (auto *arena = _internal_metadata_.DeleteReturnArena<std::string>()) {
+  (void)arena;
+    return;
+  }
+  SharedDtor();
+}
+
+inline void Instruction::SharedDtor() {
+  GOOGLE_DCHECK(GetArenaForAllocation() == nullptr);
+  _impl_._extensions_.~ExtensionSet();
+}
+
+void Instruction::SetCachedSize(int size) const {
+  _impl_._cached_size_.Set(size);
+}
+
+void Instruction::Clear() {
+// @@protoc_insertion_point(message_clear_start:HostBuffers.Instruction)
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  _impl_._extensions_.Clear();
+  _internal_metadata_.Clear<std::string>();
+}
+
+const char* Instruction::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
+#define CHK_(x) if (PROTOBUF_PREDICT_FALSE(!(x))) goto failure
+  while (!ctx->Done(&ptr)) {
+    uint32_t tag;
+    ptr = ::_pbi::ReadTag(ptr, &tag);
+    if ((tag == 0) || ((tag & 7) == 4)) {
+      CHK_(ptr);
+      ctx->SetLastTag(tag);
+      goto message_done;
+    }
+    if ((16u <= tag)) {
+      ptr = _impl_._extensions_.ParseField(tag, ptr, internal_default_instance(), &_internal_metadata_, ctx);
+      CHK_(ptr != nullptr);
+      continue;
+    }
+    ptr = UnknownFieldParse(
+        tag,
+        _internal_metadata_.mutable_unknown_fields<std::string>(),
+        ptr, ctx);
+    CHK_(ptr != nullptr);
+  }  // while
+message_done:
+  return ptr;
+failure:
+  ptr = nullptr;
+  goto message_done;
+#undef CHK_
+}
+
+uint8_t* Instruction::_InternalSerialize(
+    uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const {
+  // @@protoc_insertion_point(serialize_to_array_start:HostBuffers.Instruction)
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  // Extension range [2, 536870912)
+  target = _impl_._extensions_._InternalSerialize(
+  internal_default_instance(), 2, 536870912, target, stream);
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    target = stream->WriteRaw(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).data(),
+        static_cast<int>(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size()), target);
+  }
+  // @@protoc_insertion_point(serialize_to_array_end:HostBuffers.Instruction)
+  return target;
+}
+
+size_t Instruction::ByteSizeLong() const {
+// @@protoc_insertion_point(message_byte_size_start:HostBuffers.Instruction)
+  size_t total_size = 0;
+
+  total_size += _impl_._extensions_.ByteSize();
+
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    total_size += _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size();
+  }
+  int cached_size = ::_pbi::ToCachedSize(total_size);
+  SetCachedSize(cached_size);
+  return total_size;
+}
+
+void Instruction::CheckTypeAndMergeFrom(
+    const ::PROTOBUF_NAMESPACE_ID::MessageLite& from) {
+  MergeFrom(*::_pbi::DownCast<const Instruction*>(
+      &from));
+}
+
+void Instruction::MergeFrom(const Instruction& from) {
+  Instruction* const _this = this;
+  // @@protoc_insertion_point(class_specific_merge_from_start:HostBuffers.Instruction)
+  GOOGLE_DCHECK_NE(&from, _this);
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  _this->_impl_._extensions_.MergeFrom(internal_default_instance(), from._impl_._extensions_);
+  _this->_internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+}
+
+void Instruction::CopyFrom(const Instruction& from) {
+// @@protoc_insertion_point(class_specific_copy_from_start:HostBuffers.Instruction)
+  if (&from == this) return;
+  Clear();
+  MergeFrom(from);
+}
+
+bool Instruction::IsInitialized() const {
+  if (!_impl_._extensions_.IsInitialized()) {
+    return false;
+  }
+
+  return true;
+}
+
+void Instruction::InternalSwap(Instruction* other) {
+  using std::swap;
+  _impl_._extensions_.InternalSwap(&other->_impl_._extensions_);
+  _internal_metadata_.InternalSwap(&other->_internal_metadata_);
+}
+
+std::string Instruction::GetTypeName() const {
+  return "HostBuffers.Instruction";
+}
+
+
+// ===================================================================
+
+class HostBytes::_Internal {
+ public:
+  using HasBits = decltype(std::declval<HostBytes>()._impl_._has_bits_);
+  static void set_has_hoststring(HasBits* has_bits) {
+    (*has_bits)[0] |= 1u;
+  }
+};
+
+HostBytes::HostBytes(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                         bool is_message_owned)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite(arena, is_message_owned) {
+  SharedCtor(arena, is_message_owned);
+  // @@protoc_insertion_point(arena_constructor:HostBuffers.HostBytes)
+}
+HostBytes::HostBytes(const HostBytes& from)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite() {
+  HostBytes* const _this = this; (void)_this;
+  new (&_impl_) Impl_{
+      decltype(_impl_._has_bits_){from._impl_._has_bits_}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.hoststring_){}};
+
+  _internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+  _impl_.hoststring_.InitDefault();
+  #ifdef PROTOBUF_FORCE_COPY_DEFAULT_STRING
+    _impl_.hoststring_.Set("", GetArenaForAllocation());
+  #endif // PROTOBUF_FORCE_COPY_DEFAULT_STRING
+  if (from._internal_has_hoststring()) {
+    _this->_impl_.hoststring_.Set(from._internal_hoststring(), 
+      _this->GetArenaForAllocation());
+  }
+  // @@protoc_insertion_point(copy_constructor:HostBuffers.HostBytes)
+}
+
+inline void HostBytes::SharedCtor(
+    ::_pb::Arena* arena, bool is_message_owned) {
+  (void)arena;
+  (void)is_message_owned;
+  new (&_impl_) Impl_{
+      decltype(_impl_._has_bits_){}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.hoststring_){}
+  };
+  _impl_.hoststring_.InitDefault();
+  #ifdef PROTOBUF_FORCE_COPY_DEFAULT_STRING
+    _impl_.hoststring_.Set("", GetArenaForAllocation());
+  #endif // PROTOBUF_FORCE_COPY_DEFAULT_STRING
+}
+
+HostBytes::~HostBytes() {
+  // @@protoc_insertion_point(destructor:HostBuffers.HostBytes)
+  if (auto *arena = _internal_metadata_.DeleteReturnArena<std::string>()) {
+  (void)arena;
+    return;
+  }
+  SharedDtor();
+}
+
+inline void HostBytes::SharedDtor() {
+  GOOGLE_DCHECK(GetArenaForAllocation() == nullptr);
+  _impl_.hoststring_.Destroy();
+}
+
+void HostBytes::SetCachedSize(int size) const {
+  _impl_._cached_size_.Set(size);
+}
+
+void HostBytes::Clear() {
+// @@protoc_insertion_point(message_clear_start:HostBuffers.HostBytes)
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  cached_has_bits = _impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000001u) {
+    _impl_.hoststring_.ClearNonDefaultToEmpty();
+  }
+  _impl_._has_bits_.Clear();
+  _internal_metadata_.Clear<std::string>();
+}
+
+const char* HostBytes::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
+#define CHK_(x) if (PROTOBUF_PREDICT_FALSE(!(x))) goto failure
+  _Internal::HasBits has_bits{};
+  while (!ctx->Done(&ptr)) {
+    uint32_t tag;
+    ptr = ::_pbi::ReadTag(ptr, &tag);
+    switch (tag >> 3) {
+      // optional bytes hoststring = 4;
+      case 4:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 34)) {
+          auto str = _internal_mutable_hoststring();
+          ptr = ::_pbi::InlineGreedyStringParser(str, ptr, ctx);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      default:
+        goto handle_unusual;
+    }  // switch
+  handle_unusual:
+    if ((tag == 0) || ((tag & 7) == 4)) {
+      CHK_(ptr);
+      ctx->SetLastTag(tag);
+      goto message_done;
+    }
+    ptr = UnknownFieldParse(
+        tag,
+        _internal_metadata_.mutable_unknown_fields<std::string>(),
+        ptr, ctx);
+    CHK_(ptr != nullptr);
+  }  // while
+message_done:
+  _impl_._has_bits_.Or(has_bits);
+  return ptr;
+failure:
+  ptr = nullptr;
+  goto message_done;
+#undef CHK_
+}
+
+uint8_t* HostBytes::_InternalSerialize(
+    uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const {
+  // @@protoc_insertion_point(serialize_to_array_start:HostBuffers.HostBytes)
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  cached_has_bits = _impl_._has_bits_[0];
+  // optional bytes hoststring = 4;
+  if (cached_has_bits & 0x00000001u) {
+    target = stream->WriteBytesMaybeAliased(
+        4, this->_internal_hoststring(), target);
+  }
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    target = stream->WriteRaw(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).data(),
+        static_cast<int>(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size()), target);
+  }
+  // @@protoc_insertion_point(serialize_to_array_end:HostBuffers.HostBytes)
+  return target;
+}
+
+size_t HostBytes::ByteSizeLong() const {
+// @@protoc_insertion_point(message_byte_size_start:HostBuffers.HostBytes)
+  size_t total_size = 0;
+
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  // optional bytes hoststring = 4;
+  cached_has_bits = _impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000001u) {
+    total_size += 1 +
+      ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::BytesSize(
+        this->_internal_hoststring());
+  }
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    total_size += _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size();
+  }
+  int cached_size = ::_pbi::ToCachedSize(total_size);
+  SetCachedSize(cached_size);
+  return total_size;
+}
+
+void HostBytes::CheckTypeAndMergeFrom(
+    const ::PROTOBUF_NAMESPACE_ID::MessageLite& from) {
+  MergeFrom(*::_pbi::DownCast<const HostBytes*>(
+      &from));
+}
+
+void HostBytes::MergeFrom(const HostBytes& from) {
+  HostBytes* const _this = this;
+  // @@protoc_insertion_point(class_specific_merge_from_start:HostBuffers.HostBytes)
+  GOOGLE_DCHECK_NE(&from, _this);
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  if (from._internal_has_hoststring()) {
+    _this->_internal_set_hoststring(from._internal_hoststring());
+  }
+  _this->_internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+}
+
+void HostBytes::CopyFrom(const HostBytes& from) {
+// @@protoc_insertion_point(class_specific_copy_from_start:HostBuffers.HostBytes)
+  if (&from == this) return;
+  Clear();
+  MergeFrom(from);
+}
+
+bool HostBytes::IsInitialized() const {
+  return true;
+}
+
+void HostBytes::InternalSwap(HostBytes* other) {
+  using std::swap;
+  auto* lhs_arena = GetArenaForAllocation();
+  auto* rhs_arena = other->GetArenaForAllocation();
+  _internal_metadata_.InternalSwap(&other->_internal_metadata_);
+  swap(_impl_._has_bits_[0], other->_impl_._has_bits_[0]);
+  ::PROTOBUF_NAMESPACE_ID::internal::ArenaStringPtr::InternalSwap(
+      &_impl_.hoststring_, lhs_arena,
+      &other->_impl_.hoststring_, rhs_arena
+  );
+}
+
+std::string HostBytes::GetTypeName() const {
+  return "HostBuffers.HostBytes";
+}
+
+
+// ===================================================================
+
+class ResizeMessage::_Internal {
+ public:
+  using HasBits = decltype(std::declval<ResizeMessage>()._impl_._has_bits_);
+  static void set_has_width(HasBits* has_bits) {
+    (*has_bits)[0] |= 1u;
+  }
+  static void set_has_height(HasBits* has_bits) {
+    (*has_bits)[0] |= 2u;
+  }
+};
+
+ResizeMessage::ResizeMessage(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                         bool is_message_owned)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite(arena, is_message_owned) {
+  SharedCtor(arena, is_message_owned);
+  // @@protoc_insertion_point(arena_constructor:HostBuffers.ResizeMessage)
+}
+ResizeMessage::ResizeMessage(const ResizeMessage& from)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite() {
+  ResizeMessage* const _this = this; (void)_this;
+  new (&_impl_) Impl_{
+      decltype(_impl_._has_bits_){from._impl_._has_bits_}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.width_){}
+    , decltype(_impl_.height_){}};
+
+  _internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+  ::memcpy(&_impl_.width_, &from._impl_.width_,
+    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.height_) -
+    reinterpret_cast<char*>(&_impl_.width_)) + sizeof(_impl_.height_));
+  // @@protoc_insertion_point(copy_constructor:HostBuffers.ResizeMessage)
+}
+
+inline void ResizeMessage::SharedCtor(
+    ::_pb::Arena* arena, bool is_message_owned) {
+  (void)arena;
+  (void)is_message_owned;
+  new (&_impl_) Impl_{
+      decltype(_impl_._has_bits_){}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.width_){0}
+    , decltype(_impl_.height_){0}
+  };
+}
+
+ResizeMessage::~ResizeMessage() {
+  // @@protoc_insertion_point(destructor:HostBuffers.ResizeMessage)
+  if (auto *arena = _internal_metadata_.DeleteReturnArena<std::string>()) {
+  (void)arena;
+    return;
+  }
+  SharedDtor();
+}
+
+inline void ResizeMessage::SharedDtor() {
+  GOOGLE_DCHECK(GetArenaForAllocation() == nullptr);
+}
+
+void ResizeMessage::SetCachedSize(int size) const {
+  _impl_._cached_size_.Set(size);
+}
+
+void ResizeMessage::Clear() {
+// @@protoc_insertion_point(message_clear_start:HostBuffers.ResizeMessage)
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  cached_has_bits = _impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000003u) {
+    ::memset(&_impl_.width_, 0, static_cast<size_t>(
+        reinterpret_cast<char*>(&_impl_.height_) -
+        reinterpret_cast<char*>(&_impl_.width_)) + sizeof(_impl_.height_));
+  }
+  _impl_._has_bits_.Clear();
+  _internal_metadata_.Clear<std::string>();
+}
+
+const char* ResizeMessage::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
+#define CHK_(x) if (PROTOBUF_PREDICT_FALSE(!(x))) goto failure
+  _Internal::HasBits has_bits{};
+  while (!ctx->Done(&ptr)) {
+    uint32_t tag;
+    ptr = ::_pbi::ReadTag(ptr, &tag);
+    switch (tag >> 3) {
+      // optional int32 width = 5;
+      case 5:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 40)) {
+          _Internal::set_has_width(&has_bits);
+          _impl_.width_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional int32 height = 6;
+      case 6:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 48)) {
+          _Internal::set_has_height(&has_bits);
+          _impl_.height_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint32(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      default:
+        goto handle_unusual;
+    }  // switch
+  handle_unusual:
+    if ((tag == 0) || ((tag & 7) == 4)) {
+      CHK_(ptr);
+      ctx->SetLastTag(tag);
+      goto message_done;
+    }
+    ptr = UnknownFieldParse(
+        tag,
+        _internal_metadata_.mutable_unknown_fields<std::string>(),
+        ptr, ctx);
+    CHK_(ptr != nullptr);
+  }  // while
+message_done:
+  _impl_._has_bits_.Or(has_bits);
+  return ptr;
+failure:
+  ptr = nullptr;
+  goto message_done;
+#undef CHK_
+}
+
+uint8_t* ResizeMessage::_InternalSerialize(
+    uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const {
+  // @@protoc_insertion_point(serialize_to_array_start:HostBuffers.ResizeMessage)
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  cached_has_bits = _impl_._has_bits_[0];
+  // optional int32 width = 5;
+  if (cached_has_bits & 0x00000001u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(5, this->_internal_width(), target);
+  }
+
+  // optional int32 height = 6;
+  if (cached_has_bits & 0x00000002u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteInt32ToArray(6, this->_internal_height(), target);
+  }
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    target = stream->WriteRaw(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).data(),
+        static_cast<int>(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size()), target);
+  }
+  // @@protoc_insertion_point(serialize_to_array_end:HostBuffers.ResizeMessage)
+  return target;
+}
+
+size_t ResizeMessage::ByteSizeLong() const {
+// @@protoc_insertion_point(message_byte_size_start:HostBuffers.ResizeMessage)
+  size_t total_size = 0;
+
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  cached_has_bits = _impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000003u) {
+    // optional int32 width = 5;
+    if (cached_has_bits & 0x00000001u) {
+      total_size += ::_pbi::WireFormatLite::Int32SizePlusOne(this->_internal_width());
+    }
+
+    // optional int32 height = 6;
+    if (cached_has_bits & 0x00000002u) {
+      total_size += ::_pbi::WireFormatLite::Int32SizePlusOne(this->_internal_height());
+    }
+
+  }
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    total_size += _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size();
+  }
+  int cached_size = ::_pbi::ToCachedSize(total_size);
+  SetCachedSize(cached_size);
+  return total_size;
+}
+
+void ResizeMessage::CheckTypeAndMergeFrom(
+    const ::PROTOBUF_NAMESPACE_ID::MessageLite& from) {
+  MergeFrom(*::_pbi::DownCast<const ResizeMessage*>(
+      &from));
+}
+
+void ResizeMessage::MergeFrom(const ResizeMessage& from) {
+  ResizeMessage* const _this = this;
+  // @@protoc_insertion_point(class_specific_merge_from_start:HostBuffers.ResizeMessage)
+  GOOGLE_DCHECK_NE(&from, _this);
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  cached_has_bits = from._impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000003u) {
+    if (cached_has_bits & 0x00000001u) {
+      _this->_impl_.width_ = from._impl_.width_;
+    }
+    if (cached_has_bits & 0x00000002u) {
+      _this->_impl_.height_ = from._impl_.height_;
+    }
+    _this->_impl_._has_bits_[0] |= cached_has_bits;
+  }
+  _this->_internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+}
+
+void ResizeMessage::CopyFrom(const ResizeMessage& from) {
+// @@protoc_insertion_point(class_specific_copy_from_start:HostBuffers.ResizeMessage)
+  if (&from == this) return;
+  Clear();
+  MergeFrom(from);
+}
+
+bool ResizeMessage::IsInitialized() const {
+  return true;
+}
+
+void ResizeMessage::InternalSwap(ResizeMessage* other) {
+  using std::swap;
+  _internal_metadata_.InternalSwap(&other->_internal_metadata_);
+  swap(_impl_._has_bits_[0], other->_impl_._has_bits_[0]);
+  ::PROTOBUF_NAMESPACE_ID::internal::memswap<
+      PROTOBUF_FIELD_OFFSET(ResizeMessage, _impl_.height_)
+      + sizeof(ResizeMessage::_impl_.height_)
+      - PROTOBUF_FIELD_OFFSET(ResizeMessage, _impl_.width_)>(
+          reinterpret_cast<char*>(&_impl_.width_),
+          reinterpret_cast<char*>(&other->_impl_.width_));
+}
+
+std::string ResizeMessage::GetTypeName() const {
+  return "HostBuffers.ResizeMessage";
+}
+
+
+// ===================================================================
+
+class EchoAck::_Internal {
+ public:
+  using HasBits = decltype(std::declval<EchoAck>()._impl_._has_bits_);
+  static void set_has_echo_ack_num(HasBits* has_bits) {
+    (*has_bits)[0] |= 1u;
+  }
+};
+
+EchoAck::EchoAck(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                         bool is_message_owned)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite(arena, is_message_owned) {
+  SharedCtor(arena, is_message_owned);
+  // @@protoc_insertion_point(arena_constructor:HostBuffers.EchoAck)
+}
+EchoAck::EchoAck(const EchoAck& from)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite() {
+  EchoAck* const _this = this; (void)_this;
+  new (&_impl_) Impl_{
+      decltype(_impl_._has_bits_){from._impl_._has_bits_}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.echo_ack_num_){}};
+
+  _internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+  _this->_impl_.echo_ack_num_ = from._impl_.echo_ack_num_;
+  // @@protoc_insertion_point(copy_constructor:HostBuffers.EchoAck)
+}
+
+inline void EchoAck::SharedCtor(
+    ::_pb::Arena* arena, bool is_message_owned) {
+  (void)arena;
+  (void)is_message_owned;
+  new (&_impl_) Impl_{
+      decltype(_impl_._has_bits_){}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.echo_ack_num_){uint64_t{0u}}
+  };
+}
+
+EchoAck::~EchoAck() {
+  // @@protoc_insertion_point(destructor:HostBuffers.EchoAck)
+  if (auto *arena = _internal_metadata_.DeleteReturnArena<std::string>()) {
+  (void)arena;
+    return;
+  }
+  SharedDtor();
+}
+
+inline void EchoAck::SharedDtor() {
+  GOOGLE_DCHECK(GetArenaForAllocation() == nullptr);
+}
+
+void EchoAck::SetCachedSize(int size) const {
+  _impl_._cached_size_.Set(size);
+}
+
+void EchoAck::Clear() {
+// @@protoc_insertion_point(message_clear_start:HostBuffers.EchoAck)
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  _impl_.echo_ack_num_ = uint64_t{0u};
+  _impl_._has_bits_.Clear();
+  _internal_metadata_.Clear<std::string>();
+}
+
+const char* EchoAck::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
+#define CHK_(x) if (PROTOBUF_PREDICT_FALSE(!(x))) goto failure
+  _Internal::HasBits has_bits{};
+  while (!ctx->Done(&ptr)) {
+    uint32_t tag;
+    ptr = ::_pbi::ReadTag(ptr, &tag);
+    switch (tag >> 3) {
+      // optional uint64 echo_ack_num = 8;
+      case 8:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 64)) {
+          _Internal::set_has_echo_ack_num(&has_bits);
+          _impl_.echo_ack_num_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      default:
+        goto handle_unusual;
+    }  // switch
+  handle_unusual:
+    if ((tag == 0) || ((tag & 7) == 4)) {
+      CHK_(ptr);
+      ctx->SetLastTag(tag);
+      goto message_done;
+    }
+    ptr = UnknownFieldParse(
+        tag,
+        _internal_metadata_.mutable_unknown_fields<std::string>(),
+        ptr, ctx);
+    CHK_(ptr != nullptr);
+  }  // while
+message_done:
+  _impl_._has_bits_.Or(has_bits);
+  return ptr;
+failure:
+  ptr = nullptr;
+  goto message_done;
+#undef CHK_
+}
+
+uint8_t* EchoAck::_InternalSerialize(
+    uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const {
+  // @@protoc_insertion_point(serialize_to_array_start:HostBuffers.EchoAck)
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  cached_has_bits = _impl_._has_bits_[0];
+  // optional uint64 echo_ack_num = 8;
+  if (cached_has_bits & 0x00000001u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteUInt64ToArray(8, this->_internal_echo_ack_num(), target);
+  }
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    target = stream->WriteRaw(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).data(),
+        static_cast<int>(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size()), target);
+  }
+  // @@protoc_insertion_point(serialize_to_array_end:HostBuffers.EchoAck)
+  return target;
+}
+
+size_t EchoAck::ByteSizeLong() const {
+// @@protoc_insertion_point(message_byte_size_start:HostBuffers.EchoAck)
+  size_t total_size = 0;
+
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  // optional uint64 echo_ack_num = 8;
+  cached_has_bits = _impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000001u) {
+    total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(this->_internal_echo_ack_num());
+  }
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    total_size += _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size();
+  }
+  int cached_size = ::_pbi::ToCachedSize(total_size);
+  SetCachedSize(cached_size);
+  return total_size;
+}
+
+void EchoAck::CheckTypeAndMergeFrom(
+    const ::PROTOBUF_NAMESPACE_ID::MessageLite& from) {
+  MergeFrom(*::_pbi::DownCast<const EchoAck*>(
+      &from));
+}
+
+void EchoAck::MergeFrom(const EchoAck& from) {
+  EchoAck* const _this = this;
+  // @@protoc_insertion_point(class_specific_merge_from_start:HostBuffers.EchoAck)
+  GOOGLE_DCHECK_NE(&from, _this);
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  if (from._internal_has_echo_ack_num()) {
+    _this->_internal_set_echo_ack_num(from._internal_echo_ack_num());
+  }
+  _this->_internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+}
+
+void EchoAck::CopyFrom(const EchoAck& from) {
+// @@protoc_insertion_point(class_specific_copy_from_start:HostBuffers.EchoAck)
+  if (&from == this) return;
+  Clear();
+  MergeFrom(from);
+}
+
+bool EchoAck::IsInitialized() const {
+  return true;
+}
+
+void EchoAck::InternalSwap(EchoAck* other) {
+  using std::swap;
+  _internal_metadata_.InternalSwap(&other->_internal_metadata_);
+  swap(_impl_._has_bits_[0], other->_impl_._has_bits_[0]);
+  swap(_impl_.echo_ack_num_, other->_impl_.echo_ack_num_);
+}
+
+std::string EchoAck::GetTypeName() const {
+  return "HostBuffers.EchoAck";
+}
+
+
+// ===================================================================
+
+class ScrollbackLines::_Internal {
+ public:
+  using HasBits = decltype(std::declval<ScrollbackLines>()._impl_._has_bits_);
+  static void set_has_first(HasBits* has_bits) {
+    (*has_bits)[0] |= 1u;
+  }
+  static void set_has_end(HasBits* has_bits) {
+    (*has_bits)[0] |= 2u;
+  }
+  static void set_has_oldest(HasBits* has_bits) {
+    (*has_bits)[0] |= 4u;
+  }
+};
+
+ScrollbackLines::ScrollbackLines(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                         bool is_message_owned)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite(arena, is_message_owned) {
+  SharedCtor(arena, is_message_owned);
+  // @@protoc_insertion_point(arena_constructor:HostBuffers.ScrollbackLines)
+}
+ScrollbackLines::ScrollbackLines(const ScrollbackLines& from)
+  : ::PROTOBUF_NAMESPACE_ID::MessageLite() {
+  ScrollbackLines* const _this = this; (void)_this;
+  new (&_impl_) Impl_{
+      decltype(_impl_._has_bits_){from._impl_._has_bits_}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.line_){from._impl_.line_}
+    , decltype(_impl_.first_){}
+    , decltype(_impl_.end_){}
+    , decltype(_impl_.oldest_){}};
+
+  _internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+  ::memcpy(&_impl_.first_, &from._impl_.first_,
+    static_cast<size_t>(reinterpret_cast<char*>(&_impl_.oldest_) -
+    reinterpret_cast<char*>(&_impl_.first_)) + sizeof(_impl_.oldest_));
+  // @@protoc_insertion_point(copy_constructor:HostBuffers.ScrollbackLines)
+}
+
+inline void ScrollbackLines::SharedCtor(
+    ::_pb::Arena* arena, bool is_message_owned) {
+  (void)arena;
+  (void)is_message_owned;
+  new (&_impl_) Impl_{
+      decltype(_impl_._has_bits_){}
+    , /*decltype(_impl_._cached_size_)*/{}
+    , decltype(_impl_.line_){arena}
+    , decltype(_impl_.first_){uint64_t{0u}}
+    , decltype(_impl_.end_){uint64_t{0u}}
+    , decltype(_impl_.oldest_){uint64_t{0u}}
+  };
+}
+
+ScrollbackLines::~ScrollbackLines() {
+  // @@protoc_insertion_point(destructor:HostBuffers.ScrollbackLines)
+  if (auto *arena = _internal_metadata_.DeleteReturnArena<std::string>()) {
+  (void)arena;
+    return;
+  }
+  SharedDtor();
+}
+
+inline void ScrollbackLines::SharedDtor() {
+  GOOGLE_DCHECK(GetArenaForAllocation() == nullptr);
+  _impl_.line_.~RepeatedPtrField();
+}
+
+void ScrollbackLines::SetCachedSize(int size) const {
+  _impl_._cached_size_.Set(size);
+}
+
+void ScrollbackLines::Clear() {
+// @@protoc_insertion_point(message_clear_start:HostBuffers.ScrollbackLines)
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  _impl_.line_.Clear();
+  cached_has_bits = _impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000007u) {
+    ::memset(&_impl_.first_, 0, static_cast<size_t>(
+        reinterpret_cast<char*>(&_impl_.oldest_) -
+        reinterpret_cast<char*>(&_impl_.first_)) + sizeof(_impl_.oldest_));
+  }
+  _impl_._has_bits_.Clear();
+  _internal_metadata_.Clear<std::string>();
+}
+
+const char* ScrollbackLines::_InternalParse(const char* ptr, ::_pbi::ParseContext* ctx) {
+#define CHK_(x) if (PROTOBUF_PREDICT_FALSE(!(x))) goto failure
+  _Internal::HasBits has_bits{};
+  while (!ctx->Done(&ptr)) {
+    uint32_t tag;
+    ptr = ::_pbi::ReadTag(ptr, &tag);
+    switch (tag >> 3) {
+      // optional uint64 first = 10;
+      case 10:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 80)) {
+          _Internal::set_has_first(&has_bits);
+          _impl_.first_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // optional uint64 end = 11;
+      case 11:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 88)) {
+          _Internal::set_has_end(&has_bits);
+          _impl_.end_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      // repeated bytes line = 12;
+      case 12:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 98)) {
+          ptr -= 1;
+          do {
+            ptr += 1;
+            auto str = _internal_add_line();
+            ptr = ::_pbi::InlineGreedyStringParser(str, ptr, ctx);
+            CHK_(ptr);
+            if (!ctx->DataAvailable(ptr)) break;
+          } while (::PROTOBUF_NAMESPACE_ID::internal::ExpectTag<98>(ptr));
+        } else
+          goto handle_unusual;
+        continue;
+      // optional uint64 oldest = 13;
+      case 13:
+        if (PROTOBUF_PREDICT_TRUE(static_cast<uint8_t>(tag) == 104)) {
+          _Internal::set_has_oldest(&has_bits);
+          _impl_.oldest_ = ::PROTOBUF_NAMESPACE_ID::internal::ReadVarint64(&ptr);
+          CHK_(ptr);
+        } else
+          goto handle_unusual;
+        continue;
+      default:
+        goto handle_unusual;
+    }  // switch
+  handle_unusual:
+    if ((tag == 0) || ((tag & 7) == 4)) {
+      CHK_(ptr);
+      ctx->SetLastTag(tag);
+      goto message_done;
+    }
+    ptr = UnknownFieldParse(
+        tag,
+        _internal_metadata_.mutable_unknown_fields<std::string>(),
+        ptr, ctx);
+    CHK_(ptr != nullptr);
+  }  // while
+message_done:
+  _impl_._has_bits_.Or(has_bits);
+  return ptr;
+failure:
+  ptr = nullptr;
+  goto message_done;
+#undef CHK_
+}
+
+uint8_t* ScrollbackLines::_InternalSerialize(
+    uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const {
+  // @@protoc_insertion_point(serialize_to_array_start:HostBuffers.ScrollbackLines)
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  cached_has_bits = _impl_._has_bits_[0];
+  // optional uint64 first = 10;
+  if (cached_has_bits & 0x00000001u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteUInt64ToArray(10, this->_internal_first(), target);
+  }
+
+  // optional uint64 end = 11;
+  if (cached_has_bits & 0x00000002u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteUInt64ToArray(11, this->_internal_end(), target);
+  }
+
+  // repeated bytes line = 12;
+  for (int i = 0, n = this->_internal_line_size(); i < n; i++) {
+    const auto& s = this->_internal_line(i);
+    target = stream->WriteBytes(12, s, target);
+  }
+
+  // optional uint64 oldest = 13;
+  if (cached_has_bits & 0x00000004u) {
+    target = stream->EnsureSpace(target);
+    target = ::_pbi::WireFormatLite::WriteUInt64ToArray(13, this->_internal_oldest(), target);
+  }
+
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    target = stream->WriteRaw(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).data(),
+        static_cast<int>(_internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size()), target);
+  }
+  // @@protoc_insertion_point(serialize_to_array_end:HostBuffers.ScrollbackLines)
+  return target;
+}
+
+size_t ScrollbackLines::ByteSizeLong() const {
+// @@protoc_insertion_point(message_byte_size_start:HostBuffers.ScrollbackLines)
+  size_t total_size = 0;
+
+  uint32_t cached_has_bits = 0;
+  // Prevent compiler warnings about cached_has_bits being unused
+  (void) cached_has_bits;
+
+  // repeated bytes line = 12;
+  total_size += 1 *
+      ::PROTOBUF_NAMESPACE_ID::internal::FromIntSize(_impl_.line_.size());
+  for (int i = 0, n = _impl_.line_.size(); i < n; i++) {
+    total_size += ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::BytesSize(
+      _impl_.line_.Get(i));
+  }
+
+  cached_has_bits = _impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000007u) {
+    // optional uint64 first = 10;
+    if (cached_has_bits & 0x00000001u) {
+      total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(this->_internal_first());
+    }
+
+    // optional uint64 end = 11;
+    if (cached_has_bits & 0x00000002u) {
+      total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(this->_internal_end());
+    }
+
+    // optional uint64 oldest = 13;
+    if (cached_has_bits & 0x00000004u) {
+      total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(this->_internal_oldest());
+    }
+
+  }
+  if (PROTOBUF_PREDICT_FALSE(_internal_metadata_.have_unknown_fields())) {
+    total_size += _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString).size();
+  }
+  int cached_size = ::_pbi::ToCachedSize(total_size);
+  SetCachedSize(cached_size);
+  return total_size;
+}
+
+void ScrollbackLines::CheckTypeAndMergeFrom(
+    const ::PROTOBUF_NAMESPACE_ID::MessageLite& from) {
+  MergeFrom(*::_pbi::DownCast<const ScrollbackLines*>(
+      &from));
+}
+
+void ScrollbackLines::MergeFrom(const ScrollbackLines& from) {
+  ScrollbackLines* const _this = this;
+  // @@protoc_insertion_point(class_specific_merge_from_start:HostBuffers.ScrollbackLines)
+  GOOGLE_DCHECK_NE(&from, _this);
+  uint32_t cached_has_bits = 0;
+  (void) cached_has_bits;
+
+  _this->_impl_.line_.MergeFrom(from._impl_.line_);
+  cached_has_bits = from._impl_._has_bits_[0];
+  if (cached_has_bits & 0x00000007u) {
+    if (cached_has_bits & 0x00000001u) {
+      _this->_impl_.first_ = from._impl_.first_;
+    }
+    if (cached_has_bits & 0x00000002u) {
+      _this->_impl_.end_ = from._impl_.end_;
+    }
+    if (cached_has_bits & 0x00000004u) {
+      _this->_impl_.oldest_ = from._impl_.oldest_;
+    }
+    _this->_impl_._has_bits_[0] |= cached_has_bits;
+  }
+  _this->_internal_metadata_.MergeFrom<std::string>(from._internal_metadata_);
+}
+
+void ScrollbackLines::CopyFrom(const ScrollbackLines& from) {
+// @@protoc_insertion_point(class_specific_copy_from_start:HostBuffers.ScrollbackLines)
+  if (&from == this) return;
+  Clear();
+  MergeFrom(from);
+}
+
+bool ScrollbackLines::IsInitialized() const {
+  return true;
+}
+
+void ScrollbackLines::InternalSwap(ScrollbackLines* other) {
+  using std::swap;
+  _internal_metadata_.InternalSwap(&other->_internal_metadata_);
+  swap(_impl_._has_bits_[0], other->_impl_._has_bits_[0]);
+  _impl_.line_.InternalSwap(&other->_impl_.line_);
+  ::PROTOBUF_NAMESPACE_ID::internal::memswap<
+      PROTOBUF_FIELD_OFFSET(ScrollbackLines, _impl_.oldest_)
+      + sizeof(ScrollbackLines::_impl_.oldest_)
+      - PROTOBUF_FIELD_OFFSET(ScrollbackLines, _impl_.first_)>(
+          reinterpret_cast<char*>(&_impl_.first_),
+          reinterpret_cast<char*>(&other->_impl_.first_));
+}
+
+std::string ScrollbackLines::GetTypeName() const {
+  return "HostBuffers.ScrollbackLines";
+}
+
+PROTOBUF_ATTRIBUTE_INIT_PRIORITY2 ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier< ::HostBuffers::Instruction,
+    ::PROTOBUF_NAMESPACE_ID::internal::MessageTypeTraits< ::HostBuffers::HostBytes >, 11, false>
+  hostbytes(kHostbytesFieldNumber, ::HostBuffers::HostBytes::default_instance(), nullptr);
+PROTOBUF_ATTRIBUTE_INIT_PRIORITY2 ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier< ::HostBuffers::Instruction,
+    ::PROTOBUF_NAMESPACE_ID::internal::MessageTypeTraits< ::HostBuffers::ResizeMessage >, 11, false>
+  resize(kResizeFieldNumber, ::HostBuffers::ResizeMessage::default_instance(), nullptr);
+PROTOBUF_ATTRIBUTE_INIT_PRIORITY2 ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier< ::HostBuffers::Instruction,
+    ::PROTOBUF_NAMESPACE_ID::internal::MessageTypeTraits< ::HostBuffers::EchoAck >, 11, false>
+  echoack(kEchoackFieldNumber, ::HostBuffers::EchoAck::default_instance(), nullptr);
+PROTOBUF_ATTRIBUTE_INIT_PRIORITY2 ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier< ::HostBuffers::Instruction,
+    ::PROTOBUF_NAMESPACE_ID::internal::MessageTypeTraits< ::HostBuffers::ScrollbackLines >, 11, false>
+  scrollback(kScrollbackFieldNumber, ::HostBuffers::ScrollbackLines::default_instance(), nullptr);
+
+// @@protoc_insertion_point(namespace_scope)
+}  // namespace HostBuffers
+PROTOBUF_NAMESPACE_OPEN
+template<> PROTOBUF_NOINLINE ::HostBuffers::HostMessage*
+Arena::CreateMaybeMessage< ::HostBuffers::HostMessage >(Arena* arena) {
+  return Arena::CreateMessageInternal< ::HostBuffers::HostMessage >(arena);
+}
+template<> PROTOBUF_NOINLINE ::HostBuffers::Instruction*
+Arena::CreateMaybeMessage< ::HostBuffers::Instruction >(Arena* arena) {
+  return Arena::CreateMessageInternal< ::HostBuffers::Instruction >(arena);
+}
+template<> PROTOBUF_NOINLINE ::HostBuffers::HostBytes*
+Arena::CreateMaybeMessage< ::HostBuffers::HostBytes >(Arena* arena) {
+  return Arena::CreateMessageInternal< ::HostBuffers::HostBytes >(arena);
+}
+template<> PROTOBUF_NOINLINE ::HostBuffers::ResizeMessage*
+Arena::CreateMaybeMessage< ::HostBuffers::ResizeMessage >(Arena* arena) {
+  return Arena::CreateMessageInternal< ::HostBuffers::ResizeMessage >(arena);
+}
+template<> PROTOBUF_NOINLINE ::HostBuffers::EchoAck*
+Arena::CreateMaybeMessage< ::HostBuffers::EchoAck >(Arena* arena) {
+  return Arena::CreateMessageInternal< ::HostBuffers::EchoAck >(arena);
+}
+template<> PROTOBUF_NOINLINE ::HostBuffers::ScrollbackLines*
+Arena::CreateMaybeMessage< ::HostBuffers::ScrollbackLines >(Arena* arena) {
+  return Arena::CreateMessageInternal< ::HostBuffers::ScrollbackLines >(arena);
+}
+PROTOBUF_NAMESPACE_CLOSE
+
+// @@protoc_insertion_point(global_scope)
+#include <google/protobuf/port_undef.inc>
@@ -0,0 +1,1599 @@
+// Generated by the protocol buffer compiler.  DO NOT EDIT!
+// source: hostinput.proto
+
+#ifndef GOOGLE_PROTOBUF_INCLUDED_hostinput_2eproto
+#define GOOGLE_PROTOBUF_INCLUDED_hostinput_2eproto
+
+#include <limits>
+#include <string>
+
+#include <google/protobuf/port_def.inc>
+#if PROTOBUF_VERSION < 3021000
+#error This file was generated by a newer version of protoc which is
+#error incompatible with your Protocol Buffer headers. Please update
+#error your headers.
+#endif
+#if 3021012 < PROTOBUF_MIN_PROTOC_VERSION
+#error This file was generated by an older version of protoc which is
+#error incompatible with your Protocol Buffer headers. Please
+#error regenerate this file with a newer version of protoc.
+#endif
+
+#include <google/protobuf/port_undef.inc>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/arena.h>
+#include <google/protobuf/arenastring.h>
+#include <google/protobuf/generated_message_util.h>
+#include <google/protobuf/metadata_lite.h>
+#include <google/protobuf/message_lite.h>
+#include <google/protobuf/repeated_field.h>  // IWYU pragma: export
+#include <google/protobuf/extension_set.h>  // IWYU pragma: export
+// @@protoc_insertion_point(includes)
+#include <google/protobuf/port_def.inc>
+#define PROTOBUF_INTERNAL_EXPORT_hostinput_2eproto
+PROTOBUF_NAMESPACE_OPEN
+namespace internal {
+class AnyMetadata;
+}  // namespace internal
+PROTOBUF_NAMESPACE_CLOSE
+
+// Internal implementation detail -- do not use these members.
+struct TableStruct_hostinput_2eproto {
+  static const uint32_t offsets[];
+};
+namespace HostBuffers {
+class EchoAck;
+struct EchoAckDefaultTypeInternal;
+extern EchoAckDefaultTypeInternal _EchoAck_default_instance_;
+class HostBytes;
+struct HostBytesDefaultTypeInternal;
+extern HostBytesDefaultTypeInternal _HostBytes_default_instance_;
+class HostMessage;
+struct HostMessageDefaultTypeInternal;
+extern HostMessageDefaultTypeInternal _HostMessage_default_instance_;
+class Instruction;
+struct InstructionDefaultTypeInternal;
+extern InstructionDefaultTypeInternal _Instruction_default_instance_;
+class ResizeMessage;
+struct ResizeMessageDefaultTypeInternal;
+extern ResizeMessageDefaultTypeInternal _ResizeMessage_default_instance_;
+class ScrollbackLines;
+struct ScrollbackLinesDefaultTypeInternal;
+extern ScrollbackLinesDefaultTypeInternal _ScrollbackLines_default_instance_;
+}  // namespace HostBuffers
+PROTOBUF_NAMESPACE_OPEN
+template<> ::HostBuffers::EchoAck* Arena::CreateMaybeMessage<::HostBuffers::EchoAck>(Arena*);
+template<> ::HostBuffers::HostBytes* Arena::CreateMaybeMessage<::HostBuffers::HostBytes>(Arena*);
+template<> ::HostBuffers::HostMessage* Arena::CreateMaybeMessage<::HostBuffers::HostMessage>(Arena*);
+template<> ::HostBuffers::Instruction* Arena::CreateMaybeMessage<::HostBuffers::Instruction>(Arena*);
+template<> ::HostBuffers::ResizeMessage* Arena::CreateMaybeMessage<::HostBuffers::ResizeMessage>(Arena*);
+template<> ::HostBuffers::ScrollbackLines* Arena::CreateMaybeMessage<::HostBuffers::ScrollbackLines>(Arena*);
+PROTOBUF_NAMESPACE_CLOSE
+namespace HostBuffers {
+
+// ===================================================================
+
+class HostMessage final :
+    public ::PROTOBUF_NAMESPACE_ID::MessageLite /* @@protoc_insertion_point(class_definition:HostBuffers.HostMessage) */ {
+ public:
+  inline HostMessage() : HostMessage(nullptr) {}
+  ~HostMessage() override;
+  explicit PROTOBUF_CONSTEXPR HostMessage(::PROTOBUF_NAMESPACE_ID::internal::ConstantInitialized);
+
+  HostMessage(const HostMessage& from);
+  HostMessage(HostMessage&& from) noexcept
+    : HostMessage() {
+    *this = ::std::move(from);
+  }
+
+  inline HostMessage& operator=(const HostMessage& from) {
+    CopyFrom(from);
+    return *this;
+  }
+  inline HostMessage& operator=(HostMessage&& from) noexcept {
+    if (this == &from) return *this;
+    if (GetOwningArena() == from.GetOwningArena()
+  #ifdef PROTOBUF_FORCE_COPY_IN_MOVE
+        && GetOwningArena() != nullptr
+  #endif  // !PROTOBUF_FORCE_COPY_IN_MOVE
+    ) {
+      InternalSwap(&from);
+    } else {
+      CopyFrom(from);
+    }
+    return *this;
+  }
+
+  inline const std::string& unknown_fields() const {
+    return _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString);
+  }
+  inline std::string* mutable_unknown_fields() {
+    return _internal_metadata_.mutable_unknown_fields<std::string>();
+  }
+
+  static const HostMessage& default_instance() {
+    return *internal_default_instance();
+  }
+  static inline const HostMessage* internal_default_instance() {
+    return reinterpret_cast<const HostMessage*>(
+               &_HostMessage_default_instance_);
+  }
+  static constexpr int kIndexInFileMessages =
+    0;
+
+  friend void swap(HostMessage& a, HostMessage& b) {
+    a.Swap(&b);
+  }
+  inline void Swap(HostMessage* other) {
+    if (other == this) return;
+  #ifdef PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() != nullptr &&
+        GetOwningArena() == other->GetOwningArena()) {
+   #else  // PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() == other->GetOwningArena()) {
+  #endif  // !PROTOBUF_FORCE_COPY_IN_SWAP
+      InternalSwap(other);
+    } else {
+      ::PROTOBUF_NAMESPACE_ID::internal::GenericSwap(this, other);
+    }
+  }
+  void UnsafeArenaSwap(HostMessage* other) {
+    if (other == this) return;
+    GOOGLE_DCHECK(GetOwningArena() == other->GetOwningArena());
+    InternalSwap(other);
+  }
+
+  // implements Message ----------------------------------------------
+
+  HostMessage* New(::PROTOBUF_NAMESPACE_ID::Arena* arena = nullptr) const final {
+    return CreateMaybeMessage<HostMessage>(arena);
+  }
+  void CheckTypeAndMergeFrom(const ::PROTOBUF_NAMESPACE_ID::MessageLite& from)  final;
+  void CopyFrom(const HostMessage& from);
+  void MergeFrom(const HostMessage& from);
+  PROTOBUF_ATTRIBUTE_REINITIALIZES void Clear() final;
+  bool IsInitialized() const final;
+
+  size_t ByteSizeLong() const final;
+  const char* _InternalParse(const char* ptr, ::PROTOBUF_NAMESPACE_ID::internal::ParseContext* ctx) final;
+  uint8_t* _InternalSerialize(
+      uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const final;
+  int GetCachedSize() const final { return _impl_._cached_size_.Get(); }
+
+  private:
+  void SharedCtor(::PROTOBUF_NAMESPACE_ID::Arena* arena, bool is_message_owned);
+  void SharedDtor();
+  void SetCachedSize(int size) const;
+  void InternalSwap(HostMessage* other);
+
+  private:
+  friend class ::PROTOBUF_NAMESPACE_ID::internal::AnyMetadata;
+  static ::PROTOBUF_NAMESPACE_ID::StringPiece FullMessageName() {
+    return "HostBuffers.HostMessage";
+  }
+  protected:
+  explicit HostMessage(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                       bool is_message_owned = false);
+  public:
+
+  std::string GetTypeName() const final;
+
+  // nested types ----------------------------------------------------
+
+  // accessors -------------------------------------------------------
+
+  enum : int {
+    kInstructionFieldNumber = 1,
+  };
+  // repeated .HostBuffers.Instruction instruction = 1;
+  int instruction_size() const;
+  private:
+  int _internal_instruction_size() const;
+  public:
+  void clear_instruction();
+  ::HostBuffers::Instruction* mutable_instruction(int index);
+  ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::HostBuffers::Instruction >*
+      mutable_instruction();
+  private:
+  const ::HostBuffers::Instruction& _internal_instruction(int index) const;
+  ::HostBuffers::Instruction* _internal_add_instruction();
+  public:
+  const ::HostBuffers::Instruction& instruction(int index) const;
+  ::HostBuffers::Instruction* add_instruction();
+  const ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::HostBuffers::Instruction >&
+      instruction() const;
+
+  // @@protoc_insertion_point(class_scope:HostBuffers.HostMessage)
+ private:
+  class _Internal;
+
+  template <typename T> friend class ::PROTOBUF_NAMESPACE_ID::Arena::InternalHelper;
+  typedef void InternalArenaConstructable_;
+  typedef void DestructorSkippable_;
+  struct Impl_ {
+    ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::HostBuffers::Instruction > instruction_;
+    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
+  };
+  union { Impl_ _impl_; };
+  friend struct ::TableStruct_hostinput_2eproto;
+};
+// -------------------------------------------------------------------
+
+class Instruction final :
+    public ::PROTOBUF_NAMESPACE_ID::MessageLite /* @@protoc_insertion_point(class_definition:HostBuffers.Instruction) */ {
+ public:
+  inline Instruction() : Instruction(nullptr) {}
+  ~Instruction() override;
+  explicit PROTOBUF_CONSTEXPR Instruction(::PROTOBUF_NAMESPACE_ID::internal::ConstantInitialized);
+
+  Instruction(const Instruction& from);
+  Instruction(Instruction&& from) noexcept
+    : Instruction() {
+    *this = ::std::move(from);
+  }
+
+  inline Instruction& operator=(const Instruction& from) {
+    CopyFrom(from);
+    return *this;
+  }
+  inline Instruction& operator=(Instruction&& from) noexcept {
+    if (this == &from) return *this;
+    if (GetOwningArena() == from.GetOwningArena()
+  #ifdef PROTOBUF_FORCE_COPY_IN_MOVE
+        && GetOwningArena() != nullptr
+  #endif  // !PROTOBUF_FORCE_COPY_IN_MOVE
+    ) {
+      InternalSwap(&from);
+    } else {
+      CopyFrom(from);
+    }
+    return *this;
+  }
+
+  inline const std::string& unknown_fields() const {
+    return _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString);
+  }
+  inline std::string* mutable_unknown_fields() {
+    return _internal_metadata_.mutable_unknown_fields<std::string>();
+  }
+
+  static const Instruction& default_instance() {
+    return *internal_default_instance();
+  }
+  static inline const Instruction* internal_default_instance() {
+    return reinterpret_cast<const Instruction*>(
+               &_Instruction_default_instance_);
+  }
+  static constexpr int kIndexInFileMessages =
+    1;
+
+  friend void swap(Instruction& a, Instruction& b) {
+    a.Swap(&b);
+  }
+  inline void Swap(Instruction* other) {
+    if (other == this) return;
+  #ifdef PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() != nullptr &&
+        GetOwningArena() == other->GetOwningArena()) {
+   #else  // PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() == other->GetOwningArena()) {
+  #endif  // !PROTOBUF_FORCE_COPY_IN_SWAP
+      InternalSwap(other);
+    } else {
+      ::PROTOBUF_NAMESPACE_ID::internal::GenericSwap(this, other);
+    }
+  }
+  void UnsafeArenaSwap(Instruction* other) {
+    if (other == this) return;
+    GOOGLE_DCHECK(GetOwningArena() == other->GetOwningArena());
+    InternalSwap(other);
+  }
+
+  // implements Message ----------------------------------------------
+
+  Instruction* New(::PROTOBUF_NAMESPACE_ID::Arena* arena = nullptr) const final {
+    return CreateMaybeMessage<Instruction>(arena);
+  }
+  void CheckTypeAndMergeFrom(const ::PROTOBUF_NAMESPACE_ID::MessageLite& from)  final;
+  void CopyFrom(const Instruction& from);
+  void MergeFrom(const Instruction& from);
+  PROTOBUF_ATTRIBUTE_REINITIALIZES void Clear() final;
+  bool IsInitialized() const final;
+
+  size_t ByteSizeLong() const final;
+  const char* _InternalParse(const char* ptr, ::PROTOBUF_NAMESPACE_ID::internal::ParseContext* ctx) final;
+  uint8_t* _InternalSerialize(
+      uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const final;
+  int GetCachedSize() const final { return _impl_._cached_size_.Get(); }
+
+  private:
+  void SharedCtor(::PROTOBUF_NAMESPACE_ID::Arena* arena, bool is_message_owned);
+  void SharedDtor();
+  void SetCachedSize(int size) const;
+  void InternalSwap(Instruction* other);
+
+  private:
+  friend class ::PROTOBUF_NAMESPACE_ID::internal::AnyMetadata;
+  static ::PROTOBUF_NAMESPACE_ID::StringPiece FullMessageName() {
+    return "HostBuffers.Instruction";
+  }
+  protected:
+  explicit Instruction(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                       bool is_message_owned = false);
+  public:
+
+  std::string GetTypeName() const final;
+
+  // nested types ----------------------------------------------------
+
+  // accessors -------------------------------------------------------
+
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline bool HasExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) const {
+
+    return _impl_._extensions_.Has(id.number());
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline void ClearExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) {
+    _impl_._extensions_.ClearExtension(id.number());
+
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline int ExtensionSize(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) const {
+
+    return _impl_._extensions_.ExtensionSize(id.number());
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline typename _proto_TypeTraits::Singular::ConstType GetExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) const {
+
+    return _proto_TypeTraits::Get(id.number(), _impl_._extensions_,
+                                  id.default_value());
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline typename _proto_TypeTraits::Singular::MutableType MutableExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) {
+
+    return _proto_TypeTraits::Mutable(id.number(), _field_type,
+                                      &_impl_._extensions_);
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline void SetExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id,
+      typename _proto_TypeTraits::Singular::ConstType value) {
+    _proto_TypeTraits::Set(id.number(), _field_type, value, &_impl_._extensions_);
+
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline void SetAllocatedExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id,
+      typename _proto_TypeTraits::Singular::MutableType value) {
+    _proto_TypeTraits::SetAllocated(id.number(), _field_type, value,
+                                    &_impl_._extensions_);
+
+  }
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline void UnsafeArenaSetAllocatedExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id,
+      typename _proto_TypeTraits::Singular::MutableType value) {
+    _proto_TypeTraits::UnsafeArenaSetAllocated(id.number(), _field_type,
+                                               value, &_impl_._extensions_);
+
+  }
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  PROTOBUF_NODISCARD inline
+      typename _proto_TypeTraits::Singular::MutableType
+      ReleaseExtension(
+          const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+              Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) {
+
+    return _proto_TypeTraits::Release(id.number(), _field_type,
+                                      &_impl_._extensions_);
+  }
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline typename _proto_TypeTraits::Singular::MutableType
+  UnsafeArenaReleaseExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) {
+
+    return _proto_TypeTraits::UnsafeArenaRelease(id.number(), _field_type,
+                                                 &_impl_._extensions_);
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline typename _proto_TypeTraits::Repeated::ConstType GetExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id,
+      int index) const {
+
+    return _proto_TypeTraits::Get(id.number(), _impl_._extensions_, index);
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline typename _proto_TypeTraits::Repeated::MutableType MutableExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id,
+      int index) {
+
+    return _proto_TypeTraits::Mutable(id.number(), index, &_impl_._extensions_);
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline void SetExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id,
+      int index, typename _proto_TypeTraits::Repeated::ConstType value) {
+    _proto_TypeTraits::Set(id.number(), index, value, &_impl_._extensions_);
+
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline typename _proto_TypeTraits::Repeated::MutableType AddExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) {
+    typename _proto_TypeTraits::Repeated::MutableType to_add =
+        _proto_TypeTraits::Add(id.number(), _field_type, &_impl_._extensions_);
+
+    return to_add;
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline void AddExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id,
+      typename _proto_TypeTraits::Repeated::ConstType value) {
+    _proto_TypeTraits::Add(id.number(), _field_type, _is_packed, value,
+                           &_impl_._extensions_);
+
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline const typename _proto_TypeTraits::Repeated::RepeatedFieldType&
+  GetRepeatedExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) const {
+
+    return _proto_TypeTraits::GetRepeated(id.number(), _impl_._extensions_);
+  }
+
+  template <typename _proto_TypeTraits,
+            ::PROTOBUF_NAMESPACE_ID::internal::FieldType _field_type,
+            bool _is_packed>
+  inline typename _proto_TypeTraits::Repeated::RepeatedFieldType*
+  MutableRepeatedExtension(
+      const ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier<
+          Instruction, _proto_TypeTraits, _field_type, _is_packed>& id) {
+
+    return _proto_TypeTraits::MutableRepeated(id.number(), _field_type,
+                                              _is_packed, &_impl_._extensions_);
+  }
+
+  // @@protoc_insertion_point(class_scope:HostBuffers.Instruction)
+ private:
+  class _Internal;
+
+  template <typename T> friend class ::PROTOBUF_NAMESPACE_ID::Arena::InternalHelper;
+  typedef void InternalArenaConstructable_;
+  typedef void DestructorSkippable_;
+  struct Impl_ {
+    ::PROTOBUF_NAMESPACE_ID::internal::ExtensionSet _extensions_;
+
+    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
+  };
+  union { Impl_ _impl_; };
+  friend struct ::TableStruct_hostinput_2eproto;
+};
+// -------------------------------------------------------------------
+
+class HostBytes final :
+    public ::PROTOBUF_NAMESPACE_ID::MessageLite /* @@protoc_insertion_point(class_definition:HostBuffers.HostBytes) */ {
+ public:
+  inline HostBytes() : HostBytes(nullptr) {}
+  ~HostBytes() override;
+  explicit PROTOBUF_CONSTEXPR HostBytes(::PROTOBUF_NAMESPACE_ID::internal::ConstantInitialized);
+
+  HostBytes(const HostBytes& from);
+  HostBytes(HostBytes&& from) noexcept
+    : HostBytes() {
+    *this = ::std::move(from);
+  }
+
+  inline HostBytes& operator=(const HostBytes& from) {
+    CopyFrom(from);
+    return *this;
+  }
+  inline HostBytes& operator=(HostBytes&& from) noexcept {
+    if (this == &from) return *this;
+    if (GetOwningArena() == from.GetOwningArena()
+  #ifdef PROTOBUF_FORCE_COPY_IN_MOVE
+        && GetOwningArena() != nullptr
+  #endif  // !PROTOBUF_FORCE_COPY_IN_MOVE
+    ) {
+      InternalSwap(&from);
+    } else {
+      CopyFrom(from);
+    }
+    return *this;
+  }
+
+  inline const std::string& unknown_fields() const {
+    return _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString);
+  }
+  inline std::string* mutable_unknown_fields() {
+    return _internal_metadata_.mutable_unknown_fields<std::string>();
+  }
+
+  static const HostBytes& default_instance() {
+    return *internal_default_instance();
+  }
+  static inline const HostBytes* internal_default_instance() {
+    return reinterpret_cast<const HostBytes*>(
+               &_HostBytes_default_instance_);
+  }
+  static constexpr int kIndexInFileMessages =
+    2;
+
+  friend void swap(HostBytes& a, HostBytes& b) {
+    a.Swap(&b);
+  }
+  inline void Swap(HostBytes* other) {
+    if (other == this) return;
+  #ifdef PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() != nullptr &&
+        GetOwningArena() == other->GetOwningArena()) {
+   #else  // PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() == other->GetOwningArena()) {
+  #endif  // !PROTOBUF_FORCE_COPY_IN_SWAP
+      InternalSwap(other);
+    } else {
+      ::PROTOBUF_NAMESPACE_ID::internal::GenericSwap(this, other);
+    }
+  }
+  void UnsafeArenaSwap(HostBytes* other) {
+    if (other == this) return;
+    GOOGLE_DCHECK(GetOwningArena() == other->GetOwningArena());
+    InternalSwap(other);
+  }
+
+  // implements Message ----------------------------------------------
+
+  HostBytes* New(::PROTOBUF_NAMESPACE_ID::Arena* arena = nullptr) const final {
+    return CreateMaybeMessage<HostBytes>(arena);
+  }
+  void CheckTypeAndMergeFrom(const ::PROTOBUF_NAMESPACE_ID::MessageLite& from)  final;
+  void CopyFrom(const HostBytes& from);
+  void MergeFrom(const HostBytes& from);
+  PROTOBUF_ATTRIBUTE_REINITIALIZES void Clear() final;
+  bool IsInitialized() const final;
+
+  size_t ByteSizeLong() const final;
+  const char* _InternalParse(const char* ptr, ::PROTOBUF_NAMESPACE_ID::internal::ParseContext* ctx) final;
+  uint8_t* _InternalSerialize(
+      uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const final;
+  int GetCachedSize() const final { return _impl_._cached_size_.Get(); }
+
+  private:
+  void SharedCtor(::PROTOBUF_NAMESPACE_ID::Arena* arena, bool is_message_owned);
+  void SharedDtor();
+  void SetCachedSize(int size) const;
+  void InternalSwap(HostBytes* other);
+
+  private:
+  friend class ::PROTOBUF_NAMESPACE_ID::internal::AnyMetadata;
+  static ::PROTOBUF_NAMESPACE_ID::StringPiece FullMessageName() {
+    return "HostBuffers.HostBytes";
+  }
+  protected:
+  explicit HostBytes(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                       bool is_message_owned = false);
+  public:
+
+  std::string GetTypeName() const final;
+
+  // nested types ----------------------------------------------------
+
+  // accessors -------------------------------------------------------
+
+  enum : int {
+    kHoststringFieldNumber = 4,
+  };
+  // optional bytes hoststring = 4;
+  bool has_hoststring() const;
+  private:
+  bool _internal_has_hoststring() const;
+  public:
+  void clear_hoststring();
+  const std::string& hoststring() const;
+  template <typename ArgT0 = const std::string&, typename... ArgT>
+  void set_hoststring(ArgT0&& arg0, ArgT... args);
+  std::string* mutable_hoststring();
+  PROTOBUF_NODISCARD std::string* release_hoststring();
+  void set_allocated_hoststring(std::string* hoststring);
+  private:
+  const std::string& _internal_hoststring() const;
+  inline PROTOBUF_ALWAYS_INLINE void _internal_set_hoststring(const std::string& value);
+  std::string* _internal_mutable_hoststring();
+  public:
+
+  // @@protoc_insertion_point(class_scope:HostBuffers.HostBytes)
+ private:
+  class _Internal;
+
+  template <typename T> friend class ::PROTOBUF_NAMESPACE_ID::Arena::InternalHelper;
+  typedef void InternalArenaConstructable_;
+  typedef void DestructorSkippable_;
+  struct Impl_ {
+    ::PROTOBUF_NAMESPACE_ID::internal::HasBits<1> _has_bits_;
+    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
+    ::PROTOBUF_NAMESPACE_ID::internal::ArenaStringPtr hoststring_;
+  };
+  union { Impl_ _impl_; };
+  friend struct ::TableStruct_hostinput_2eproto;
+};
+// -------------------------------------------------------------------
+
+class ResizeMessage final :
+    public ::PROTOBUF_NAMESPACE_ID::MessageLite /* @@protoc_insertion_point(class_definition:HostBuffers.ResizeMessage) */ {
+ public:
+  inline ResizeMessage() : ResizeMessage(nullptr) {}
+  ~ResizeMessage() override;
+  explicit PROTOBUF_CONSTEXPR ResizeMessage(::PROTOBUF_NAMESPACE_ID::internal::ConstantInitialized);
+
+  ResizeMessage(const ResizeMessage& from);
+  ResizeMessage(ResizeMessage&& from) noexcept
+    : ResizeMessage() {
+    *this = ::std::move(from);
+  }
+
+  inline ResizeMessage& operator=(const ResizeMessage& from) {
+    CopyFrom(from);
+    return *this;
+  }
+  inline ResizeMessage& operator=(ResizeMessage&& from) noexcept {
+    if (this == &from) return *this;
+    if (GetOwningArena() == from.GetOwningArena()
+  #ifdef PROTOBUF_FORCE_COPY_IN_MOVE
+        && GetOwningArena() != nullptr
+  #endif  // !PROTOBUF_FORCE_COPY_IN_MOVE
+    ) {
+      InternalSwap(&from);
+    } else {
+      CopyFrom(from);
+    }
+    return *this;
+  }
+
+  inline const std::string& unknown_fields() const {
+    return _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString);
+  }
+  inline std::string* mutable_unknown_fields() {
+    return _internal_metadata_.mutable_unknown_fields<std::string>();
+  }
+
+  static const ResizeMessage& default_instance() {
+    return *internal_default_instance();
+  }
+  static inline const ResizeMessage* internal_default_instance() {
+    return reinterpret_cast<const ResizeMessage*>(
+               &_ResizeMessage_default_instance_);
+  }
+  static constexpr int kIndexInFileMessages =
+    3;
+
+  friend void swap(ResizeMessage& a, ResizeMessage& b) {
+    a.Swap(&b);
+  }
+  inline void Swap(ResizeMessage* other) {
+    if (other == this) return;
+  #ifdef PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() != nullptr &&
+        GetOwningArena() == other->GetOwningArena()) {
+   #else  // PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() == other->GetOwningArena()) {
+  #endif  // !PROTOBUF_FORCE_COPY_IN_SWAP
+      InternalSwap(other);
+    } else {
+      ::PROTOBUF_NAMESPACE_ID::internal::GenericSwap(this, other);
+    }
+  }
+  void UnsafeArenaSwap(ResizeMessage* other) {
+    if (other == this) return;
+    GOOGLE_DCHECK(GetOwningArena() == other->GetOwningArena());
+    InternalSwap(other);
+  }
+
+  // implements Message ----------------------------------------------
+
+  ResizeMessage* New(::PROTOBUF_NAMESPACE_ID::Arena* arena = nullptr) const final {
+    return CreateMaybeMessage<ResizeMessage>(arena);
+  }
+  void CheckTypeAndMergeFrom(const ::PROTOBUF_NAMESPACE_ID::MessageLite& from)  final;
+  void CopyFrom(const ResizeMessage& from);
+  void MergeFrom(const ResizeMessage& from);
+  PROTOBUF_ATTRIBUTE_REINITIALIZES void Clear() final;
+  bool IsInitialized() const final;
+
+  size_t ByteSizeLong() const final;
+  const char* _InternalParse(const char* ptr, ::PROTOBUF_NAMESPACE_ID::internal::ParseContext* ctx) final;
+  uint8_t* _InternalSerialize(
+      uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const final;
+  int GetCachedSize() const final { return _impl_._cached_size_.Get(); }
+
+  private:
+  void SharedCtor(::PROTOBUF_NAMESPACE_ID::Arena* arena, bool is_message_owned);
+  void SharedDtor();
+  void SetCachedSize(int size) const;
+  void InternalSwap(ResizeMessage* other);
+
+  private:
+  friend class ::PROTOBUF_NAMESPACE_ID::internal::AnyMetadata;
+  static ::PROTOBUF_NAMESPACE_ID::StringPiece FullMessageName() {
+    return "HostBuffers.ResizeMessage";
+  }
+  protected:
+  explicit ResizeMessage(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                       bool is_message_owned = false);
+  public:
+
+  std::string GetTypeName() const final;
+
+  // nested types ----------------------------------------------------
+
+  // accessors -------------------------------------------------------
+
+  enum : int {
+    kWidthFieldNumber = 5,
+    kHeightFieldNumber = 6,
+  };
+  // optional int32 width = 5;
+  bool has_width() const;
+  private:
+  bool _internal_has_width() const;
+  public:
+  void clear_width();
+  int32_t width() const;
+  void set_width(int32_t value);
+  private:
+  int32_t _internal_width() const;
+  void _internal_set_width(int32_t value);
+  public:
+
+  // optional int32 height = 6;
+  bool has_height() const;
+  private:
+  bool _internal_has_height() const;
+  public:
+  void clear_height();
+  int32_t height() const;
+  void set_height(int32_t value);
+  private:
+  int32_t _internal_height() const;
+  void _internal_set_height(int32_t value);
+  public:
+
+  // @@protoc_insertion_point(class_scope:HostBuffers.ResizeMessage)
+ private:
+  class _Internal;
+
+  template <typename T> friend class ::PROTOBUF_NAMESPACE_ID::Arena::InternalHelper;
+  typedef void InternalArenaConstructable_;
+  typedef void DestructorSkippable_;
+  struct Impl_ {
+    ::PROTOBUF_NAMESPACE_ID::internal::HasBits<1> _has_bits_;
+    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
+    int32_t width_;
+    int32_t height_;
+  };
+  union { Impl_ _impl_; };
+  friend struct ::TableStruct_hostinput_2eproto;
+};
+// -------------------------------------------------------------------
+
+class EchoAck final :
+    public ::PROTOBUF_NAMESPACE_ID::MessageLite /* @@protoc_insertion_point(class_definition:HostBuffers.EchoAck) */ {
+ public:
+  inline EchoAck() : EchoAck(nullptr) {}
+  ~EchoAck() override;
+  explicit PROTOBUF_CONSTEXPR EchoAck(::PROTOBUF_NAMESPACE_ID::internal::ConstantInitialized);
+
+  EchoAck(const EchoAck& from);
+  EchoAck(EchoAck&& from) noexcept
+    : EchoAck() {
+    *this = ::std::move(from);
+  }
+
+  inline EchoAck& operator=(const EchoAck& from) {
+    CopyFrom(from);
+    return *this;
+  }
+  inline EchoAck& operator=(EchoAck&& from) noexcept {
+    if (this == &from) return *this;
+    if (GetOwningArena() == from.GetOwningArena()
+  #ifdef PROTOBUF_FORCE_COPY_IN_MOVE
+        && GetOwningArena() != nullptr
+  #endif  // !PROTOBUF_FORCE_COPY_IN_MOVE
+    ) {
+      InternalSwap(&from);
+    } else {
+      CopyFrom(from);
+    }
+    return *this;
+  }
+
+  inline const std::string& unknown_fields() const {
+    return _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString);
+  }
+  inline std::string* mutable_unknown_fields() {
+    return _internal_metadata_.mutable_unknown_fields<std::string>();
+  }
+
+  static const EchoAck& default_instance() {
+    return *internal_default_instance();
+  }
+  static inline const EchoAck* internal_default_instance() {
+    return reinterpret_cast<const EchoAck*>(
+               &_EchoAck_default_instance_);
+  }
+  static constexpr int kIndexInFileMessages =
+    4;
+
+  friend void swap(EchoAck& a, EchoAck& b) {
+    a.Swap(&b);
+  }
+  inline void Swap(EchoAck* other) {
+    if (other == this) return;
+  #ifdef PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() != nullptr &&
+        GetOwningArena() == other->GetOwningArena()) {
+   #else  // PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() == other->GetOwningArena()) {
+  #endif  // !PROTOBUF_FORCE_COPY_IN_SWAP
+      InternalSwap(other);
+    } else {
+      ::PROTOBUF_NAMESPACE_ID::internal::GenericSwap(this, other);
+    }
+  }
+  void UnsafeArenaSwap(EchoAck* other) {
+    if (other == this) return;
+    GOOGLE_DCHECK(GetOwningArena() == other->GetOwningArena());
+    InternalSwap(other);
+  }
+
+  // implements Message ----------------------------------------------
+
+  EchoAck* New(::PROTOBUF_NAMESPACE_ID::Arena* arena = nullptr) const final {
+    return CreateMaybeMessage<EchoAck>(arena);
+  }
+  void CheckTypeAndMergeFrom(const ::PROTOBUF_NAMESPACE_ID::MessageLite& from)  final;
+  void CopyFrom(const EchoAck& from);
+  void MergeFrom(const EchoAck& from);
+  PROTOBUF_ATTRIBUTE_REINITIALIZES void Clear() final;
+  bool IsInitialized() const final;
+
+  size_t ByteSizeLong() const final;
+  const char* _InternalParse(const char* ptr, ::PROTOBUF_NAMESPACE_ID::internal::ParseContext* ctx) final;
+  uint8_t* _InternalSerialize(
+      uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const final;
+  int GetCachedSize() const final { return _impl_._cached_size_.Get(); }
+
+  private:
+  void SharedCtor(::PROTOBUF_NAMESPACE_ID::Arena* arena, bool is_message_owned);
+  void SharedDtor();
+  void SetCachedSize(int size) const;
+  void InternalSwap(EchoAck* other);
+
+  private:
+  friend class ::PROTOBUF_NAMESPACE_ID::internal::AnyMetadata;
+  static ::PROTOBUF_NAMESPACE_ID::StringPiece FullMessageName() {
+    return "HostBuffers.EchoAck";
+  }
+  protected:
+  explicit EchoAck(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                       bool is_message_owned = false);
+  public:
+
+  std::string GetTypeName() const final;
+
+  // nested types ----------------------------------------------------
+
+  // accessors -------------------------------------------------------
+
+  enum : int {
+    kEchoAckNumFieldNumber = 8,
+  };
+  // optional uint64 echo_ack_num = 8;
+  bool has_echo_ack_num() const;
+  private:
+  bool _internal_has_echo_ack_num() const;
+  public:
+  void clear_echo_ack_num();
+  uint64_t echo_ack_num() const;
+  void set_echo_ack_num(uint64_t value);
+  private:
+  uint64_t _internal_echo_ack_num() const;
+  void _internal_set_echo_ack_num(uint64_t value);
+  public:
+
+  // @@protoc_insertion_point(class_scope:HostBuffers.EchoAck)
+ private:
+  class _Internal;
+
+  template <typename T> friend class ::PROTOBUF_NAMESPACE_ID::Arena::InternalHelper;
+  typedef void InternalArenaConstructable_;
+  typedef void DestructorSkippable_;
+  struct Impl_ {
+    ::PROTOBUF_NAMESPACE_ID::internal::HasBits<1> _has_bits_;
+    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
+    uint64_t echo_ack_num_;
+  };
+  union { Impl_ _impl_; };
+  friend struct ::TableStruct_hostinput_2eproto;
+};
+// -------------------------------------------------------------------
+
+class ScrollbackLines final :
+    public ::PROTOBUF_NAMESPACE_ID::MessageLite /* @@protoc_insertion_point(class_definition:HostBuffers.ScrollbackLines) */ {
+ public:
+  inline ScrollbackLines() : ScrollbackLines(nullptr) {}
+  ~ScrollbackLines() override;
+  explicit PROTOBUF_CONSTEXPR ScrollbackLines(::PROTOBUF_NAMESPACE_ID::internal::ConstantInitialized);
+
+  ScrollbackLines(const ScrollbackLines& from);
+  ScrollbackLines(ScrollbackLines&& from) noexcept
+    : ScrollbackLines() {
+    *this = ::std::move(from);
+  }
+
+  inline ScrollbackLines& operator=(const ScrollbackLines& from) {
+    CopyFrom(from);
+    return *this;
+  }
+  inline ScrollbackLines& operator=(ScrollbackLines&& from) noexcept {
+    if (this == &from) return *this;
+    if (GetOwningArena() == from.GetOwningArena()
+  #ifdef PROTOBUF_FORCE_COPY_IN_MOVE
+        && GetOwningArena() != nullptr
+  #endif  // !PROTOBUF_FORCE_COPY_IN_MOVE
+    ) {
+      InternalSwap(&from);
+    } else {
+      CopyFrom(from);
+    }
+    return *this;
+  }
+
+  inline const std::string& unknown_fields() const {
+    return _internal_metadata_.unknown_fields<std::string>(::PROTOBUF_NAMESPACE_ID::internal::GetEmptyString);
+  }
+  inline std::string* mutable_unknown_fields() {
+    return _internal_metadata_.mutable_unknown_fields<std::string>();
+  }
+
+  static const ScrollbackLines& default_instance() {
+    return *internal_default_instance();
+  }
+  static inline const ScrollbackLines* internal_default_instance() {
+    return reinterpret_cast<const ScrollbackLines*>(
+               &_ScrollbackLines_default_instance_);
+  }
+  static constexpr int kIndexInFileMessages =
+    5;
+
+  friend void swap(ScrollbackLines& a, ScrollbackLines& b) {
+    a.Swap(&b);
+  }
+  inline void Swap(ScrollbackLines* other) {
+    if (other == this) return;
+  #ifdef PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() != nullptr &&
+        GetOwningArena() == other->GetOwningArena()) {
+   #else  // PROTOBUF_FORCE_COPY_IN_SWAP
+    if (GetOwningArena() == other->GetOwningArena()) {
+  #endif  // !PROTOBUF_FORCE_COPY_IN_SWAP
+      InternalSwap(other);
+    } else {
+      ::PROTOBUF_NAMESPACE_ID::internal::GenericSwap(this, other);
+    }
+  }
+  void UnsafeArenaSwap(ScrollbackLines* other) {
+    if (other == this) return;
+    GOOGLE_DCHECK(GetOwningArena() == other->GetOwningArena());
+    InternalSwap(other);
+  }
+
+  // implements Message ----------------------------------------------
+
+  ScrollbackLines* New(::PROTOBUF_NAMESPACE_ID::Arena* arena = nullptr) const final {
+    return CreateMaybeMessage<ScrollbackLines>(arena);
+  }
+  void CheckTypeAndMergeFrom(const ::PROTOBUF_NAMESPACE_ID::MessageLite& from)  final;
+  void CopyFrom(const ScrollbackLines& from);
+  void MergeFrom(const ScrollbackLines& from);
+  PROTOBUF_ATTRIBUTE_REINITIALIZES void Clear() final;
+  bool IsInitialized() const final;
+
+  size_t ByteSizeLong() const final;
+  const char* _InternalParse(const char* ptr, ::PROTOBUF_NAMESPACE_ID::internal::ParseContext* ctx) final;
+  uint8_t* _InternalSerialize(
+      uint8_t* target, ::PROTOBUF_NAMESPACE_ID::io::EpsCopyOutputStream* stream) const final;
+  int GetCachedSize() const final { return _impl_._cached_size_.Get(); }
+
+  private:
+  void SharedCtor(::PROTOBUF_NAMESPACE_ID::Arena* arena, bool is_message_owned);
+  void SharedDtor();
+  void SetCachedSize(int size) const;
+  void InternalSwap(ScrollbackLines* other);
+
+  private:
+  friend class ::PROTOBUF_NAMESPACE_ID::internal::AnyMetadata;
+  static ::PROTOBUF_NAMESPACE_ID::StringPiece FullMessageName() {
+    return "HostBuffers.ScrollbackLines";
+  }
+  protected:
+  explicit ScrollbackLines(::PROTOBUF_NAMESPACE_ID::Arena* arena,
+                       bool is_message_owned = false);
+  public:
+
+  std::string GetTypeName() const final;
+
+  // nested types ----------------------------------------------------
+
+  // accessors -------------------------------------------------------
+
+  enum : int {
+    kLineFieldNumber = 12,
+    kFirstFieldNumber = 10,
+    kEndFieldNumber = 11,
+    kOldestFieldNumber = 13,
+  };
+  // repeated bytes line = 12;
+  int line_size() const;
+  private:
+  int _internal_line_size() const;
+  public:
+  void clear_line();
+  const std::string& line(int index) const;
+  std::string* mutable_line(int index);
+  void set_line(int index, const std::string& value);
+  void set_line(int index, std::string&& value);
+  void set_line(int index, const char* value);
+  void set_line(int index, const void* value, size_t size);
+  std::string* add_line();
+  void add_line(const std::string& value);
+  void add_line(std::string&& value);
+  void add_line(const char* value);
+  void add_line(const void* value, size_t size);
+  const ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField<std::string>& line() const;
+  ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField<std::string>* mutable_line();
+  private:
+  const std::string& _internal_line(int index) const;
+  std::string* _internal_add_line();
+  public:
+
+  // optional uint64 first = 10;
+  bool has_first() const;
+  private:
+  bool _internal_has_first() const;
+  public:
+  void clear_first();
+  uint64_t first() const;
+  void set_first(uint64_t value);
+  private:
+  uint64_t _internal_first() const;
+  void _internal_set_first(uint64_t value);
+  public:
+
+  // optional uint64 end = 11;
+  bool has_end() const;
+  private:
+  bool _internal_has_end() const;
+  public:
+  void clear_end();
+  uint64_t end() const;
+  void set_end(uint64_t value);
+  private:
+  uint64_t _internal_end() const;
+  void _internal_set_end(uint64_t value);
+  public:
+
+  // optional uint64 oldest = 13;
+  bool has_oldest() const;
+  private:
+  bool _internal_has_oldest() const;
+  public:
+  void clear_oldest();
+  uint64_t oldest() const;
+  void set_oldest(uint64_t value);
+  private:
+  uint64_t _internal_oldest() const;
+  void _internal_set_oldest(uint64_t value);
+  public:
+
+  // @@protoc_insertion_point(class_scope:HostBuffers.ScrollbackLines)
+ private:
+  class _Internal;
+
+  template <typename T> friend class ::PROTOBUF_NAMESPACE_ID::Arena::InternalHelper;
+  typedef void InternalArenaConstructable_;
+  typedef void DestructorSkippable_;
+  struct Impl_ {
+    ::PROTOBUF_NAMESPACE_ID::internal::HasBits<1> _has_bits_;
+    mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
+    ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField<std::string> line_;
+    uint64_t first_;
+    uint64_t end_;
+    uint64_t oldest_;
+  };
+  union { Impl_ _impl_; };
+  friend struct ::TableStruct_hostinput_2eproto;
+};
+// ===================================================================
+
+static const int kHostbytesFieldNumber = 2;
+extern ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier< ::HostBuffers::Instruction,
+    ::PROTOBUF_NAMESPACE_ID::internal::MessageTypeTraits< ::HostBuffers::HostBytes >, 11, false >
+  hostbytes;
+static const int kResizeFieldNumber = 3;
+extern ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier< ::HostBuffers::Instruction,
+    ::PROTOBUF_NAMESPACE_ID::internal::MessageTypeTraits< ::HostBuffers::ResizeMessage >, 11, false >
+  resize;
+static const int kEchoackFieldNumber = 7;
+extern ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier< ::HostBuffers::Instruction,
+    ::PROTOBUF_NAMESPACE_ID::internal::MessageTypeTraits< ::HostBuffers::EchoAck >, 11, false >
+  echoack;
+static const int kScrollbackFieldNumber = 9;
+extern ::PROTOBUF_NAMESPACE_ID::internal::ExtensionIdentifier< ::HostBuffers::Instruction,
+    ::PROTOBUF_NAMESPACE_ID::internal::MessageTypeTraits< ::HostBuffers::ScrollbackLines >, 11, false >
+  scrollback;
+
+// ===================================================================
+
+#ifdef __GNUC__
+  #pragma GCC diagnostic push
+  #pragma GCC diagnostic ignored "-Wstrict-aliasing"
+#endif  // __GNUC__
+// HostMessage
+
+// repeated .HostBuffers.Instruction instruction = 1;
+inline int HostMessage::_internal_instruction_size() const {
+  return _impl_.instruction_.size();
+}
+inline int HostMessage::instruction_size() const {
+  return _internal_instruction_size();
+}
+inline void HostMessage::clear_instruction() {
+  _impl_.instruction_.Clear();
+}
+inline ::HostBuffers::Instruction* HostMessage::mutable_instruction(int index) {
+  // @@protoc_insertion_point(field_mutable:HostBuffers.HostMessage.instruction)
+  return _impl_.instruction_.Mutable(index);
+}
+inline ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::HostBuffers::Instruction >*
+HostMessage::mutable_instruction() {
+  // @@protoc_insertion_point(field_mutable_list:HostBuffers.HostMessage.instruction)
+  return &_impl_.instruction_;
+}
+inline const ::HostBuffers::Instruction& HostMessage::_internal_instruction(int index) const {
+  return _impl_.instruction_.Get(index);
+}
+inline const ::HostBuffers::Instruction& HostMessage::instruction(int index) const {
+  // @@protoc_insertion_point(field_get:HostBuffers.HostMessage.instruction)
+  return _internal_instruction(index);
+}
+inline ::HostBuffers::Instruction* HostMessage::_internal_add_instruction() {
+  return _impl_.instruction_.Add();
+}
+inline ::HostBuffers::Instruction* HostMessage::add_instruction() {
+  ::HostBuffers::Instruction* _add = _internal_add_instruction();
+  // @@protoc_insertion_point(field_add:HostBuffers.HostMessage.instruction)
+  return _add;
+}
+inline const ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::HostBuffers::Instruction >&
+HostMessage::instruction() const {
+  // @@protoc_insertion_point(field_list:HostBuffers.HostMessage.instruction)
+  return _impl_.instruction_;
+}
+
+// -------------------------------------------------------------------
+
+// Instruction
+
+// -------------------------------------------------------------------
+
+// HostBytes
+
+// optional bytes hoststring = 4;
+inline bool HostBytes::_internal_has_hoststring() const {
+  bool value = (_impl_._has_bits_[0] & 0x00000001u) != 0;
+  return value;
+}
+inline bool HostBytes::has_hoststring() const {
+  return _internal_has_hoststring();
+}
+inline void HostBytes::clear_hoststring() {
+  _impl_.hoststring_.ClearToEmpty();
+  _impl_._has_bits_[0] &= ~0x00000001u;
+}
+inline const std::string& HostBytes::hoststring() const {
+  // @@protoc_insertion_point(field_get:HostBuffers.HostBytes.hoststring)
+  return _internal_hoststring();
+}
+template <typename ArgT0, typename... ArgT>
+inline PROTOBUF_ALWAYS_INLINE
+void HostBytes::set_hoststring(ArgT0&& arg0, ArgT... args) {
+ _impl_._has_bits_[0] |= 0x00000001u;
+ _impl_.hoststring_.SetBytes(static_cast<ArgT0 &&>(arg0), args..., GetArenaForAllocation());
+  // @@protoc_insertion_point(field_set:HostBuffers.HostBytes.hoststring)
+}
+inline std::string* HostBytes::mutable_hoststring() {
+  std::string* _s = _internal_mutable_hoststring();
+  // @@protoc_insertion_point(field_mutable:HostBuffers.HostBytes.hoststring)
+  return _s;
+}
+inline const std::string& HostBytes::_internal_hoststring() const {
+  return _impl_.hoststring_.Get();
+}
+inline void HostBytes::_internal_set_hoststring(const std::string& value) {
+  _impl_._has_bits_[0] |= 0x00000001u;
+  _impl_.hoststring_.Set(value, GetArenaForAllocation());
+}
+inline std::string* HostBytes::_internal_mutable_hoststring() {
+  _impl_._has_bits_[0] |= 0x00000001u;
+  return _impl_.hoststring_.Mutable(GetArenaForAllocation());
+}
+inline std::string* HostBytes::release_hoststring() {
+  // @@protoc_insertion_point(field_release:HostBuffers.HostBytes.hoststring)
+  if (!_internal_has_hoststring()) {
+    return nullptr;
+  }
+  _impl_._has_bits_[0] &= ~0x00000001u;
+  auto* p = _impl_.hoststring_.Release();
+#ifdef PROTOBUF_FORCE_COPY_DEFAULT_STRING
+  if (_impl_.hoststring_.IsDefault()) {
+    _impl_.hoststring_.Set("", GetArenaForAllocation());
+  }
+#endif // PROTOBUF_FORCE_COPY_DEFAULT_STRING
+  return p;
+}
+inline void HostBytes::set_allocated_hoststring(std::string* hoststring) {
+  if (hoststring != nullptr) {
+    _impl_._has_bits_[0] |= 0x00000001u;
+  } else {
+    _impl_._has_bits_[0] &= ~0x00000001u;
+  }
+  _impl_.hoststring_.SetAllocated(hoststring, GetArenaForAllocation());
+#ifdef PROTOBUF_FORCE_COPY_DEFAULT_STRING
+  if (_impl_.hoststring_.IsDefault()) {
+    _impl_.hoststring_.Set("", GetArenaForAllocation());
+  }
+#endif // PROTOBUF_FORCE_COPY_DEFAULT_STRING
+  // @@protoc_insertion_point(field_set_allocated:HostBuffers.HostBytes.hoststring)
+}
+
+// -------------------------------------------------------------------
+
+// ResizeMessage
+
+// optional int32 width = 5;
+inline bool ResizeMessage::_internal_has_width() const {
+  bool value = (_impl_._has_bits_[0] & 0x00000001u) != 0;
+  return value;
+}
+inline bool ResizeMessage::has_width() const {
+  return _internal_has_width();
+}
+inline void ResizeMessage::clear_width() {
+  _impl_.width_ = 0;
+  _impl_._has_bits_[0] &= ~0x00000001u;
+}
+inline int32_t ResizeMessage::_internal_width() const {
+  return _impl_.width_;
+}
+inline int32_t ResizeMessage::width() const {
+  // @@protoc_insertion_point(field_get:HostBuffers.ResizeMessage.width)
+  return _internal_width();
+}
+inline void ResizeMessage::_internal_set_width(int32_t value) {
+  _impl_._has_bits_[0] |= 0x00000001u;
+  _impl_.width_ = value;
+}
+inline void ResizeMessage::set_width(int32_t value) {
+  _internal_set_width(value);
+  // @@protoc_insertion_point(field_set:HostBuffers.ResizeMessage.width)
+}
+
+// optional int32 height = 6;
+inline bool ResizeMessage::_internal_has_height() const {
+  bool value = (_impl_._has_bits_[0] & 0x00000002u) != 0;
+  return value;
+}
+inline bool ResizeMessage::has_height() const {
+  return _internal_has_height();
+}
+inline void ResizeMessage::clear_height() {
+  _impl_.height_ = 0;
+  _impl_._has_bits_[0] &= ~0x00000002u;
+}
+inline int32_t ResizeMessage::_internal_height() const {
+  return _impl_.height_;
+}
+inline int32_t ResizeMessage::height() const {
+  // @@protoc_insertion_point(field_get:HostBuffers.ResizeMessage.height)
+  return _internal_height();
+}
+inline void ResizeMessage::_internal_set_height(int32_t value) {
+  _impl_._has_bits_[0] |= 0x00000002u;
+  _impl_.height_ = value;
+}
+inline void ResizeMessage::set_height(int32_t value) {
+  _internal_set_height(value);
+  // @@protoc_insertion_point(field_set:HostBuffers.ResizeMessage.height)
+}
+
+// -------------------------------------------------------------------
+
+// EchoAck
+
+// optional uint64 echo_ack_num = 8;
+inline bool EchoAck::_internal_has_echo_ack_num() const {
+  bool value = (_impl_._has_bits_[0] & 0x00000001u) != 0;
+  return value;
+}
+inline bool EchoAck::has_echo_ack_num() const {
+  return _internal_has_echo_ack_num();
+}
+inline void EchoAck::clear_echo_ack_num() {
+  _impl_.echo_ack_num_ = uint64_t{0u};
+  _impl_._has_bits_[0] &= ~0x00000001u;
+}
+inline uint64_t EchoAck::_internal_echo_ack_num() const {
+  return _impl_.echo_ack_num_;
+}
+inline uint64_t EchoAck::echo_ack_num() const {
+  // @@protoc_insertion_point(field_get:HostBuffers.EchoAck.echo_ack_num)
+  return _internal_echo_ack_num();
+}
+inline void EchoAck::_internal_set_echo_ack_num(uint64_t value) {
+  _impl_._has_bits_[0] |= 0x00000001u;
+  _impl_.echo_ack_num_ = value;
+}
+inline void EchoAck::set_echo_ack_num(uint64_t value) {
+  _internal_set_echo_ack_num(value);
+  // @@protoc_insertion_point(field_set:HostBuffers.EchoAck.echo_ack_num)
+}
+
+// -------------------------------------------------------------------
+
+// ScrollbackLines
+
+// optional uint64 first = 10;
+inline bool ScrollbackLines::_internal_has_first() const {
+  bool value = (_impl_._has_bits_[0] & 0x00000001u) != 0;
+  return value;
+}
+inline bool ScrollbackLines::has_first() const {
+  return _internal_has_first();
+}
+inline void ScrollbackLines::clear_first() {
+  _impl_.first_ = uint64_t{0u};
+  _impl_._has_bits_[0] &= ~0x00000001u;
+}
+inline uint64_t ScrollbackLines::_internal_first() const {
+  return _impl_.first_;
+}
+inline uint64_t ScrollbackLines::first() const {
+  // @@protoc_insertion_point(field_get:HostBuffers.ScrollbackLines.first)
+  return _internal_first();
+}
+inline void ScrollbackLines::_internal_set_first(uint64_t value) {
+  _impl_._has_bits_[0] |= 0x00000001u;
+  _impl_.first_ = value;
+}
+inline void ScrollbackLines::set_first(uint64_t value) {
+  _internal_set_first(value);
+  // @@protoc_insertion_point(field_set:HostBuffers.ScrollbackLines.first)
+}
+
+// optional uint64 end = 11;
+inline bool ScrollbackLines::_internal_has_end() const {
+  bool value = (_impl_._has_bits_[0] & 0x00000002u) != 0;
+  return value;
+}
+inline bool ScrollbackLines::has_end() const {
+  return _internal_has_end();
+}
+inline void ScrollbackLines::clear_end() {
+  _impl_.end_ = uint64_t{0u};
+  _impl_._has_bits_[0] &= ~0x00000002u;
+}
+inline uint64_t ScrollbackLines::_internal_end() const {
+  return _impl_.end_;
+}
+inline uint64_t ScrollbackLines::end() const {
+  // @@protoc_insertion_point(field_get:HostBuffers.ScrollbackLines.end)
+  return _internal_end();
+}
+inline void ScrollbackLines::_internal_set_end(uint64_t value) {
+  _impl_._has_bits_[0] |= 0x00000002u;
+  _impl_.end_ = value;
+}
+inline void ScrollbackLines::set_end(uint64_t value) {
+  _internal_set_end(value);
+  // @@protoc_insertion_point(field_set:HostBuffers.ScrollbackLines.end)
+}
+
+// repeated bytes line = 12;
+inline int ScrollbackLines::_internal_line_size() const {
+  return _impl_.line_.size();
+}
+inline int ScrollbackLines::line_size() const {
+  return _internal_line_size();
+}
+inline void ScrollbackLines::clear_line() {
+  _impl_.line_.Clear();
+}
+inline std::string* ScrollbackLines::add_line() {
+  std::string* _s = _internal_add_line();
+  // @@protoc_insertion_point(field_add_mutable:HostBuffers.ScrollbackLines.line)
+  return _s;
+}
+inline const std::string& ScrollbackLines::_internal_line(int index) const {
+  return _impl_.line_.Get(index);
+}
+inline const std::string& ScrollbackLines::line(int index) const {
+  // @@protoc_insertion_point(field_get:HostBuffers.ScrollbackLines.line)
+  return _internal_line(index);
+}
+inline std::string* ScrollbackLines::mutable_line(int index) {
+  // @@protoc_insertion_point(field_mutable:HostBuffers.ScrollbackLines.line)
+  return _impl_.line_.Mutable(index);
+}
+inline void ScrollbackLines::set_line(int index, const std::string& value) {
+  _impl_.line_.Mutable(index)->assign(value);
+  // @@protoc_insertion_point(field_set:HostBuffers.ScrollbackLines.line)
+}
+inline void ScrollbackLines::set_line(int index, std::string&& value) {
+  _impl_.line_.Mutable(index)->assign(std::move(value));
+  // @@protoc_insertion_point(field_set:HostBuffers.ScrollbackLines.line)
+}
+inline void ScrollbackLines::set_line(int index, const char* value) {
+  GOOGLE_DCHECK(value != nullptr);
+  _impl_.line_.Mutable(index)->assign(value);
+  // @@protoc_insertion_point(field_set_char:HostBuffers.ScrollbackLines.line)
+}
+inline void ScrollbackLines::set_line(int index, const void* value, size_t size) {
+  _impl_.line_.Mutable(index)->assign(
+    reinterpret_cast<const char*>(value), size);
+  // @@protoc_insertion_point(field_set_pointer:HostBuffers.ScrollbackLines.line)
+}
+inline std::string* ScrollbackLines::_internal_add_line() {
+  return _impl_.line_.Add();
+}
+inline void ScrollbackLines::add_line(const std::string& value) {
+  _impl_.line_.Add()->assign(value);
+  // @@protoc_insertion_point(field_add:HostBuffers.ScrollbackLines.line)
+}
+inline void ScrollbackLines::add_line(std::string&& value) {
+  _impl_.line_.Add(std::move(value));
+  // @@protoc_insertion_point(field_add:HostBuffers.ScrollbackLines.line)
+}
+inline void ScrollbackLines::add_line(const char* value) {
+  GOOGLE_DCHECK(value != nullptr);
+  _impl_.line_.Add()->assign(value);
+  // @@protoc_insertion_point(field_add_char:HostBuffers.ScrollbackLines.line)
+}
+inline void ScrollbackLines::add_line(const void* value, size_t size) {
+  _impl_.line_.Add()->assign(reinterpret_cast<const char*>(value), size);
+  // @@protoc_insertion_point(field_add_pointer:HostBuffers.ScrollbackLines.line)
+}
+inline const ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField<std::string>&
+ScrollbackLines::line() const {
+  // @@protoc_insertion_point(field_list:HostBuffers.ScrollbackLines.line)
+  return _impl_.line_;
+}
+inline ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField<std::string>*
+ScrollbackLines::mutable_line() {
+  // @@protoc_insertion_point(field_mutable_list:HostBuffers.ScrollbackLines.line)
+  return &_impl_.line_;
+}
+
+// optional uint64 oldest = 13;
+inline bool ScrollbackLines::_internal_has_oldest() const {
+  bool value = (_impl_._has_bits_[0] & 0x00000004u) != 0;
+  return value;
+}
+inline bool ScrollbackLines::has_oldest() const {
+  return _internal_has_oldest();
+}
+inline void ScrollbackLines::clear_oldest() {
+  _impl_.oldest_ = uint64_t{0u};
+  _impl_._has_bits_[0] &= ~0x00000004u;
+}
+inline uint64_t ScrollbackLines::_internal_oldest() const {
+  return _impl_.oldest_;
+}
+inline uint64_t ScrollbackLines::oldest() const {
+  // @@protoc_insertion_point(field_get:HostBuffers.ScrollbackLines.oldest)
+  return _internal_oldest();
+}
+inline void ScrollbackLines::_internal_set_oldest(uint64_t value) {
+  _impl_._has_bits_[0] |= 0x00000004u;
+  _impl_.oldest_ = value;
+}
+inline void ScrollbackLines::set_oldest(uint64_t value) {
+  _internal_set_oldest(value);
+  // @@protoc_insertion_point(field_set:HostBuffers.ScrollbackLines.oldest)
+}
+
+#ifdef __GNUC__
+  #pragma GCC diagnostic pop
+#endif  // __GNUC__
+// -------------------------------------------------------------------
+
+// -------------------------------------------------------------------
+
+// -------------------------------------------------------------------
+
+// -------------------------------------------------------------------
+
+// -------------------------------------------------------------------
+
+
+// @@protoc_insertion_point(namespace_scope)
+
+}  // namespace HostBuffers
+
+// @@protoc_insertion_point(global_scope)
+
+#include <google/protobuf/port_undef.inc>
+#endif  // GOOGLE_PROTOBUF_INCLUDED_GOOGLE_PROTOBUF_INCLUDED_hostinput_2eproto
@@ -30,7 +30,11 @@
     also delete it here.
 */
 
+#include <algorithm>
+#include <cassert>
 #include <climits>
+#include <cstring>
+#include <vector>
 
 #include "src/protobufs/hostinput.pb.h"
 #include "src/statesync/completeterminal.h"
@@ -41,16 +45,182 @@ using namespace Parser;
 using namespace Terminal;
 using namespace HostBuffers;
 
+uint64_t Complete::new_generation( void )
+{
+  static uint64_t generation_counter = 0;
+  return ++generation_counter;
+}
+
+/* Length of the SGR or EL sequence (ESC [ params m, or K) at the
+   start of s, or 0. */
+static size_t flood_csi_length( const char* s, size_t len )
+{
+  if ( len < 3 || s[0] != '\033' || s[1] != '[' ) {
+    return 0;
+  }
+  for ( size_t i = 2; i < len; i++ ) {
+    if ( s[i] == 'm' || s[i] == 'K' ) {
+      return i + 1;
+    } else if ( !( ( '0' <= s[i] && s[i] <= '9' ) || s[i] == ';' || s[i] == ':' ) ) {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/* Whether the sequence is an SGR whose parameters are all 0, which
+   resets every rendition. */
+static bool sgr_resets( const char* s, size_t len )
+{
+  if ( len == 0 || s[len - 1] != 'm' ) {
+    return false;
+  }
+  for ( size_t i = 2; i + 1 < len; i++ ) {
+    if ( s[i] != '0' && s[i] != ';' ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Length of the leading run of input that only prints, moves the
+   cursor within the line, feeds lines, erases within the line or sets
+   renditions: text (without C1 controls encoded in UTF-8), HT, BS,
+   CR, LF, EL and SGR. */
+static size_t flood_run( const char* s, size_t len )
+{
+  size_t i = 0;
+  while ( i < len ) {
+    const unsigned char c = s[i];
+    if ( ( 0x20 <= c && c < 0x7f ) || c == '\r' || c == '\n' || c == '\t' || c == '\b' ) {
+      i++;
+    } else if ( c >= 0x80 ) {
+      if ( c == 0xc2 && i + 1 < len && static_cast<unsigned char>( s[i + 1] ) < 0xa0 ) {
+        break;
+      }
+      i++;
+    } else {
+      const size_t csi = flood_csi_length( s + i, len - i );
+      if ( csi == 0 ) {
+        break;
+      }
+      i += csi;
+    }
+  }
+  return i;
+}
+
+/* With the scrolling region covering the screen, a carriage return
+   followed by 2 * height - 1 line feeds (and nothing but flood_run()
+   input) leaves the same state whatever it started from: the cursor
+   reaches the bottom row within height - 1 feeds, from then on the
+   cursor, wrap flag and combining-character position move in
+   lockstep, and the remaining feeds scroll every earlier row away.
+   So the flood before that carriage return need not be emulated,
+   apart from its SGR sequences, whose renditions carry over; erases
+   within the line only touch rows that scroll away.
+
+   Returns where emulation should resume, and sets *flood_end to where
+   the flood stopped, or a screenful on if that is later, so that a
+   caller tries again only past it.  Nothing is skipped while rows that
+   scroll off go to scrollback. */
+size_t Complete::fast_forward( const string& str, size_t start, size_t* flood_end )
+{
+  if ( terminal.get_fb().has_scrollback() ) {
+    *flood_end = str.size();
+    return start;
+  }
+
+  const DrawState& ds = terminal.get_fb().ds;
+  const char* s = str.data();
+  const size_t end = start + flood_run( s + start, str.size() - start );
+  *flood_end = std::max( end, start + static_cast<size_t>( ds.get_width() ) * ds.get_height() );
+
+  if ( ds.get_scrolling_region_top_row() != 0 || ds.get_scrolling_region_bottom_row() != ds.get_height() - 1 ) {
+    return start;
+  }
+
+  /* the last carriage return with enough line feeds after it */
+  const size_t feeds_needed = 2 * ds.get_height() - 1;
+  size_t feeds = 0;
+  size_t cut = end;
+  while ( cut > start && feeds < feeds_needed ) {
+    cut--;
+    feeds += ( s[cut] == '\n' );
+  }
+  while ( cut > start && s[cut] != '\r' ) {
+    cut--;
+  }
+  if ( feeds < feeds_needed || s[cut] != '\r' ) {
+    return start;
+  }
+
+  /* carry over the renditions, from the last SGR that resets them */
+  const char* from = s + start;
+  for ( const char* p = s + cut; p > from; ) {
+    p--;
+    if ( *p == '\033' && sgr_resets( p, flood_csi_length( p, s + cut - p ) ) ) {
+      from = p;
+      break;
+    }
+  }
+  for ( const char* esc = from; ( esc = static_cast<const char*>( memchr( esc, '\033', s + cut - esc ) ) ); ) {
+    const size_t csi = flood_csi_length( esc, s + cut - esc );
+    assert( csi > 0 );
+    if ( esc[csi - 1] == 'm' ) {
+      for ( size_t i = 0; i < csi; i++ ) {
+        parser.input( esc[i], actions );
+      }
+      for ( const ParserAction& act : actions ) {
+        act_on_terminal( act, &terminal );
+      }
+      actions.clear();
+    }
+    esc += csi;
+  }
+
+  return cut;
+}
+
 string Complete::act( const string& str )
 {
-  for ( unsigned int i = 0; i < str.size(); i++ ) {
-    /* parse octet into up to three actions */
-    parser.input( str[i], actions );
+  generation = new_generation();
+
+  const DrawState& ds = terminal.get_fb().ds;
+  const size_t flood_length = static_cast<size_t>( ds.get_width() ) * ds.get_height() * FLOOD_SCREENS;
+  size_t flood_end = 0;
+
+  for ( size_t i = 0; i < str.size(); ) {
+    /* skip what a flood would scroll away before the next frame */
+    if ( i >= flood_end && str.size() - i >= flood_length && parser.is_ground() ) {
+      i = fast_forward( str, i, &flood_end );
+    }
+
+    /* hand runs of plain text straight to the emulator */
+    if ( parser.is_ground() ) {
+      const size_t run = Parser::UTF8Parser::printable_ascii_run( str.data() + i, str.size() - i );
+      if ( run > 0 ) {
+        terminal.print_ascii_run( str.data() + i, run );
+        i += run;
+        continue;
+      }
+    }
+
+    /* decode a run of multibyte text at once, or parse one octet
+       into up to three actions */
+    size_t consumed = 0;
+    if ( parser.is_ground() && static_cast<unsigned char>( str[i] ) >= 0x80 ) {
+      consumed = parser.input_printable_run( str.data() + i, str.size() - i, PRINT_RUN_LENGTH, actions );
+    }
+    if ( consumed == 0 ) {
+      parser.input( str[i], actions );
+      consumed = 1;
+    }
+    i += consumed;
 
-    /* apply actions to terminal and delete them */
-    for ( Actions::iterator it = actions.begin(); it != actions.end(); it++ ) {
-      Action& act = **it;
-      act.act_on_terminal( &terminal );
+    /* apply actions to terminal; the buffer keeps its capacity */
+    for ( const ParserAction& act : actions ) {
+      act_on_terminal( act, &terminal );
     }
     actions.clear();
   }
@@ -60,6 +230,8 @@ string Complete::act( const string& str )
 
 string Complete::act( const Action& act )
 {
+  generation = new_generation();
+
   /* apply action to terminal */
   act.act_on_terminal( &terminal );
   return terminal.read_octets_to_host();
@@ -90,9 +262,80 @@ string Complete::diff_from( const Complete& existing ) const
     }
   }
 
+  if ( scrollback_page && !same_scrollback_page( existing ) ) {
+    ScrollbackLines* lines = output.add_instruction()->MutableExtension( scrollback );
+    lines->set_first( scrollback_page->first );
+    lines->set_end( scrollback_page->end );
+    lines->set_oldest( scrollback_page->oldest );
+    for ( const string& line : scrollback_page->lines ) {
+      lines->add_line( line );
+    }
+  }
+
   return output.SerializeAsString();
 }
 
+/* An intermediate state between existing and this one whose diff fits in
+   about budget bytes.  Changed rows closest to the cursor come from this
+   state; the others are left as they are in existing and go out in later
+   frames. */
+Complete Complete::partial_from( const Complete& existing, size_t budget ) const
+{
+  const Framebuffer& fb = get_fb();
+  const Framebuffer& old_fb = existing.get_fb();
+  const int height = fb.ds.get_height();
+
+  if ( ( fb.ds.get_width() != old_fb.ds.get_width() ) || ( height != old_fb.ds.get_height() ) ) {
+    return *this;
+  }
+
+  /* find changed rows, nearest to the cursor first */
+  auto row_changed = [&]( int row ) { return !( *fb.get_row( row ) == *old_fb.get_row( row ) ); };
+  vector<int> changed;
+  const int cursor_row = fb.ds.get_cursor_row();
+  for ( int distance = 0; distance < height; distance++ ) {
+    const int above = cursor_row - distance;
+    const int below = cursor_row + distance;
+    if ( ( above >= 0 ) && row_changed( above ) ) {
+      changed.push_back( above );
+    }
+    if ( distance && ( below < height ) && row_changed( below ) ) {
+      changed.push_back( below );
+    }
+  }
+
+  if ( changed.size() < 2 ) {
+    return *this;
+  }
+
+  /* state with only the first `count` changed rows applied */
+  auto make_partial = [&]( size_t count ) {
+    Complete partial( *this );
+    partial.generation = new_generation();
+    partial.echo_ack = existing.echo_ack;
+    for ( size_t i = count; i < changed.size(); i++ ) {
+      partial.terminal.share_row( changed[i], existing.terminal );
+    }
+    return partial;
+  };
+
+  /* binary search for the most rows that fit; always make progress */
+  size_t best = 1;
+  size_t low = 2;
+  size_t high = changed.size() - 1;
+  while ( low <= high ) {
+    size_t mid = ( low + high ) / 2;
+    if ( make_partial( mid ).diff_from( existing ).size() <= budget ) {
+      best = mid;
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  return make_partial( best );
+}
+
 string Complete::init_diff( void ) const
 {
   return diff_from( Complete( get_fb().ds.get_width(), get_fb().ds.get_height() ) );
@@ -114,14 +357,32 @@ void Complete::apply_string( const string& diff )
       uint64_t inst_echo_ack_num = input.instruction( i ).GetExtension( echoack ).echo_ack_num();
       assert( inst_echo_ack_num >= echo_ack );
       echo_ack = inst_echo_ack_num;
+      generation = new_generation();
+    } else if ( input.instruction( i ).HasExtension( scrollback ) ) {
+      const ScrollbackLines& lines = input.instruction( i ).GetExtension( scrollback );
+      ScrollbackPage page { lines.first(), lines.end(), lines.oldest(), {} };
+      page.lines.assign( lines.line().begin(), lines.line().end() );
+      set_scrollback_page( page );
     }
   }
 }
 
+void Complete::set_scrollback_page( const ScrollbackPage& page )
+{
+  scrollback_page = std::make_shared<const ScrollbackPage>( page );
+  generation = new_generation();
+}
+
+bool Complete::same_scrollback_page( const Complete& x ) const
+{
+  return ( scrollback_page == x.scrollback_page )
+         || ( scrollback_page && x.scrollback_page && ( *scrollback_page == *x.scrollback_page ) );
+}
+
 bool Complete::operator==( Complete const& x ) const
 {
   //  assert( parser == x.parser ); /* parser state is irrelevant for us */
-  return ( terminal == x.terminal ) && ( echo_ack == x.echo_ack );
+  return ( terminal == x.terminal ) && ( echo_ack == x.echo_ack ) && same_scrollback_page( x );
 }
 
 bool Complete::set_echo_ack( uint64_t now )
@@ -146,6 +407,7 @@ bool Complete::set_echo_ack( uint64_t now )
 
   if ( echo_ack != newest_echo_ack ) {
     ret = true;
+    generation = new_generation();
   }
 
   echo_ack = newest_echo_ack;
@@ -191,7 +453,12 @@ bool Complete::compare( const Complete& other ) const
 
   for ( int y = 0; y < height; y++ ) {
     for ( int x = 0; x < width; x++ ) {
-      if ( fb.get_cell( y, x )->compare( *other_fb.get_cell( y, x ) ) ) {
+      bool differs = fb.get_cell( y, x )->compare( *other_fb.get_cell( y, x ) );
+      if ( !( fb.get_renditions( y, x ) == other_fb.get_renditions( y, x ) ) ) {
+        fprintf( stderr, "renditions differ\n" );
+        differs = true;
+      }
+      if ( differs ) {
         fprintf( stderr, "Cell (%d, %d) differs.\n", y, x );
         ret = true;
       }
@@ -35,6 +35,9 @@
 
 #include <cstdint>
 #include <list>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "src/terminal/parser.h"
 #include "src/terminal/terminal.h"
@@ -42,6 +45,22 @@
 /* This class represents the complete terminal -- a UTF8Parser feeding Actions to an Emulator. */
 
 namespace Terminal {
+class Scrollback;
+
+/* Lines of the server's scrollback, sent in answer to a request. */
+struct ScrollbackPage
+{
+  uint64_t first;  /* number of the first line */
+  uint64_t end;    /* number of lines the server has seen scroll off */
+  uint64_t oldest; /* number of the oldest line the server still keeps */
+  std::vector<std::string> lines;
+
+  bool operator==( const ScrollbackPage& x ) const
+  {
+    return ( first == x.first ) && ( end == x.end ) && ( oldest == x.oldest ) && ( lines == x.lines );
+  }
+};
+
 class Complete
 {
 private:
@@ -58,11 +77,25 @@ private:
   input_history_type input_history;
   uint64_t echo_ack;
 
+  /* Changes whenever the displayed state may change; copies share it.
+     Equal generations imply equal states. */
+  uint64_t generation;
+  static uint64_t new_generation( void );
+
+  /* the latest scrollback page the client asked for; copies share it */
+  std::shared_ptr<const ScrollbackPage> scrollback_page;
+  bool same_scrollback_page( const Complete& x ) const;
+
   static const int ECHO_TIMEOUT = 50; /* for late ack */
+  static const size_t PRINT_RUN_LENGTH = 256; /* characters decoded per batch of actions */
+  static const int FLOOD_SCREENS = 4;         /* shorter input is always emulated in full */
+
+  size_t fast_forward( const std::string& str, size_t start, size_t* flood_end );
 
 public:
   Complete( size_t width, size_t height )
-    : parser(), terminal( width, height ), display( false ), actions(), input_history(), echo_ack( 0 )
+    : parser(), terminal( width, height ), display( false ), actions(), input_history(), echo_ack( 0 ),
+      generation( new_generation() ), scrollback_page()
   {}
 
   std::string act( const std::string& str );
@@ -70,6 +103,12 @@ public:
 
   const Framebuffer& get_fb( void ) const { return terminal.get_fb(); }
   void reset_input( void ) { parser.reset_input(); }
+
+  /* Keep the rows that scroll off the top in scrollback; floods are
+     then emulated in full, so that every row reaches it. */
+  void set_scrollback( Scrollback* scrollback ) { terminal.set_scrollback( scrollback ); }
+  void set_scrollback_page( const ScrollbackPage& page );
+  std::shared_ptr<const ScrollbackPage> get_scrollback_page( void ) const { return scrollback_page; }
   uint64_t get_echo_ack( void ) const { return echo_ack; }
   bool set_echo_ack( uint64_t now );
   void register_input_frame( uint64_t n, uint64_t now );
@@ -77,7 +116,9 @@ public:
 
   /* interface for Network::Transport */
   void subtract( const Complete* ) const {}
+  uint64_t get_generation( void ) const { return generation; }
   std::string diff_from( const Complete& existing ) const;
+  Complete partial_from( const Complete& existing, size_t budget ) const;
   std::string init_diff( void ) const;
   void apply_string( const std::string& diff );
   bool operator==( const Complete& x ) const;
@@ -41,6 +41,12 @@ using namespace Parser;
 using namespace Network;
 using namespace ClientBuffers;
 
+uint64_t UserStream::new_generation( void )
+{
+  static uint64_t generation_counter = 0;
+  return ++generation_counter;
+}
+
 void UserStream::subtract( const UserStream* prefix )
 {
   // if we are subtracting ourself from ourself, just clear the std::deque
@@ -89,6 +95,11 @@ std::string UserStream::diff_from( const UserStream& existing ) const
         new_inst->MutableExtension( resize )->set_width( my_it->resize.width );
         new_inst->MutableExtension( resize )->set_height( my_it->resize.height );
       } break;
+      case ScrollbackRequestType: {
+        Instruction* new_inst = output.add_instruction();
+        new_inst->MutableExtension( scrollback )->set_end( my_it->scrollback.end );
+        new_inst->MutableExtension( scrollback )->set_count( my_it->scrollback.count );
+      } break;
       default:
         assert( !"unexpected event type" );
         break;
@@ -105,6 +116,8 @@ void UserStream::apply_string( const std::string& diff )
   ClientBuffers::UserMessage input;
   fatal_assert( input.ParseFromString( diff ) );
 
+  generation = new_generation();
+
   for ( int i = 0; i < input.instruction_size(); i++ ) {
     if ( input.instruction( i ).HasExtension( keystroke ) ) {
       std::string the_bytes = input.instruction( i ).GetExtension( keystroke ).keys();
@@ -114,6 +127,9 @@ void UserStream::apply_string( const std::string& diff )
     } else if ( input.instruction( i ).HasExtension( resize ) ) {
       actions.push_back( UserEvent( Resize( input.instruction( i ).GetExtension( resize ).width(),
                                             input.instruction( i ).GetExtension( resize ).height() ) ) );
+    } else if ( input.instruction( i ).HasExtension( scrollback ) ) {
+      const ClientBuffers::ScrollbackRequest& request = input.instruction( i ).GetExtension( scrollback );
+      actions.push_back( UserEvent( Parser::ScrollbackRequest( request.end(), request.count() ) ) );
     }
   }
 }
@@ -125,6 +141,8 @@ const Parser::Action& UserStream::get_action( unsigned int i ) const
       return actions[i].userbyte;
     case ResizeType:
       return actions[i].resize;
+    case ScrollbackRequestType:
+      return actions[i].scrollback;
     default:
       assert( !"unexpected action type" );
       static const Parser::Ignore nothing = Parser::Ignore();
@@ -34,6 +34,7 @@
 #define USER_HPP
 
 #include <cassert>
+#include <cstdint>
 #include <deque>
 #include <list>
 #include <string>
@@ -44,7 +45,8 @@ namespace Network {
 enum UserEventType
 {
   UserByteType = 0,
-  ResizeType = 1
+  ResizeType = 1,
+  ScrollbackRequestType = 2
 };
 
 class UserEvent
@@ -53,10 +55,17 @@ public:
   UserEventType type;
   Parser::UserByte userbyte;
   Parser::Resize resize;
+  Parser::ScrollbackRequest scrollback;
 
-  UserEvent( const Parser::UserByte& s_userbyte ) : type( UserByteType ), userbyte( s_userbyte ), resize( -1, -1 )
+  UserEvent( const Parser::UserByte& s_userbyte )
+    : type( UserByteType ), userbyte( s_userbyte ), resize( -1, -1 ), scrollback( 0, 0 )
+  {}
+  UserEvent( const Parser::Resize& s_resize )
+    : type( ResizeType ), userbyte( 0 ), resize( s_resize ), scrollback( 0, 0 )
+  {}
+  UserEvent( const Parser::ScrollbackRequest& s_scrollback )
+    : type( ScrollbackRequestType ), userbyte( 0 ), resize( -1, -1 ), scrollback( s_scrollback )
   {}
-  UserEvent( const Parser::Resize& s_resize ) : type( ResizeType ), userbyte( 0 ), resize( s_resize ) {}
 
 private:
   UserEvent();
@@ -64,7 +73,8 @@ private:
 public:
   bool operator==( const UserEvent& x ) const
   {
-    return ( type == x.type ) && ( userbyte == x.userbyte ) && ( resize == x.resize );
+    return ( type == x.type ) && ( userbyte == x.userbyte ) && ( resize == x.resize )
+           && ( scrollback == x.scrollback );
   }
 };
 
@@ -73,11 +83,30 @@ class UserStream
 private:
   std::deque<UserEvent> actions;
 
+  /* Changes whenever events are added; copies share it.  subtract()
+     keeps it, since the sender removes the same acknowledged prefix
+     from every state it holds. */
+  uint64_t generation;
+  static uint64_t new_generation( void );
+
 public:
-  UserStream() : actions() {}
+  UserStream() : actions(), generation( new_generation() ) {}
 
-  void push_back( const Parser::UserByte& s_userbyte ) { actions.push_back( UserEvent( s_userbyte ) ); }
-  void push_back( const Parser::Resize& s_resize ) { actions.push_back( UserEvent( s_resize ) ); }
+  void push_back( const Parser::UserByte& s_userbyte )
+  {
+    actions.push_back( UserEvent( s_userbyte ) );
+    generation = new_generation();
+  }
+  void push_back( const Parser::Resize& s_resize )
+  {
+    actions.push_back( UserEvent( s_resize ) );
+    generation = new_generation();
+  }
+  void push_back( const Parser::ScrollbackRequest& s_scrollback )
+  {
+    actions.push_back( UserEvent( s_scrollback ) );
+    generation = new_generation();
+  }
 
   bool empty( void ) const { return actions.empty(); }
   size_t size( void ) const { return actions.size(); }
@@ -85,12 +114,14 @@ public:
 
   /* interface for Network::Transport */
   void subtract( const UserStream* prefix );
+  uint64_t get_generation( void ) const { return generation; }
   std::string diff_from( const UserStream& existing ) const;
+  UserStream partial_from( const UserStream&, size_t ) const { return *this; }
   std::string init_diff( void ) const { return diff_from( UserStream() ); };
   void apply_string( const std::string& diff );
   bool operator==( const UserStream& x ) const { return actions == x.actions; }
 
-  bool compare( const UserStream& ) { return false; }
+  bool compare( const UserStream& ) const { return false; }
 };
 }
 
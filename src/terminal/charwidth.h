@@ -0,0 +1,59 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+#ifndef CHARWIDTH_HPP
+#define CHARWIDTH_HPP
+
+#include <cstdint>
+
+namespace Terminal {
+/* Columns taken by a character, as wcwidth() would say: 0 for combining
+   characters, 2 for wide ones and -1 for non-printing ones.  Unlike
+   wcwidth() it reads a compiled table of a pinned Unicode version, so
+   it is fast, ignores the locale, and gives the same answer on the
+   client and the server. */
+int char_width_table( uint32_t ch );
+
+inline int char_width( wchar_t ch )
+{
+  const uint32_t c = static_cast<uint32_t>( ch );
+  if ( c >= 0x20 && c < 0x7f ) {
+    return 1;
+  }
+  return char_width_table( c );
+}
+
+const char* char_width_unicode( void );
+}
+
+#endif
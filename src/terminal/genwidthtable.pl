@@ -0,0 +1,101 @@
+#!/usr/bin/perl
+
+# Generates charwidthtable.h, the two-level table behind
+# Terminal::char_width(), from the Unicode Character Database that
+# ships with Perl.  The Unicode version is pinned (UNICODE_VERSION in
+# Makefile.am) and the table is kept in the tree, so that every build
+# of mosh, client and server alike, agrees on character widths.  To
+# regenerate it, run "make update-width-table" with a Perl whose UCD is
+# that version.
+
+use strict;
+use warnings;
+use Unicode::UCD qw(prop_invlist prop_invmap);
+
+my $version = shift or die "usage: $0 unicode-version\n";
+Unicode::UCD::UnicodeVersion() eq $version
+    or die "Perl's UCD is version " . Unicode::UCD::UnicodeVersion() . ", not $version\n";
+
+my $MAX = 0x110000;
+my @width = (1) x $MAX;
+
+sub fill {
+    my ( $prop, $value_width ) = @_;
+    my ( $ranges, $values ) = prop_invmap($prop);
+    for my $i ( 0 .. $#$ranges ) {
+        my $w = $value_width->( $values->[$i] );
+        next unless defined $w;
+        my $end = $i < $#$ranges ? $ranges->[ $i + 1 ] : $MAX;
+        @width[ $ranges->[$i] .. $end - 1 ] = ($w) x ( $end - $ranges->[$i] );
+    }
+}
+
+# East Asian Wide and Fullwidth characters take two columns.
+fill( 'East_Asian_Width', sub { $_[0] eq 'W' || $_[0] eq 'F' ? 2 : undef } );
+
+# Combining marks and format characters take none; controls,
+# surrogates and line and paragraph separators are not printable.
+my %category_width = (
+    Mn => 0,     # nonspacing mark
+    Me => 0,     # enclosing mark
+    Cf => 0,     # format
+    Cc => -1,    # control
+    Cs => -1,    # surrogate
+    Zl => -1,    # line separator
+    Zp => -1,    # paragraph separator
+);
+fill( 'General_Category', sub { $category_width{ $_[0] } } );
+
+# Hangul Jamo medial vowels and final consonants join the syllable
+# before them.
+@width[ 0x1160 .. 0x11FF ] = (0) x ( 0x11FF - 0x1160 + 1 );
+@width[ 0xD7B0 .. 0xD7FF ] = (0) x ( 0xD7FF - 0xD7B0 + 1 );
+
+# Prepended concatenation marks are format characters that are
+# displayed, spanning the digits that follow.
+my @marks = prop_invlist('Prepended_Concatenation_Mark');
+for ( my $i = 0 ; $i < @marks ; $i += 2 ) {
+    @width[ $marks[$i] .. $marks[ $i + 1 ] - 1 ] = (1) x ( $marks[ $i + 1 ] - $marks[$i] );
+}
+
+$width[0x00]   = 0;    # as wcwidth()
+$width[0x00AD] = 1;    # soft hyphen is displayed
+
+# Two bits per character, width + 1, in blocks of 256 characters;
+# identical blocks are stored once.
+my ( @index, @blocks, %block_number );
+for ( my $base = 0 ; $base < $MAX ; $base += 256 ) {
+    my @bytes;
+    for ( my $i = 0 ; $i < 256 ; $i += 4 ) {
+        my $byte = 0;
+        for my $j ( 0 .. 3 ) {
+            $byte |= ( $width[ $base + $i + $j ] + 1 ) << ( 2 * $j );
+        }
+        push @bytes, $byte;
+    }
+    my $key = join ',', @bytes;
+    unless ( exists $block_number{$key} ) {
+        $block_number{$key} = scalar @blocks;
+        push @blocks, \@bytes;
+    }
+    push @index, $block_number{$key};
+}
+die "too many distinct blocks\n" if @blocks > 256;
+
+print "/* Generated by genwidthtable.pl from Unicode $version; do not edit. */\n\n";
+print "static const char char_width_unicode_version[] = \"$version\";\n\n";
+printf "static const uint8_t char_width_index[%d] = {\n", scalar @index;
+for ( my $i = 0 ; $i < @index ; $i += 16 ) {
+    my $last = $i + 15 < $#index ? $i + 15 : $#index;
+    print '  ', join( ', ', @index[ $i .. $last ] ), ",\n";
+}
+print "};\n\n";
+printf "static const uint8_t char_width_blocks[%d][64] = {\n", scalar @blocks;
+for my $block (@blocks) {
+    print "  {\n";
+    for ( my $i = 0 ; $i < 64 ; $i += 16 ) {
+        print '    ', join( ', ', map { sprintf '0x%02x', $_ } @$block[ $i .. $i + 15 ] ), ",\n";
+    }
+    print "  },\n";
+}
+print "};\n";
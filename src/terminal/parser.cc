@@ -30,133 +30,518 @@
     also delete it here.
 */
 
+#include <array>
 #include <cassert>
-#include <cerrno>
 #include <cstdint>
-#include <cwchar>
-#include <typeinfo>
+#include <type_traits>
+#include <utility>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
 
 #include "src/terminal/parser.h"
 
-const Parser::StateFamily Parser::family;
+namespace {
+using namespace Parser;
+
+/* Action codes are indices into ParserAction. */
+enum ActionCode : uint8_t
+{
+  IGNORE,
+  PRINT,
+  EXECUTE,
+  CLEAR,
+  COLLECT,
+  PARAM,
+  ESC_DISPATCH,
+  CSI_DISPATCH,
+  HOOK,
+  PUT,
+  UNHOOK,
+  OSC_START,
+  OSC_PUT,
+  OSC_END,
+  ACTION_COUNT
+};
+
+static_assert( std::variant_size_v<ParserAction> == ACTION_COUNT, "action codes must cover ParserAction" );
+static_assert( std::is_same_v<std::variant_alternative_t<PRINT, ParserAction>, Print> );
+static_assert( std::is_same_v<std::variant_alternative_t<OSC_END, ParserAction>, OSC_End> );
+
+struct TableEntry
+{
+  ActionCode action;
+  StateId next; /* STATE_COUNT: stay, without exit or entry actions */
+};
+
+/* Characters from U+00A0 up behave like 'A'; see table_index(). */
+const wchar_t TABLE_WIDTH = 0xA0;
 
-static void append_or_delete( Parser::ActionPointer act, Parser::Actions& vec )
+/* The transition rules of http://www.vt100.net/emu/dec_ansi_parser, as
+   in parserstate.cc, evaluated once at compile time. */
+
+constexpr bool C0_prime( wchar_t ch )
 {
-  assert( act );
+  return ( ch <= 0x17 ) || ( ch == 0x19 ) || ( ( 0x1C <= ch ) && ( ch <= 0x1F ) );
+}
 
-  if ( !act->ignore() ) {
-    vec.push_back( act );
+constexpr bool GLGR( wchar_t ch )
+{
+  return ( ( 0x20 <= ch ) && ( ch <= 0x7F ) )     /* GL area */
+         || ( ( 0xA0 <= ch ) && ( ch <= 0xFF ) ); /* GR area */
+}
+
+constexpr TableEntry to( StateId next, ActionCode action = IGNORE )
+{
+  return TableEntry { action, next };
+}
+
+constexpr TableEntry act( ActionCode action )
+{
+  return TableEntry { action, STATE_COUNT };
+}
+
+constexpr TableEntry anywhere_rule( wchar_t ch )
+{
+  if ( ( ch == 0x18 ) || ( ch == 0x1A ) || ( ( 0x80 <= ch ) && ( ch <= 0x8F ) )
+       || ( ( 0x91 <= ch ) && ( ch <= 0x97 ) ) || ( ch == 0x99 ) || ( ch == 0x9A ) ) {
+    return to( GROUND, EXECUTE );
+  } else if ( ch == 0x9C ) {
+    return to( GROUND );
+  } else if ( ch == 0x1B ) {
+    return to( ESCAPE );
+  } else if ( ( ch == 0x98 ) || ( ch == 0x9E ) || ( ch == 0x9F ) ) {
+    return to( SOS_PM_APC_STRING );
+  } else if ( ch == 0x90 ) {
+    return to( DCS_ENTRY );
+  } else if ( ch == 0x9D ) {
+    return to( OSC_STRING );
+  } else if ( ch == 0x9B ) {
+    return to( CSI_ENTRY );
   }
+  return act( IGNORE );
 }
 
-void Parser::Parser::input( wchar_t ch, Actions& ret )
+constexpr TableEntry state_rule( StateId state, wchar_t ch )
 {
-  Transition tx = state->input( ch );
+  switch ( state ) {
+    case GROUND:
+      if ( C0_prime( ch ) ) {
+        return act( EXECUTE );
+      } else if ( GLGR( ch ) ) {
+        return act( PRINT );
+      }
+      break;
+    case ESCAPE:
+      if ( C0_prime( ch ) ) {
+        return act( EXECUTE );
+      } else if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
+        return to( ESCAPE_INTERMEDIATE, COLLECT );
+      } else if ( ( ( 0x30 <= ch ) && ( ch <= 0x4F ) ) || ( ( 0x51 <= ch ) && ( ch <= 0x57 ) ) || ( ch == 0x59 )
+                  || ( ch == 0x5A ) || ( ch == 0x5C ) || ( ( 0x60 <= ch ) && ( ch <= 0x7E ) ) ) {
+        return to( GROUND, ESC_DISPATCH );
+      } else if ( ch == 0x5B ) {
+        return to( CSI_ENTRY );
+      } else if ( ch == 0x5D ) {
+        return to( OSC_STRING );
+      } else if ( ch == 0x50 ) {
+        return to( DCS_ENTRY );
+      } else if ( ( ch == 0x58 ) || ( ch == 0x5E ) || ( ch == 0x5F ) ) {
+        return to( SOS_PM_APC_STRING );
+      }
+      break;
+    case ESCAPE_INTERMEDIATE:
+      if ( C0_prime( ch ) ) {
+        return act( EXECUTE );
+      } else if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
+        return act( COLLECT );
+      } else if ( ( 0x30 <= ch ) && ( ch <= 0x7E ) ) {
+        return to( GROUND, ESC_DISPATCH );
+      }
+      break;
+    case CSI_ENTRY:
+      if ( C0_prime( ch ) ) {
+        return act( EXECUTE );
+      } else if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
+        return to( GROUND, CSI_DISPATCH );
+      } else if ( ( 0x30 <= ch ) && ( ch <= 0x3B ) ) { /* ':' separates sub-parameters */
+        return to( CSI_PARAM, PARAM );
+      } else if ( ( 0x3C <= ch ) && ( ch <= 0x3F ) ) {
+        return to( CSI_PARAM, COLLECT );
+      } else if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
+        return to( CSI_INTERMEDIATE, COLLECT );
+      }
+      break;
+    case CSI_PARAM:
+      if ( C0_prime( ch ) ) {
+        return act( EXECUTE );
+      } else if ( ( 0x30 <= ch ) && ( ch <= 0x3B ) ) {
+        return act( PARAM );
+      } else if ( ( 0x3C <= ch ) && ( ch <= 0x3F ) ) {
+        return to( CSI_IGNORE );
+      } else if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
+        return to( CSI_INTERMEDIATE, COLLECT );
+      } else if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
+        return to( GROUND, CSI_DISPATCH );
+      }
+      break;
+    case CSI_INTERMEDIATE:
+      if ( C0_prime( ch ) ) {
+        return act( EXECUTE );
+      } else if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
+        return act( COLLECT );
+      } else if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
+        return to( GROUND, CSI_DISPATCH );
+      } else if ( ( 0x30 <= ch ) && ( ch <= 0x3F ) ) {
+        return to( CSI_IGNORE );
+      }
+      break;
+    case CSI_IGNORE:
+      if ( C0_prime( ch ) ) {
+        return act( EXECUTE );
+      } else if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
+        return to( GROUND );
+      }
+      break;
+    case DCS_ENTRY:
+      if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
+        return to( DCS_INTERMEDIATE, COLLECT );
+      } else if ( ch == 0x3A ) {
+        return to( DCS_IGNORE );
+      } else if ( ( ( 0x30 <= ch ) && ( ch <= 0x39 ) ) || ( ch == 0x3B ) ) {
+        return to( DCS_PARAM, PARAM );
+      } else if ( ( 0x3C <= ch ) && ( ch <= 0x3F ) ) {
+        return to( DCS_PARAM, COLLECT );
+      } else if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
+        return to( DCS_PASSTHROUGH );
+      }
+      break;
+    case DCS_PARAM:
+      if ( ( ( 0x30 <= ch ) && ( ch <= 0x39 ) ) || ( ch == 0x3B ) ) {
+        return act( PARAM );
+      } else if ( ( ch == 0x3A ) || ( ( 0x3C <= ch ) && ( ch <= 0x3F ) ) ) {
+        return to( DCS_IGNORE );
+      } else if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
+        return to( DCS_INTERMEDIATE, COLLECT );
+      } else if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
+        return to( DCS_PASSTHROUGH );
+      }
+      break;
+    case DCS_INTERMEDIATE:
+      if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
+        return act( COLLECT );
+      } else if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
+        return to( DCS_PASSTHROUGH );
+      } else if ( ( 0x30 <= ch ) && ( ch <= 0x3F ) ) {
+        return to( DCS_IGNORE );
+      }
+      break;
+    case DCS_PASSTHROUGH:
+      if ( C0_prime( ch ) || ( ( 0x20 <= ch ) && ( ch <= 0x7E ) ) ) {
+        return act( PUT );
+      } else if ( ch == 0x9C ) {
+        return to( GROUND );
+      }
+      break;
+    case DCS_IGNORE:
+    case SOS_PM_APC_STRING:
+      if ( ch == 0x9C ) {
+        return to( GROUND );
+      }
+      break;
+    case OSC_STRING:
+      if ( ( 0x20 <= ch ) && ( ch <= 0x7F ) ) {
+        return act( OSC_PUT );
+      } else if ( ( ch == 0x9C ) || ( ch == 0x07 ) ) { /* 0x07 is xterm non-ANSI variant */
+        return to( GROUND );
+      }
+      break;
+    case STATE_COUNT:
+      break;
+  }
+  return act( IGNORE );
+}
+
+constexpr ActionCode entry_action( StateId state )
+{
+  switch ( state ) {
+    case ESCAPE:
+    case CSI_ENTRY:
+    case DCS_ENTRY:
+      return CLEAR;
+    case DCS_PASSTHROUGH:
+      return HOOK;
+    case OSC_STRING:
+      return OSC_START;
+    default:
+      return IGNORE;
+  }
+}
+
+constexpr ActionCode exit_action( StateId state )
+{
+  switch ( state ) {
+    case DCS_PASSTHROUGH:
+      return UNHOOK;
+    case OSC_STRING:
+      return OSC_END;
+    default:
+      return IGNORE;
+  }
+}
 
-  if ( tx.next_state != NULL ) {
-    append_or_delete( state->exit(), ret );
+struct TransitionTable
+{
+  TableEntry entries[STATE_COUNT][TABLE_WIDTH];
+  ActionCode entry_actions[STATE_COUNT];
+  ActionCode exit_actions[STATE_COUNT];
+};
+
+constexpr TransitionTable build_transition_table( void )
+{
+  TransitionTable table {};
+  for ( int state = 0; state < STATE_COUNT; state++ ) {
+    table.entry_actions[state] = entry_action( StateId( state ) );
+    table.exit_actions[state] = exit_action( StateId( state ) );
+    for ( wchar_t ch = 0; ch < TABLE_WIDTH; ch++ ) {
+      const TableEntry anywhere = anywhere_rule( ch );
+      table.entries[state][ch] = anywhere.next != STATE_COUNT ? anywhere : state_rule( StateId( state ), ch );
+    }
   }
+  return table;
+}
 
-  append_or_delete( tx.action, ret );
+constexpr TransitionTable transition_table = build_transition_table();
 
-  if ( tx.next_state != NULL ) {
-    append_or_delete( tx.next_state->enter(), ret );
-    state = tx.next_state;
+/* Negative code points behave like NUL, and everything from U+00A0 up
+   is parsed like 'A'. */
+inline wchar_t table_index( wchar_t ch )
+{
+  const int64_t code = ch; /* wchar_t may be unsigned */
+  if ( code < 0 ) {
+    return 0;
   }
+  return code >= TABLE_WIDTH ? 0x41 : ch;
 }
 
-Parser::UTF8Parser::UTF8Parser() : parser(), buf_len( 0 )
+template<size_t... I>
+std::array<ParserAction, sizeof...( I )> make_prototypes( std::index_sequence<I...> )
 {
-  assert( BUF_SIZE >= (size_t)MB_CUR_MAX );
-  buf[0] = '\0';
+  return { ParserAction( std::in_place_index<I> )... };
 }
 
-void Parser::UTF8Parser::input( char c, Actions& ret )
+const std::array<ParserAction, ACTION_COUNT> prototypes =
+  make_prototypes( std::make_index_sequence<ACTION_COUNT>() );
+
+inline void append( ActionCode code, Actions& ret )
+{
+  if ( code != IGNORE ) {
+    ret.push_back( prototypes[code] );
+  }
+}
+}
+
+void Parser::Parser::input( wchar_t ch, Actions& ret )
 {
-  assert( buf_len < BUF_SIZE );
+  const TableEntry& tx = transition_table.entries[state][table_index( ch )];
+
+  if ( tx.next != STATE_COUNT ) {
+    append( transition_table.exit_actions[state], ret );
+  }
+
+  if ( tx.action != IGNORE ) {
+    ret.push_back( prototypes[tx.action] );
+    Action& act = get_action( ret.back() );
+    act.char_present = true;
+    act.ch = ch;
+  }
+
+  if ( tx.next != STATE_COUNT ) {
+    append( transition_table.entry_actions[tx.next], ret );
+    state = tx.next;
+  }
+}
 
-  /* 1-byte UTF-8 character, aka ASCII?  Cheat. */
-  if ( buf_len == 0 && static_cast<unsigned char>( c ) <= 0x7f ) {
-    parser.input( static_cast<wchar_t>( c ), ret );
+Parser::UTF8Parser::UTF8Parser() : parser(), codepoint( 0 ), length( 0 ), remaining( 0 ) {}
+
+void Parser::UTF8Parser::start_sequence( unsigned char c, Actions& ret )
+{
+  /* Lead bytes as glibc accepts them, including the obsolete 5- and
+     6-byte forms; what they decode to is out of range and is replaced
+     in finish_sequence. */
+  if ( c < 0xC2 || c > 0xFD ) { /* stray continuation byte, overlong 2-byte lead, 0xFE, 0xFF */
+    parser.input( 0xFFFD, ret );
     return;
   }
 
-  buf[buf_len++] = c;
-
-  /* This function will only work in a UTF-8 locale. */
-  wchar_t pwc;
-  mbstate_t ps = mbstate_t();
-
-  size_t total_bytes_parsed = 0;
-  size_t orig_buf_len = buf_len;
-
-  /* this routine is somewhat complicated in order to comply with
-     Unicode 6.0, section 3.9, "Best Practices for using U+FFFD" */
-
-  while ( total_bytes_parsed != orig_buf_len ) {
-    assert( total_bytes_parsed < orig_buf_len );
-    assert( buf_len > 0 );
-    size_t bytes_parsed = mbrtowc( &pwc, buf, buf_len, &ps );
-
-    /* this returns 0 when n = 0! */
-
-    if ( bytes_parsed == 0 ) {
-      /* character was NUL, accept and clear buffer */
-      assert( buf_len == 1 );
-      buf_len = 0;
-      pwc = L'\0';
-      bytes_parsed = 1;
-    } else if ( bytes_parsed == (size_t)-1 ) {
-      /* invalid sequence, use replacement character and try again with last char */
-      assert( errno == EILSEQ );
-      if ( buf_len > 1 ) {
-        buf[0] = buf[buf_len - 1];
-        bytes_parsed = buf_len - 1;
-        buf_len = 1;
-      } else {
-        buf_len = 0;
-        bytes_parsed = 1;
-      }
-      pwc = (wchar_t)0xFFFD;
-    } else if ( bytes_parsed == (size_t)-2 ) {
-      /* can't parse incomplete multibyte character */
-      total_bytes_parsed += buf_len;
-      continue;
+  if ( c < 0xE0 ) {
+    length = 2;
+    codepoint = c & 0x1F;
+  } else if ( c < 0xF0 ) {
+    length = 3;
+    codepoint = c & 0x0F;
+  } else if ( c < 0xF8 ) {
+    length = 4;
+    codepoint = c & 0x07;
+  } else if ( c < 0xFC ) {
+    length = 5;
+    codepoint = c & 0x03;
+  } else {
+    length = 6;
+    codepoint = c & 0x01;
+  }
+  remaining = length - 1;
+}
+
+void Parser::UTF8Parser::finish_sequence( Actions& ret )
+{
+  static const uint32_t shortest[] = { 0, 0, 0x80, 0x800, 0x10000, 0x200000, 0x4000000 };
+
+  if ( codepoint < shortest[length] || ( codepoint >= 0xD800 && codepoint <= 0xDFFF ) ) {
+    /* overlong or surrogate: replace the sequence, then its final
+       continuation byte, which is invalid on its own */
+    parser.input( 0xFFFD, ret );
+    parser.input( 0xFFFD, ret );
+  } else if ( codepoint > 0x10FFFF ) { /* outside Unicode range */
+    parser.input( 0xFFFD, ret );
+  } else {
+    parser.input( static_cast<wchar_t>( codepoint ), ret );
+  }
+  length = 0;
+}
+
+void Parser::UTF8Parser::input( char c, Actions& ret )
+{
+  const unsigned char byte = c;
+
+  if ( remaining == 0 ) {
+    /* 1-byte UTF-8 character, aka ASCII?  Cheat. */
+    if ( byte <= 0x7f ) {
+      parser.input( static_cast<wchar_t>( byte ), ret );
     } else {
-      /* parsed into pwc, accept */
-      assert( bytes_parsed <= buf_len );
-      memmove( buf, buf + bytes_parsed, buf_len - bytes_parsed );
-      buf_len = buf_len - bytes_parsed;
+      start_sequence( byte, ret );
     }
+    return;
+  }
 
-    /* Cast to unsigned for checks, because some
-       platforms (e.g. ARM) use uint32_t as wchar_t,
-       causing compiler warning on "pwc > 0" check. */
-    const uint32_t pwcheck = pwc;
+  if ( ( byte & 0xC0 ) != 0x80 ) {
+    /* sequence cut short: replace it, then decode this byte afresh */
+    remaining = 0;
+    length = 0;
+    parser.input( 0xFFFD, ret );
+    input( c, ret );
+    return;
+  }
+
+  codepoint = ( codepoint << 6 ) | ( byte & 0x3F );
+  if ( --remaining == 0 ) {
+    finish_sequence( ret );
+  }
+}
 
-    if ( pwcheck > 0x10FFFF ) { /* outside Unicode range */
-      pwc = (wchar_t)0xFFFD;
+size_t Parser::UTF8Parser::printable_ascii_run( const char* s, size_t len )
+{
+  size_t i = 0;
+
+#if defined( __SSE2__ )
+  /* Signed compares: bytes >= 0x80 are negative and fail the lower bound. */
+  const __m128i below = _mm_set1_epi8( 0x1F );
+  const __m128i above = _mm_set1_epi8( 0x7F );
+  for ( ; i + 16 <= len; i += 16 ) {
+    const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( s + i ) );
+    const __m128i printable = _mm_and_si128( _mm_cmpgt_epi8( v, below ), _mm_cmplt_epi8( v, above ) );
+    const unsigned int mask = _mm_movemask_epi8( printable );
+    if ( mask != 0xFFFF ) {
+      return i + __builtin_ctz( ~mask );
     }
+  }
+#endif
 
-    if ( ( pwcheck >= 0xD800 ) && ( pwcheck <= 0xDFFF ) ) { /* surrogate code point */
-      /*
-        OS X unfortunately allows these sequences without EILSEQ, but
-        they are ill-formed UTF-8 and we shouldn't repeat them to the
-        user's terminal.
-      */
-      pwc = (wchar_t)0xFFFD;
+  while ( i < len ) {
+    const unsigned char c = s[i];
+    if ( c < 0x20 || c > 0x7E ) {
+      break;
     }
+    i++;
+  }
+  return i;
+}
+
+size_t Parser::UTF8Parser::input_printable_run( const char* s, size_t len, size_t max_chars, Actions& ret )
+{
+  assert( is_ground() );
 
-    parser.input( pwc, ret );
+  const unsigned char* in = reinterpret_cast<const unsigned char*>( s );
+  size_t i = 0;
 
-    total_bytes_parsed += bytes_parsed;
+#if defined( __SSE2__ )
+  /* Bound the run by the first ASCII byte, 16 at a time. */
+  size_t limit = 0;
+  while ( limit + 16 <= len ) {
+    const unsigned int high = _mm_movemask_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( s + limit ) ) );
+    if ( high != 0xFFFF ) {
+      limit += __builtin_ctz( ~high );
+      break;
+    }
+    limit += 16;
   }
-}
+  if ( limit + 16 > len ) {
+    while ( limit < len && in[limit] >= 0x80 ) {
+      limit++;
+    }
+  }
+  len = limit;
+#endif
 
-Parser::Parser::Parser( const Parser& other ) : state( other.state ) {}
+  /* Only the well-formed shortest forms of RFC 3629 are taken here;
+     everything else is left to input() and its replacement rules. */
+  for ( size_t chars = 0; chars < max_chars && i < len; chars++ ) {
+    const unsigned char b0 = in[i];
+    uint32_t cp;
+    size_t n;
+    if ( b0 < 0xC2 ) {
+      break; /* ASCII, continuation byte, or overlong 2-byte lead */
+    } else if ( b0 < 0xE0 ) {
+      if ( i + 2 > len || ( in[i + 1] & 0xC0 ) != 0x80 ) {
+        break;
+      }
+      cp = ( ( b0 & 0x1F ) << 6 ) | ( in[i + 1] & 0x3F );
+      if ( cp < 0xA0 ) {
+        break; /* C1 control */
+      }
+      n = 2;
+    } else if ( b0 < 0xF0 ) {
+      if ( i + 3 > len || ( ( in[i + 1] & 0xC0 ) != 0x80 ) || ( ( in[i + 2] & 0xC0 ) != 0x80 ) ) {
+        break;
+      }
+      cp = ( ( b0 & 0x0F ) << 12 ) | ( ( in[i + 1] & 0x3F ) << 6 ) | ( in[i + 2] & 0x3F );
+      if ( cp < 0x800 || ( cp >= 0xD800 && cp <= 0xDFFF ) ) {
+        break;
+      }
+      n = 3;
+    } else if ( b0 < 0xF5 ) {
+      if ( i + 4 > len || ( ( in[i + 1] & 0xC0 ) != 0x80 ) || ( ( in[i + 2] & 0xC0 ) != 0x80 )
+           || ( ( in[i + 3] & 0xC0 ) != 0x80 ) ) {
+        break;
+      }
+      cp = ( ( b0 & 0x07 ) << 18 ) | ( ( in[i + 1] & 0x3F ) << 12 ) | ( ( in[i + 2] & 0x3F ) << 6 )
+           | ( in[i + 3] & 0x3F );
+      if ( cp < 0x10000 || cp > 0x10FFFF ) {
+        break;
+      }
+      n = 4;
+    } else {
+      break;
+    }
 
-Parser::Parser& Parser::Parser::operator=( const Parser& other )
-{
-  state = other.state;
-  return *this;
+    /* what Parser::input() produces for a GL/GR character in ground */
+    Print act;
+    act.char_present = true;
+    act.ch = static_cast<wchar_t>( cp );
+    ret.push_back( act );
+    i += n;
+  }
+
+  return i;
 }
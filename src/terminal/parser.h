@@ -36,54 +36,90 @@
 /* Based on Paul Williams's parser,
    http://www.vt100.net/emu/dec_ansi_parser */
 
+#include <cstdint>
 #include <cstring>
 #include <cwchar>
 
-#include "parserstate.h"
-#include "parserstatefamily.h"
-#include "parsertransition.h"
 #include "src/terminal/parseraction.h"
 
 namespace Parser {
-extern const StateFamily family;
+/* States of the DEC ANSI parser, indexing its transition tables. */
+enum StateId : uint8_t
+{
+  GROUND,
+  ESCAPE,
+  ESCAPE_INTERMEDIATE,
+  CSI_ENTRY,
+  CSI_PARAM,
+  CSI_INTERMEDIATE,
+  CSI_IGNORE,
+  DCS_ENTRY,
+  DCS_PARAM,
+  DCS_INTERMEDIATE,
+  DCS_PASSTHROUGH,
+  DCS_IGNORE,
+  OSC_STRING,
+  SOS_PM_APC_STRING,
+  STATE_COUNT
+};
 
 class Parser
 {
 private:
-  State const* state;
+  StateId state;
 
 public:
-  Parser() : state( &family.s_Ground ) {}
-
-  Parser( const Parser& other );
-  Parser& operator=( const Parser& );
-  ~Parser() {}
+  Parser() : state( GROUND ) {}
 
   void input( wchar_t ch, Actions& actions );
 
-  void reset_input( void ) { state = &family.s_Ground; }
-};
+  void reset_input( void ) { state = GROUND; }
 
-static const size_t BUF_SIZE = 8;
+  bool is_ground( void ) const { return state == GROUND; }
+};
 
+/* Locale-independent UTF-8 decoder feeding a Parser.  Malformed input
+   becomes U+FFFD with the same granularity as glibc's mbrtowc, which
+   this replaces: an unexpected byte ends the pending sequence and is
+   then decoded afresh, and an overlong or surrogate sequence is only
+   rejected once complete, after which its last byte is reconsidered. */
 class UTF8Parser
 {
 private:
   Parser parser;
 
-  char buf[BUF_SIZE];
-  size_t buf_len;
+  uint32_t codepoint;     /* accumulated bits of the pending sequence */
+  unsigned int length;    /* length of the pending sequence, 0 if none */
+  unsigned int remaining; /* continuation bytes still expected */
+
+  void start_sequence( unsigned char c, Actions& actions );
+  void finish_sequence( Actions& actions );
 
 public:
   UTF8Parser();
 
   void input( char c, Actions& actions );
 
+  /* In the ground state, a printable ASCII byte only ever produces a
+     Print action, so a caller may hand a whole run of them to the
+     emulator at once. */
+  bool is_ground( void ) const { return remaining == 0 && parser.is_ground(); }
+
+  /* Length of the leading run of printable ASCII (0x20-0x7E) in s. */
+  static size_t printable_ascii_run( const char* s, size_t len );
+
+  /* In the ground state, append Print actions for the leading run of
+     well-formed multibyte characters at or above U+00A0, stopping at
+     ASCII, C1 controls, anything malformed or truncated, or after
+     max_chars characters.  Returns the number of bytes consumed. */
+  size_t input_printable_run( const char* s, size_t len, size_t max_chars, Actions& actions );
+
   void reset_input( void )
   {
     parser.reset_input();
-    buf[0] = '\0';
-    buf_len = 0;
+    codepoint = 0;
+    length = 0;
+    remaining = 0;
   }
 };
 }
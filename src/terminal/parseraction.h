@@ -33,8 +33,9 @@
 #ifndef PARSERACTION_HPP
 #define PARSERACTION_HPP
 
-#include <memory>
+#include <cstdint>
 #include <string>
+#include <variant>
 #include <vector>
 
 namespace Terminal {
@@ -48,7 +49,7 @@ public:
   wchar_t ch;
   bool char_present;
 
-  virtual std::string name( void ) = 0;
+  virtual std::string name( void ) const = 0;
 
   virtual void act_on_terminal( Terminal::Emulator* ) const {};
 
@@ -58,98 +59,129 @@ public:
   virtual ~Action() {};
 };
 
-using ActionPointer = std::shared_ptr<Action>;
-using Actions = std::vector<ActionPointer>;
-
-class Ignore : public Action
+class Ignore final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Ignore" ); }
+  std::string name( void ) const { return std::string( "Ignore" ); }
   bool ignore() const { return true; }
 };
-class Print : public Action
+class Print final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Print" ); }
+  std::string name( void ) const { return std::string( "Print" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
-class Execute : public Action
+class Execute final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Execute" ); }
+  std::string name( void ) const { return std::string( "Execute" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
-class Clear : public Action
+class Clear final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Clear" ); }
+  std::string name( void ) const { return std::string( "Clear" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
-class Collect : public Action
+class Collect final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Collect" ); }
+  std::string name( void ) const { return std::string( "Collect" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
-class Param : public Action
+class Param final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Param" ); }
+  std::string name( void ) const { return std::string( "Param" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
-class Esc_Dispatch : public Action
+class Esc_Dispatch final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Esc_Dispatch" ); }
+  std::string name( void ) const { return std::string( "Esc_Dispatch" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
-class CSI_Dispatch : public Action
+class CSI_Dispatch final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "CSI_Dispatch" ); }
+  std::string name( void ) const { return std::string( "CSI_Dispatch" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
-class Hook : public Action
+class Hook final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Hook" ); }
+  std::string name( void ) const { return std::string( "Hook" ); }
 };
-class Put : public Action
+class Put final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Put" ); }
+  std::string name( void ) const { return std::string( "Put" ); }
 };
-class Unhook : public Action
+class Unhook final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "Unhook" ); }
+  std::string name( void ) const { return std::string( "Unhook" ); }
 };
-class OSC_Start : public Action
+class OSC_Start final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "OSC_Start" ); }
+  std::string name( void ) const { return std::string( "OSC_Start" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
-class OSC_Put : public Action
+class OSC_Put final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "OSC_Put" ); }
+  std::string name( void ) const { return std::string( "OSC_Put" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
-class OSC_End : public Action
+class OSC_End final : public Action
 {
 public:
-  std::string name( void ) { return std::string( "OSC_End" ); }
+  std::string name( void ) const { return std::string( "OSC_End" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 };
 
+/* The host-source state machine emits its actions by value, so parsing
+   never touches the heap once the caller's Actions vector has grown. */
+using ParserAction = std::variant<Ignore,
+                                  Print,
+                                  Execute,
+                                  Clear,
+                                  Collect,
+                                  Param,
+                                  Esc_Dispatch,
+                                  CSI_Dispatch,
+                                  Hook,
+                                  Put,
+                                  Unhook,
+                                  OSC_Start,
+                                  OSC_Put,
+                                  OSC_End>;
+using Actions = std::vector<ParserAction>;
+
+inline const Action& get_action( const ParserAction& act )
+{
+  return std::visit( []( const Action& a ) -> const Action& { return a; }, act );
+}
+
+inline Action& get_action( ParserAction& act )
+{
+  return std::visit( []( Action& a ) -> Action& { return a; }, act );
+}
+
+/* Statically dispatched, so the final action types are called directly. */
+inline void act_on_terminal( const ParserAction& act, Terminal::Emulator* emu )
+{
+  std::visit( [emu]( const auto& a ) { a.act_on_terminal( emu ); }, act );
+}
+
 class UserByte : public Action
 {
   /* user keystroke -- not part of the host-source state machine*/
 public:
   char c; /* The user-source byte. We don't try to interpret the charset */
 
-  std::string name( void ) { return std::string( "UserByte" ); }
+  std::string name( void ) const { return std::string( "UserByte" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 
   UserByte( int s_c ) : c( s_c ) {}
@@ -163,13 +195,28 @@ class Resize : public Action
 public:
   size_t width, height;
 
-  std::string name( void ) { return std::string( "Resize" ); }
+  std::string name( void ) const { return std::string( "Resize" ); }
   void act_on_terminal( Terminal::Emulator* emu ) const;
 
   Resize( size_t s_width, size_t s_height ) : width( s_width ), height( s_height ) {}
 
   bool operator==( const Resize& other ) const { return ( width == other.width ) && ( height == other.height ); }
 };
+
+class ScrollbackRequest : public Action
+{
+  /* request for lines of the server's scrollback -- not part of the
+     host-source state machine; the server answers it, not the terminal */
+public:
+  uint64_t end; /* number of the line after the last one wanted, or 0 for the newest */
+  uint32_t count;
+
+  std::string name( void ) const { return std::string( "ScrollbackRequest" ); }
+
+  ScrollbackRequest( uint64_t s_end, uint32_t s_count ) : end( s_end ), count( s_count ) {}
+
+  bool operator==( const ScrollbackRequest& other ) const { return ( end == other.end ) && ( count == other.count ); }
+};
 }
 
 #endif
@@ -0,0 +1,65 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+#ifndef PARSERREFERENCE_HPP
+#define PARSERREFERENCE_HPP
+
+#include "parserstate.h"
+#include "parserstatefamily.h"
+#include "parsertransition.h"
+#include "src/terminal/parseraction.h"
+
+namespace Parser {
+extern const StateFamily family;
+
+/* The original state-object form of the parser, with one class per
+   state and the transition rules written out as code.  Parser compiles
+   the same rules into tables; this is kept as the reference it is
+   checked against. */
+class ReferenceParser
+{
+private:
+  State const* state;
+
+public:
+  ReferenceParser() : state( &family.s_Ground ) {}
+
+  void input( wchar_t ch, Actions& actions );
+
+  void reset_input( void ) { state = &family.s_Ground; }
+
+  bool is_ground( void ) const { return state == &family.s_Ground; }
+};
+}
+
+#endif
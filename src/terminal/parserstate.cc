@@ -30,18 +30,42 @@
     also delete it here.
 */
 
-#include <memory>
-
+#include "parserreference.h"
 #include "parserstate.h"
 #include "parserstatefamily.h"
 
 using namespace Parser;
 
+const StateFamily Parser::family;
+
+static void append_or_delete( const ParserAction& act, Actions& vec )
+{
+  if ( !std::holds_alternative<Ignore>( act ) ) {
+    vec.push_back( act );
+  }
+}
+
+void ReferenceParser::input( wchar_t ch, Actions& ret )
+{
+  Transition tx = state->input( ch );
+
+  if ( tx.next_state != NULL ) {
+    append_or_delete( state->exit(), ret );
+  }
+
+  append_or_delete( tx.action, ret );
+
+  if ( tx.next_state != NULL ) {
+    append_or_delete( tx.next_state->enter(), ret );
+    state = tx.next_state;
+  }
+}
+
 Transition State::anywhere_rule( wchar_t ch ) const
 {
   if ( ( ch == 0x18 ) || ( ch == 0x1A ) || ( ( 0x80 <= ch ) && ( ch <= 0x8F ) )
        || ( ( 0x91 <= ch ) && ( ch <= 0x97 ) ) || ( ch == 0x99 ) || ( ch == 0x9A ) ) {
-    return Transition( std::make_shared<Execute>(), &family->s_Ground );
+    return Transition( Execute(), &family->s_Ground );
   } else if ( ch == 0x9C ) {
     return Transition( &family->s_Ground );
   } else if ( ch == 0x1B ) {
@@ -56,7 +80,7 @@ Transition State::anywhere_rule( wchar_t ch ) const
     return Transition( &family->s_CSI_Entry );
   }
 
-  return Transition( (State*)NULL, ActionPointer() ); /* don't allocate an Ignore action */
+  return Transition( (State*)NULL );
 }
 
 Transition State::input( wchar_t ch ) const
@@ -64,15 +88,17 @@ Transition State::input( wchar_t ch ) const
   /* Check for immediate transitions. */
   Transition anywhere = anywhere_rule( ch );
   if ( anywhere.next_state ) {
-    anywhere.action->char_present = true;
-    anywhere.action->ch = ch;
+    Action& act = get_action( anywhere.action );
+    act.char_present = true;
+    act.ch = ch;
     return anywhere;
   }
   /* Normal X.364 state machine. */
   /* Parse high Unicode codepoints like 'A'. */
   Transition ret = this->input_state_rule( ch >= 0xA0 ? 0x41 : ch );
-  ret.action->char_present = true;
-  ret.action->ch = ch;
+  Action& act = get_action( ret.action );
+  act.char_present = true;
+  act.ch = ch;
   return ret;
 }
 
@@ -90,34 +116,34 @@ static bool GLGR( wchar_t ch )
 Transition Ground::input_state_rule( wchar_t ch ) const
 {
   if ( C0_prime( ch ) ) {
-    return Transition( std::make_shared<Execute>() );
+    return Transition( Execute() );
   }
 
   if ( GLGR( ch ) ) {
-    return Transition( std::make_shared<Print>() );
+    return Transition( Print() );
   }
 
   return Transition();
 }
 
-ActionPointer Escape::enter( void ) const
+ParserAction Escape::enter( void ) const
 {
-  return std::make_shared<Clear>();
+  return Clear();
 }
 
 Transition Escape::input_state_rule( wchar_t ch ) const
 {
   if ( C0_prime( ch ) ) {
-    return Transition( std::make_shared<Execute>() );
+    return Transition( Execute() );
   }
 
   if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
-    return Transition( std::make_shared<Collect>(), &family->s_Escape_Intermediate );
+    return Transition( Collect(), &family->s_Escape_Intermediate );
   }
 
   if ( ( ( 0x30 <= ch ) && ( ch <= 0x4F ) ) || ( ( 0x51 <= ch ) && ( ch <= 0x57 ) ) || ( ch == 0x59 )
        || ( ch == 0x5A ) || ( ch == 0x5C ) || ( ( 0x60 <= ch ) && ( ch <= 0x7E ) ) ) {
-    return Transition( std::make_shared<Esc_Dispatch>(), &family->s_Ground );
+    return Transition( Esc_Dispatch(), &family->s_Ground );
   }
 
   if ( ch == 0x5B ) {
@@ -142,49 +168,45 @@ Transition Escape::input_state_rule( wchar_t ch ) const
 Transition Escape_Intermediate::input_state_rule( wchar_t ch ) const
 {
   if ( C0_prime( ch ) ) {
-    return Transition( std::make_shared<Execute>() );
+    return Transition( Execute() );
   }
 
   if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
-    return Transition( std::make_shared<Collect>() );
+    return Transition( Collect() );
   }
 
   if ( ( 0x30 <= ch ) && ( ch <= 0x7E ) ) {
-    return Transition( std::make_shared<Esc_Dispatch>(), &family->s_Ground );
+    return Transition( Esc_Dispatch(), &family->s_Ground );
   }
 
   return Transition();
 }
 
-ActionPointer CSI_Entry::enter( void ) const
+ParserAction CSI_Entry::enter( void ) const
 {
-  return std::make_shared<Clear>();
+  return Clear();
 }
 
 Transition CSI_Entry::input_state_rule( wchar_t ch ) const
 {
   if ( C0_prime( ch ) ) {
-    return Transition( std::make_shared<Execute>() );
+    return Transition( Execute() );
   }
 
   if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
-    return Transition( std::make_shared<CSI_Dispatch>(), &family->s_Ground );
+    return Transition( CSI_Dispatch(), &family->s_Ground );
   }
 
-  if ( ( ( 0x30 <= ch ) && ( ch <= 0x39 ) ) || ( ch == 0x3B ) ) {
-    return Transition( std::make_shared<Param>(), &family->s_CSI_Param );
+  if ( ( 0x30 <= ch ) && ( ch <= 0x3B ) ) { /* ':' separates sub-parameters */
+    return Transition( Param(), &family->s_CSI_Param );
   }
 
   if ( ( 0x3C <= ch ) && ( ch <= 0x3F ) ) {
-    return Transition( std::make_shared<Collect>(), &family->s_CSI_Param );
-  }
-
-  if ( ch == 0x3A ) {
-    return Transition( &family->s_CSI_Ignore );
+    return Transition( Collect(), &family->s_CSI_Param );
   }
 
   if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
-    return Transition( std::make_shared<Collect>(), &family->s_CSI_Intermediate );
+    return Transition( Collect(), &family->s_CSI_Intermediate );
   }
 
   return Transition();
@@ -193,23 +215,23 @@ Transition CSI_Entry::input_state_rule( wchar_t ch ) const
 Transition CSI_Param::input_state_rule( wchar_t ch ) const
 {
   if ( C0_prime( ch ) ) {
-    return Transition( std::make_shared<Execute>() );
+    return Transition( Execute() );
   }
 
-  if ( ( ( 0x30 <= ch ) && ( ch <= 0x39 ) ) || ( ch == 0x3B ) ) {
-    return Transition( std::make_shared<Param>() );
+  if ( ( 0x30 <= ch ) && ( ch <= 0x3B ) ) {
+    return Transition( Param() );
   }
 
-  if ( ( ch == 0x3A ) || ( ( 0x3C <= ch ) && ( ch <= 0x3F ) ) ) {
+  if ( ( 0x3C <= ch ) && ( ch <= 0x3F ) ) {
     return Transition( &family->s_CSI_Ignore );
   }
 
   if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
-    return Transition( std::make_shared<Collect>(), &family->s_CSI_Intermediate );
+    return Transition( Collect(), &family->s_CSI_Intermediate );
   }
 
   if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
-    return Transition( std::make_shared<CSI_Dispatch>(), &family->s_Ground );
+    return Transition( CSI_Dispatch(), &family->s_Ground );
   }
 
   return Transition();
@@ -218,15 +240,15 @@ Transition CSI_Param::input_state_rule( wchar_t ch ) const
 Transition CSI_Intermediate::input_state_rule( wchar_t ch ) const
 {
   if ( C0_prime( ch ) ) {
-    return Transition( std::make_shared<Execute>() );
+    return Transition( Execute() );
   }
 
   if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
-    return Transition( std::make_shared<Collect>() );
+    return Transition( Collect() );
   }
 
   if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
-    return Transition( std::make_shared<CSI_Dispatch>(), &family->s_Ground );
+    return Transition( CSI_Dispatch(), &family->s_Ground );
   }
 
   if ( ( 0x30 <= ch ) && ( ch <= 0x3F ) ) {
@@ -239,7 +261,7 @@ Transition CSI_Intermediate::input_state_rule( wchar_t ch ) const
 Transition CSI_Ignore::input_state_rule( wchar_t ch ) const
 {
   if ( C0_prime( ch ) ) {
-    return Transition( std::make_shared<Execute>() );
+    return Transition( Execute() );
   }
 
   if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
@@ -249,15 +271,15 @@ Transition CSI_Ignore::input_state_rule( wchar_t ch ) const
   return Transition();
 }
 
-ActionPointer DCS_Entry::enter( void ) const
+ParserAction DCS_Entry::enter( void ) const
 {
-  return std::make_shared<Clear>();
+  return Clear();
 }
 
 Transition DCS_Entry::input_state_rule( wchar_t ch ) const
 {
   if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
-    return Transition( std::make_shared<Collect>(), &family->s_DCS_Intermediate );
+    return Transition( Collect(), &family->s_DCS_Intermediate );
   }
 
   if ( ch == 0x3A ) {
@@ -265,11 +287,11 @@ Transition DCS_Entry::input_state_rule( wchar_t ch ) const
   }
 
   if ( ( ( 0x30 <= ch ) && ( ch <= 0x39 ) ) || ( ch == 0x3B ) ) {
-    return Transition( std::make_shared<Param>(), &family->s_DCS_Param );
+    return Transition( Param(), &family->s_DCS_Param );
   }
 
   if ( ( 0x3C <= ch ) && ( ch <= 0x3F ) ) {
-    return Transition( std::make_shared<Collect>(), &family->s_DCS_Param );
+    return Transition( Collect(), &family->s_DCS_Param );
   }
 
   if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
@@ -282,7 +304,7 @@ Transition DCS_Entry::input_state_rule( wchar_t ch ) const
 Transition DCS_Param::input_state_rule( wchar_t ch ) const
 {
   if ( ( ( 0x30 <= ch ) && ( ch <= 0x39 ) ) || ( ch == 0x3B ) ) {
-    return Transition( std::make_shared<Param>() );
+    return Transition( Param() );
   }
 
   if ( ( ch == 0x3A ) || ( ( 0x3C <= ch ) && ( ch <= 0x3F ) ) ) {
@@ -290,7 +312,7 @@ Transition DCS_Param::input_state_rule( wchar_t ch ) const
   }
 
   if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
-    return Transition( std::make_shared<Collect>(), &family->s_DCS_Intermediate );
+    return Transition( Collect(), &family->s_DCS_Intermediate );
   }
 
   if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
@@ -303,7 +325,7 @@ Transition DCS_Param::input_state_rule( wchar_t ch ) const
 Transition DCS_Intermediate::input_state_rule( wchar_t ch ) const
 {
   if ( ( 0x20 <= ch ) && ( ch <= 0x2F ) ) {
-    return Transition( std::make_shared<Collect>() );
+    return Transition( Collect() );
   }
 
   if ( ( 0x40 <= ch ) && ( ch <= 0x7E ) ) {
@@ -317,20 +339,20 @@ Transition DCS_Intermediate::input_state_rule( wchar_t ch ) const
   return Transition();
 }
 
-ActionPointer DCS_Passthrough::enter( void ) const
+ParserAction DCS_Passthrough::enter( void ) const
 {
-  return std::make_shared<Hook>();
+  return Hook();
 }
 
-ActionPointer DCS_Passthrough::exit( void ) const
+ParserAction DCS_Passthrough::exit( void ) const
 {
-  return std::make_shared<Unhook>();
+  return Unhook();
 }
 
 Transition DCS_Passthrough::input_state_rule( wchar_t ch ) const
 {
   if ( C0_prime( ch ) || ( ( 0x20 <= ch ) && ( ch <= 0x7E ) ) ) {
-    return Transition( std::make_shared<Put>() );
+    return Transition( Put() );
   }
 
   if ( ch == 0x9C ) {
@@ -349,20 +371,20 @@ Transition DCS_Ignore::input_state_rule( wchar_t ch ) const
   return Transition();
 }
 
-ActionPointer OSC_String::enter( void ) const
+ParserAction OSC_String::enter( void ) const
 {
-  return std::make_shared<OSC_Start>();
+  return OSC_Start();
 }
 
-ActionPointer OSC_String::exit( void ) const
+ParserAction OSC_String::exit( void ) const
 {
-  return std::make_shared<OSC_End>();
+  return OSC_End();
 }
 
 Transition OSC_String::input_state_rule( wchar_t ch ) const
 {
   if ( ( 0x20 <= ch ) && ( ch <= 0x7F ) ) {
-    return Transition( std::make_shared<OSC_Put>() );
+    return Transition( OSC_Put() );
   }
 
   if ( ( ch == 0x9C ) || ( ch == 0x07 ) ) { /* 0x07 is xterm non-ANSI variant */
@@ -43,9 +43,7 @@ class State;
 class Transition
 {
 public:
-  // Transition is only a courier for an Action; it should
-  // never create/delete one on its own.
-  ActionPointer action;
+  ParserAction action;
   State* next_state;
 
   Transition( const Transition& x ) : action( x.action ), next_state( x.next_state ) {}
@@ -56,14 +54,11 @@ public:
 
     return *this;
   }
-  Transition( ActionPointer s_action = std::make_shared<Ignore>(), State* s_next_state = NULL )
+  Transition( ParserAction s_action = Ignore(), State* s_next_state = NULL )
     : action( s_action ), next_state( s_next_state )
   {}
 
-  // This is only ever used in the 1-argument form;
-  // we use this instead of an initializer to
-  // tell Coverity the object never owns *action.
-  Transition( State* s_next_state, ActionPointer s_action = std::make_shared<Ignore>() )
+  Transition( State* s_next_state, ParserAction s_action = Ignore() )
     : action( s_action ), next_state( s_next_state )
   {}
 };
@@ -30,6 +30,7 @@
     also delete it here.
 */
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
@@ -37,11 +38,14 @@
 
 #include <unistd.h>
 
+#include "src/terminal/charwidth.h"
 #include "src/terminal/terminal.h"
 
 using namespace Terminal;
 
-Emulator::Emulator( size_t s_width, size_t s_height ) : fb( s_width, s_height ), dispatch(), user() {}
+Emulator::Emulator( size_t s_width, size_t s_height )
+  : fb( s_width, s_height ), dispatch(), user(), last_graphic( 0 )
+{}
 
 std::string Emulator::read_octets_to_host( void )
 {
@@ -61,58 +65,51 @@ void Emulator::print( const Parser::Print* act )
 
   const wchar_t ch = act->ch;
 
-  /*
-   * Check for printing ISO 8859-1 first, it's a cheap way to detect
-   * some common narrow characters.
-   */
-  const int chwidth = ch == L'\0' ? -1 : ( Cell::isprint_iso8859_1( ch ) ? 1 : wcwidth( ch ) );
-
-  Cell* this_cell = fb.get_mutable_cell();
+  const int chwidth = ch == L'\0' ? -1 : char_width( ch );
 
   switch ( chwidth ) {
     case 1: /* normal character */
     case 2: /* wide character */
       if ( fb.ds.auto_wrap_mode && fb.ds.next_print_will_wrap ) {
-        fb.get_mutable_row( -1 )->set_wrap( true );
+        fb.get_mutable_cell( -1, fb.ds.get_width() - 1 )->set_wrap( true );
         fb.ds.move_col( 0 );
         fb.move_rows_autoscroll( 1 );
-        this_cell = NULL;
       } else if ( fb.ds.auto_wrap_mode && ( chwidth == 2 )
                   && ( fb.ds.get_cursor_col() == fb.ds.get_width() - 1 ) ) {
         /* wrap 2-cell chars if no room, even without will-wrap flag */
-        fb.reset_cell( this_cell );
-        fb.get_mutable_row( -1 )->set_wrap( false );
+        fb.reset_cell();
+        fb.get_mutable_cell( -1, fb.ds.get_width() - 1 )->set_wrap( false );
         /* There doesn't seem to be a consistent way to get the
            downstream terminal emulator to set the wrap-around
            copy-and-paste flag on a row that ends with an empty cell
            because a wide char was wrapped to the next line. */
         fb.ds.move_col( 0 );
         fb.move_rows_autoscroll( 1 );
-        this_cell = NULL;
       }
 
       if ( fb.ds.insert_mode ) {
         for ( int i = 0; i < chwidth; i++ ) {
           fb.insert_cell( fb.ds.get_cursor_row(), fb.ds.get_cursor_col() );
         }
-        this_cell = NULL;
       }
 
-      if ( !this_cell ) {
-        this_cell = fb.get_mutable_cell();
+      {
+        const int col = fb.ds.get_cursor_col();
+        Row* row = fb.get_mutable_row( -1, col, col + 1 );
+        Cell& this_cell = row->cells.at( col );
+        this_cell.reset();
+        this_cell.append( ch );
+        this_cell.set_wide( chwidth == 2 ); /* chwidth had better be 1 or 2 here */
+        row->set_renditions( col, fb.ds.get_renditions() );
       }
 
-      fb.reset_cell( this_cell );
-      this_cell->append( ch );
-      this_cell->set_wide( chwidth == 2 ); /* chwidth had better be 1 or 2 here */
-      fb.apply_renditions_to_cell( this_cell );
-
       if ( chwidth == 2 && fb.ds.get_cursor_col() + 1 < fb.ds.get_width() ) { /* erase overlapped cell */
-        fb.reset_cell( fb.get_mutable_cell( fb.ds.get_cursor_row(), fb.ds.get_cursor_col() + 1 ) );
+        fb.reset_cell( fb.ds.get_cursor_row(), fb.ds.get_cursor_col() + 1 );
       }
 
       fb.ds.move_col( chwidth, true, true );
 
+      last_graphic = ch;
       break;
     case 0: /* combining character */
     {
@@ -138,13 +135,118 @@ void Emulator::print( const Parser::Print* act )
     case -1: /* unprintable character */
       break;
     default:
-      assert( !"unexpected character width from wcwidth()" );
+      assert( !"unexpected character width from char_width()" );
       break;
   }
 }
 
+void Emulator::print_ascii_run( const char* s, size_t len )
+{
+  if ( len == 0 ) {
+    return;
+  }
+  const wchar_t last = static_cast<unsigned char>( s[len - 1] );
+
+  while ( len > 0 ) {
+    if ( fb.ds.next_print_will_wrap ) {
+      if ( fb.ds.auto_wrap_mode ) {
+        fb.get_mutable_cell( -1, fb.ds.get_width() - 1 )->set_wrap( true );
+        fb.ds.move_col( 0 );
+        fb.move_rows_autoscroll( 1 );
+      } else {
+        /* without autowrap, everything lands in the last column */
+        s += len - 1;
+        len = 1;
+      }
+    }
+
+    /* In insert mode every character shifts the rest of the row, and a
+       cursor outside the origin-mode region snaps back after the first
+       character; take the slow path for one character. */
+    const int cursor_row = fb.ds.get_cursor_row();
+    if ( fb.ds.insert_mode || cursor_row < fb.ds.limit_top() || cursor_row > fb.ds.limit_bottom() ) {
+      Parser::Print act;
+      act.char_present = true;
+      act.ch = static_cast<unsigned char>( *s );
+      print( &act );
+      s++;
+      len--;
+      continue;
+    }
+
+    const int col = fb.ds.get_cursor_col();
+    const size_t n = std::min( len, static_cast<size_t>( fb.ds.get_width() - col ) );
+    const Renditions& renditions = fb.ds.get_renditions();
+
+    Row* row = fb.get_mutable_row( -1, col, col + static_cast<int>( n ) );
+    for ( size_t i = 0; i < n; i++ ) {
+      Cell& cell = row->cells[col + i];
+      cell.reset();
+      cell.append( s[i] );
+      row->set_renditions( col + i, renditions );
+    }
+
+    /* Leave the cursor, combining-character position and wrap flag
+       exactly where n single-character moves would have. */
+    if ( n > 1 ) {
+      fb.ds.move_col( n - 1, true, true );
+    }
+    fb.ds.move_col( 1, true, true );
+
+    s += n;
+    len -= n;
+  }
+
+  last_graphic = last;
+}
+
+/* REP: print the last graphic character count more times.  Past a
+   point, more repetitions change nothing on the screen: without
+   autowrap they overwrite the last column, and with it they only fill
+   the rows that scroll through again with the same character.  The
+   count is cut to that point, keeping the remainder that decides where
+   the cursor ends up, so a hostile count costs no more than a screen. */
+void Emulator::repeat( int count )
+{
+  if ( last_graphic == 0 ) {
+    return;
+  }
+  const int width = fb.ds.get_width();
+  if ( !fb.ds.auto_wrap_mode ) {
+    count = std::min( count, width - fb.ds.get_cursor_col() + 1 );
+  } else {
+    const int per_row = std::max( 1, width / char_width( last_graphic ) );
+    const int limit = width + ( fb.ds.get_height() + 1 ) * per_row;
+    if ( count > limit ) {
+      count = limit + ( count - limit ) % per_row;
+    }
+  }
+  if ( last_graphic < 0x80 ) {
+    const std::string run( count, static_cast<char>( last_graphic ) );
+    print_ascii_run( run.data(), run.size() );
+    return;
+  }
+  Parser::Print act;
+  act.char_present = true;
+  act.ch = last_graphic;
+  for ( int i = 0; i < count; i++ ) {
+    print( &act );
+  }
+}
+
 void Emulator::CSI_dispatch( const Parser::CSI_Dispatch* act )
 {
+  /* Only the emulator knows what was printed last, so REP is handled
+     here rather than by a dispatch function. */
+  if ( act->ch == L'b' && dispatch.get_dispatch_chars().empty() ) {
+    for ( int i = 0; i < dispatch.param_count(); i++ ) {
+      if ( dispatch.is_subparam( i ) ) {
+        return; /* as if the sequence had gone to CSI_Ignore */
+      }
+    }
+    repeat( dispatch.getparam( 0, 1 ) );
+    return;
+  }
   dispatch.dispatch( CSI, act, &fb );
 }
 
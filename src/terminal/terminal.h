@@ -66,8 +66,11 @@ private:
   Dispatcher dispatch;
   UserInput user;
 
+  wchar_t last_graphic; /* the character REP repeats; 0 until one is printed */
+
   /* action methods */
   void print( const Parser::Print* act );
+  void repeat( int count );
   void execute( const Parser::Execute* act );
   void CSI_dispatch( const Parser::CSI_Dispatch* act );
   void Esc_dispatch( const Parser::Esc_Dispatch* act );
@@ -79,7 +82,12 @@ public:
 
   std::string read_octets_to_host( void );
 
+  /* Print a run of printable ASCII; same effect as a Print action per byte. */
+  void print_ascii_run( const char* s, size_t len );
+
   const Framebuffer& get_fb( void ) const { return fb; }
+  void share_row( int row, const Emulator& other ) { fb.share_row( row, other.fb ); }
+  void set_scrollback( Scrollback* scrollback ) { fb.set_scrollback( scrollback ); }
 
   bool operator==( Emulator const& x ) const;
 };
@@ -31,7 +31,6 @@
 */
 
 #include <cassert>
-#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -45,18 +44,52 @@ using namespace Terminal;
 static const size_t MAXIMUM_CLIPBOARD_SIZE = 16 * 1024;
 
 Dispatcher::Dispatcher()
-  : params(), parsed_params(), parsed( false ), dispatch_chars(), OSC_string(), terminal_to_host()
-{}
+  : params(),
+    subparams(),
+    params_length( 0 ),
+    param_chars( 0 ),
+    has_subparams( false ),
+    dispatch_chars(),
+    OSC_string(),
+    terminal_to_host()
+{
+  clear_params();
+}
+
+void Dispatcher::clear_params( void )
+{
+  params[0] = -1;
+  subparams[0] = false;
+  params_length = 1;
+  param_chars = 0;
+  has_subparams = false;
+}
 
 void Dispatcher::newparamchar( const Parser::Param* act )
 {
   assert( act->char_present );
-  assert( ( act->ch == ';' ) || ( ( act->ch >= '0' ) && ( act->ch <= '9' ) ) );
-  if ( params.length() < 100 ) {
-    /* enough for 16 five-char params plus 15 semicolons */
-    params.push_back( act->ch );
+  const wchar_t ch = act->ch;
+  assert( ( ch == ';' ) || ( ch == ':' ) || ( ( ch >= '0' ) && ( ch <= '9' ) ) );
+  if ( param_chars >= MAX_PARAM_CHARS ) {
+    return;
+  }
+  param_chars++;
+
+  if ( ( ch == ';' ) || ( ch == ':' ) ) {
+    params[params_length] = -1;
+    subparams[params_length] = ( ch == ':' );
+    params_length++;
+    has_subparams |= ( ch == ':' );
+    return;
+  }
+
+  int& val = params[params_length - 1];
+  if ( val < 0 ) {
+    val = 0;
+  }
+  if ( val <= PARAM_MAX ) {
+    val = val * 10 + ( ch - '0' );
   }
-  parsed = false;
 }
 
 void Dispatcher::collect( const Parser::Collect* act )
@@ -70,126 +103,107 @@ void Dispatcher::collect( const Parser::Collect* act )
 
 void Dispatcher::clear( const Parser::Clear* act __attribute( ( unused ) ) )
 {
-  params.clear();
+  clear_params();
   dispatch_chars.clear();
-  parsed = false;
 }
 
-void Dispatcher::parse_params( void )
+std::string Dispatcher::str( void )
 {
-  if ( parsed ) {
-    return;
-  }
-
-  parsed_params.clear();
-  const char* str = params.c_str();
-  const char* segment_begin = str;
-
-  while ( 1 ) {
-    const char* segment_end = strchr( segment_begin, ';' );
-    if ( segment_end == NULL ) {
-      break;
+  std::string param_string;
+  for ( int i = 0; i < params_length; i++ ) {
+    if ( i > 0 ) {
+      param_string.push_back( subparams[i] ? ':' : ';' );
     }
-
-    errno = 0;
-    char* endptr;
-    long val = strtol( segment_begin, &endptr, 10 );
-    if ( endptr == segment_begin ) {
-      val = -1;
+    if ( params[i] >= 0 ) {
+      param_string += std::to_string( params[i] );
     }
-
-    if ( val > PARAM_MAX || errno == ERANGE ) {
-      val = -1;
-      errno = 0;
-    }
-
-    if ( errno == 0 || segment_begin == endptr ) {
-      parsed_params.push_back( val );
-    }
-
-    segment_begin = segment_end + 1;
-  }
-
-  /* get last param */
-  errno = 0;
-  char* endptr;
-  long val = strtol( segment_begin, &endptr, 10 );
-  if ( endptr == segment_begin ) {
-    val = -1;
   }
 
-  if ( val > PARAM_MAX || errno == ERANGE ) {
-    val = -1;
-    errno = 0;
-  }
-
-  if ( errno == 0 || segment_begin == endptr ) {
-    parsed_params.push_back( val );
-  }
+  char assum[64];
+  snprintf( assum, 64, "[dispatch=\"%s\" params=\"%s\"]", dispatch_chars.c_str(), param_string.c_str() );
+  return std::string( assum );
+}
 
-  parsed = true;
+/* construct on first use to avoid static initialization order crash */
+DispatchRegistry& Terminal::get_global_dispatch_registry( void )
+{
+  static DispatchRegistry global_dispatch_registry;
+  return global_dispatch_registry;
 }
 
-int Dispatcher::getparam( size_t N, int defaultval )
+bool DispatchTable::slot( const std::string& dispatch_chars, int* prefix, int* final )
 {
-  int ret = defaultval;
-  if ( !parsed ) {
-    parse_params();
+  const size_t len = dispatch_chars.size();
+  if ( len == 0 || len > 2 ) {
+    return false;
   }
 
-  if ( parsed_params.size() > N ) {
-    ret = parsed_params[N];
+  const unsigned char last = dispatch_chars[len - 1];
+  if ( last >= FINALS ) {
+    return false;
   }
+  *final = last;
 
-  if ( ret < 1 )
-    ret = defaultval;
+  if ( len == 1 ) {
+    *prefix = 0;
+    return true;
+  }
 
-  return ret;
+  const unsigned char first = dispatch_chars[0];
+  if ( first < 0x20 || first > 0x3F ) {
+    return false;
+  }
+  *prefix = 1 + first - 0x20;
+  return true;
 }
 
-int Dispatcher::param_count( void )
+const Function* DispatchTable::find( const std::string& dispatch_chars, bool* covered ) const
 {
-  if ( !parsed ) {
-    parse_params();
-  }
-
-  return parsed_params.size();
+  int prefix, final;
+  *covered = slot( dispatch_chars, &prefix, &final );
+  return *covered ? entries[prefix][final] : NULL;
 }
 
-std::string Dispatcher::str( void )
+void DispatchTable::insert( const std::string& dispatch_chars, const Function* f )
 {
-  char assum[64];
-  snprintf( assum, 64, "[dispatch=\"%s\" params=\"%s\"]", dispatch_chars.c_str(), params.c_str() );
-  return std::string( assum );
+  int prefix, final;
+  if ( slot( dispatch_chars, &prefix, &final ) ) {
+    entries[prefix][final] = f;
+  }
 }
 
-/* construct on first use to avoid static initialization order crash */
-DispatchRegistry& Terminal::get_global_dispatch_registry( void )
+/* as with std::map::insert, the first registration of a key wins */
+static const Function* insert( dispatch_map_t& map, const std::string& dispatch_chars, const Function& f )
 {
-  static DispatchRegistry global_dispatch_registry;
-  return global_dispatch_registry;
+  return &map.insert( dispatch_map_t::value_type( dispatch_chars, f ) ).first->second;
 }
 
 static void register_function( Function_Type type, const std::string& dispatch_chars, Function f )
 {
+  DispatchRegistry& registry = get_global_dispatch_registry();
+
   switch ( type ) {
     case ESCAPE:
-      get_global_dispatch_registry().escape.insert( dispatch_map_t::value_type( dispatch_chars, f ) );
+      registry.escape_table.insert( dispatch_chars, insert( registry.escape, dispatch_chars, f ) );
       break;
     case CSI:
-      get_global_dispatch_registry().CSI.insert( dispatch_map_t::value_type( dispatch_chars, f ) );
-      break;
-    case CONTROL:
-      get_global_dispatch_registry().control.insert( dispatch_map_t::value_type( dispatch_chars, f ) );
+      registry.CSI_table.insert( dispatch_chars, insert( registry.CSI, dispatch_chars, f ) );
       break;
+    case CONTROL: {
+      const Function* entry = insert( registry.control, dispatch_chars, f );
+      if ( dispatch_chars.size() == 1 ) {
+        registry.control_table[static_cast<unsigned char>( dispatch_chars[0] )] = entry;
+      }
+    } break;
   }
 }
 
 Function::Function( Function_Type type,
                     const std::string& dispatch_chars,
                     void ( *s_function )( Framebuffer*, Dispatcher* ),
-                    bool s_clears_wrap_state )
-  : function( s_function ), clears_wrap_state( s_clears_wrap_state )
+                    bool s_clears_wrap_state,
+                    bool s_accepts_subparams )
+  : function( s_function ), clears_wrap_state( s_clears_wrap_state ), accepts_subparams( s_accepts_subparams )
 {
   register_function( type, dispatch_chars, *this );
 }
@@ -205,36 +219,38 @@ void Dispatcher::dispatch( Function_Type type, const Parser::Action* act, Frameb
     collect( &act2 );
   }
 
-  dispatch_map_t* map = NULL;
-  switch ( type ) {
-    case ESCAPE:
-      map = &get_global_dispatch_registry().escape;
-      break;
-    case CSI:
-      map = &get_global_dispatch_registry().CSI;
-      break;
-    case CONTROL:
-      map = &get_global_dispatch_registry().control;
-      break;
-  }
-
-  std::string key = dispatch_chars;
+  const DispatchRegistry& registry = get_global_dispatch_registry();
+  const Function* function = NULL;
   if ( type == CONTROL ) {
     assert( act->ch <= 255 );
-    char ctrlstr[2] = { (char)act->ch, 0 };
-    key = std::string( ctrlstr, 1 );
+    function = registry.control_table[static_cast<unsigned char>( act->ch )];
+  } else {
+    const DispatchTable& table = ( type == ESCAPE ) ? registry.escape_table : registry.CSI_table;
+    const dispatch_map_t& map = ( type == ESCAPE ) ? registry.escape : registry.CSI;
+    bool covered;
+    function = table.find( dispatch_chars, &covered );
+    if ( !covered ) {
+      dispatch_map_t::const_iterator i = map.find( dispatch_chars );
+      if ( i != map.end() ) {
+        function = &i->second;
+      }
+    }
+  }
+
+  if ( ( type == CSI ) && has_subparams && ( ( function == NULL ) || !function->accepts_subparams ) ) {
+    /* as if the sequence had gone to CSI_Ignore */
+    return;
   }
 
-  dispatch_map_t::const_iterator i = map->find( key );
-  if ( i == map->end() ) {
+  if ( function == NULL ) {
     /* unknown function */
     fb->ds.next_print_will_wrap = false;
     return;
   }
-  if ( i->second.clears_wrap_state ) {
+  if ( function->clears_wrap_state ) {
     fb->ds.next_print_will_wrap = false;
   }
-  i->second.function( fb, this );
+  function->function( fb, this );
 }
 
 void Dispatcher::OSC_put( const Parser::OSC_Put* act )
@@ -252,7 +268,16 @@ void Dispatcher::OSC_start( const Parser::OSC_Start* act __attribute( ( unused )
 
 bool Dispatcher::operator==( const Dispatcher& x ) const
 {
-  return ( params == x.params ) && ( parsed_params == x.parsed_params ) && ( parsed == x.parsed )
-         && ( dispatch_chars == x.dispatch_chars ) && ( OSC_string == x.OSC_string )
+  if ( ( params_length != x.params_length ) || ( param_chars != x.param_chars )
+       || ( has_subparams != x.has_subparams ) ) {
+    return false;
+  }
+  for ( int i = 0; i < params_length; i++ ) {
+    if ( ( params[i] != x.params[i] ) || ( subparams[i] != x.subparams[i] ) ) {
+      return false;
+    }
+  }
+
+  return ( dispatch_chars == x.dispatch_chars ) && ( OSC_string == x.OSC_string )
          && ( terminal_to_host == x.terminal_to_host );
 }
@@ -64,17 +64,41 @@ enum Function_Type
 class Function
 {
 public:
-  Function() : function( NULL ), clears_wrap_state( true ) {}
+  Function() : function( NULL ), clears_wrap_state( true ), accepts_subparams( false ) {}
   Function( Function_Type type,
             const std::string& dispatch_chars,
             void ( *s_function )( Framebuffer*, Dispatcher* ),
-            bool s_clears_wrap_state = true );
+            bool s_clears_wrap_state = true,
+            bool s_accepts_subparams = false );
   void ( *function )( Framebuffer*, Dispatcher* );
   bool clears_wrap_state;
+  bool accepts_subparams; /* otherwise sequences with ':' are ignored */
 };
 
 using dispatch_map_t = std::map<std::string, Function>;
 
+/* Direct-indexed view of a dispatch map for the keys that occur in
+   practice: a final byte below 0x80, optionally preceded by a single
+   intermediate or private-marker byte (0x20-0x3F).  Other keys are
+   left to the map. */
+class DispatchTable
+{
+private:
+  static const int PREFIXES = 1 + 0x20; /* none, or one of 0x20-0x3F */
+  static const int FINALS = 0x80;
+
+  const Function* entries[PREFIXES][FINALS];
+
+  static bool slot( const std::string& dispatch_chars, int* prefix, int* final );
+
+public:
+  DispatchTable() : entries() {}
+
+  /* covered: whether the key can be in the table at all */
+  const Function* find( const std::string& dispatch_chars, bool* covered ) const;
+  void insert( const std::string& dispatch_chars, const Function* f );
+};
+
 class DispatchRegistry
 {
 public:
@@ -82,32 +106,60 @@ public:
   dispatch_map_t CSI;
   dispatch_map_t control;
 
-  DispatchRegistry() : escape(), CSI(), control() {}
+  /* filled in alongside the maps as functions register */
+  DispatchTable escape_table;
+  DispatchTable CSI_table;
+  const Function* control_table[256];
+
+  DispatchRegistry() : escape(), CSI(), control(), escape_table(), CSI_table(), control_table() {}
 };
 
 DispatchRegistry& get_global_dispatch_registry( void );
 
 class Dispatcher
 {
+public:
+  static const int PARAM_MAX = 65535;
+  /* prevent evil escape sequences from causing long loops */
+
 private:
-  std::string params;
-  std::vector<int> parsed_params;
-  bool parsed;
+  static const int MAX_PARAM_CHARS = 100; /* enough for 16 five-char params plus 15 separators */
+  static const int MAX_PARAMS = MAX_PARAM_CHARS + 1;
+
+  /* Parameters are accumulated as their digits arrive. -1 marks an
+     empty parameter; values above PARAM_MAX stick at PARAM_MAX + 1
+     and read back as empty. */
+  int params[MAX_PARAMS];
+  bool subparams[MAX_PARAMS]; /* preceded by ':' rather than ';' */
+  int params_length;          /* always at least one */
+  int param_chars;
+  bool has_subparams;
 
   std::string dispatch_chars;
   std::vector<wchar_t> OSC_string; /* only used to set the window title */
 
-  void parse_params( void );
+  void clear_params( void );
 
 public:
-  static const int PARAM_MAX = 65535;
-  /* prevent evil escape sequences from causing long loops */
-
   std::string terminal_to_host; /* this is the reply string */
 
   Dispatcher();
-  int getparam( size_t N, int defaultval );
-  int param_count( void );
+
+  /* -1 if the parameter is empty, out of range or absent */
+  int param( size_t N ) const
+  {
+    if ( N >= static_cast<size_t>( params_length ) || params[N] > PARAM_MAX ) {
+      return -1;
+    }
+    return params[N];
+  }
+  bool is_subparam( size_t N ) const { return N < static_cast<size_t>( params_length ) && subparams[N]; }
+  int getparam( size_t N, int defaultval ) const
+  {
+    int ret = param( N );
+    return ( ret < 1 ) ? defaultval : ret;
+  }
+  int param_count( void ) const { return params_length; }
 
   void newparamchar( const Parser::Param* act );
   void collect( const Parser::Collect* act );
@@ -116,7 +168,7 @@ public:
   std::string str( void );
 
   void dispatch( Function_Type type, const Parser::Action* act, Framebuffer* fb );
-  std::string get_dispatch_chars( void ) const { return dispatch_chars; }
+  const std::string& get_dispatch_chars( void ) const { return dispatch_chars; }
   std::vector<wchar_t> get_OSC_string( void ) const { return OSC_string; }
 
   void OSC_put( const Parser::OSC_Put* act );
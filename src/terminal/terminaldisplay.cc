@@ -30,7 +30,10 @@
     also delete it here.
 */
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <vector>
 
 #include "src/terminal/terminalframebuffer.h"
 #include "terminaldisplay.h"
@@ -60,9 +63,17 @@ std::string Display::close() const
 
 std::string Display::new_frame( bool initialized, const Framebuffer& last, const Framebuffer& f ) const
 {
-  FrameState frame( last );
+  std::string out;
+  /* Preallocate for better performance.  Make a guess-- doesn't matter for correctness */
+  out.reserve( last.ds.get_width() * last.ds.get_height() * 4 );
+  new_frame( initialized, last, f, out );
+  return out;
+}
 
-  char tmp[64];
+void Display::new_frame( bool initialized, const Framebuffer& last, const Framebuffer& f, std::string& out ) const
+{
+  out.clear();
+  FrameState frame( last, out );
 
   /* has bell been rung? */
   if ( f.get_bell_count() != frame.last_frame.get_bell_count() ) {
@@ -115,8 +126,7 @@ std::string Display::new_frame( bool initialized, const Framebuffer& last, const
   /* has reverse video state changed? */
   if ( ( !initialized ) || ( f.ds.reverse_video != frame.last_frame.ds.reverse_video ) ) {
     /* set reverse video */
-    snprintf( tmp, 64, "\033[?5%c", ( f.ds.reverse_video ? 'h' : 'l' ) );
-    frame.append( tmp );
+    frame.append( f.ds.reverse_video ? "\033[?5h" : "\033[?5l" );
   }
 
   /* has size changed? */
@@ -142,114 +152,39 @@ std::string Display::new_frame( bool initialized, const Framebuffer& last, const
     frame.append( "\033[?25l" );
   }
 
-  int frame_y = 0;
-  Framebuffer::row_pointer blank_row;
-  Framebuffer::rows_type rows( frame.last_frame.get_rows() );
+  /* The old rows as the terminal shows them, copied only when they are
+     to be moved or extended; a full repaint reads the last frame's. */
+  Framebuffer::rows_type rows;
+  const bool wider = frame.last_frame.ds.get_width() < f.ds.get_width();
+  const bool taller = frame.last_frame.ds.get_height() < f.ds.get_height();
+  if ( initialized || wider || taller ) {
+    rows = frame.last_frame.get_rows();
+  }
   /* Extend rows if we've gotten a resize and new is wider than old */
-  if ( frame.last_frame.ds.get_width() < f.ds.get_width() ) {
+  if ( wider ) {
     for ( Framebuffer::rows_type::iterator p = rows.begin(); p != rows.end(); p++ ) {
-      *p = std::make_shared<Row>( **p );
-      ( *p )->cells.resize( f.ds.get_width(), Cell( f.ds.get_background_rendition() ) );
+      *p = Row::create( **p );
+      ( *p )->resize( f.ds.get_width(), f.ds.get_background_rendition() );
     }
   }
   /* Add rows if we've gotten a resize and new is taller than old */
-  if ( static_cast<int>( rows.size() ) < f.ds.get_height() ) {
+  if ( taller ) {
     // get a proper blank row
     const size_t w = f.ds.get_width();
     const color_type c = 0;
-    blank_row = std::make_shared<Row>( w, c );
-    rows.resize( f.ds.get_height(), blank_row );
+    rows.resize( f.ds.get_height(), Row::create( w, c ) );
   }
 
-  /* shortcut -- has display moved up by a certain number of lines? */
+  /* shortcut -- have blocks of rows moved? */
   if ( initialized ) {
-    int lines_scrolled = 0;
-    int scroll_height = 0;
-
-    for ( int row = 0; row < f.ds.get_height(); row++ ) {
-      const Row* new_row = f.get_row( 0 );
-      const Row* old_row = &*rows.at( row );
-      if ( !( new_row == old_row || *new_row == *old_row ) ) {
-        continue;
-      }
-      /* if row 0, we're looking at ourselves and probably didn't scroll */
-      if ( row == 0 ) {
-        break;
-      }
-      /* found a scroll */
-      lines_scrolled = row;
-      scroll_height = 1;
-
-      /* how big is the region that was scrolled? */
-      for ( int region_height = 1; lines_scrolled + region_height < f.ds.get_height(); region_height++ ) {
-        if ( *f.get_row( region_height ) == *rows.at( lines_scrolled + region_height ) ) {
-          scroll_height = region_height + 1;
-        } else {
-          break;
-        }
-      }
-
-      break;
-    }
-
-    if ( scroll_height ) {
-      frame_y = scroll_height;
-
-      if ( lines_scrolled ) {
-        /* Now we need a proper blank row. */
-        if ( blank_row.get() == NULL ) {
-          const size_t w = f.ds.get_width();
-          const color_type c = 0;
-          blank_row = std::make_shared<Row>( w, c );
-        }
-        frame.update_rendition( initial_rendition(), true );
-
-        int top_margin = 0;
-        int bottom_margin = top_margin + lines_scrolled + scroll_height - 1;
-
-        assert( bottom_margin < f.ds.get_height() );
-
-        /* Common case:  if we're already on the bottom line and we're scrolling the whole
-         * screen, just do a CR and LFs.
-         */
-        if ( scroll_height + lines_scrolled == f.ds.get_height() && frame.cursor_y + 1 == f.ds.get_height() ) {
-          frame.append( '\r' );
-          frame.append( lines_scrolled, '\n' );
-          frame.cursor_x = 0;
-        } else {
-          /* set scrolling region */
-          snprintf( tmp, 64, "\033[%d;%dr", top_margin + 1, bottom_margin + 1 );
-          frame.append( tmp );
-
-          /* go to bottom of scrolling region */
-          frame.cursor_x = frame.cursor_y = -1;
-          frame.append_silent_move( bottom_margin, 0 );
-
-          /* scroll */
-          frame.append( lines_scrolled, '\n' );
-
-          /* reset scrolling region */
-          frame.append( "\033[r" );
-          /* invalidate cursor position after unsetting scrolling region */
-          frame.cursor_x = frame.cursor_y = -1;
-        }
-
-        /* do the move in our local index */
-        for ( int i = top_margin; i <= bottom_margin; i++ ) {
-          if ( i + lines_scrolled <= bottom_margin ) {
-            rows.at( i ) = rows.at( i + lines_scrolled );
-          } else {
-            rows.at( i ) = blank_row;
-          }
-        }
-      }
-    }
+    move_rows( frame, f, rows );
   }
 
   /* Now update the display, row by row */
   bool wrap = false;
-  for ( ; frame_y < f.ds.get_height(); frame_y++ ) {
-    wrap = put_row( initialized, frame, f, frame_y, *rows.at( frame_y ), wrap );
+  for ( int frame_y = 0; frame_y < f.ds.get_height(); frame_y++ ) {
+    const Row& old_row = rows.empty() ? *frame.last_frame.get_row( frame_y ) : *rows.at( frame_y );
+    wrap = put_row( initialized, frame, f, frame_y, old_row, wrap );
   }
 
   /* has cursor location changed? */
@@ -284,11 +219,9 @@ std::string Display::new_frame( bool initialized, const Framebuffer& last, const
       frame.append( "\033[?1000l" );
     } else {
       if ( frame.last_frame.ds.mouse_reporting_mode != DrawState::MOUSE_REPORTING_NONE ) {
-        snprintf( tmp, sizeof( tmp ), "\033[?%dl", frame.last_frame.ds.mouse_reporting_mode );
-        frame.append( tmp );
+        frame.append_private_mode( frame.last_frame.ds.mouse_reporting_mode, false );
       }
-      snprintf( tmp, sizeof( tmp ), "\033[?%dh", f.ds.mouse_reporting_mode );
-      frame.append( tmp );
+      frame.append_private_mode( f.ds.mouse_reporting_mode, true );
     }
   }
 
@@ -305,15 +238,310 @@ std::string Display::new_frame( bool initialized, const Framebuffer& last, const
       frame.append( "\033[?1005l" );
     } else {
       if ( frame.last_frame.ds.mouse_encoding_mode != DrawState::MOUSE_ENCODING_DEFAULT ) {
-        snprintf( tmp, sizeof( tmp ), "\033[?%dl", frame.last_frame.ds.mouse_encoding_mode );
-        frame.append( tmp );
+        frame.append_private_mode( frame.last_frame.ds.mouse_encoding_mode, false );
       }
-      snprintf( tmp, sizeof( tmp ), "\033[?%dh", f.ds.mouse_encoding_mode );
-      frame.append( tmp );
+      frame.append_private_mode( f.ds.mouse_encoding_mode, true );
     }
   }
 
-  return frame.str;
+}
+
+/* Rows compare by generation and then by cached content hash, so a
+   row that moved is found cheaply. */
+static bool same_row( const Row& a, const Row& b )
+{
+  return &a == &b || a == b;
+}
+
+/* What repainting a row would cost, roughly: its cells up to the last
+   non-blank one. */
+static int repaint_cost( const Row& row )
+{
+  int end = row.cells.size();
+  while ( end > 0 && row.cells[end - 1].is_blank() ) {
+    end--;
+  }
+  return end;
+}
+
+/* A move sets and resets a scrolling region, positions the cursor and
+   scrolls. */
+static bool worth_moving( int saved, int offset )
+{
+  return saved > 16 + std::min( std::abs( offset ), 4 );
+}
+
+/* Move blocks of rows on the terminal to where the new frame has them,
+   so that put_row need not repaint them: upward and downward scrolls
+   of the whole screen or of a region, and lines inserted or deleted in
+   between.  Rows unchanged at the top and bottom are left out.  The
+   rest of the old rows are matched to the new ones as a common
+   subsequence, the one that saves the most repainting; each run of
+   matches at the same offset is a block, worth moving if it saves more
+   than the move costs.  Since blocks keep their order, moving the
+   upward ones from the top down and then the downward ones from the
+   bottom up never scrolls away a block still to be moved. */
+void Display::move_rows( FrameState& frame, const Framebuffer& f, Framebuffer::rows_type& rows ) const
+{
+  const int height = f.ds.get_height();
+  int top = 0, bottom = height;
+  while ( top < bottom && same_row( *f.get_row( top ), *rows.at( top ) ) ) {
+    top++;
+  }
+  while ( bottom > top && same_row( *f.get_row( bottom - 1 ), *rows.at( bottom - 1 ) ) ) {
+    bottom--;
+  }
+  const int n = bottom - top;
+  if ( n < 2 ) {
+    return;
+  }
+
+  /* best[i * (n + 1) + j] is the most repainting saved by matching new
+     rows from top + i with old rows from top + j.  Blank rows count for
+     a little, so that they join the blocks around them. */
+  std::vector<int> weight( n );
+  for ( int i = 0; i < n; i++ ) {
+    weight[i] = repaint_cost( *f.get_row( top + i ) ) + 1;
+  }
+  const int stride = n + 1;
+  std::vector<int> best( stride * stride, 0 );
+  for ( int i = n - 1; i >= 0; i-- ) {
+    const Row& new_row = *f.get_row( top + i );
+    for ( int j = n - 1; j >= 0; j-- ) {
+      int b = std::max( best[( i + 1 ) * stride + j], best[i * stride + j + 1] );
+      if ( same_row( new_row, *rows[top + j] ) ) {
+        b = std::max( b, weight[i] + best[( i + 1 ) * stride + j + 1] );
+      }
+      best[i * stride + j] = b;
+    }
+  }
+
+  /* follow the matches, gathering runs of them: new rows [start, start
+     + length) were old rows [start + offset, ...) */
+  struct Block
+  {
+    int start, length, offset, saved;
+  };
+  std::vector<Block> blocks;
+  for ( int i = 0, j = 0; i < n && j < n && best[i * stride + j] > 0; ) {
+    const int y = top + i;
+    if ( best[i * stride + j] != weight[i] + best[( i + 1 ) * stride + j + 1]
+         || !same_row( *f.get_row( y ), *rows[top + j] ) ) {
+      if ( best[( i + 1 ) * stride + j] >= best[i * stride + j + 1] ) {
+        i++;
+      } else {
+        j++;
+      }
+      continue;
+    }
+    const int offset = j - i;
+    if ( blocks.empty() || blocks.back().offset != offset || blocks.back().start + blocks.back().length != y ) {
+      blocks.push_back( Block { y, 0, offset, 0 } );
+    }
+    blocks.back().length++;
+    if ( !same_row( *f.get_row( y ), *rows[y] ) ) {
+      blocks.back().saved += weight[i] - 1;
+    }
+    i++;
+    j++;
+  }
+
+  /* upward moves from the top, then downward ones from the bottom */
+  std::vector<Block> order;
+  for ( const Block& block : blocks ) {
+    if ( block.offset > 0 && worth_moving( block.saved, block.offset ) ) {
+      order.push_back( block );
+    }
+  }
+  for ( auto block = blocks.rbegin(); block != blocks.rend(); block++ ) {
+    if ( block->offset < 0 && worth_moving( block->saved, block->offset ) ) {
+      order.push_back( *block );
+    }
+  }
+  if ( order.empty() ) {
+    return;
+  }
+
+  /* Now we need a proper blank row. */
+  const Framebuffer::row_pointer blank_row( Row::create( f.ds.get_width(), 0 ) );
+  frame.update_rendition( initial_rendition(), true );
+
+  bool region_set = false;
+  for ( const Block& block : order ) {
+    const bool up = block.offset > 0;
+    const int lines = std::abs( block.offset );
+    const int region_top = up ? block.start : block.start + block.offset;
+    const int region_bottom = up ? block.start + block.length + block.offset - 1 : block.start + block.length - 1;
+    const bool whole_screen = ( region_top == 0 && region_bottom == height - 1 );
+
+    if ( whole_screen && up && !region_set && frame.cursor_y == height - 1 ) {
+      /* Common case:  if we're already on the bottom line and we're
+         scrolling the whole screen, just do a CR and LFs. */
+      frame.append( '\r' );
+      frame.append( lines, '\n' );
+      frame.cursor_x = 0;
+    } else {
+      if ( !whole_screen ) {
+        /* set scrolling region */
+        frame.append( "\033[" );
+        frame.append_decimal( region_top + 1 );
+        frame.append( ';' );
+        frame.append_decimal( region_bottom + 1 );
+        frame.append( 'r' );
+        region_set = true;
+      } else if ( region_set ) {
+        frame.append( "\033[r" );
+        region_set = false;
+      }
+      /* cursor position is unknown after setting the region, and relative
+         moves might scroll it */
+      frame.cursor_x = frame.cursor_y = -1;
+
+      if ( up && lines < 4 ) {
+        /* go to bottom of scrolling region and scroll */
+        frame.append_silent_move( region_bottom, 0 );
+        frame.append( lines, '\n' );
+      } else if ( !up && lines == 1 ) {
+        /* go to top of scrolling region and reverse index */
+        frame.append_silent_move( region_top, 0 );
+        frame.append( "\033M" );
+      } else {
+        /* delete or insert lines at the top of the region */
+        frame.append_silent_move( region_top, 0 );
+        frame.append_csi( lines, up ? 'M' : 'L' );
+      }
+      frame.cursor_x = frame.cursor_y = -1;
+    }
+
+    /* do the move in our local index */
+    if ( up ) {
+      for ( int y = region_top; y <= region_bottom; y++ ) {
+        rows.at( y ) = y + lines <= region_bottom ? rows.at( y + lines ) : blank_row;
+      }
+    } else {
+      for ( int y = region_bottom; y >= region_top; y-- ) {
+        rows.at( y ) = y - lines >= region_top ? rows.at( y - lines ) : blank_row;
+      }
+    }
+  }
+
+  if ( region_set ) {
+    /* reset scrolling region */
+    frame.append( "\033[r" );
+    /* invalidate cursor position after unsetting scrolling region */
+    frame.cursor_x = frame.cursor_y = -1;
+  }
+}
+
+/* When the cursor is a few cells to the left on the same row, and they
+   already show printable ASCII in the current rendition, printing them
+   again is shorter than moving over them. */
+bool Display::overwrite_gap( FrameState& frame, const Row& row, int frame_y, int frame_x ) const
+{
+  const Row::cells_type& cells = row.cells;
+  const int gap = frame_x - frame.cursor_x;
+  if ( frame.cursor_y != frame_y || frame.cursor_x < 0 || gap <= 0 || gap >= frame.move_cost( frame_y, frame_x ) ) {
+    return false;
+  }
+  for ( int x = frame.cursor_x; x < frame_x; x++ ) {
+    const Cell& cell = cells[x];
+    if ( !cell.is_single_character() || cell.printed_size() != 1 || cell.get_wide()
+         || !( row.get_renditions( x ) == frame.current_rendition ) ) {
+      return false;
+    }
+  }
+  for ( int x = frame.cursor_x; x < frame_x; x++ ) {
+    frame.append_cell( cells[x] );
+  }
+  frame.cursor_x = frame_x;
+  return true;
+}
+
+static bool same_cell_but_wrap( const Row& row, int col, const Row& old_row, int old_col )
+{
+  const Cell& a = row.cells[col];
+  const Cell& b = old_row.cells[old_col];
+  if ( !( row.get_renditions( col ) == old_row.get_renditions( old_col ) ) ) {
+    return false;
+  }
+  if ( a.get_wrap() == b.get_wrap() ) {
+    return a == b;
+  }
+  Cell c( a );
+  c.set_wrap( b.get_wrap() );
+  return c == b;
+}
+
+/* Has the row from column start on shifted sideways by a few cells
+   since the old row, as when characters are inserted or deleted in a
+   command line?  If so, and ICH or DCH (which fill with blanks in the
+   default rendition) saves enough repainting, shift it on the terminal
+   and set *shifted to what the terminal then shows. */
+bool Display::shift_cells( FrameState& frame,
+                           int frame_y,
+                           int start,
+                           const Row& row,
+                           const Row& old_row,
+                           Framebuffer::row_pointer* shifted ) const
+{
+  const int max_shift = 8, min_span = 8;
+  if ( !has_ich && !has_dch ) {
+    return false;
+  }
+
+  /* the span [first, last) where the rows differ */
+  const Row::cells_type& cells = row.cells;
+  const Row::cells_type& old_cells = old_row.cells;
+  const int width = cells.size();
+  int first = start, last = width;
+  while ( first < width && row.same_cell( first, old_row, first ) ) {
+    first++;
+  }
+  while ( last > first && row.same_cell( last - 1, old_row, last - 1 ) ) {
+    last--;
+  }
+  if ( last - first < min_span || ( first > 0 && ( cells[first - 1].get_wide() || old_cells[first - 1].get_wide() ) ) ) {
+    return false;
+  }
+
+  for ( int k = 1; k <= max_shift && k < last - first; k++ ) {
+    for ( const bool insert : { true, false } ) {
+      if ( insert ? !has_ich || old_cells[width - k - 1].get_wide() : !has_dch || old_cells[first + k - 1].get_wide() ) {
+        continue;
+      }
+      /* most rows are rejected by the first shifted cell */
+      bool match = insert ? same_cell_but_wrap( row, first + k, old_row, first )
+                          : same_cell_but_wrap( row, first, old_row, first + k );
+      int saved = 0;
+      for ( int x = insert ? first + k : first; match && x < ( insert ? width : width - k ); x++ ) {
+        match = same_cell_but_wrap( row, x, old_row, insert ? x - k : x + k );
+        saved += x < last && !row.same_cell( x, old_row, x );
+      }
+      if ( !match || saved <= FrameState::csi_length( k ) + 2 ) {
+        continue;
+      }
+
+      frame.append_silent_move( frame_y, first );
+      frame.update_rendition( initial_rendition() );
+      frame.append_csi( k, insert ? '@' : 'P' );
+
+      *shifted = Row::create( old_row );
+      Row& shifted_row = **shifted;
+      for ( int i = 0; i < k; i++ ) {
+        if ( insert ) {
+          shifted_row.insert_cell( first, 0 );
+        } else {
+          shifted_row.delete_cell( first, 0 );
+        }
+      }
+      for ( Cell& cell : shifted_row.cells ) {
+        cell.set_wrap( false );
+      }
+      shifted_row.cells.back().set_wrap( old_cells.back().get_wrap() );
+      return true;
+    }
+  }
+  return false;
 }
 
 bool Display::put_row( bool initialized,
@@ -323,17 +551,16 @@ bool Display::put_row( bool initialized,
                        const Row& old_row,
                        bool wrap ) const
 {
-  char tmp[64];
   int frame_x = 0;
 
   const Row& row = *f.get_row( frame_y );
   const Row::cells_type& cells = row.cells;
-  const Row::cells_type& old_cells = old_row.cells;
+  const Row* old = &old_row;
 
   /* If we're forced to write the first column because of wrap, go ahead and do so. */
   if ( wrap ) {
     const Cell& cell = cells.at( 0 );
-    frame.update_rendition( cell.get_renditions() );
+    frame.update_rendition( row.get_renditions( 0 ) );
     frame.append_cell( cell );
     frame_x += cell.get_width();
     frame.cursor_x += cell.get_width();
@@ -350,13 +577,40 @@ bool Display::put_row( bool initialized,
   bool wrote_last_cell = false;
   Renditions blank_renditions = initial_rendition();
 
+  /* If the row is a copy of the old one, only its damaged columns can
+     differ, and the scan below would skip every other cell.  Start at
+     the first damaged cell the scan would land on (it steps over the
+     right half of a wide cell), and stop once past the damage. */
+  int damage_start, damage_end = row_width;
+  if ( initialized && row.changed_columns( old_row, &damage_start, &damage_end ) ) {
+    int wide_run = 0;
+    while ( damage_start - wide_run - 1 >= frame_x && cells[damage_start - wide_run - 1].get_wide() ) {
+      wide_run++;
+    }
+    if ( wide_run % 2 ) {
+      damage_start--;
+    }
+    frame_x = std::max( frame_x, damage_start );
+  }
+
+  /* If the rest of the row has moved sideways, shift it on the terminal
+     too, and compare with the shifted copy from here on. */
+  Framebuffer::row_pointer shifted;
+  if ( initialized && shift_cells( frame, frame_y, frame_x, row, old_row, &shifted ) ) {
+    old = shifted.get();
+    damage_end = row_width;
+  }
+
   /* iterate for every cell */
   while ( frame_x < row_width ) {
+    if ( frame_x >= damage_end && !clear_count ) {
+      break;
+    }
 
     const Cell& cell = cells.at( frame_x );
 
     /* Does cell need to be drawn?  Skip all this. */
-    if ( initialized && !clear_count && ( cell == old_cells.at( frame_x ) ) ) {
+    if ( initialized && !clear_count && row.same_cell( frame_x, *old, frame_x ) ) {
       frame_x += cell.get_width();
       continue;
     }
@@ -364,9 +618,9 @@ bool Display::put_row( bool initialized,
     /* Slurp up all the empty cells */
     if ( cell.empty() ) {
       if ( !clear_count ) {
-        blank_renditions = cell.get_renditions();
+        blank_renditions = row.get_renditions( frame_x );
       }
-      if ( cell.get_renditions() == blank_renditions ) {
+      if ( row.get_renditions( frame_x ) == blank_renditions ) {
         /* Remember run of blank cells */
         clear_count++;
         frame_x++;
@@ -379,10 +633,13 @@ bool Display::put_row( bool initialized,
       /* Move to the right position. */
       frame.append_silent_move( frame_y, frame_x - clear_count );
       frame.update_rendition( blank_renditions );
+      /* ECH leaves the cursor behind, where spaces advance it */
       bool can_use_erase = has_bce || ( frame.current_rendition == initial_rendition() );
-      if ( can_use_erase && has_ech && clear_count > 4 ) {
-        snprintf( tmp, 64, "\033[%dX", clear_count );
-        frame.append( tmp );
+      if ( can_use_erase && has_ech
+           && FrameState::csi_length( clear_count )
+                  + FrameState::plan_move( frame_y, frame_x - clear_count, frame_y, frame_x, NULL )
+                < clear_count ) {
+        frame.append_csi( clear_count, 'X' );
       } else {
         frame.append( clear_count, ' ' );
         frame.cursor_x = frame_x;
@@ -391,7 +648,7 @@ bool Display::put_row( bool initialized,
       // If the current character is *another* empty cell in a different rendition,
       // we restart counting and continue here
       if ( cell.empty() ) {
-        blank_renditions = cell.get_renditions();
+        blank_renditions = row.get_renditions( frame_x );
         clear_count = 1;
         frame_x++;
         continue;
@@ -411,11 +668,27 @@ bool Display::put_row( bool initialized,
     if ( wrap_this && frame_x + cell_width >= row_width ) {
       frame.cursor_x = frame.cursor_y = -1;
     }
-    frame.append_silent_move( frame_y, frame_x );
-    frame.update_rendition( cell.get_renditions() );
+    if ( !overwrite_gap( frame, row, frame_y, frame_x ) ) {
+      frame.append_silent_move( frame_y, frame_x );
+    }
+    frame.update_rendition( row.get_renditions( frame_x ) );
     frame.append_cell( cell );
     frame_x += cell_width;
     frame.cursor_x += cell_width;
+
+    /* REP repeats the last character printed */
+    if ( has_rep && cell_width == 1 && cell.is_single_character() ) {
+      int run = 0;
+      while ( frame_x + run < row_width && row.same_cell( frame_x + run, frame_x - 1 ) ) {
+        run++;
+      }
+      if ( run > 0 && FrameState::csi_length( run ) < run * static_cast<int>( cell.printed_size() ) ) {
+        frame.append_csi( run, 'b' );
+        frame_x += run;
+        frame.cursor_x += run;
+      }
+    }
+
     if ( frame_x >= row_width ) {
       wrote_last_cell = true;
     }
@@ -439,6 +712,11 @@ bool Display::put_row( bool initialized,
     }
   }
 
+  if ( wrote_last_cell && frame_y == f.ds.get_height() - 1 ) {
+    /* The cursor is on the last column with a wrap pending, which
+       relative moves (backspace in particular) would get wrong. */
+    frame.cursor_x = frame.cursor_y = -1;
+  }
   if ( !( wrote_last_cell && ( frame_y < f.ds.get_height() - 1 ) ) ) {
     return false;
   }
@@ -458,13 +736,10 @@ bool Display::put_row( bool initialized,
   return false;
 }
 
-FrameState::FrameState( const Framebuffer& s_last )
-  : str(), cursor_x( 0 ), cursor_y( 0 ), current_rendition( 0 ), cursor_visible( s_last.ds.cursor_visible ),
+FrameState::FrameState( const Framebuffer& s_last, std::string& s_str )
+  : str( s_str ), cursor_x( 0 ), cursor_y( 0 ), current_rendition( 0 ), cursor_visible( s_last.ds.cursor_visible ),
     last_frame( s_last )
-{
-  /* Preallocate for better performance.  Make a guess-- doesn't matter for correctness */
-  str.reserve( last_frame.ds.get_width() * last_frame.ds.get_height() * 4 );
-}
+{}
 
 void FrameState::append_silent_move( int y, int x )
 {
@@ -480,37 +755,188 @@ void FrameState::append_silent_move( int y, int x )
 
 void FrameState::append_move( int y, int x )
 {
-  const int last_x = cursor_x;
-  const int last_y = cursor_y;
+  plan_move( cursor_y, cursor_x, y, x, &str );
   cursor_x = x;
   cursor_y = y;
-  // Only optimize if cursor pos is known
+}
+
+int FrameState::move_cost( int y, int x ) const
+{
+  if ( cursor_x == x && cursor_y == y ) {
+    return 0;
+  }
+  return plan_move( cursor_y, cursor_x, y, x, NULL );
+}
+
+static int decimal_length( int n )
+{
+  int length = 1;
+  while ( n >= 10 ) {
+    n /= 10;
+    length++;
+  }
+  return length;
+}
+
+/* Bytes of a CSI sequence with one parameter, left out when it is 1. */
+int FrameState::csi_length( int n )
+{
+  return n == 1 ? 3 : 3 + decimal_length( n );
+}
+
+static void append_csi_to( std::string* out, int n, char final )
+{
+  out->append( "\033[" );
+  if ( n != 1 ) {
+    append_decimal( *out, n );
+  }
+  out->push_back( final );
+}
+
+void FrameState::append_csi( int n, char final )
+{
+  append_csi_to( &str, n, final );
+}
+
+void FrameState::append_private_mode( int mode, bool set )
+{
+  append( "\033[?" );
+  append_decimal( mode );
+  append( set ? 'h' : 'l' );
+}
+
+/* The shortest way from (last_y, last_x) to (y, x): an absolute CUP,
+   or a vertical step (LFs, CUD or CUU) followed by a horizontal one
+   (CR, backspaces, CUF, CUB, CHA, or CR and CUF).  Relative moves need
+   a known cursor position.  Returns the bytes, appending them to out
+   unless it is NULL. */
+int FrameState::plan_move( int last_y, int last_x, int y, int x, std::string* out )
+{
+  const int cup_cost
+    = x == 0 ? ( y == 0 ? 3 : 3 + decimal_length( y + 1 ) ) : 4 + decimal_length( y + 1 ) + decimal_length( x + 1 );
+
+  enum
+  {
+    STAY,
+    LINE_FEEDS,
+    DOWN,
+    UP
+  } vertical
+    = STAY;
+  enum
+  {
+    NONE,
+    CARRIAGE_RETURN,
+    BACKSPACES,
+    BACK,
+    FORWARD,
+    COLUMN,
+    RETURN_FORWARD
+  } horizontal
+    = NONE;
+  int relative_cost = -1;
+
   if ( last_x != -1 && last_y != -1 ) {
-    // Can we use CR and/or LF?  They're cheap and easier to trace.
-    if ( x == 0 && y - last_y >= 0 && y - last_y < 5 ) {
-      if ( last_x != 0 ) {
-        append( '\r' );
+    const int dy = y - last_y, dx = x - last_x;
+    int vertical_cost = 0;
+    if ( dy > 0 ) {
+      vertical = dy <= csi_length( dy ) ? LINE_FEEDS : DOWN;
+      vertical_cost = std::min( dy, csi_length( dy ) );
+    } else if ( dy < 0 ) {
+      vertical = UP;
+      vertical_cost = csi_length( -dy );
+    }
+
+    int horizontal_cost = 0;
+    if ( dx != 0 ) {
+      horizontal = COLUMN;
+      horizontal_cost = csi_length( x + 1 );
+      const auto consider = [&]( int cost, decltype( horizontal ) way ) {
+        if ( cost < horizontal_cost ) {
+          horizontal_cost = cost;
+          horizontal = way;
+        }
+      };
+      if ( x == 0 ) {
+        consider( 1, CARRIAGE_RETURN );
+      } else {
+        consider( 1 + csi_length( x ), RETURN_FORWARD );
+      }
+      if ( dx < 0 ) {
+        consider( -dx, BACKSPACES );
+        consider( csi_length( -dx ), BACK );
+      } else {
+        consider( csi_length( dx ), FORWARD );
+      }
+    }
+    relative_cost = vertical_cost + horizontal_cost;
+  }
+
+  if ( relative_cost < 0 || cup_cost < relative_cost ) {
+    if ( out ) {
+      out->append( "\033[" );
+      if ( x != 0 || y != 0 ) {
+        Terminal::append_decimal( *out, y + 1 );
+      }
+      if ( x != 0 ) {
+        out->push_back( ';' );
+        Terminal::append_decimal( *out, x + 1 );
       }
-      append( y - last_y, '\n' );
-      return;
+      out->push_back( 'H' );
+    }
+    return cup_cost;
+  }
+
+  if ( out ) {
+    const int dy = y - last_y, dx = x - last_x;
+    switch ( vertical ) {
+      case LINE_FEEDS:
+        out->append( dy, '\n' );
+        break;
+      case DOWN:
+        append_csi_to( out, dy, 'B' );
+        break;
+      case UP:
+        append_csi_to( out, -dy, 'A' );
+        break;
+      case STAY:
+        break;
     }
-    // Backspaces are good too.
-    if ( y == last_y && x - last_x < 0 && x - last_x > -5 ) {
-      append( last_x - x, '\b' );
-      return;
+    switch ( horizontal ) {
+      case CARRIAGE_RETURN:
+        out->append( 1, '\r' );
+        break;
+      case RETURN_FORWARD:
+        out->append( 1, '\r' );
+        append_csi_to( out, x, 'C' );
+        break;
+      case BACKSPACES:
+        out->append( -dx, '\b' );
+        break;
+      case BACK:
+        append_csi_to( out, -dx, 'D' );
+        break;
+      case FORWARD:
+        append_csi_to( out, dx, 'C' );
+        break;
+      case COLUMN:
+        append_csi_to( out, x + 1, 'G' );
+        break;
+      case NONE:
+        break;
     }
-    // More optimizations are possible.
   }
-  char tmp[64];
-  snprintf( tmp, 64, "\033[%d;%dH", y + 1, x + 1 );
-  append( tmp );
+  return relative_cost;
 }
 
 void FrameState::update_rendition( const Renditions& r, bool force )
 {
-  if ( force || !( current_rendition == r ) ) {
-    /* print renditions */
-    append_string( r.sgr() );
+  if ( force ) {
+    r.append_sgr( str );
+    current_rendition = r;
+  } else if ( !( current_rendition == r ) ) {
+    /* print only what changes */
+    r.append_sgr( str, current_rendition );
     current_rendition = r;
   }
 }
@@ -40,7 +40,7 @@ namespace Terminal {
 class FrameState
 {
 public:
-  std::string str;
+  std::string& str; /* the caller's, reused from frame to frame */
 
   int cursor_x, cursor_y;
   Renditions current_rendition;
@@ -48,17 +48,23 @@ public:
 
   const Framebuffer& last_frame;
 
-  FrameState( const Framebuffer& s_last );
+  FrameState( const Framebuffer& s_last, std::string& s_str );
 
   void append( char c ) { str.append( 1, c ); }
   void append( size_t s, char c ) { str.append( s, c ); }
   void append( wchar_t wc ) { Cell::append_to_str( str, wc ); }
   void append( const char* s ) { str.append( s ); }
   void append_string( const std::string& append ) { str.append( append ); }
+  void append_decimal( unsigned int n ) { Terminal::append_decimal( str, n ); }
+  void append_csi( int n, char final ); /* CSI n final, leaving out n if it is 1 */
+  void append_private_mode( int mode, bool set );
 
   void append_cell( const Cell& cell ) { cell.print_grapheme( str ); }
   void append_silent_move( int y, int x );
   void append_move( int y, int x );
+  int move_cost( int y, int x ) const; /* bytes append_move would take */
+  static int csi_length( int n );
+  static int plan_move( int last_y, int last_x, int y, int x, std::string* out );
   void update_rendition( const Renditions& r, bool force = false );
 };
 
@@ -72,8 +78,24 @@ private:
 
   bool has_title; /* supports window title and icon name */
 
+  bool has_rep; /* repeats the last character; never used in diffs sent
+                   to a client, whose emulator may be too old for REP */
+
+  bool has_ich, has_dch; /* inserts and deletes characters */
+
   const char *smcup, *rmcup; /* enter and exit alternate screen mode */
 
+  void move_rows( FrameState& frame, const Framebuffer& f, Framebuffer::rows_type& rows ) const;
+
+  bool overwrite_gap( FrameState& frame, const Row& row, int frame_y, int frame_x ) const;
+
+  bool shift_cells( FrameState& frame,
+                    int frame_y,
+                    int start,
+                    const Row& row,
+                    const Row& old_row,
+                    Framebuffer::row_pointer* shifted ) const;
+
   bool put_row( bool initialized,
                 FrameState& frame,
                 const Framebuffer& f,
@@ -86,6 +108,9 @@ public:
   std::string close() const;
 
   std::string new_frame( bool initialized, const Framebuffer& last, const Framebuffer& f ) const;
+  /* Writes the update into out, replacing its contents but keeping its
+     storage, so that a caller reusing out seldom allocates. */
+  void new_frame( bool initialized, const Framebuffer& last, const Framebuffer& f, std::string& out ) const;
 
   Display( bool use_environment );
 };
@@ -81,7 +81,8 @@ static const char* ti_str( const char* capname )
 }
 
 Display::Display( bool use_environment )
-  : has_ech( true ), has_bce( true ), has_title( true ), smcup( NULL ), rmcup( NULL )
+  : has_ech( true ), has_bce( true ), has_title( true ), has_rep( false ), has_ich( true ), has_dch( true ),
+    smcup( NULL ), rmcup( NULL )
 {
   if ( use_environment ) {
     int errret = -2;
@@ -110,6 +111,11 @@ Display::Display( bool use_environment )
     /* check for BCE */
     has_bce = ti_flag( "bce" );
 
+    /* check for REP, ICH and DCH */
+    has_rep = ti_str( "rep" );
+    has_ich = ti_str( "ich" );
+    has_dch = ti_str( "dch" );
+
     /* Check if we can set the window title and icon name.  terminfo does not
        have reliable information on this, so we hardcode a whitelist of
        terminal type prefixes. */
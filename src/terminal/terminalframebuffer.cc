@@ -30,27 +30,134 @@
     also delete it here.
 */
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <unordered_map>
 
 #include "src/terminal/terminalframebuffer.h"
+#include "src/terminal/terminalscrollback.h"
 
 using namespace Terminal;
 
-Cell::Cell( color_type background_color )
-  : contents(), renditions( background_color ), wide( false ), fallback( false ), wrap( false )
+Cell::Cell()
+  : contents(),
+    contents_size( 0 ),
+    interned( false ),
+    wide( false ),
+    fallback( false ),
+    wrap( false ),
+    rendition( 0 )
 {}
 
-void Cell::reset( color_type background_color )
+void Cell::reset( void )
 {
-  contents.clear();
-  renditions = Renditions( background_color );
+  clear();
   wide = false;
   fallback = false;
   wrap = false;
 }
 
+/* Long graphemes, each stored once and counted by the cells holding
+   it.  An entry whose last cell goes away is freed and its index used
+   again, so the table holds only what is on some screen. */
+namespace {
+class GraphemeTable
+{
+private:
+  struct Entry
+  {
+    std::string grapheme;
+    uint32_t references;
+  };
+
+  std::deque<Entry> entries; /* stable references */
+  std::vector<uint32_t> free_indices;
+  std::unordered_map<std::string, uint32_t> indices;
+
+public:
+  GraphemeTable() : entries(), free_indices(), indices() {}
+
+  const std::string& get( uint32_t index ) const { return entries[index].grapheme; }
+
+  void retain( uint32_t index ) { entries[index].references++; }
+
+  void release( uint32_t index )
+  {
+    Entry& entry = entries[index];
+    assert( entry.references > 0 );
+    if ( --entry.references == 0 ) {
+      indices.erase( entry.grapheme );
+      std::string().swap( entry.grapheme );
+      free_indices.push_back( index );
+    }
+  }
+
+  /* The grapheme's index, with one reference taken for the caller */
+  uint32_t intern( const std::string& grapheme )
+  {
+    auto it = indices.find( grapheme );
+    if ( it != indices.end() ) {
+      retain( it->second );
+      return it->second;
+    }
+    uint32_t index;
+    if ( free_indices.empty() ) {
+      index = entries.size();
+      entries.push_back( Entry { grapheme, 1 } );
+    } else {
+      index = free_indices.back();
+      free_indices.pop_back();
+      entries[index] = Entry { grapheme, 1 };
+    }
+    indices.emplace( grapheme, index );
+    return index;
+  }
+};
+}
+
+/* Constructed on first use to avoid static initialization order
+   trouble, and never destroyed, since cells in other static objects
+   may outlive it. */
+static GraphemeTable& get_grapheme_table( void )
+{
+  static GraphemeTable* table = new GraphemeTable;
+  return *table;
+}
+
+const std::string& Cell::interned_grapheme( uint32_t index )
+{
+  return get_grapheme_table().get( index );
+}
+
+void Cell::retain_grapheme( uint32_t index )
+{
+  get_grapheme_table().retain( index );
+}
+
+void Cell::release_grapheme( uint32_t index )
+{
+  get_grapheme_table().release( index );
+}
+
+void Cell::append_bytes( const char* bytes, size_t len )
+{
+  if ( !interned && contents_size + len <= INLINE_SIZE ) {
+    memcpy( contents + contents_size, bytes, len );
+    contents_size += len;
+    return;
+  }
+
+  std::string grapheme( data(), size() );
+  grapheme.append( bytes, len );
+  const uint32_t index = get_grapheme_table().intern( grapheme );
+  clear();
+  memcpy( contents, &index, sizeof index );
+  interned = true;
+}
+
 void DrawState::reinitialize_tabs( unsigned int start )
 {
   assert( default_tabs );
@@ -72,26 +179,27 @@ DrawState::DrawState( int s_width, int s_height )
 }
 
 Framebuffer::Framebuffer( int s_width, int s_height )
-  : rows(), icon_name(), window_title(), clipboard(), bell_count( 0 ), title_initialized( false ),
-    ds( s_width, s_height )
+  : rows(), first_row( 0 ), icon_name(), window_title(), clipboard(), bell_count( 0 ),
+    title_initialized( false ), scrollback( NULL ), ds( s_width, s_height )
 {
   assert( s_height > 0 );
   assert( s_width > 0 );
   const size_t w = s_width;
   const color_type c = 0;
-  rows = rows_type( s_height, row_pointer( std::make_shared<Row>( w, c ) ) );
+  rows = rows_type( s_height, Row::create( w, c ) );
 }
 
 Framebuffer::Framebuffer( const Framebuffer& other )
-  : rows( other.rows ), icon_name( other.icon_name ), window_title( other.window_title ),
+  : rows( other.rows ), first_row( other.first_row ), icon_name( other.icon_name ), window_title( other.window_title ),
     clipboard( other.clipboard ), bell_count( other.bell_count ), title_initialized( other.title_initialized ),
-    ds( other.ds )
+    scrollback( NULL ), ds( other.ds )
 {}
 
 Framebuffer& Framebuffer::operator=( const Framebuffer& other )
 {
   if ( this != &other ) {
     rows = other.rows;
+    first_row = other.first_row;
     icon_name = other.icon_name;
     window_title = other.window_title;
     clipboard = other.clipboard;
@@ -102,9 +210,41 @@ Framebuffer& Framebuffer::operator=( const Framebuffer& other )
   return *this;
 }
 
+Framebuffer::rows_type Framebuffer::get_rows() const
+{
+  rows_type ret( rows.begin() + first_row, rows.end() );
+  ret.insert( ret.end(), rows.begin(), rows.begin() + first_row );
+  return ret;
+}
+
+bool Framebuffer::same_rows( const Framebuffer& x ) const
+{
+  if ( rows.size() != x.rows.size() ) {
+    return false;
+  }
+  for ( size_t i = 0; i < rows.size(); i++ ) {
+    if ( row_slot( i ) != x.row_slot( i ) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Framebuffer::linearize( void )
+{
+  std::rotate( rows.begin(), rows.begin() + first_row, rows.end() );
+  first_row = 0;
+}
+
 void Framebuffer::scroll( int N )
 {
   if ( N >= 0 ) {
+    if ( scrollback && ds.get_scrolling_region_top_row() == 0 ) {
+      const int lines = std::min( N, ds.get_scrolling_region_bottom_row() + 1 );
+      for ( int i = 0; i < lines; i++ ) {
+        scrollback->push( row_slot( i ) );
+      }
+    }
     delete_line( ds.get_scrolling_region_top_row(), N );
   } else {
     insert_line( ds.get_scrolling_region_top_row(), -N );
@@ -260,14 +400,6 @@ int DrawState::limit_bottom( void ) const
   return origin_mode ? scrolling_region_bottom_row : height - 1;
 }
 
-void Framebuffer::apply_renditions_to_cell( Cell* cell )
-{
-  if ( !cell ) {
-    cell = get_mutable_cell();
-  }
-  cell->set_renditions( ds.get_renditions() );
-}
-
 SavedCursor::SavedCursor()
   : cursor_col( 0 ), cursor_row( 0 ), renditions( 0 ), auto_wrap_mode( true ), origin_mode( false )
 {}
@@ -309,12 +441,26 @@ void Framebuffer::insert_line( int before_row, int count )
     return;
   }
 
-  // delete old rows
-  rows_type::iterator start = rows.begin() + ds.get_scrolling_region_bottom_row() + 1 - scroll;
-  rows.erase( start, start + scroll );
+  const row_pointer blank = newrow();
+  const int bottom = ds.get_scrolling_region_bottom_row();
+
+  if ( before_row == 0 && full_screen_region() ) {
+    /* scrolling the whole screen down: rotate the ring */
+    for ( int i = 0; i < scroll; i++ ) {
+      first_row = ( first_row == 0 ? rows.size() : first_row ) - 1;
+      row_slot( 0 ) = blank;
+    }
+    return;
+  }
+
+  // shift rows down over the ones pushed off the bottom of the region
+  for ( int i = bottom; i >= before_row + scroll; i-- ) {
+    row_slot( i ) = std::move( row_slot( i - scroll ) );
+  }
   // insert new rows
-  start = rows.begin() + before_row;
-  rows.insert( start, scroll, newrow() );
+  for ( int i = before_row; i < before_row + scroll; i++ ) {
+    row_slot( i ) = blank;
+  }
 }
 
 void Framebuffer::delete_line( int row, int count )
@@ -332,18 +478,165 @@ void Framebuffer::delete_line( int row, int count )
     return;
   }
 
-  // delete old rows
-  rows_type::iterator start = rows.begin() + row;
-  rows.erase( start, start + scroll );
+  const row_pointer blank = newrow();
+  const int bottom = ds.get_scrolling_region_bottom_row();
+
+  if ( row == 0 && full_screen_region() ) {
+    /* scrolling the whole screen up: rotate the ring */
+    for ( int i = 0; i < scroll; i++ ) {
+      row_slot( 0 ) = blank;
+      first_row = ( first_row + 1 == rows.size() ) ? 0 : first_row + 1;
+    }
+    return;
+  }
+
+  // shift rows up over the deleted ones
+  for ( int i = row; i + scroll <= bottom; i++ ) {
+    row_slot( i ) = std::move( row_slot( i + scroll ) );
+  }
   // insert a block of dummy rows
-  start = rows.begin() + ds.get_scrolling_region_bottom_row() + 1 - scroll;
-  rows.insert( start, scroll, newrow() );
+  for ( int i = bottom + 1 - scroll; i <= bottom; i++ ) {
+    row_slot( i ) = blank;
+  }
 }
 
 Row::Row( const size_t s_width, const color_type background_color )
-  : cells( s_width, Cell( background_color ) ), gen( get_gen() )
+  : cells( s_width ), gen( get_gen() ), references( 0 ), palette( 1, Renditions( background_color ) ),
+    last_rendition( 0 ), content_hash( 0 ), hash_valid( false ), serial( next_serial() ), base_serial( 0 ),
+    damage_start( 0 ), damage_end( 0 )
 {}
 
+uint64_t Row::next_serial( void )
+{
+  static uint64_t serial_counter = 0;
+  return ++serial_counter;
+}
+
+bool Row::changed_columns( const Row& old, int* start, int* end ) const
+{
+  if ( base_serial != old.serial || cells.size() != old.cells.size() ) {
+    return false;
+  }
+  *start = damage_start;
+  *end = std::max( damage_start, damage_end );
+  return true;
+}
+
+bool Row::operator==( const Row& x ) const
+{
+  if ( gen != x.gen ) {
+    return false;
+  }
+  int start, end;
+  if ( changed_columns( x, &start, &end ) || x.changed_columns( *this, &start, &end ) ) {
+    return same_cells( x, start, end );
+  }
+  return same_contents( x );
+}
+
+bool Row::same_cells( const Row& x, int start, int end ) const
+{
+  for ( int col = start; col < end; col++ ) {
+    if ( !same_cell( col, x, col ) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Row::compute_hash( void ) const
+{
+  uint64_t h = cells.size();
+  for ( const Cell& cell : cells ) {
+    const uint64_t renditions_hash = palette[cell.rendition].hash_value() * 0x9e3779b97f4a7c15ULL;
+    h = ( ( h << 5 ) | ( h >> 59 ) ) ^ cell.hash_value() ^ renditions_hash;
+    h *= 0x100000001b3ULL;
+  }
+  content_hash = h;
+  hash_valid = true;
+}
+
+/* Rows whose last reference has gone, kept for reuse so that the
+   emulator's copy-on-write and the sender's retained states don't
+   churn the allocator.  Only rows of one width are kept: that of the
+   most recently released row, which is the current screen width. */
+namespace {
+class RowPool
+{
+private:
+  static const size_t MAX_POOLED_CELLS = 1 << 18;
+
+  size_t width;
+  std::vector<Row*> rows;
+
+public:
+  RowPool() : width( 0 ), rows() {}
+
+  Row* take( size_t s_width )
+  {
+    if ( s_width != width || rows.empty() ) {
+      return NULL;
+    }
+    Row* row = rows.back();
+    rows.pop_back();
+    return row;
+  }
+
+  void give( Row* row )
+  {
+    const size_t row_width = row->cells.size();
+    if ( row_width != width ) {
+      for ( Row* r : rows ) {
+        delete r;
+      }
+      rows.clear();
+      width = row_width;
+    }
+    if ( ( rows.size() + 1 ) * row_width > MAX_POOLED_CELLS ) {
+      delete row;
+      return;
+    }
+    rows.push_back( row );
+  }
+};
+}
+
+/* Never destroyed, since rows held by static objects may still be
+   released during exit. */
+static RowPool& get_row_pool( void )
+{
+  static RowPool* pool = new RowPool;
+  return *pool;
+}
+
+void Row::recycle( Row* row )
+{
+  get_row_pool().give( row );
+}
+
+RowPointer Row::create( size_t width, color_type background_color )
+{
+  Row* row = get_row_pool().take( width );
+  if ( row ) {
+    row->reset( background_color );
+    row->base_serial = 0;
+  } else {
+    row = new Row( width, background_color );
+  }
+  return RowPointer( row );
+}
+
+RowPointer Row::create( const Row& other )
+{
+  Row* row = get_row_pool().take( other.cells.size() );
+  if ( row ) {
+    *row = other;
+  } else {
+    row = new Row( other );
+  }
+  return RowPointer( row );
+}
+
 uint64_t Row::get_gen() const
 {
   static uint64_t gen_counter = 0;
@@ -352,24 +645,78 @@ uint64_t Row::get_gen() const
 
 void Row::insert_cell( int col, color_type background_color )
 {
-  cells.insert( cells.begin() + col, Cell( background_color ) );
+  Cell blank;
+  blank.rendition = intern_renditions( Renditions( background_color ) );
+  cells.insert( cells.begin() + col, blank );
   cells.pop_back();
+  damage( col, cells.size() );
 }
 
 void Row::delete_cell( int col, color_type background_color )
 {
-  cells.push_back( Cell( background_color ) );
+  Cell blank;
+  blank.rendition = intern_renditions( Renditions( background_color ) );
+  cells.push_back( blank );
   cells.erase( cells.begin() + col );
+  damage( col, cells.size() );
+}
+
+void Row::resize( size_t width, color_type background_color )
+{
+  Cell blank;
+  blank.rendition = intern_renditions( Renditions( background_color ) );
+  cells.resize( width, blank );
+  damage( 0, cells.size() );
+}
+
+uint16_t Row::add_renditions( const Renditions& r )
+{
+  for ( size_t i = 0; i < palette.size(); i++ ) {
+    if ( palette[i] == r ) {
+      last_rendition = i;
+      return last_rendition;
+    }
+  }
+  /* Compacting leaves at most one entry per cell, so waiting until the
+     palette is twice the width keeps it rare.  Indices stay within 16
+     bits for any width a window can have (at most 65535 columns). */
+  if ( palette.size() >= std::min<size_t>( 2 * cells.size() + 16, UINT16_MAX ) ) {
+    compact_palette();
+  }
+  palette.push_back( r );
+  last_rendition = palette.size() - 1;
+  return last_rendition;
+}
+
+/* Drop the entries no cell uses, keeping the order of the rest. */
+void Row::compact_palette( void )
+{
+  std::vector<uint16_t> remap( palette.size(), 0 );
+  for ( const Cell& cell : cells ) {
+    remap[cell.rendition] = 1;
+  }
+  size_t used = 0;
+  for ( size_t i = 0; i < palette.size(); i++ ) {
+    if ( remap[i] ) {
+      palette[used] = palette[i];
+      remap[i] = used++;
+    }
+  }
+  palette.resize( used, palette[0] );
+  for ( Cell& cell : cells ) {
+    cell.rendition = remap[cell.rendition];
+  }
+  last_rendition = 0;
 }
 
 void Framebuffer::insert_cell( int row, int col )
 {
-  get_mutable_row( row )->insert_cell( col, ds.get_background_rendition() );
+  get_mutable_row( row, col, ds.get_width() )->insert_cell( col, ds.get_background_rendition() );
 }
 
 void Framebuffer::delete_cell( int row, int col )
 {
-  get_mutable_row( row )->delete_cell( col, ds.get_background_rendition() );
+  get_mutable_row( row, col, ds.get_width() )->delete_cell( col, ds.get_background_rendition() );
 }
 
 void Framebuffer::reset( void )
@@ -377,6 +724,7 @@ void Framebuffer::reset( void )
   int width = ds.get_width(), height = ds.get_height();
   ds = DrawState( width, height );
   rows = rows_type( height, newrow() );
+  first_row = 0;
   window_title.clear();
   clipboard.clear();
   /* do not reset bell_count */
@@ -402,6 +750,7 @@ void Framebuffer::resize( int s_width, int s_height )
   int oldwidth = ds.get_width();
   ds.resize( s_width, s_height );
 
+  linearize();
   row_pointer blankrow( newrow() );
   if ( oldheight != s_height ) {
     rows.resize( s_height, blankrow );
@@ -410,9 +759,9 @@ void Framebuffer::resize( int s_width, int s_height )
     return;
   }
   for ( rows_type::iterator i = rows.begin(); i != rows.end() && *i != blankrow; i++ ) {
-    *i = std::make_shared<Row>( **i );
+    *i = Row::create( **i );
     ( *i )->set_wrap( false );
-    ( *i )->cells.resize( s_width, Cell( ds.get_background_rendition() ) );
+    ( *i )->resize( s_width, ds.get_background_rendition() );
   }
 }
 
@@ -445,37 +794,40 @@ void DrawState::resize( int s_width, int s_height )
 }
 
 Renditions::Renditions( color_type s_background )
-  : foreground_color( 0 ), background_color( s_background ), attributes( 0 )
-{}
+  : bits( 0 )
+{
+  store_background_color( s_background );
+}
 
 /* This routine cannot be used to set a color beyond the 16-color set. */
 void Renditions::set_rendition( color_type num )
 {
   if ( num == 0 ) {
     clear_attributes();
-    foreground_color = background_color = 0;
+    store_foreground_color( 0 );
+    store_background_color( 0 );
     return;
   }
 
   if ( num == 39 ) {
-    foreground_color = 0;
+    store_foreground_color( 0 );
     return;
   } else if ( num == 49 ) {
-    background_color = 0;
+    store_background_color( 0 );
     return;
   }
 
   if ( ( 30 <= num ) && ( num <= 37 ) ) { /* foreground color in 8-color set */
-    foreground_color = num;
+    store_foreground_color( num );
     return;
   } else if ( ( 40 <= num ) && ( num <= 47 ) ) { /* background color in 8-color set */
-    background_color = num;
+    store_background_color( num );
     return;
   } else if ( ( 90 <= num ) && ( num <= 97 ) ) { /* foreground color in 16-color set */
-    foreground_color = num - 90 + 38;
+    store_foreground_color( num - 90 + 38 );
     return;
   } else if ( ( 100 <= num ) && ( num <= 107 ) ) { /* background color in 16-color set */
-    background_color = num - 100 + 48;
+    store_background_color( num - 100 + 48 );
     return;
   }
 
@@ -513,93 +865,132 @@ void Renditions::set_rendition( color_type num )
 void Renditions::set_foreground_color( int num )
 {
   if ( ( 0 <= num ) && ( num <= 255 ) ) {
-    foreground_color = 30 + num;
+    store_foreground_color( 30 + num );
   } else if ( is_true_color( num ) ) {
-    foreground_color = num;
+    store_foreground_color( num );
   }
 }
 
 void Renditions::set_background_color( int num )
 {
   if ( ( 0 <= num ) && ( num <= 255 ) ) {
-    background_color = 40 + num;
+    store_background_color( 40 + num );
   } else if ( is_true_color( num ) ) {
-    background_color = num;
+    store_background_color( num );
   }
 }
 
-std::string Renditions::sgr( void ) const
+/* SGR parameters for a color, each preceded by a semicolon */
+static void append_color( std::string& ret, unsigned int color, bool background )
 {
-  std::string ret;
-  char col[64];
+  const unsigned int base = background ? 40 : 30;
+  if ( Renditions::is_true_color( color ) ) {
+    ret.append( background ? ";48;2;" : ";38;2;" );
+    append_decimal( ret, ( color >> 16 ) & 0xff );
+    ret.push_back( ';' );
+    append_decimal( ret, ( color >> 8 ) & 0xff );
+    ret.push_back( ';' );
+    append_decimal( ret, color & 0xff );
+  } else if ( color > base + 7 ) { /* use 256-color set */
+    ret.append( background ? ";48;5;" : ";38;5;" );
+    append_decimal( ret, color - base );
+  } else { /* ANSI color */
+    ret.push_back( ';' );
+    append_decimal( ret, color );
+  }
+}
 
-  ret.append( "\033[0" );
-  if ( get_attribute( bold ) )
-    ret.append( ";1" );
-  if ( get_attribute( italic ) )
-    ret.append( ";3" );
-  if ( get_attribute( underlined ) )
-    ret.append( ";4" );
-  if ( get_attribute( blink ) )
-    ret.append( ";5" );
-  if ( get_attribute( inverse ) )
-    ret.append( ";7" );
-  if ( get_attribute( invisible ) )
-    ret.append( ";8" );
+/* Attributes append_sgr() sets, with the parameters that turn them on
+   and off */
+static const struct
+{
+  Renditions::attribute_type attribute;
+  const char *on, *off;
+} sgr_attributes[] = {
+  { Renditions::bold, ";1", ";22" },      { Renditions::italic, ";3", ";23" },  { Renditions::underlined, ";4", ";24" },
+  { Renditions::blink, ";5", ";25" },     { Renditions::inverse, ";7", ";27" }, { Renditions::invisible, ";8", ";28" },
+};
+
+/* A reset followed by every attribute and color */
+void Renditions::append_sgr( std::string& out ) const
+{
+  const unsigned int fg = foreground_color();
+  const unsigned int bg = background_color();
 
-  if ( foreground_color ) {
-    // Since foreground_color is a 25-bit field, it is promoted to an int when
-    // manipulated. (See [conv.prom] in various C++ standards, e.g.,
-    // https://timsong-cpp.github.io/cppwp/n4659/conv.prom#5.) The correct
-    // printf format specifier is thus %d.
-    if ( is_true_color( foreground_color ) ) {
-      snprintf( col,
-                sizeof( col ),
-                ";38;2;%d;%d;%d",
-                ( foreground_color >> 16 ) & 0xff,
-                ( foreground_color >> 8 ) & 0xff,
-                foreground_color & 0xff );
-    } else if ( foreground_color > 37 ) { /* use 256-color set */
-      snprintf( col, sizeof( col ), ";38;5;%d", foreground_color - 30 );
-    } else { /* ANSI foreground color */
-      // Unfortunately, some versions of GCC (notably including GCC 9.3) give
-      // -Wformat warnings when relying on [conv.prom] to promote
-      // foreground_color in calls to printf. Explicitly promote it to silence
-      // the warning.
-      int fg = foreground_color;
-      snprintf( col, sizeof( col ), ";%d", fg );
+  out.append( "\033[0" );
+  for ( const auto& a : sgr_attributes ) {
+    if ( get_attribute( a.attribute ) ) {
+      out.append( a.on );
     }
-    ret.append( col );
   }
-  if ( background_color ) {
-    // See comment above about bit-field promotion; it applies here as well.
-    if ( is_true_color( background_color ) ) {
-      snprintf( col,
-                sizeof( col ),
-                ";48;2;%d;%d;%d",
-                ( background_color >> 16 ) & 0xff,
-                ( background_color >> 8 ) & 0xff,
-                background_color & 0xff );
-    } else if ( background_color > 47 ) { /* use 256-color set */
-      snprintf( col, sizeof( col ), ";48;5;%d", background_color - 40 );
-    } else { /* ANSI background color */
-      // See comment above about explicit promotion; it applies here as well.
-      int bg = background_color;
-      snprintf( col, sizeof( col ), ";%d", bg );
+
+  if ( fg ) {
+    append_color( out, fg, false );
+  }
+  if ( bg ) {
+    append_color( out, bg, true );
+  }
+  out.append( "m" );
+}
+
+/* The shortest SGR sequence taking a terminal from the renditions from
+   to these: only the attributes and colors that change, or the full
+   reset.  Both are written, and the longer one taken out again. */
+void Renditions::append_sgr( std::string& out, const Renditions& from ) const
+{
+  const size_t start = out.size();
+  append_sgr( out );
+  const size_t full = out.size() - start;
+
+  out.append( "\033[" );
+  const size_t params = out.size();
+  for ( const auto& a : sgr_attributes ) {
+    if ( get_attribute( a.attribute ) != from.get_attribute( a.attribute ) ) {
+      out.append( get_attribute( a.attribute ) ? a.on : a.off );
     }
-    ret.append( col );
   }
-  ret.append( "m" );
 
-  return ret;
+  const unsigned int fg = foreground_color();
+  const unsigned int bg = background_color();
+  if ( fg != from.foreground_color() ) {
+    if ( fg ) {
+      append_color( out, fg, false );
+    } else {
+      out.append( ";39" );
+    }
+  }
+  if ( bg != from.background_color() ) {
+    if ( bg ) {
+      append_color( out, bg, true );
+    } else {
+      out.append( ";49" );
+    }
+  }
+
+  if ( out.size() == params ) {
+    out.resize( start ); /* nothing append_sgr() would show has changed */
+    return;
+  }
+  out.erase( params, 1 ); /* the first semicolon */
+  out.append( "m" );
+
+  if ( out.size() - start - full < full ) {
+    out.erase( start, full );
+  } else {
+    out.resize( start + full );
+  }
 }
 
 void Row::reset( color_type background_color )
 {
   gen = get_gen();
+  palette.assign( 1, Renditions( background_color ) );
+  last_rendition = 0;
   for ( cells_type::iterator i = cells.begin(); i != cells.end(); i++ ) {
-    i->reset( background_color );
+    i->reset();
+    i->rendition = 0;
   }
+  damage( 0, cells.size() );
 }
 
 void Framebuffer::prefix_window_title( const title_type& s )
@@ -613,7 +1004,7 @@ void Framebuffer::prefix_window_title( const title_type& s )
 
 std::string Cell::debug_contents( void ) const
 {
-  if ( contents.empty() ) {
+  if ( empty() ) {
     return "'_' ()";
   }
   std::string chars( 1, '\'' );
@@ -621,7 +1012,7 @@ std::string Cell::debug_contents( void ) const
   chars.append( "' [" );
   const char* lazycomma = "";
   char buf[64];
-  for ( content_type::const_iterator i = contents.begin(); i < contents.end(); i++ ) {
+  for ( const char *i = data(), *end = data() + size(); i < end; i++ ) {
 
     snprintf( buf, sizeof buf, "%s0x%02x", lazycomma, static_cast<uint8_t>( *i ) );
     chars.append( buf );
@@ -650,9 +1041,9 @@ bool Cell::compare( const Cell& other ) const
     fprintf( stderr,
              "Contents: %s (%ld) vs. %s (%ld)\n",
              debug_contents().c_str(),
-             static_cast<long int>( contents.size() ),
+             static_cast<long int>( size() ),
              other.debug_contents().c_str(),
-             static_cast<long int>( other.contents.size() ) );
+             static_cast<long int>( other.size() ) );
   }
 
   if ( fallback != other.fallback ) {
@@ -670,11 +1061,6 @@ bool Cell::compare( const Cell& other ) const
     fprintf( stderr, "width: %d vs. %d\n", wide, other.wide );
   }
 
-  if ( !( renditions == other.renditions ) ) {
-    ret = true;
-    fprintf( stderr, "renditions differ\n" );
-  }
-
   if ( wrap != other.wrap ) {
     ret = true;
     // See comment above about bit-field promotion; it applies here as well.
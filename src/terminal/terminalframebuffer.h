@@ -33,13 +33,17 @@
 #ifndef TERMINALFB_HPP
 #define TERMINALFB_HPP
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
 #include <cstdint>
+#include <cstring>
 #include <deque>
 #include <list>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 /* Terminal framebuffer */
@@ -47,6 +51,19 @@
 namespace Terminal {
 using color_type = uint32_t;
 
+/* Appends n in decimal; escape sequences are built often enough that
+   snprintf shows up. */
+inline void append_decimal( std::string& out, unsigned int n )
+{
+  char digits[10];
+  size_t i = sizeof digits;
+  do {
+    digits[--i] = '0' + n % 10;
+    n /= 10;
+  } while ( n );
+  out.append( digits + i, sizeof digits - i );
+}
+
 class Renditions
 {
 public:
@@ -64,16 +81,31 @@ public:
 
 private:
   static const uint64_t true_color_mask = 0x1000000;
-  uint64_t foreground_color : 25;
-  uint64_t background_color : 25;
-  uint64_t attributes : 8;
+
+  /* Foreground color, background color and attributes share one word,
+     with the unused bits kept zero, so that renditions compare (and
+     hash) as a single integer. */
+  static const int color_bits = 25;
+  static const uint64_t color_mask = ( uint64_t( 1 ) << color_bits ) - 1;
+  static const int background_shift = color_bits;
+  static const int attribute_shift = 2 * color_bits;
+  uint64_t bits;
+
+  unsigned int foreground_color( void ) const { return bits & color_mask; }
+  unsigned int background_color( void ) const { return ( bits >> background_shift ) & color_mask; }
+  void store_foreground_color( uint64_t color ) { bits = ( bits & ~color_mask ) | ( color & color_mask ); }
+  void store_background_color( uint64_t color )
+  {
+    bits = ( bits & ~( color_mask << background_shift ) ) | ( ( color & color_mask ) << background_shift );
+  }
 
 public:
   Renditions( color_type s_background );
   void set_foreground_color( int num );
   void set_background_color( int num );
   void set_rendition( color_type num );
-  std::string sgr( void ) const;
+  void append_sgr( std::string& out ) const;
+  void append_sgr( std::string& out, const Renditions& from ) const;
 
   static unsigned int make_true_color( unsigned int r, unsigned int g, unsigned int b )
   {
@@ -82,95 +114,199 @@ public:
 
   static bool is_true_color( unsigned int color ) { return ( color & true_color_mask ) != 0; }
 
-  // unsigned int get_foreground_rendition() const { return foreground_color; }
-  unsigned int get_background_rendition() const { return background_color; }
+  // unsigned int get_foreground_rendition() const { return foreground_color(); }
+  unsigned int get_background_rendition() const { return background_color(); }
 
-  bool operator==( const Renditions& x ) const
-  {
-    return ( attributes == x.attributes ) && ( foreground_color == x.foreground_color )
-           && ( background_color == x.background_color );
-  }
+  bool operator==( const Renditions& x ) const { return bits == x.bits; }
+  uint64_t hash_value( void ) const { return bits; }
   void set_attribute( attribute_type attr, bool val )
   {
-    attributes = val ? ( attributes | ( 1 << attr ) ) : ( attributes & ~( 1 << attr ) );
+    const uint64_t bit = uint64_t( 1 ) << ( attribute_shift + attr );
+    bits = val ? ( bits | bit ) : ( bits & ~bit );
   }
-  bool get_attribute( attribute_type attr ) const { return attributes & ( 1 << attr ); }
-  void clear_attributes() { attributes = 0; }
+  bool get_attribute( attribute_type attr ) const { return bits & ( uint64_t( 1 ) << ( attribute_shift + attr ) ); }
+  void clear_attributes() { bits &= ( uint64_t( 1 ) << attribute_shift ) - 1; }
 };
 
 class Cell
 {
 private:
-  typedef std::string content_type; /* can be std::string, std::vector<uint8_t>, or __gnu_cxx::__vstring */
-  content_type contents;
-  Renditions renditions;
-  unsigned int wide : 1;     /* 0 = narrow, 1 = wide */
-  unsigned int fallback : 1; /* first character is combining character */
-  unsigned int wrap : 1;
+  friend class Row;
+
+  /* Graphemes of up to INLINE_SIZE bytes, which is nearly all of them,
+     are kept in the cell itself.  Longer ones are interned in a table
+     shared by all cells, and the cell holds their index and one of the
+     entry's references; the entry is freed with its last cell. */
+  static const size_t INLINE_SIZE = 5;
+
+  char contents[INLINE_SIZE]; /* unused bytes are zero */
+  uint8_t contents_size : 3;
+  uint8_t interned : 1; /* contents holds an index into the grapheme table */
+  uint8_t wide : 1;     /* 0 = narrow, 1 = wide */
+  uint8_t fallback : 1; /* first character is combining character */
+  uint8_t wrap : 1;
+  /* The cell's renditions, as an index into the palette of the row
+     holding it; meaningless for a cell copied out of its row. */
+  uint16_t rendition;
+
+  static const std::string& interned_grapheme( uint32_t index );
+  static void retain_grapheme( uint32_t index );
+  static void release_grapheme( uint32_t index );
+  uint32_t interned_index( void ) const
+  {
+    uint32_t index;
+    memcpy( &index, contents, sizeof index );
+    return index;
+  }
 
-private:
-  Cell();
+  const char* data( void ) const { return interned ? interned_grapheme( interned_index() ).data() : contents; }
+  size_t size( void ) const { return interned ? interned_grapheme( interned_index() ).size() : contents_size; }
+
+  bool same_contents( const Cell& x ) const
+  {
+    return ( contents_size == x.contents_size ) && ( interned == x.interned )
+           && ( memcmp( contents, x.contents, INLINE_SIZE ) == 0 );
+  }
+
+  void append_bytes( const char* bytes, size_t len );
 
 public:
-  Cell( color_type background_color );
+  Cell();
 
-  void reset( color_type background_color );
+  Cell( const Cell& x )
+    : contents(), contents_size( x.contents_size ), interned( x.interned ), wide( x.wide ), fallback( x.fallback ),
+      wrap( x.wrap ), rendition( x.rendition )
+  {
+    memcpy( contents, x.contents, INLINE_SIZE );
+    if ( interned ) {
+      retain_grapheme( interned_index() );
+    }
+  }
+
+  Cell& operator=( const Cell& x )
+  {
+    if ( x.interned ) {
+      retain_grapheme( x.interned_index() );
+    }
+    if ( interned ) {
+      release_grapheme( interned_index() );
+    }
+    memcpy( contents, x.contents, INLINE_SIZE );
+    contents_size = x.contents_size;
+    interned = x.interned;
+    wide = x.wide;
+    fallback = x.fallback;
+    wrap = x.wrap;
+    rendition = x.rendition;
+    return *this;
+  }
 
+  ~Cell()
+  {
+    if ( interned ) {
+      release_grapheme( interned_index() );
+    }
+  }
+
+  /* Blanks the cell; its row sets the renditions. */
+  void reset( void );
+
+  /* Cells compare by what they show apart from renditions, which are
+     the row's to compare (see Row::same_cell). */
   bool operator==( const Cell& x ) const
   {
-    return ( ( contents == x.contents ) && ( fallback == x.fallback ) && ( wide == x.wide )
-             && ( renditions == x.renditions ) && ( wrap == x.wrap ) );
+    return ( same_contents( x ) && ( fallback == x.fallback ) && ( wide == x.wide ) && ( wrap == x.wrap ) );
   }
 
   bool operator!=( const Cell& x ) const { return !operator==( x ); }
 
+  /* Equal cells hash equally; built field by field, since the bytes of
+     a cell include the rendition index. */
+  uint64_t hash_value( void ) const
+  {
+    uint64_t packed = 0;
+    memcpy( &packed, contents, INLINE_SIZE );
+    return ( packed << 8 ) | contents_size | ( interned << 3 ) | ( wide << 4 ) | ( fallback << 5 ) | ( wrap << 6 );
+  }
+
   /* Accessors for contents field */
   std::string debug_contents( void ) const;
 
-  bool empty( void ) const { return contents.empty(); }
+  bool empty( void ) const { return contents_size == 0 && !interned; }
   /* 32 seems like a reasonable limit on combining characters */
-  bool full( void ) const { return contents.size() >= 32; }
-  void clear( void ) { contents.clear(); }
+  bool full( void ) const { return size() >= 32; }
+  void clear( void )
+  {
+    if ( interned ) {
+      release_grapheme( interned_index() );
+    }
+    memset( contents, 0, INLINE_SIZE );
+    contents_size = 0;
+    interned = false;
+  }
 
   bool is_blank( void ) const
   {
     // XXX fix.
-    return ( contents.empty() || contents == " " || contents == "\xC2\xA0" );
+    return ( empty() || ( contents_size == 1 && contents[0] == ' ' )
+             || ( contents_size == 2 && contents[0] == '\xC2' && contents[1] == '\xA0' ) );
   }
 
-  bool contents_match( const Cell& other ) const
+  /* Does the cell hold exactly one character, printed in how many bytes? */
+  bool is_single_character( void ) const
   {
-    return ( is_blank() && other.is_blank() ) || ( contents == other.contents );
+    if ( empty() || fallback ) {
+      return false;
+    }
+    const unsigned char lead = data()[0];
+    const size_t length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+    return size() == length;
   }
+  size_t printed_size( void ) const { return empty() ? 1 : size() + ( fallback ? 2 : 0 ); }
 
-  bool compare( const Cell& other ) const;
-
-  // Is this a printing ISO 8859-1 character?
-  static bool isprint_iso8859_1( const wchar_t c )
+  bool contents_match( const Cell& other ) const
   {
-    return ( c <= 0xff && c >= 0xa0 ) || ( c <= 0x7e && c >= 0x20 );
+    return ( is_blank() && other.is_blank() ) || same_contents( other );
   }
 
+  bool compare( const Cell& other ) const;
+
+  /* Encodes c as UTF-8, which mosh requires of the locale, without a
+     trip through wcrtomb.  What has no encoding becomes U+FFFD. */
   static void append_to_str( std::string& dest, const wchar_t c )
   {
-    /* ASCII?  Cheat. */
-    if ( static_cast<uint32_t>( c ) <= 0x7f ) {
-      dest.push_back( static_cast<char>( c ) );
+    uint32_t u = c;
+    if ( u <= 0x7f ) {
+      dest.push_back( static_cast<char>( u ) );
       return;
     }
-    static mbstate_t ps = mbstate_t();
-    char tmp[MB_LEN_MAX];
-    size_t ignore = wcrtomb( NULL, 0, &ps );
-    (void)ignore;
-    size_t len = wcrtomb( tmp, c, &ps );
+    if ( u > 0x10ffff || ( u >= 0xd800 && u <= 0xdfff ) ) {
+      u = 0xfffd;
+    }
+    char tmp[4];
+    size_t len;
+    if ( u <= 0x7ff ) {
+      tmp[0] = 0xc0 | ( u >> 6 );
+      len = 2;
+    } else if ( u <= 0xffff ) {
+      tmp[0] = 0xe0 | ( u >> 12 );
+      tmp[1] = 0x80 | ( ( u >> 6 ) & 0x3f );
+      len = 3;
+    } else {
+      tmp[0] = 0xf0 | ( u >> 18 );
+      tmp[1] = 0x80 | ( ( u >> 12 ) & 0x3f );
+      tmp[2] = 0x80 | ( ( u >> 6 ) & 0x3f );
+      len = 4;
+    }
+    tmp[len - 1] = 0x80 | ( u & 0x3f );
     dest.append( tmp, len );
   }
 
   void append( const wchar_t c )
   {
     /* ASCII?  Cheat. */
-    if ( static_cast<uint32_t>( c ) <= 0x7f ) {
-      contents.push_back( static_cast<char>( c ) );
+    if ( static_cast<uint32_t>( c ) <= 0x7f && contents_size < INLINE_SIZE && !interned ) {
+      contents[contents_size++] = static_cast<char>( c );
       return;
     }
     static mbstate_t ps = mbstate_t();
@@ -178,12 +314,12 @@ public:
     size_t ignore = wcrtomb( NULL, 0, &ps );
     (void)ignore;
     size_t len = wcrtomb( tmp, c, &ps );
-    contents.insert( contents.end(), tmp, tmp + len );
+    append_bytes( tmp, len );
   }
 
   void print_grapheme( std::string& output ) const
   {
-    if ( contents.empty() ) {
+    if ( empty() ) {
       output.append( 1, ' ' );
       return;
     }
@@ -194,13 +330,10 @@ public:
     if ( fallback ) {
       output.append( "\xC2\xA0" );
     }
-    output.append( contents );
+    output.append( data(), size() );
   }
 
   /* Other accessors */
-  const Renditions& get_renditions( void ) const { return renditions; }
-  Renditions& get_renditions( void ) { return renditions; }
-  void set_renditions( const Renditions& r ) { renditions = r; }
   bool get_wide( void ) const { return wide; }
   void set_wide( bool w ) { wide = w; }
   unsigned int get_width( void ) const { return wide + 1; }
@@ -210,6 +343,11 @@ public:
   void set_wrap( bool f ) { wrap = f; }
 };
 
+static_assert( sizeof( Cell ) == 8, "cells should stay compact" );
+
+class RowPointer;
+class Scrollback;
+
 class Row
 {
 public:
@@ -221,22 +359,215 @@ public:
   uint64_t gen;
 
 private:
+  friend class RowPointer;
+  unsigned int references;
+
+  /* The renditions the cells use, each held once, and each cell
+     holding an index into this.  Rows seldom use more than a few, so a lookup usually hits
+     the last one asked for.  Entries no cell uses any more are
+     dropped when the palette grows well past the row's width. */
+  std::vector<Renditions> palette;
+  uint16_t last_rendition;
+
+  /* Hash of the cells, computed when first asked for. */
+  mutable uint64_t content_hash;
+  mutable bool hash_valid;
+
+  /* serial names this row's contents, and changes whenever they do.  A
+     copy remembers the serial of the row it was copied from, and which
+     columns [damage_start, damage_end) may have changed since. */
+  uint64_t serial;
+  uint64_t base_serial;
+  int damage_start, damage_end;
+
   Row();
 
+  /* Called when the last RowPointer to a row goes away. */
+  static void recycle( Row* row );
+
+  static uint64_t next_serial( void );
+
+  void become_copy_of( const Row& other )
+  {
+    gen = other.gen;
+    last_rendition = other.last_rendition;
+    content_hash = other.content_hash;
+    hash_valid = other.hash_valid;
+    serial = next_serial();
+    base_serial = other.serial;
+    damage_start = damage_end = 0;
+  }
+
+  uint16_t intern_renditions( const Renditions& r )
+  {
+    if ( palette[last_rendition] == r ) {
+      return last_rendition;
+    }
+    return add_renditions( r );
+  }
+  uint16_t add_renditions( const Renditions& r );
+  void compact_palette( void );
+
+  bool same_cells( const Row& x, int start, int end ) const;
+
 public:
   Row( const size_t s_width, const color_type background_color );
+  Row( const Row& other ) : cells( other.cells ), references( 0 ), palette( other.palette )
+  {
+    become_copy_of( other );
+  }
+  Row& operator=( const Row& other )
+  {
+    cells = other.cells;
+    palette = other.palette;
+    become_copy_of( other );
+    return *this;
+  }
+
+  /* New blank rows and copies of rows, reusing pooled rows when possible. */
+  static RowPointer create( size_t width, color_type background_color );
+  static RowPointer create( const Row& other );
 
   void insert_cell( int col, color_type background_color );
   void delete_cell( int col, color_type background_color );
+  void resize( size_t width, color_type background_color );
 
   void reset( color_type background_color );
+  void reset_cell( int col, color_type background_color )
+  {
+    const uint16_t index = intern_renditions( Renditions( background_color ) );
+    cells[col].reset();
+    cells[col].rendition = index;
+  }
+
+  /* Renditions are read and changed through the row, which owns the
+     palette the cells index. */
+  const Renditions& get_renditions( int col ) const { return palette[cells[col].rendition]; }
+  void set_renditions( int col, const Renditions& r )
+  {
+    const uint16_t index = intern_renditions( r );
+    cells[col].rendition = index;
+  }
+  /* Stores a cell, which may have come from another row, with the given renditions. */
+  void set_cell( int col, const Cell& cell, const Renditions& r )
+  {
+    const uint16_t index = intern_renditions( r );
+    cells[col] = cell;
+    cells[col].rendition = index;
+  }
+
+  /* Do two cells of this row show the same thing?  The palette holds
+     each rendition once, so their indices can be compared directly. */
+  bool same_cell( int col, int other_col ) const
+  {
+    return cells[col] == cells[other_col] && cells[col].rendition == cells[other_col].rendition;
+  }
+  bool same_renditions( int col, int other_col ) const
+  {
+    return cells[col].rendition == cells[other_col].rendition;
+  }
+  /* ... or a cell of this row and one of another */
+  bool same_cell( int col, const Row& other, int other_col ) const
+  {
+    return cells[col] == other.cells[other_col] && get_renditions( col ) == other.get_renditions( other_col );
+  }
 
-  bool operator==( const Row& x ) const { return ( gen == x.gen && cells == x.cells ); }
+  uint64_t hash( void ) const
+  {
+    if ( !hash_valid ) {
+      compute_hash();
+    }
+    return content_hash;
+  }
+
+  /* Anything that changes the cells must say which ones; Framebuffer
+     does so whenever it hands out a mutable row. */
+  void damage( int start, int end )
+  {
+    hash_valid = false;
+    serial = next_serial();
+    if ( damage_start >= damage_end ) {
+      damage_start = start;
+      damage_end = end;
+    } else {
+      damage_start = std::min( damage_start, start );
+      damage_end = std::max( damage_end, end );
+    }
+  }
+
+  /* If this row is a copy of old, set the columns outside of which the
+     two are known to match. */
+  bool changed_columns( const Row& old, int* start, int* end ) const;
+
+  bool same_contents( const Row& x ) const
+  {
+    return ( hash() == x.hash() && cells.size() == x.cells.size() && same_cells( x, 0, cells.size() ) );
+  }
+  bool operator==( const Row& x ) const;
 
   bool get_wrap( void ) const { return cells.back().get_wrap(); }
-  void set_wrap( bool w ) { cells.back().set_wrap( w ); }
+  void set_wrap( bool w )
+  {
+    cells.back().set_wrap( w );
+    damage( cells.size() - 1, cells.size() );
+  }
 
   uint64_t get_gen() const;
+
+private:
+  void compute_hash( void ) const;
+};
+
+/* Rows are shared between framebuffers (see below) with a reference
+   count kept in the row itself.  Mosh is single-threaded, so the count
+   needs no atomics, and a row is handed back to a pool for reuse
+   rather than freed when its last reference goes away. */
+class RowPointer
+{
+private:
+  Row* row;
+
+  void acquire( void )
+  {
+    if ( row ) {
+      row->references++;
+    }
+  }
+
+  void release( void )
+  {
+    if ( row && --row->references == 0 ) {
+      Row::recycle( row );
+    }
+  }
+
+public:
+  RowPointer() : row( NULL ) {}
+  explicit RowPointer( Row* s_row ) : row( s_row ) { acquire(); }
+  RowPointer( const RowPointer& other ) : row( other.row ) { acquire(); }
+  RowPointer( RowPointer&& other ) noexcept : row( other.row ) { other.row = NULL; }
+  ~RowPointer() { release(); }
+
+  RowPointer& operator=( const RowPointer& other )
+  {
+    RowPointer copy( other );
+    std::swap( row, copy.row );
+    return *this;
+  }
+
+  RowPointer& operator=( RowPointer&& other ) noexcept
+  {
+    std::swap( row, other.row );
+    return *this;
+  }
+
+  Row* get( void ) const { return row; }
+  Row& operator*( void ) const { return *row; }
+  Row* operator->( void ) const { return row; }
+  bool unique( void ) const { return row->references == 1; }
+
+  bool operator==( const RowPointer& x ) const { return row == x.row; }
+  bool operator!=( const RowPointer& x ) const { return row != x.row; }
 };
 
 class SavedCursor
@@ -361,10 +692,10 @@ public:
 
 class Framebuffer
 {
-  // To minimize copying of rows and cells, we use shared_ptr to
+  // To minimize copying of rows and cells, we use RowPointer to
   // share unchanged rows between multiple Framebuffers.  If we
   // write to a row in a Framebuffer and it is shared with other
-  // owners, we copy it first.  The shared_ptr naturally manages the
+  // owners, we copy it first.  The RowPointer naturally manages the
   // usage of the actual rows themselves.
   //
   // We gain a couple of free extras by doing this:
@@ -375,22 +706,52 @@ class Framebuffer
   // * If no row is shared, the frame has not been modified.
 public:
   typedef std::vector<wchar_t> title_type;
-  typedef std::shared_ptr<Row> row_pointer;
-  typedef std::vector<row_pointer> rows_type; /* can be either std::vector or std::deque */
+  typedef RowPointer row_pointer;
+  typedef std::vector<row_pointer> rows_type;
 
 private:
+  /* Rows are kept in a ring: screen row 0 is rows[first_row].  Scrolling
+     the whole screen then only moves first_row and replaces the rows
+     that scrolled off, rather than shifting every pointer. */
   rows_type rows;
+  size_t first_row;
   title_type icon_name;
   title_type window_title;
   title_type clipboard;
   unsigned int bell_count;
   bool title_initialized; /* true if the window title has been set via an OSC */
+  Scrollback* scrollback; /* gets the rows scrolled off the top; not copied */
 
   row_pointer newrow( void )
   {
     const size_t w = ds.get_width();
     const color_type c = ds.get_background_rendition();
-    return std::make_shared<Row>( w, c );
+    return Row::create( w, c );
+  }
+
+  row_pointer& row_slot( int row )
+  {
+    return const_cast<row_pointer&>( static_cast<const Framebuffer*>( this )->row_slot( row ) );
+  }
+
+  const row_pointer& row_slot( int row ) const
+  {
+    if ( row < 0 || static_cast<size_t>( row ) >= rows.size() ) {
+      throw std::out_of_range( "Framebuffer row out of range" );
+    }
+    size_t i = first_row + row;
+    if ( i >= rows.size() ) {
+      i -= rows.size();
+    }
+    return rows[i];
+  }
+
+  /* Rotate storage back so that screen row 0 is rows[0]. */
+  void linearize( void );
+
+  bool full_screen_region( void ) const
+  {
+    return ds.get_scrolling_region_top_row() == 0 && ds.get_scrolling_region_bottom_row() == ds.get_height() - 1;
   }
 
 public:
@@ -399,7 +760,8 @@ public:
   Framebuffer& operator=( const Framebuffer& other );
   DrawState ds;
 
-  const rows_type& get_rows() const { return rows; }
+  /* Rows in screen order. */
+  rows_type get_rows() const;
 
   void scroll( int N );
   void move_rows_autoscroll( int rows );
@@ -409,7 +771,7 @@ public:
     if ( row == -1 )
       row = ds.get_cursor_row();
 
-    return rows.at( row ).get();
+    return row_slot( row ).get();
   }
 
   inline const Cell* get_cell( int row = -1, int col = -1 ) const
@@ -419,21 +781,25 @@ public:
     if ( col == -1 )
       col = ds.get_cursor_col();
 
-    return &rows.at( row )->cells.at( col );
+    return &row_slot( row )->cells.at( col );
   }
 
-  Row* get_mutable_row( int row )
+  /* The caller may change cells [damage_start, damage_end) of the row. */
+  Row* get_mutable_row( int row, int damage_start, int damage_end )
   {
     if ( row == -1 )
       row = ds.get_cursor_row();
-    row_pointer& mutable_row = rows.at( row );
+    row_pointer& mutable_row = row_slot( row );
     // If the row is shared, copy it.
     if ( !mutable_row.unique() ) {
-      mutable_row = std::make_shared<Row>( *mutable_row );
+      mutable_row = Row::create( *mutable_row );
     }
+    mutable_row->damage( damage_start, damage_end );
     return mutable_row.get();
   }
 
+  Row* get_mutable_row( int row ) { return get_mutable_row( row, 0, ds.get_width() ); }
+
   Cell* get_mutable_cell( int row = -1, int col = -1 )
   {
     if ( row == -1 )
@@ -441,12 +807,38 @@ public:
     if ( col == -1 )
       col = ds.get_cursor_col();
 
-    return &get_mutable_row( row )->cells.at( col );
+    return &get_mutable_row( row, col, col + 1 )->cells.at( col );
   }
 
-  Cell* get_combining_cell( void );
+  /* Share another framebuffer's copy of a row (same dimensions required). */
+  void share_row( int row, const Framebuffer& other ) { row_slot( row ) = other.row_slot( row ); }
+
+  const Renditions& get_renditions( int row = -1, int col = -1 ) const
+  {
+    if ( row == -1 )
+      row = ds.get_cursor_row();
+    if ( col == -1 )
+      col = ds.get_cursor_col();
+
+    return row_slot( row )->get_renditions( col );
+  }
 
-  void apply_renditions_to_cell( Cell* cell );
+  void set_renditions( int row, int col, const Renditions& r )
+  {
+    if ( row == -1 )
+      row = ds.get_cursor_row();
+    if ( col == -1 )
+      col = ds.get_cursor_col();
+
+    get_mutable_row( row, col, col + 1 )->set_renditions( col, r );
+  }
+
+  void set_cell( int row, int col, const Cell& cell, const Renditions& r )
+  {
+    get_mutable_row( row, col, col + 1 )->set_cell( col, cell, r );
+  }
+
+  Cell* get_combining_cell( void );
 
   void insert_line( int before_row, int count );
   void delete_line( int row, int count );
@@ -470,15 +862,28 @@ public:
 
   void resize( int s_width, int s_height );
 
-  void reset_cell( Cell* c ) { c->reset( ds.get_background_rendition() ); }
+  void reset_cell( int row = -1, int col = -1 )
+  {
+    if ( row == -1 )
+      row = ds.get_cursor_row();
+    if ( col == -1 )
+      col = ds.get_cursor_col();
+
+    get_mutable_row( row, col, col + 1 )->reset_cell( col, ds.get_background_rendition() );
+  }
   void reset_row( Row* r ) { r->reset( ds.get_background_rendition() ); }
 
+  void set_scrollback( Scrollback* s ) { scrollback = s; }
+  bool has_scrollback( void ) const { return scrollback != NULL; }
+
   void ring_bell( void ) { bell_count++; }
   unsigned int get_bell_count( void ) const { return bell_count; }
 
+  bool same_rows( const Framebuffer& x ) const;
+
   bool operator==( const Framebuffer& x ) const
   {
-    return ( rows == x.rows ) && ( window_title == x.window_title ) && ( clipboard == x.clipboard )
+    return same_rows( x ) && ( window_title == x.window_title ) && ( clipboard == x.clipboard )
            && ( bell_count == x.bell_count ) && ( ds == x.ds );
   }
 };
@@ -47,7 +47,7 @@ using namespace Terminal;
 static void clearline( Framebuffer* fb, int row, int start, int end )
 {
   for ( int col = start; col <= end; col++ ) {
-    fb->reset_cell( fb->get_mutable_cell( row, col ) );
+    fb->reset_cell( row, col );
   }
 }
 
@@ -155,7 +155,7 @@ static void Esc_DECALN( Framebuffer* fb, Dispatcher* dispatch __attribute( ( unu
 {
   for ( int y = 0; y < fb->ds.get_height(); y++ ) {
     for ( int x = 0; x < fb->ds.get_width(); x++ ) {
-      fb->reset_cell( fb->get_mutable_cell( y, x ) );
+      fb->reset_cell( y, x );
       fb->get_mutable_cell( y, x )->append( 'E' );
     }
   }
@@ -410,11 +410,45 @@ static void Ctrl_BEL( Framebuffer* fb, Dispatcher* dispatch __attribute( ( unuse
 
 static Function func_Ctrl_BEL( CONTROL, "\x07", Ctrl_BEL );
 
+/* colon-separated forms: [34]8:5:<n>, [34]8:2:<r>:<g>:<b>, the ITU
+   [34]8:2:<colorspace>:<r>:<g>:<b>, and 4:<style> for underlines.
+   Unknown groups are skipped whole. */
+static void SGR_with_subparams( Framebuffer* fb, const Dispatcher* dispatch, int rendition, int first, int count )
+{
+  if ( rendition == 38 || rendition == 48 ) {
+    unsigned int color;
+    if ( ( dispatch->param( first ) == 5 ) && ( count >= 2 ) ) {
+      color = dispatch->getparam( first + 1, 0 );
+    } else if ( ( dispatch->param( first ) == 2 ) && ( count >= 4 ) ) {
+      const int rgb = first + ( ( count >= 5 ) ? 2 : 1 );
+      color = Renditions::make_true_color(
+        dispatch->getparam( rgb, 0 ), dispatch->getparam( rgb + 1, 0 ), dispatch->getparam( rgb + 2, 0 ) );
+    } else {
+      return;
+    }
+
+    ( rendition == 38 ) ? fb->ds.set_foreground_color( color ) : fb->ds.set_background_color( color );
+  } else if ( rendition == 4 ) {
+    fb->ds.add_rendition( ( dispatch->getparam( first, 0 ) == 0 ) ? 24 : 4 );
+  }
+}
+
 /* select graphics rendition -- e.g., bold, blinking, etc. */
 static void CSI_SGR( Framebuffer* fb, Dispatcher* dispatch )
 {
   for ( int i = 0; i < dispatch->param_count(); i++ ) {
     int rendition = dispatch->getparam( i, 0 );
+
+    int subparam_count = 0;
+    while ( dispatch->is_subparam( i + 1 + subparam_count ) ) {
+      subparam_count++;
+    }
+    if ( subparam_count > 0 ) {
+      SGR_with_subparams( fb, dispatch, rendition, i + 1, subparam_count );
+      i += subparam_count;
+      continue;
+    }
+
     /* We need to special-case the handling of [34]8 ; 5 ; Ps,
        because Ps of 0 in that case does not mean reset to default, even
        though it means that otherwise (as usually renditions are applied
@@ -450,7 +484,8 @@ static void CSI_SGR( Framebuffer* fb, Dispatcher* dispatch )
   }
 }
 
-static Function func_CSI_SGR( CSI, "m", CSI_SGR, false ); /* changing renditions doesn't clear wrap flag */
+/* changing renditions doesn't clear wrap flag */
+static Function func_CSI_SGR( CSI, "m", CSI_SGR, false, true );
 
 /* save and restore cursor */
 static void Esc_DECSC( Framebuffer* fb, Dispatcher* dispatch __attribute( ( unused ) ) )
@@ -0,0 +1,150 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+#include <algorithm>
+
+#include <zlib.h>
+
+#include "src/terminal/terminalscrollback.h"
+#include "src/util/fatal_assert.h"
+
+using namespace Terminal;
+
+/* A row's text, without trailing blanks, and a newline. */
+static void append_text( std::string& out, const Row& row )
+{
+  size_t end = row.cells.size();
+  while ( end > 0 && row.cells[end - 1].is_blank() ) {
+    end--;
+  }
+  for ( size_t col = 0; col < end; col += row.cells[col].get_width() ) {
+    row.cells[col].print_grapheme( out );
+  }
+  out.push_back( '\n' );
+}
+
+/* Append lines [from, to) of text, whose lines each end in a newline
+   and are numbered from first. */
+static void append_lines( const std::string& text, uint64_t first, uint64_t from, uint64_t to,
+                          std::vector<std::string>* lines )
+{
+  size_t pos = 0;
+  for ( uint64_t line = first; line < to && pos < text.size(); line++ ) {
+    const size_t newline = text.find( '\n', pos );
+    fatal_assert( newline != std::string::npos );
+    if ( line >= from ) {
+      lines->push_back( text.substr( pos, newline - pos ) );
+    }
+    pos = newline + 1;
+  }
+}
+
+Scrollback::Scrollback( size_t s_memory_limit )
+  : blocks(), block_bytes( 0 ), open_text(), open_lines( 0 ), pending(), end_line( 0 ),
+    memory_limit( s_memory_limit ), deflater()
+{
+  /* one deflate state for every block, rather than one each */
+  fatal_assert( Z_OK == deflateInit( &deflater, Z_BEST_SPEED ) );
+}
+
+Scrollback::~Scrollback()
+{
+  deflateEnd( &deflater );
+}
+
+void Scrollback::close_block( void )
+{
+  fatal_assert( Z_OK == deflateReset( &deflater ) );
+  std::string deflated( deflateBound( &deflater, open_text.size() ), '\0' );
+  deflater.next_in = reinterpret_cast<Bytef*>( &open_text[0] );
+  deflater.avail_in = open_text.size();
+  deflater.next_out = reinterpret_cast<Bytef*>( &deflated[0] );
+  deflater.avail_out = deflated.size();
+  fatal_assert( Z_STREAM_END == deflate( &deflater, Z_FINISH ) );
+  deflated.resize( deflater.total_out );
+  deflated.shrink_to_fit();
+
+  blocks.push_back( Block { end_line - open_lines, open_lines, open_text.size(), std::move( deflated ) } );
+  block_bytes += blocks.back().deflated.size();
+  open_text.clear();
+  open_lines = 0;
+}
+
+void Scrollback::compact( void )
+{
+  for ( const Framebuffer::row_pointer& row : pending ) {
+    append_text( open_text, *row );
+    open_lines++;
+    end_line++;
+    if ( open_lines == BLOCK_LINES ) {
+      close_block();
+    }
+  }
+  pending.clear();
+
+  while ( !blocks.empty() && memory_used() > memory_limit ) {
+    block_bytes -= blocks.front().deflated.size();
+    blocks.pop_front();
+  }
+}
+
+uint64_t Scrollback::get_lines( uint64_t end, size_t count, std::vector<std::string>* lines )
+{
+  compact();
+  lines->clear();
+
+  if ( end == 0 || end > end_line ) {
+    end = end_line;
+  }
+  const uint64_t first = std::max( get_first_line(), end - std::min<uint64_t>( count, end ) );
+  if ( first >= end ) {
+    return end;
+  }
+
+  for ( const Block& block : blocks ) {
+    if ( block.first + block.lines <= first || block.first >= end ) {
+      continue;
+    }
+    uLongf size = block.text_size;
+    std::string text( size, '\0' );
+    fatal_assert( Z_OK
+                  == uncompress( reinterpret_cast<Bytef*>( &text[0] ),
+                                 &size,
+                                 reinterpret_cast<const Bytef*>( block.deflated.data() ),
+                                 block.deflated.size() ) );
+    append_lines( text, block.first, first, end, lines );
+  }
+  append_lines( open_text, end_line - open_lines, first, end, lines );
+
+  return first;
+}
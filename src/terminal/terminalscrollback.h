@@ -0,0 +1,104 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+#ifndef TERMINALSCROLLBACK_HPP
+#define TERMINALSCROLLBACK_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "src/terminal/terminalframebuffer.h"
+
+namespace Terminal {
+/* Lines that have scrolled off the top of the screen, kept as UTF-8
+   text without renditions and numbered from 0 in the order they left.
+   Scrolling only takes a reference to the row; compact() turns rows
+   into text and deflates every BLOCK_LINES lines into a block,
+   dropping the oldest blocks to stay within the memory limit. */
+class Scrollback
+{
+private:
+  static const size_t BLOCK_LINES = 256;
+
+  struct Block
+  {
+    uint64_t first;     /* number of the first line */
+    size_t lines;
+    size_t text_size;   /* bytes before compression */
+    std::string deflated;
+  };
+
+  std::deque<Block> blocks;
+  size_t block_bytes; /* total size of the deflated blocks */
+
+  /* lines not yet in a block, each ending in a newline */
+  std::string open_text;
+  size_t open_lines;
+
+  std::vector<Framebuffer::row_pointer> pending;
+
+  uint64_t end_line; /* number of the next line to be compacted */
+  size_t memory_limit;
+
+  z_stream deflater;
+
+  void close_block( void );
+
+public:
+  Scrollback( size_t s_memory_limit );
+  ~Scrollback();
+
+  /* not copyable: owns the deflate state */
+  Scrollback( const Scrollback& ) = delete;
+  Scrollback& operator=( const Scrollback& ) = delete;
+
+  void push( const Framebuffer::row_pointer& row ) { pending.push_back( row ); }
+
+  /* Call between host reads, away from the emulator's hot path. */
+  void compact( void );
+
+  uint64_t get_first_line( void ) const { return blocks.empty() ? end_line - open_lines : blocks.front().first; }
+  uint64_t get_end_line( void ) const { return end_line; }
+  size_t memory_used( void ) const { return block_bytes + open_text.size(); }
+
+  /* Up to count lines ending before line end, or before the newest line
+     if end is 0 or past it.  Returns the number of the first. */
+  uint64_t get_lines( uint64_t end, size_t count, std::vector<std::string>* lines );
+};
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Tests Terminal::char_width() against widths every terminal agrees on */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "src/terminal/charwidth.h"
+
+static const struct
+{
+  wchar_t ch;
+  int width;
+} examples[] = {
+  { L'\0', 0 },     { 0x07, -1 },    { 0x1b, -1 },    { L'a', 1 },     { 0x7f, -1 },   { 0x85, -1 },
+  { 0xa0, 1 },      { 0xad, 1 },     { 0xe9, 1 },     { 0x0301, 0 },   { 0x0600, 1 },  { 0x1100, 2 },
+  { 0x1160, 0 },    { 0x200b, 0 },   { 0x200d, 0 },   { 0x2028, -1 },  { 0x3042, 2 },  { 0x4e2d, 2 },
+  { 0xac00, 2 },    { 0xd7b0, 0 },   { 0xfe0f, 0 },   { 0xff21, 2 },   { 0xff61, 1 },  { 0x1f600, 2 },
+  { 0x1f3fb, 2 },   { 0x20000, 2 },  { 0xe0001, 0 },  { 0xf0000, 1 },  { 0x110000, -1 },
+};
+
+int main()
+{
+  int failures = 0;
+  for ( const auto& example : examples ) {
+    const int width = Terminal::char_width( example.ch );
+    if ( width != example.width ) {
+      fprintf( stderr,
+               "U+%04X: width %d, expected %d\n",
+               static_cast<unsigned int>( example.ch ),
+               width,
+               example.width );
+      failures++;
+    }
+  }
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
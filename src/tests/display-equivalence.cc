@@ -0,0 +1,103 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Tests that the output of Display::new_frame, applied to a terminal
+   showing the previous frame, reproduces the new frame. */
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "src/statesync/completeterminal.h"
+#include "src/terminal/terminaldisplay.h"
+
+#include "terminal_compare.h"
+
+/* Escape sequences that move or reshape what is on screen: scrolling
+   regions, index and reverse index, insert and delete line and
+   character, erases and colors.  Text is ASCII only. */
+static const char* const sequences[] = {
+  "\r\n",    "\n",       "\033M",     "\033D",      "\033[5;10r",      "\033[2;20r",         "\033[r",
+  "\033[H",   "\033[2;3H", "\033[20;1H", "\033[3L",    "\033[2M",         "\033[L",             "\033[M",
+  "\033[3@",  "\033[2P",   "\033[K",     "\033[1K",    "\033[2J",         "\033[J",             "\033[4X",
+  "\033[31m", "\033[44m",  "\033[1;4m",  "\033[0m",    "\033[7m",         "\033[22;24m",        "\033[38;5;99m",
+  "\033[3S",  "\033[2T",   "\t",         "\033[10G",   "\033[?6h",        "\033[48;2;10;20;30m", "\033[?6l",
+};
+
+int main()
+{
+  if ( !use_utf8_locale() ) {
+    return 77;
+  }
+
+  const Terminal::Display display( false );
+  std::mt19937 rng( 1 );
+  for ( int iteration = 0; iteration < 500; iteration++ ) {
+    const int width = 10 + rng() % 80;
+    const int height = 2 + rng() % 30;
+
+    Terminal::Complete complete( width, height );
+    Terminal::Framebuffer last( width, height );
+    Terminal::Complete replica( width, height );
+    replica.act( display.new_frame( false, last, complete.get_fb() ) );
+    last = complete.get_fb();
+
+    for ( int frame = 0; frame < 20; frame++ ) {
+      std::string input;
+      const int pieces = rng() % 40;
+      for ( int i = 0; i < pieces; i++ ) {
+        if ( rng() % 2 == 0 ) {
+          input += pick( rng, sequences );
+        } else {
+          const int length = rng() % 100;
+          const char c = static_cast<char>( 0x20 + rng() % 95 );
+          for ( int j = 0; j < length; j++ ) {
+            /* runs of one character, with some variety */
+            input += ( rng() % 4 ) ? c : static_cast<char>( 0x20 + rng() % 95 );
+          }
+        }
+      }
+      complete.act( input );
+
+      replica.act( display.new_frame( true, last, complete.get_fb() ) );
+      last = complete.get_fb();
+
+      if ( !same_screen( complete.get_fb(), replica.get_fb() ) ) {
+        fprintf( stderr, "Mismatch on iteration %d, frame %d (%dx%d).\n", iteration, frame, width, height );
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
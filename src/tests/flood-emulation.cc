@@ -0,0 +1,108 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Tests that Complete::act, when it fast-forwards through a flood of
+   output, leaves the terminal exactly as emulating every byte does */
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "src/statesync/completeterminal.h"
+
+#include "terminal_compare.h"
+
+/* Line endings, renditions and erases in the line, which a flood may
+   contain, and sequences that end a flood or whose effect must survive
+   it: cursor motion, scrolling regions, modes, titles, bells, C1
+   controls in UTF-8, truncated and combining characters. */
+static const char* const sequences[] = {
+  "\r\n",       "\r\n",        "\r\n",      "\n",          "\r",          "\t",         "\b",
+  "\033[31m",   "\033[1;4m",   "\033[0m",   "\033[44m",    "\033[m",      "\033[38:5:99m", "\033[48;2;1;2;3m",
+  "\033[;00m",  "\033[0;7m",   "\033[K",    "\033[1K",     "\033[2K",
+  "\033[H",     "\033[5;10r",  "\033[r",    "\033[?7l",    "\033[?7h",    "\033[4h",    "\033[4l",
+  "\033[?6h",   "\033[?6l",    "\033[2J",   "\033]0;title\007", "\007",   "\xc2\x85",   "\xc2\x9b" "7m",
+  "\xe4\xb8",   "\xcc\x81",    "\0337",     "\0338",       "\033M",       "\033[3g",    "\033[2;5H",
+};
+
+static const char* const glyphs[] = { "\xe4\xb8\xad", "\xf0\x9f\x98\x80", "\xc3\xa9", "\xcc\x81" };
+
+int main()
+{
+  if ( !use_utf8_locale() ) {
+    return 77;
+  }
+
+  std::mt19937 rng( 1 );
+  for ( int iteration = 0; iteration < 400; iteration++ ) {
+    const int width = 1 + rng() % 100;
+    const int height = 1 + rng() % 40;
+
+    /* mostly lines of text, now and then something else */
+    std::string input;
+    const int lines = rng() % 600;
+    for ( int i = 0; i < lines; i++ ) {
+      const int length = rng() % ( 2 * width );
+      for ( int j = 0; j < length; j++ ) {
+        if ( rng() % 20 == 0 ) {
+          input += pick( rng, glyphs );
+        } else {
+          input += static_cast<char>( 0x20 + rng() % 95 );
+        }
+      }
+      const int extras = rng() % 8 == 0 ? rng() % 4 : 0;
+      for ( int j = 0; j < extras; j++ ) {
+        input += pick( rng, sequences );
+      }
+      input += "\r\n";
+    }
+
+    /* in a few host reads, so that floods start in any state */
+    Terminal::Complete complete( width, height );
+    for ( size_t i = 0; i < input.size(); ) {
+      const size_t n = rng() % ( input.size() - i + 1 ) + 1;
+      complete.act( input.substr( i, n ) );
+      i += n;
+    }
+
+    Terminal::Emulator reference( width, height );
+    emulate_bytewise( input, &reference );
+
+    if ( !same_terminal( complete.get_fb(), reference.get_fb() ) ) {
+      fprintf( stderr, "Mismatch on iteration %d (%dx%d).\n", iteration, width, height );
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,113 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+
+/* Tests that long graphemes, kept out of line in a shared table, are
+   stored whole however many distinct ones a process has seen, and that
+   equal ones still compare equal across terminals */
+
+#include <cstdio>
+#include <string>
+
+#include "src/statesync/completeterminal.h"
+#include "src/terminal/parser.h"
+
+#include "terminal_compare.h"
+
+/* 'q' and count combining marks (U+0300 on), picked by n */
+static std::string long_grapheme( unsigned int n, int count )
+{
+  std::string g = "q";
+  for ( int i = 0; i < count; i++ ) {
+    const unsigned int mark = 0x300 + n % 0x70;
+    n /= 0x70;
+    g += static_cast<char>( 0xc0 | ( mark >> 6 ) );
+    g += static_cast<char>( 0x80 | ( mark & 0x3f ) );
+  }
+  return g;
+}
+
+static std::string printed( const Terminal::Complete& terminal, int row, int col )
+{
+  std::string out;
+  terminal.get_fb().get_cell( row, col )->print_grapheme( out );
+  return out;
+}
+
+int main()
+{
+  if ( !use_utf8_locale() ) {
+    return 77;
+  }
+
+  /* more distinct long graphemes than a table of 65536 would hold, a
+     line at a time so that none are skipped as a flood */
+  {
+    Terminal::Complete flood( 80, 24 );
+    std::string line;
+    for ( unsigned int n = 0; n < 70000; n++ ) {
+      line += long_grapheme( n, 4 );
+      if ( n % 80 == 79 ) {
+        flood.act( line + "\r\n" );
+        line.clear();
+      }
+    }
+    if ( printed( flood, 22, 0 ) != long_grapheme( 69920, 4 ) ) {
+      fprintf( stderr, "Flooding terminal lost a grapheme.\n" );
+      return 1;
+    }
+  }
+
+  const std::string grapheme = long_grapheme( 12345, 5 );
+  Terminal::Complete a( 10, 2 ), b( 10, 2 );
+  a.act( grapheme );
+  b.act( "x\r" + grapheme );
+  if ( printed( a, 0, 0 ) != grapheme || printed( b, 0, 0 ) != grapheme ) {
+    fprintf( stderr, "Grapheme of %zu bytes stored as %zu.\n", grapheme.size(), printed( a, 0, 0 ).size() );
+    return 1;
+  }
+  if ( !( *a.get_fb().get_cell( 0, 0 ) == *b.get_fb().get_cell( 0, 0 ) ) ) {
+    fprintf( stderr, "Equal graphemes compare unequal.\n" );
+    return 1;
+  }
+
+  /* copies outlive the terminal they came from */
+  Terminal::Framebuffer copy( a.get_fb() );
+  a.act( "\033[2J" );
+  if ( printed( b, 0, 0 ) != grapheme || !( *copy.get_cell( 0, 0 ) == *b.get_fb().get_cell( 0, 0 ) ) ) {
+    fprintf( stderr, "Grapheme freed while still in use.\n" );
+    return 1;
+  }
+
+  return 0;
+}
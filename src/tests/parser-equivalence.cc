@@ -0,0 +1,184 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Tests that the table-driven Parser produces exactly the actions of
+   the state-object ReferenceParser: for every state and input class,
+   over the fuzzing corpora, and over random code point streams */
+
+#include <dirent.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "src/terminal/parser.h"
+#include "src/terminal/parserreference.h"
+
+using Trace = std::vector<std::tuple<size_t, bool, wchar_t>>;
+
+static void record( Parser::Actions& actions, Trace& trace )
+{
+  for ( const Parser::ParserAction& act : actions ) {
+    const Parser::Action& a = Parser::get_action( act );
+    trace.push_back( std::make_tuple( act.index(), a.char_present, a.ch ) );
+  }
+  actions.clear();
+}
+
+static bool same_actions( const std::vector<wchar_t>& input )
+{
+  Parser::Parser table;
+  Parser::ReferenceParser reference;
+  Parser::Actions actions;
+  Trace expected, actual;
+
+  for ( const wchar_t ch : input ) {
+    reference.input( ch, actions );
+    record( actions, expected );
+    table.input( ch, actions );
+    record( actions, actual );
+    if ( expected != actual || reference.is_ground() != table.is_ground() ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void report( const char* what, const std::vector<wchar_t>& input )
+{
+  fprintf( stderr, "Mismatch (%s) on input:", what );
+  for ( const wchar_t ch : input ) {
+    fprintf( stderr, " %x", static_cast<unsigned int>( ch ) );
+  }
+  fprintf( stderr, "\n" );
+}
+
+/* Feed each byte of every corpus file as a code point, so C1 controls
+   and the GR area are reached as well. */
+static int check_corpus( const std::string& dir, int* files )
+{
+  DIR* d = opendir( dir.c_str() );
+  if ( d == NULL ) {
+    perror( dir.c_str() );
+    return 1;
+  }
+
+  int failures = 0;
+  while ( const struct dirent* entry = readdir( d ) ) {
+    if ( entry->d_name[0] == '.' ) {
+      continue;
+    }
+    std::ifstream file( dir + "/" + entry->d_name, std::ios::binary );
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const std::string bytes = contents.str();
+
+    std::vector<wchar_t> input;
+    for ( const char c : bytes ) {
+      input.push_back( static_cast<unsigned char>( c ) );
+    }
+    if ( !same_actions( input ) ) {
+      fprintf( stderr, "Mismatch on corpus file %s/%s\n", dir.c_str(), entry->d_name );
+      failures++;
+    }
+    ( *files )++;
+  }
+  closedir( d );
+  return failures;
+}
+
+int main()
+{
+  /* Every code point class the tables distinguish, plus the boundaries
+     around them. */
+  std::vector<wchar_t> classes;
+  classes.push_back( -1 );
+  for ( wchar_t ch = 0; ch <= 0xA0; ch++ ) {
+    classes.push_back( ch );
+  }
+  classes.push_back( 0xFF );
+  classes.push_back( 0x100 );
+  classes.push_back( 0x3000 );
+  classes.push_back( 0x10FFFF );
+
+  /* Prefixes that lead from ground to each state. */
+  const std::vector<std::vector<wchar_t>> prefixes = {
+    {},           { 0x1B },       { 0x1B, ' ' },  { 0x9B },      { 0x9B, '1' }, { 0x9B, ' ' }, { 0x9B, ':' },
+    { 0x90 },     { 0x90, '1' }, { 0x90, ' ' }, { 0x90, 'p' }, { 0x90, ':' }, { 0x9D },      { 0x98 },
+  };
+
+  for ( const std::vector<wchar_t>& prefix : prefixes ) {
+    for ( const wchar_t first : classes ) {
+      for ( const wchar_t second : classes ) {
+        std::vector<wchar_t> input( prefix );
+        input.push_back( first );
+        input.push_back( second );
+        if ( !same_actions( input ) ) {
+          report( "state table", input );
+          return 1;
+        }
+      }
+    }
+  }
+
+  const char* srcdir = getenv( "srcdir" );
+  const std::string fuzz_dir = std::string( srcdir ? srcdir : "." ) + "/../fuzz/";
+  int files = 0;
+  if ( check_corpus( fuzz_dir + "terminal_parser_corpus", &files )
+       + check_corpus( fuzz_dir + "terminal_corpus", &files ) ) {
+    return 1;
+  }
+  if ( files == 0 ) {
+    fprintf( stderr, "No corpus files found.\n" );
+    return 1;
+  }
+
+  std::mt19937 rng( 1 );
+  for ( int iteration = 0; iteration < 2000; iteration++ ) {
+    std::vector<wchar_t> input( rng() % 400 );
+    for ( wchar_t& ch : input ) {
+      ch = classes[rng() % classes.size()];
+    }
+    if ( !same_actions( input ) ) {
+      report( "random", input );
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,210 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Tests that a screen update too big for one frame goes out as a
+   series of partial states, each within the byte budget (or a single
+   row, when even that is over it), with rows nearest the cursor first,
+   converging on the current state for no more than the single diff
+   would have cost plus a small overhead per frame; and that a Transport pair with a frame budget
+   still converges over a lossy link */
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/network/networktransport-impl.h"
+#include "src/network/simulatedconnection.h"
+#include "src/statesync/completeterminal.h"
+#include "src/statesync/user.h"
+#include "src/util/timestamp.h"
+
+#include "terminal_compare.h"
+
+using namespace Network;
+
+typedef Transport<UserStream, Terminal::Complete> ClientTransport;
+typedef Transport<Terminal::Complete, UserStream> ServerTransport;
+
+static const int WIDTH = 80;
+static const int HEIGHT = 24;
+
+/* A screenful of distinct lines, leaving the cursor on row 10 */
+static std::string screenful( void )
+{
+  std::string out;
+  char buf[128];
+  for ( int row = 0; row < HEIGHT; row++ ) {
+    snprintf( buf,
+              sizeof buf,
+              "\033[%d;1Hline %02d: the quick brown fox jumps over the lazy dog %08x",
+              row + 1,
+              row,
+              row * 2654435761u );
+    out += buf;
+  }
+  return out + "\033[11;5H";
+}
+
+/* Rows on which two states differ */
+static std::vector<int> differing_rows( const Terminal::Complete& a, const Terminal::Complete& b )
+{
+  std::vector<int> rows;
+  for ( int row = 0; row < HEIGHT; row++ ) {
+    if ( !a.get_fb().get_row( row )->same_contents( *b.get_fb().get_row( row ) ) ) {
+      rows.push_back( row );
+    }
+  }
+  return rows;
+}
+
+static bool send_in_parts( size_t budget )
+{
+  const Terminal::Complete blank( WIDTH, HEIGHT );
+  Terminal::Complete current( blank );
+  current.act( screenful() );
+  const int cursor_row = current.get_fb().ds.get_cursor_row();
+  const size_t full = current.diff_from( blank ).size();
+
+  Terminal::Complete sent( blank ); /* what the sender last sent */
+  Terminal::Complete receiver( blank );
+  size_t total = 0;
+  int frame = 0;
+  for ( ; !( sent == current ); frame++ ) {
+    if ( frame > HEIGHT ) {
+      fprintf( stderr, "Budget %zu: no progress.\n", budget );
+      return false;
+    }
+    const Terminal::Complete partial = current.partial_from( sent, budget );
+    const std::string diff = partial.diff_from( sent );
+    const std::vector<int> taken = differing_rows( partial, sent );
+    const std::vector<int> left = differing_rows( current, partial );
+
+    if ( diff.size() > budget && taken.size() != 1 ) {
+      fprintf( stderr, "Budget %zu: frame of %zu bytes with %zu rows.\n", budget, diff.size(), taken.size() );
+      return false;
+    }
+    for ( int t : taken ) {
+      for ( int l : left ) {
+        if ( abs( t - cursor_row ) > abs( l - cursor_row ) ) {
+          fprintf( stderr, "Budget %zu: row %d sent before row %d.\n", budget, t, l );
+          return false;
+        }
+      }
+    }
+
+    receiver.apply_string( diff );
+    if ( receiver.compare( partial ) ) {
+      fprintf( stderr, "Budget %zu: receiver does not match the partial state.\n", budget );
+      return false;
+    }
+    total += diff.size();
+    sent = partial;
+  }
+
+  if ( receiver.compare( current ) ) {
+    fprintf( stderr, "Budget %zu: receiver did not converge.\n", budget );
+    return false;
+  }
+  /* each frame pays for its own framing and for hiding, moving and
+     showing the cursor; the rows themselves should cost no more */
+  if ( total > full + frame * 32 ) {
+    fprintf(
+      stderr, "Budget %zu: sent %zu bytes in %d frames where one diff takes %zu.\n", budget, total, frame, full );
+    return false;
+  }
+  return true;
+}
+
+static bool transport_converges( size_t budget )
+{
+  uint64_t now = 1000000;
+  set_virtual_timestamp( now );
+
+  LinkConditions conditions;
+  conditions.latency = 50;
+  conditions.jitter = 20;
+  conditions.loss = 0.1;
+  std::shared_ptr<SimulatedLink> link( new SimulatedLink( conditions, 7 ) );
+
+  Terminal::Complete terminal( WIDTH, HEIGHT );
+  UserStream blank;
+  std::unique_ptr<ServerTransport> server( ServerTransport::create_with_connection(
+    new SimulatedConnection( link, SimulatedLink::SERVER ), terminal, blank ) );
+  Terminal::Complete local_terminal( WIDTH, HEIGHT );
+  std::unique_ptr<ClientTransport> client( ClientTransport::create_with_connection(
+    new SimulatedConnection( link, SimulatedLink::CLIENT ), blank, local_terminal ) );
+  server->set_frame_budget( budget );
+
+  for ( uint64_t elapsed = 0; elapsed < 20000; elapsed++, now++ ) {
+    set_virtual_timestamp( now );
+    if ( elapsed == 100 ) {
+      /* the client must have spoken for the server to know where it is */
+      client->get_current_state().push_back( Parser::UserByte( 'x' ) );
+    }
+    if ( elapsed == 1000 ) {
+      terminal.act( screenful() );
+      server->set_current_state( terminal );
+    }
+
+    while ( link->pending( SimulatedLink::SERVER ) ) {
+      server->recv();
+    }
+    while ( link->pending( SimulatedLink::CLIENT ) ) {
+      client->recv();
+    }
+    client->tick();
+    server->tick();
+  }
+
+  if ( client->get_latest_remote_state().state->compare( terminal ) ) {
+    fprintf( stderr, "Budget %zu: client screen did not converge to server screen.\n", budget );
+    return false;
+  }
+  return true;
+}
+
+int main()
+{
+  if ( !use_utf8_locale() ) {
+    return 77;
+  }
+
+  for ( size_t budget : { 40, 300, 1000 } ) {
+    if ( !send_in_parts( budget ) || !transport_converges( budget ) ) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
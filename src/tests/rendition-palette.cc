@@ -0,0 +1,109 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Tests that a row keeps the right renditions for its cells while they
+   cycle through many more distinct renditions than the row has cells,
+   so that its palette is compacted, and that edits through the
+   framebuffer leave rows shared with other framebuffers alone */
+
+#include <cstdio>
+#include <string>
+
+#include "src/statesync/completeterminal.h"
+#include "src/terminal/parser.h"
+#include "src/terminal/terminaldisplay.h"
+
+#include "terminal_compare.h"
+
+static const int WIDTH = 20;
+static const int HEIGHT = 4;
+
+/* Rewrites the top row with a different background in every cell */
+static std::string colored_row( unsigned int round )
+{
+  std::string out = "\033[H";
+  char buf[64];
+  for ( int col = 0; col < WIDTH; col++ ) {
+    snprintf( buf, sizeof buf, "\033[48;2;%u;%d;%um%c", round % 256, col, round / 256, 'a' + col );
+    out += buf;
+  }
+  return out + "\033[m";
+}
+
+int main()
+{
+  if ( !use_utf8_locale() ) {
+    return 77;
+  }
+
+  Terminal::Complete terminal( WIDTH, HEIGHT );
+  for ( unsigned int round = 0; round < 1000; round++ ) {
+    terminal.act( colored_row( round ) );
+    if ( round % 7 == 0 ) {
+      /* and sometimes a blank or two in the default background */
+      terminal.act( "\033[1;5H\033[2X" );
+    }
+
+    Terminal::Complete fresh( WIDTH, HEIGHT );
+    fresh.act( colored_row( round ) );
+    if ( round % 7 == 0 ) {
+      fresh.act( "\033[1;5H\033[2X" );
+    }
+    if ( !same_screen( terminal.get_fb(), fresh.get_fb() ) ) {
+      fprintf( stderr, "Renditions wrong after round %u.\n", round );
+      return 1;
+    }
+  }
+
+  /* what Display draws of the row brings another terminal to the same state */
+  const Terminal::Display display( false );
+  Terminal::Complete replica( WIDTH, HEIGHT );
+  replica.act( display.new_frame( false, replica.get_fb(), terminal.get_fb() ) );
+  if ( !same_screen( terminal.get_fb(), replica.get_fb() ) ) {
+    fprintf( stderr, "Display lost renditions.\n" );
+    return 1;
+  }
+
+  /* setting renditions copies a shared row first */
+  Terminal::Framebuffer edited( terminal.get_fb() );
+  Terminal::Renditions underlined = edited.get_renditions( 0, 3 );
+  underlined.set_attribute( Terminal::Renditions::underlined, true );
+  edited.set_renditions( 0, 3, underlined );
+  if ( !( edited.get_renditions( 0, 3 ) == underlined ) || terminal.get_fb().get_renditions( 0, 3 ) == underlined
+       || !( edited.get_renditions( 0, 4 ) == terminal.get_fb().get_renditions( 0, 4 ) ) ) {
+    fprintf( stderr, "Setting renditions changed the wrong cells.\n" );
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,125 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+/* Tests that rows scrolled off the top of the screen reach the
+   scrollback as text, that its memory stays within the limit, and that
+   a page of it survives the trip from server to client */
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "src/statesync/completeterminal.h"
+#include "src/terminal/terminalscrollback.h"
+
+#include "terminal_compare.h"
+
+static bool check( bool condition, const char* what )
+{
+  if ( !condition ) {
+    fprintf( stderr, "Failed: %s\n", what );
+  }
+  return condition;
+}
+
+static std::string numbered( unsigned int n )
+{
+  return "line " + std::to_string( n );
+}
+
+int main()
+{
+  if ( !use_utf8_locale() ) {
+    return 77;
+  }
+
+  bool ok = true;
+  std::vector<std::string> lines;
+
+  /* plain lines, trailing blanks trimmed, wide characters kept whole */
+  {
+    Terminal::Complete terminal( 20, 5 );
+    Terminal::Scrollback scrollback( 1 << 20 );
+    terminal.set_scrollback( &scrollback );
+    terminal.act( "one   \r\n\xe4\xb8\xad\xe6\x96\x87 wide\r\n\033[3;5r\033[5H\r\n\r\n\033[r" );
+    ok &= check( scrollback.get_end_line() == 0, "scrolling inside a region keeps nothing" );
+    terminal.act( "\033[5H\r\n\r\n\r\n" );
+    ok &= check( scrollback.get_lines( 0, 10, &lines ) == 0, "first line number" );
+    ok &= check( lines.size() == 3 && lines[0] == "one" && lines[1] == "\xe4\xb8\xad\xe6\x96\x87 wide"
+                   && lines[2].empty(),
+                 "text of scrolled rows" );
+  }
+
+  /* many lines: pages by number, and the memory bound */
+  {
+    const size_t limit = 16384;
+    const unsigned int total = 200000;
+    Terminal::Complete terminal( 40, 10 );
+    Terminal::Scrollback scrollback( limit );
+    terminal.set_scrollback( &scrollback );
+    size_t peak = 0;
+    for ( unsigned int n = 0; n < total; n++ ) {
+      terminal.act( numbered( n ) + " of the scrollback test\r\n" );
+      if ( n % 100 == 0 ) {
+        scrollback.compact();
+        peak = std::max( peak, scrollback.memory_used() );
+      }
+    }
+    scrollback.compact();
+    const uint64_t end = scrollback.get_end_line();
+    const uint64_t first = scrollback.get_first_line();
+    ok &= check( end == total - 9, "every row that left the screen is counted" );
+    ok &= check( first > 0, "old lines are dropped" );
+    ok &= check( peak <= limit + 256 * 64, "memory stays within the limit and one open block" );
+
+    const uint64_t page = scrollback.get_lines( end - 1000, 30, &lines );
+    ok &= check( page == end - 1030 && lines.size() == 30, "page position" );
+    for ( size_t i = 0; i < lines.size(); i++ ) {
+      ok &= check( lines[i] == numbered( page + i ) + " of the scrollback test", "page text" );
+    }
+    ok &= check( scrollback.get_lines( first + 5, 30, &lines ) == first && lines.size() == 5,
+                 "page clipped at the oldest line" );
+  }
+
+  /* a page sent from server to client */
+  {
+    Terminal::Complete server( 80, 24 ), client( 80, 24 );
+    Terminal::ScrollbackPage page { 7, 9, 3, { "seven", "eight \xe4\xb8\xad" } };
+    const Terminal::Complete before( server );
+    server.set_scrollback_page( page );
+    client.apply_string( server.diff_from( before ) );
+    ok &= check( client.get_scrollback_page() && *client.get_scrollback_page() == page, "page synchronized" );
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Tests that a client/server Transport pair converges over a lossy,
+   reordering, duplicating simulated network */
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <typeinfo>
+
+#include "src/network/networktransport-impl.h"
+#include "src/network/simulatedconnection.h"
+#include "src/statesync/completeterminal.h"
+#include "src/statesync/user.h"
+#include "src/util/timestamp.h"
+
+#include "terminal_compare.h"
+
+using namespace Network;
+
+typedef Transport<UserStream, Terminal::Complete> ClientTransport;
+typedef Transport<Terminal::Complete, UserStream> ServerTransport;
+
+int main()
+{
+  if ( !use_utf8_locale() ) {
+    return 77;
+  }
+
+  uint64_t now = 1000000;
+  set_virtual_timestamp( now );
+
+  LinkConditions conditions;
+  conditions.latency = 50;
+  conditions.jitter = 40;
+  conditions.loss = 0.2;
+  conditions.reorder = 0.1;
+  conditions.duplicate = 0.1;
+  std::shared_ptr<SimulatedLink> link( new SimulatedLink( conditions, 42 ) );
+
+  Terminal::Complete terminal( 80, 24 );
+  UserStream blank;
+  std::unique_ptr<ServerTransport> server(
+    ServerTransport::create_with_connection( new SimulatedConnection( link, SimulatedLink::SERVER ), terminal, blank ) );
+  Terminal::Complete local_terminal( 80, 24 );
+  std::unique_ptr<ClientTransport> client( ClientTransport::create_with_connection(
+    new SimulatedConnection( link, SimulatedLink::CLIENT ), blank, local_terminal ) );
+
+  const std::string typed = "the quick brown fox jumps over the lazy dog";
+  std::string received;
+  uint64_t last_remote_num = server->get_remote_state_num();
+
+  for ( uint64_t elapsed = 0; elapsed < 60000; elapsed++, now++ ) {
+    set_virtual_timestamp( now );
+
+    if ( ( elapsed % 50 == 0 ) && ( elapsed / 50 < typed.size() ) ) {
+      client->get_current_state().push_back( Parser::UserByte( typed[elapsed / 50] ) );
+    }
+
+    while ( link->pending( SimulatedLink::SERVER ) ) {
+      server->recv();
+    }
+    if ( server->get_remote_state_num() != last_remote_num ) {
+      last_remote_num = server->get_remote_state_num();
+      UserStream us;
+      us.apply_string( server->get_remote_diff() );
+      for ( size_t i = 0; i < us.size(); i++ ) {
+        const Parser::Action& action = us.get_action( i );
+        if ( typeid( action ) == typeid( Parser::UserByte ) ) {
+          const char c = static_cast<const Parser::UserByte&>( action ).c;
+          received.push_back( c );
+          terminal.act( std::string( 1, c ) );
+        }
+      }
+      server->set_current_state( terminal );
+    }
+
+    while ( link->pending( SimulatedLink::CLIENT ) ) {
+      client->recv();
+    }
+
+    client->tick();
+    server->tick();
+  }
+
+  if ( received != typed ) {
+    fprintf( stderr, "Server received \"%s\", expected \"%s\".\n", received.c_str(), typed.c_str() );
+    return EXIT_FAILURE;
+  }
+
+  if ( client->get_latest_remote_state().state->compare( terminal ) ) {
+    fprintf( stderr, "Client screen did not converge to server screen.\n" );
+    return EXIT_FAILURE;
+  }
+
+  const SimulatedLink::Statistics& down = link->get_statistics( SimulatedLink::SERVER );
+  printf( "Converged; server sent %lu packets, %lu dropped.\n",
+          (unsigned long)down.packets_sent,
+          (unsigned long)down.packets_dropped );
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+/* Tests that Complete::act, with its bulk fast paths, leaves the
+   framebuffer exactly as applying one parser action at a time does */
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "src/statesync/completeterminal.h"
+
+#include "terminal_compare.h"
+
+/* Escape sequences that interact with printing: wrap and origin modes,
+   insert mode, scrolling regions, cursor motion, wide and combining
+   characters, and repeating the last character. */
+static const char* const sequences[] = {
+  "\033[?7l", "\033[?7h", "\033[4h",  "\033[4l",   "\r",     "\n",          "\033[5;10r",       "\033[?6h",
+  "\033[?6l", "\033[H",   "\033[31m", "\033[0m",   "\b",     "\t",          "\033[r",           "\033[2;3H",
+  "\033M",    "\033[3@",  "\033[2P",  "\033[1;1r", "\033[K", "\033[30;40H", "\xe4\xb8\xad",     "\xcc\x81",
+  "\033[70G", "\033D",    "\033E",    "\0337",     "\0338",  "\033[2J",     "\xf0\x9f\x98\x80", "\033[3b",
+};
+
+int main()
+{
+  if ( !use_utf8_locale() ) {
+    return 77;
+  }
+
+  std::mt19937 rng( 1 );
+  for ( int iteration = 0; iteration < 5000; iteration++ ) {
+    std::string input;
+    const int pieces = rng() % 60;
+    for ( int i = 0; i < pieces; i++ ) {
+      if ( rng() % 3 == 0 ) {
+        input += pick( rng, sequences );
+      } else {
+        const int length = rng() % 120;
+        for ( int j = 0; j < length; j++ ) {
+          input += static_cast<char>( 0x20 + rng() % 95 );
+        }
+      }
+    }
+
+    const int width = 1 + rng() % 90;
+    const int height = 1 + rng() % 30;
+
+    Terminal::Complete complete( width, height );
+    complete.act( input );
+
+    Terminal::Emulator reference( width, height );
+    emulate_bytewise( input, &reference );
+
+    if ( !same_terminal( complete.get_fb(), reference.get_fb() ) ) {
+      fprintf( stderr, "Mismatch on iteration %d (%dx%d).\n", iteration, width, height );
+      return 1;
+    }
+  }
+
+  return 0;
+}
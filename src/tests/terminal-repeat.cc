@@ -0,0 +1,156 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+
+
+/* Tests that REP with a huge count leaves the screen just as printing
+   the character that many times does, that a flood of such sequences
+   is cheap, since the emulator cuts the count short, and that Display
+   uses REP for the local terminal but never in the diffs sent to a
+   client, whose emulator may not know it */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "src/statesync/completeterminal.h"
+#include "src/terminal/terminaldisplay.h"
+
+#include "terminal_compare.h"
+
+/* narrow ASCII, narrow non-ASCII and wide */
+static const char* const characters[] = { "x", "\xc3\xa9", "\xe4\xb8\xad" };
+
+/* modes and positions the repetition starts from */
+static const char* const setups[] = {
+  "",        "\033[?7l", "\033[4h",     "\033[5;10r\033[7;1H", "\033[3;8r\033[?6h\033[2;4H",
+  "\033[30;70H", "\033[24;80H", "\033[?7l\033[4h", "\033[2;5r\033[30;1H", "\033[1;1H\033[K",
+};
+
+/* Does the output contain REP (CSI Pn b)? */
+static bool has_rep( const std::string& output )
+{
+  for ( size_t i = output.find( "\033[" ); i != std::string::npos; i = output.find( "\033[", i + 1 ) ) {
+    size_t j = i + 2;
+    while ( j < output.size() && output[j] >= '0' && output[j] <= '9' ) {
+      j++;
+    }
+    if ( j < output.size() && output[j] == 'b' ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Draws a screen of long runs with the display, checks that the output
+   reproduces it, and returns the output. */
+static bool draw_runs( const Terminal::Display& display, std::string* output )
+{
+  Terminal::Complete runs( 80, 24 );
+  runs.act( "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\r\n\033[31m------------------------------------\033[m\r\n"
+            "\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9 abc\033[70b" );
+  const Terminal::Framebuffer blank( 80, 24 );
+  *output = display.new_frame( true, blank, runs.get_fb() );
+
+  Terminal::Complete replica( 80, 24 );
+  replica.act( *output );
+  return same_screen( replica.get_fb(), runs.get_fb() );
+}
+
+int main()
+{
+  if ( !use_utf8_locale() ) {
+    return 77;
+  }
+
+  std::mt19937 rng( 1 );
+  for ( int iteration = 0; iteration < 300; iteration++ ) {
+    const int width = 2 + rng() % 90;
+    const int height = 1 + rng() % 30;
+    const std::string setup = pick( rng, setups );
+    const std::string ch = pick( rng, characters );
+    const int count = iteration % 3 ? rng() % 65536 : 65535;
+
+    Terminal::Complete repeated( width, height );
+    repeated.act( setup + ch + "\033[" + std::to_string( count ) + "b" );
+
+    std::string printed = setup;
+    for ( int i = 0; i <= count; i++ ) {
+      printed += ch;
+    }
+    Terminal::Complete reference( width, height );
+    reference.act( printed );
+
+    if ( !same_terminal( repeated.get_fb(), reference.get_fb() ) ) {
+      fprintf( stderr, "Mismatch on iteration %d (%dx%d, count %d).\n", iteration, width, height, count );
+      return 1;
+    }
+  }
+
+  /* a wide character repeated as often as a few kilobytes can ask */
+  std::string flood = "\xe4\xb8\xad";
+  for ( int i = 0; i < 1000; i++ ) {
+    flood += "\033[65535b";
+  }
+  Terminal::Complete terminal( 80, 24 );
+  const auto start = std::chrono::steady_clock::now();
+  terminal.act( flood );
+  const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+  if ( seconds > 2.0 ) {
+    fprintf( stderr, "Repeating took %.2f s.\n", seconds );
+    return 1;
+  }
+
+  /* diffs for the client */
+  std::string output;
+  if ( !draw_runs( Terminal::Display( false ), &output ) || has_rep( output ) ) {
+    fprintf( stderr, "Server-side display used REP or lost characters.\n" );
+    return 1;
+  }
+
+  /* the local terminal, if its terminfo entry can be found */
+  setenv( "TERM", "xterm-256color", 1 );
+  try {
+    const Terminal::Display local( true );
+    if ( !draw_runs( local, &output ) || !has_rep( output ) ) {
+      fprintf( stderr, "Local display did not use REP, or lost characters.\n" );
+      return 1;
+    }
+  } catch ( const std::exception& e ) {
+    fprintf( stderr, "Skipping the local display: %s\n", e.what() );
+  }
+
+  return 0;
+}
@@ -0,0 +1,101 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+#include <clocale>
+#include <cstdio>
+
+#include "src/terminal/parser.h"
+#include "src/util/locale_utils.h"
+
+#include "terminal_compare.h"
+
+bool use_utf8_locale( void )
+{
+  set_native_locale();
+  if ( !is_utf8_locale() ) {
+    setlocale( LC_ALL, "C.UTF-8" );
+  }
+  if ( !is_utf8_locale() ) {
+    fprintf( stderr, "Skipping: no UTF-8 locale.\n" );
+    return false;
+  }
+  return true;
+}
+
+void emulate_bytewise( const std::string& input, Terminal::Emulator* emulator )
+{
+  Parser::UTF8Parser parser;
+  Parser::Actions actions;
+  for ( const char c : input ) {
+    parser.input( c, actions );
+    for ( const Parser::ParserAction& act : actions ) {
+      Parser::act_on_terminal( act, emulator );
+    }
+    actions.clear();
+  }
+}
+
+bool same_screen( const Terminal::Framebuffer& a, const Terminal::Framebuffer& b )
+{
+  if ( a.ds.get_width() != b.ds.get_width() || a.ds.get_height() != b.ds.get_height()
+       || a.ds.get_cursor_row() != b.ds.get_cursor_row() || a.ds.get_cursor_col() != b.ds.get_cursor_col() ) {
+    return false;
+  }
+  for ( int row = 0; row < a.ds.get_height(); row++ ) {
+    for ( int col = 0; col < a.ds.get_width(); col++ ) {
+      const Terminal::Cell& x = *a.get_cell( row, col );
+      const Terminal::Cell& y = *b.get_cell( row, col );
+      if ( !x.contents_match( y ) || !( a.get_renditions( row, col ) == b.get_renditions( row, col ) )
+           || x.get_wide() != y.get_wide() ) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool same_terminal( const Terminal::Framebuffer& a, const Terminal::Framebuffer& b )
+{
+  if ( !( a.ds == b.ds ) || a.ds.next_print_will_wrap != b.ds.next_print_will_wrap
+       || a.ds.get_combining_char_col() != b.ds.get_combining_char_col()
+       || a.ds.get_combining_char_row() != b.ds.get_combining_char_row()
+       || a.get_window_title() != b.get_window_title() || a.get_icon_name() != b.get_icon_name()
+       || a.get_bell_count() != b.get_bell_count() ) {
+    return false;
+  }
+  for ( int row = 0; row < a.ds.get_height(); row++ ) {
+    if ( !a.get_row( row )->same_contents( *b.get_row( row ) ) ) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,68 @@
+/*
+    Mosh: the mobile shell
+    Copyright 2012 Keith Winstein
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations including
+    the two.
+
+    You must obey the GNU General Public License in all respects for all
+    of the code used other than OpenSSL. If you modify file(s) with this
+    exception, you may extend this exception to your version of the
+    file(s), but you are not obligated to do so. If you do not wish to do
+    so, delete this exception statement from your version. If you delete
+    this exception statement from all source files in the program, then
+    also delete it here.
+*/
+
+#ifndef TERMINAL_COMPARE_HPP
+#define TERMINAL_COMPARE_HPP
+
+#include <cstddef>
+#include <random>
+#include <string>
+
+#include "src/terminal/terminal.h"
+
+/* Helpers for the tests that check one way of reaching a terminal state
+   against another. */
+
+/* Sets up a UTF-8 locale, or says why the test will be skipped. */
+bool use_utf8_locale( void );
+
+/* Applies input one parser action at a time, with none of the bulk
+   paths of Complete::act, as the reference to compare against. */
+void emulate_bytewise( const std::string& input, Terminal::Emulator* emulator );
+
+/* Whether the two show the same thing: cursor position, and each cell's
+   contents, width and renditions. */
+bool same_screen( const Terminal::Framebuffer& a, const Terminal::Framebuffer& b );
+
+/* Whether the two are in the same state, down to what only affects later
+   output: the drawing state, a pending wrap, where a combining character
+   would go, the window title and icon name, and the bell count. */
+bool same_terminal( const Terminal::Framebuffer& a, const Terminal::Framebuffer& b );
+
+/* One of the strings, chosen at random */
+template<size_t N>
+const char* pick( std::mt19937& rng, const char* const ( &choices )[N] )
+{
+  return choices[rng() % N];
+}
+
+#endif
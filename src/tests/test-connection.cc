@@ -47,10 +47,17 @@ class MockState
 private:
   std::string message;
   uint64_t msg_num;
+  uint64_t generation;
+
+  static uint64_t new_generation()
+  {
+    static uint64_t generation_counter = 0;
+    return ++generation_counter;
+  }
 
 public:
-  MockState() : message( "" ), msg_num( 0 ) {}
-  MockState( const std::string& s ) : message( s ), msg_num( 0 ) {}
+  MockState() : message( "" ), msg_num( 0 ), generation( new_generation() ) {}
+  MockState( const std::string& s ) : message( s ), msg_num( 0 ), generation( new_generation() ) {}
 
   /* Get the message */
   std::string get_message() const { return message; }
@@ -60,6 +67,7 @@ public:
   {
     message = s;
     msg_num++;
+    generation = new_generation();
   }
 
   /* Compare states */
@@ -76,12 +84,16 @@ public:
     return message;
   }
 
+  /* Intermediate state within a byte budget - messages are atomic */
+  MockState partial_from( const MockState&, size_t ) const { return *this; }
+
   /* Apply diff */
   void apply_string( const std::string& diff )
   {
     if ( !diff.empty() ) {
       message = diff;
       msg_num++;
+      generation = new_generation();
     }
   }
 
@@ -94,6 +106,9 @@ public:
   /* Subtitle for display */
   std::string subtitle() const { return ""; }
 
+  /* Equal generations imply equal states (required by TransportSender) */
+  uint64_t get_generation() const { return generation; }
+
   /* Subtract common prefix (required by TransportSender) */
   void subtract( const MockState* prefix ) { /* No-op for simple string state */ }
 };
@@ -172,7 +187,7 @@ int run_server( const char* port )
         transport.recv();
 
         /* Check for new remote state */
-        std::string remote_msg = transport.get_latest_remote_state().state.get_message();
+        std::string remote_msg = transport.get_latest_remote_state().state->get_message();
         if ( !remote_msg.empty() ) {
           printf( "Received: %s\n", remote_msg.c_str() );
 
@@ -258,7 +273,7 @@ int run_client( const char* host, const char* port, const char* key )
           transport.recv();
 
           /* Check for response */
-          std::string remote_msg = transport.get_latest_remote_state().state.get_message();
+          std::string remote_msg = transport.get_latest_remote_state().state->get_message();
           if ( !remote_msg.empty() ) {
             printf( "  <- %s\n", remote_msg.c_str() );
           }
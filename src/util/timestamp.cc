@@ -59,6 +59,7 @@
 #endif
 
 static uint64_t millis_cache = -1;
+static bool virtual_clock = false;
 
 uint64_t frozen_timestamp( void )
 {
@@ -69,8 +70,18 @@ uint64_t frozen_timestamp( void )
   return millis_cache;
 }
 
+void set_virtual_timestamp( uint64_t millis )
+{
+  virtual_clock = true;
+  millis_cache = millis;
+}
+
 void freeze_timestamp( void )
 {
+  if ( virtual_clock ) {
+    return;
+  }
+
   // Try all our clock sources till we get something.  This could
   // break if a source only sometimes works in a given process.
 #if HAVE_CLOCK_GETTIME
@@ -38,4 +38,8 @@
 void freeze_timestamp( void );
 uint64_t frozen_timestamp( void );
 
+/* Replace the system clock with a simulated one (for network simulation).
+   Once set, freeze_timestamp() no longer reads the system clock. */
+void set_virtual_timestamp( uint64_t millis );
+
 #endif